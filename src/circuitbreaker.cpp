@@ -0,0 +1,115 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "circuitbreaker.hpp"
+
+#include <glog/logging.h>
+
+namespace charon
+{
+
+bool
+CircuitBreaker::AllowRequest ()
+{
+  std::lock_guard<std::mutex> lock(mut);
+
+  switch (state)
+    {
+    case State::CLOSED:
+      return true;
+
+    case State::OPEN:
+      if (Clock::now () - openedAt < cooldown)
+        return false;
+      VLOG (1) << "Cooldown elapsed, probing with a single call";
+      state = State::HALF_OPEN;
+      return true;
+
+    case State::HALF_OPEN:
+      return false;
+
+    default:
+      LOG (FATAL) << "Unexpected circuit state";
+    }
+}
+
+void
+CircuitBreaker::RecordSuccess ()
+{
+  std::lock_guard<std::mutex> lock(mut);
+
+  if (state != State::CLOSED)
+    LOG (INFO) << "Call succeeded, closing circuit";
+
+  state = State::CLOSED;
+  failures = 0;
+}
+
+void
+CircuitBreaker::RecordFailure ()
+{
+  std::lock_guard<std::mutex> lock(mut);
+
+  switch (state)
+    {
+    case State::CLOSED:
+      ++failures;
+      if (failures < threshold)
+        return;
+      LOG (WARNING) << failures << " failed calls in a row, opening circuit";
+      break;
+
+    case State::HALF_OPEN:
+      LOG (WARNING) << "Probe call failed, keeping circuit open";
+      break;
+
+    case State::OPEN:
+      /* This may happen if calls that were started before the circuit
+         opened fail later on.  Just keep the circuit open, but do not
+         extend the cooldown.  If the cooldown has elapsed, then the call
+         was a probe made without AllowRequest (e.g. after checking
+         IsOpen), and the cooldown starts over.  */
+      if (Clock::now () - openedAt < cooldown)
+        return;
+      LOG (WARNING) << "Call after cooldown failed, keeping circuit open";
+      break;
+
+    default:
+      LOG (FATAL) << "Unexpected circuit state";
+    }
+
+  state = State::OPEN;
+  openedAt = Clock::now ();
+  failures = 0;
+}
+
+bool
+CircuitBreaker::IsOpen () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return state == State::OPEN && Clock::now () - openedAt < cooldown;
+}
+
+CircuitBreaker::State
+CircuitBreaker::GetState () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return state;
+}
+
+} // namespace charon
@@ -0,0 +1,128 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_CIRCUITBREAKER_HPP
+#define CHARON_CIRCUITBREAKER_HPP
+
+#include <chrono>
+#include <mutex>
+
+namespace charon
+{
+
+/**
+ * A circuit breaker for calls to some remote service.  After a number
+ * of consecutive failures, the circuit "opens" and further calls should
+ * fail fast instead of being attempted.  After a cooldown period, a single
+ * probe call is let through; if it succeeds, the circuit closes again,
+ * and if it fails, the cooldown starts over.
+ *
+ * This class is thread-safe.
+ */
+class CircuitBreaker
+{
+
+public:
+
+  /** Clock used for the cooldown.  */
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Possible states of the circuit.
+   */
+  enum class State
+  {
+    /** Calls are attempted normally.  */
+    CLOSED,
+    /** Calls fail fast.  */
+    OPEN,
+    /** A single probe call is in progress.  */
+    HALF_OPEN,
+  };
+
+private:
+
+  /** Number of consecutive failures at which the circuit opens.  */
+  const unsigned threshold;
+
+  /** Time before a probe call is allowed on an open circuit.  */
+  const Clock::duration cooldown;
+
+  /** Mutex for the internal state.  */
+  mutable std::mutex mut;
+
+  /** The current state.  */
+  State state = State::CLOSED;
+
+  /** Number of consecutive failures seen while closed.  */
+  unsigned failures = 0;
+
+  /** Time when the circuit was last opened.  */
+  Clock::time_point openedAt;
+
+public:
+
+  /**
+   * Constructs a closed circuit breaker with the given failure threshold
+   * and cooldown period.
+   */
+  template <typename Rep, typename Period>
+    explicit CircuitBreaker (const unsigned t,
+                             const std::chrono::duration<Rep, Period>& c)
+    : threshold(t), cooldown(std::chrono::duration_cast<Clock::duration> (c))
+  {}
+
+  CircuitBreaker () = delete;
+  CircuitBreaker (const CircuitBreaker&) = delete;
+  void operator= (const CircuitBreaker&) = delete;
+
+  /**
+   * Returns true if a call may be attempted now.  On an open circuit whose
+   * cooldown has elapsed, this lets through a single probe call (and then
+   * the caller must report its result through RecordSuccess or
+   * RecordFailure).
+   */
+  bool AllowRequest ();
+
+  /**
+   * Records a successful call.
+   */
+  void RecordSuccess ();
+
+  /**
+   * Records a failed call.
+   */
+  void RecordFailure ();
+
+  /**
+   * Returns true if the circuit is open and its cooldown has not yet
+   * elapsed, i.e. if AllowRequest would return false.  Unlike AllowRequest,
+   * this does not change the state.
+   */
+  bool IsOpen () const;
+
+  /**
+   * Returns the current state of the circuit.
+   */
+  State GetState () const;
+
+};
+
+} // namespace charon
+
+#endif // CHARON_CIRCUITBREAKER_HPP
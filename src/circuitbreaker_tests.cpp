@@ -0,0 +1,137 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "circuitbreaker.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+namespace charon
+{
+namespace
+{
+
+using State = CircuitBreaker::State;
+
+class CircuitBreakerTests : public testing::Test
+{
+
+protected:
+
+  /** Cooldown period used for the tested breaker.  */
+  static constexpr auto COOLDOWN = std::chrono::milliseconds (50);
+
+  CircuitBreaker breaker;
+
+  CircuitBreakerTests ()
+    : breaker(3, COOLDOWN)
+  {}
+
+  /**
+   * Fails enough calls to open the circuit.
+   */
+  void
+  OpenCircuit ()
+  {
+    for (unsigned i = 0; i < 3; ++i)
+      {
+        ASSERT_TRUE (breaker.AllowRequest ());
+        breaker.RecordFailure ();
+      }
+    ASSERT_EQ (breaker.GetState (), State::OPEN);
+  }
+
+};
+
+constexpr std::chrono::milliseconds CircuitBreakerTests::COOLDOWN;
+
+TEST_F (CircuitBreakerTests, OpensAfterThreshold)
+{
+  EXPECT_EQ (breaker.GetState (), State::CLOSED);
+
+  breaker.RecordFailure ();
+  breaker.RecordFailure ();
+  EXPECT_EQ (breaker.GetState (), State::CLOSED);
+  EXPECT_TRUE (breaker.AllowRequest ());
+
+  breaker.RecordFailure ();
+  EXPECT_EQ (breaker.GetState (), State::OPEN);
+  EXPECT_FALSE (breaker.AllowRequest ());
+}
+
+TEST_F (CircuitBreakerTests, SuccessResetsFailures)
+{
+  breaker.RecordFailure ();
+  breaker.RecordFailure ();
+  breaker.RecordSuccess ();
+  breaker.RecordFailure ();
+  breaker.RecordFailure ();
+  EXPECT_EQ (breaker.GetState (), State::CLOSED);
+}
+
+TEST_F (CircuitBreakerTests, ProbeSuccess)
+{
+  OpenCircuit ();
+  std::this_thread::sleep_for (2 * COOLDOWN);
+
+  ASSERT_TRUE (breaker.AllowRequest ());
+  EXPECT_EQ (breaker.GetState (), State::HALF_OPEN);
+  EXPECT_FALSE (breaker.AllowRequest ());
+
+  breaker.RecordSuccess ();
+  EXPECT_EQ (breaker.GetState (), State::CLOSED);
+  EXPECT_TRUE (breaker.AllowRequest ());
+}
+
+TEST_F (CircuitBreakerTests, ProbeFailure)
+{
+  OpenCircuit ();
+  std::this_thread::sleep_for (2 * COOLDOWN);
+
+  ASSERT_TRUE (breaker.AllowRequest ());
+  breaker.RecordFailure ();
+  EXPECT_EQ (breaker.GetState (), State::OPEN);
+  EXPECT_FALSE (breaker.AllowRequest ());
+
+  std::this_thread::sleep_for (2 * COOLDOWN);
+  EXPECT_TRUE (breaker.AllowRequest ());
+}
+
+TEST_F (CircuitBreakerTests, IsOpen)
+{
+  EXPECT_FALSE (breaker.IsOpen ());
+  OpenCircuit ();
+  EXPECT_TRUE (breaker.IsOpen ());
+
+  std::this_thread::sleep_for (2 * COOLDOWN);
+  EXPECT_FALSE (breaker.IsOpen ());
+  EXPECT_EQ (breaker.GetState (), State::OPEN);
+
+  /* A failure after the cooldown restarts it.  */
+  breaker.RecordFailure ();
+  EXPECT_TRUE (breaker.IsOpen ());
+
+  std::this_thread::sleep_for (2 * COOLDOWN);
+  breaker.RecordSuccess ();
+  EXPECT_EQ (breaker.GetState (), State::CLOSED);
+}
+
+} // anonymous namespace
+} // namespace charon
@@ -18,6 +18,11 @@
 
 #include "client.hpp"
 
+#include "circuitbreaker.hpp"
+#include "compactjson.hpp"
+#include "histogram.hpp"
+#include "laneselector.hpp"
+#include "notificationfilter.hpp"
 #include "private/pubsub.hpp"
 #include "private/stanzas.hpp"
 #include "xmppclient.hpp"
@@ -27,17 +32,25 @@
 #include <gloox/iqhandler.h>
 #include <gloox/jid.h>
 #include <gloox/message.h>
+#include <gloox/messagehandler.h>
 #include <gloox/presence.h>
 #include <gloox/presencehandler.h>
+#include <gloox/tag.h>
 
 #include <jsonrpccpp/common/errors.h>
 
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
+#include <iterator>
 #include <mutex>
+#include <random>
 #include <sstream>
 #include <thread>
+#include <tuple>
 #include <vector>
 
 namespace charon
@@ -54,6 +67,12 @@ constexpr auto DEFAULT_TIMEOUT = std::chrono::seconds (3);
 /** Timeout for waitforchange calls on the client side.  */
 constexpr auto WAITFORCHANGE_TIMEOUT = std::chrono::seconds (5);
 
+/** Clock type used for all timeout measurements.  */
+using Clock = std::chrono::steady_clock;
+
+/** Time for which a connection is avoided after a call on it failed.  */
+constexpr auto LANE_FAILURE_COOLDOWN = std::chrono::seconds (10);
+
 /**
  * Abstraction of a started operation that times out after some time.  It also
  * has condition-variable functionality which allows to wait on it (and to
@@ -65,9 +84,6 @@ class TimedConditionVariable
 
 private:
 
-  /** Clock type used for all measurements.  */
-  using Clock = std::chrono::steady_clock;
-
   /** Time point of Clock when this reaches timeout.  */
   Clock::time_point endTime;
 
@@ -101,6 +117,18 @@ public:
       cv.wait_until (lock, endTime);
   }
 
+  /**
+   * Waits on the condition variable like Wait, but at most until
+   * the given time limit (if that is before our own end time).
+   */
+  void
+  Wait (std::unique_lock<std::mutex>& lock, const Clock::time_point limit)
+  {
+    const auto until = std::min (endTime, limit);
+    if (Clock::now () < until)
+      cv.wait_until (lock, until);
+  }
+
   /**
    * Notifies all waiting threads.
    */
@@ -166,6 +194,9 @@ struct OngoingRpcCall
   /** If success, the RPC result.  */
   Json::Value result;
 
+  /** If success, the cursor for more items of a paged result.  */
+  std::string cursor;
+
   /** If error, the thrown error.  */
   RpcServer::Error error;
 
@@ -261,8 +292,14 @@ RpcResultHandler::handleIqID (const gloox::IQ& iq, const int context)
 
   if (ext->IsSuccess ())
     {
+      if (ext->IsStale ())
+        LOG (WARNING)
+            << "Server " << iq.from ().full ()
+            << " returned a stale result, its backend is unavailable";
+
       call->state = OngoingRpcCall::State::RESPONSE_SUCCESS;
       call->result = ext->GetResult ();
+      call->cursor = ext->GetCursor ();
     }
   else
     {
@@ -277,6 +314,150 @@ RpcResultHandler::handleIqID (const gloox::IQ& iq, const int context)
 
 /* ************************************************************************** */
 
+/**
+ * Data for an ongoing registration with the server, either of a notification
+ * filter or for direct push of the notifications.
+ */
+struct OngoingRegistration
+{
+
+  /** Condition variable (and timeout) for the response.  */
+  TimedConditionVariable cv;
+
+  /** Mutex for the condition variable.  */
+  std::mutex mut;
+
+  /** Set to true when we have a response (success or not).  */
+  bool done = false;
+
+  /** The node returned by the server, or empty on failure.  */
+  std::string node;
+
+  /** For direct push, whether the server accepted the registration.  */
+  bool accepted = false;
+
+  template <typename Rep, typename Period>
+    explicit OngoingRegistration (const std::chrono::duration<Rep, Period>& t)
+      : cv(t)
+  {}
+
+};
+
+/**
+ * IQ handler that waits for the response to a filter registration.
+ */
+class FilterResultHandler : public gloox::IqHandler
+{
+
+private:
+
+  /** The call that we update when the response arrives.  */
+  std::shared_ptr<OngoingRegistration> call;
+
+public:
+
+  explicit FilterResultHandler (std::shared_ptr<OngoingRegistration> c)
+    : call(c)
+  {}
+
+  FilterResultHandler () = delete;
+  FilterResultHandler (const FilterResultHandler&) = delete;
+  void operator= (const FilterResultHandler&) = delete;
+
+  bool handleIq (const gloox::IQ& iq) override;
+  void handleIqID (const gloox::IQ& iq, int context) override;
+
+};
+
+bool
+FilterResultHandler::handleIq (const gloox::IQ& iq)
+{
+  LOG (WARNING) << "Ignoring IQ without id";
+  return false;
+}
+
+void
+FilterResultHandler::handleIqID (const gloox::IQ& iq, const int context)
+{
+  std::lock_guard<std::mutex> lock(call->mut);
+  if (call->done)
+    {
+      LOG (WARNING) << "Ignoring IQ for finished filter registration";
+      return;
+    }
+  call->done = true;
+
+  const auto* ext
+      = iq.findExtension<FilterRegistration> (FilterRegistration::EXT_TYPE);
+  if (iq.subtype () != gloox::IQ::Result || ext == nullptr
+        || !ext->IsValid () || ext->GetNode ().empty ())
+    LOG (WARNING)
+        << "Server " << iq.from ().full ()
+        << " did not accept our notification filter";
+  else
+    call->node = ext->GetNode ();
+
+  call->cv.Notify ();
+}
+
+/**
+ * IQ handler that waits for the response to a direct push registration.
+ */
+class DirectResultHandler : public gloox::IqHandler
+{
+
+private:
+
+  /** The call that we update when the response arrives.  */
+  std::shared_ptr<OngoingRegistration> call;
+
+public:
+
+  explicit DirectResultHandler (std::shared_ptr<OngoingRegistration> c)
+    : call(c)
+  {}
+
+  DirectResultHandler () = delete;
+  DirectResultHandler (const DirectResultHandler&) = delete;
+  void operator= (const DirectResultHandler&) = delete;
+
+  bool handleIq (const gloox::IQ& iq) override;
+  void handleIqID (const gloox::IQ& iq, int context) override;
+
+};
+
+bool
+DirectResultHandler::handleIq (const gloox::IQ& iq)
+{
+  LOG (WARNING) << "Ignoring IQ without id";
+  return false;
+}
+
+void
+DirectResultHandler::handleIqID (const gloox::IQ& iq, const int context)
+{
+  std::lock_guard<std::mutex> lock(call->mut);
+  if (call->done)
+    {
+      LOG (WARNING) << "Ignoring IQ for finished direct push registration";
+      return;
+    }
+  call->done = true;
+
+  const auto* ext
+      = iq.findExtension<DirectRegistration> (DirectRegistration::EXT_TYPE);
+  if (iq.subtype () != gloox::IQ::Result || ext == nullptr || !ext->IsValid ())
+    LOG (WARNING)
+        << "Server " << iq.from ().full ()
+        << " did not accept our direct push registration";
+  else
+    call->accepted = true;
+
+  call->cv.Notify ();
+}
+
+/* ************************************************************************** */
+
 /**
  * The current state for some notification type.  This class keeps track of
  * the known state, updates it when server notifications come in, and also is
@@ -290,6 +471,29 @@ private:
   /** NotificationType instance that we use.  */
   std::unique_ptr<NotificationType> notification;
 
+  /** The filter applied to received states (if any).  */
+  std::unique_ptr<NotificationFilter> filter;
+
+  /**
+   * Estimated offset of the server's clock relative to ours (in ms),
+   * used to correct the server timestamps on updates.
+   */
+  const std::atomic<std::int64_t>& clockOffset;
+
+  /** Lag from the server receiving a state until we get it.  */
+  Histogram lagTotal;
+
+  /** Lag from the server publishing a state until we get it.  */
+  Histogram lagDelivery;
+
+  /** Listeners to inform about new states.  */
+  const std::vector<Client::NotificationListener>& listeners;
+
+  /**
+   * Records the lag of an update with server timestamps.
+   */
+  void RecordLag (const NotificationUpdate& upd);
+
   /** Mutex for this instance.  */
   std::mutex mut;
 
@@ -303,22 +507,42 @@ private:
    */
   bool hasState = false;
 
-  /** The current state as JSON value.  */
-  Json::Value state;
+  /**
+   * The current state.  It is stored in compact form, since it is held
+   * until the next update and only converted when a waiter returns.
+   */
+  CompactJson state;
+
+  /** The state ID extracted from the current state.  */
+  Json::Value stateId;
 
 public:
 
   /**
    * Constructs a new instance for the given notification type.
    */
-  explicit NotificationState (std::unique_ptr<NotificationType> n)
-    : notification(std::move (n))
+  explicit NotificationState (
+      std::unique_ptr<NotificationType> n,
+      std::unique_ptr<NotificationFilter> f,
+      const std::atomic<std::int64_t>& offs,
+      const std::vector<Client::NotificationListener>& l)
+    : notification(std::move (n)), filter(std::move (f)), clockOffset(offs),
+      listeners(l)
   {}
 
   NotificationState () = delete;
   NotificationState (const NotificationState&) = delete;
   void operator= (const NotificationState&) = delete;
 
+  /**
+   * Returns the filter for this notification, or null if it is unfiltered.
+   */
+  const NotificationFilter*
+  GetFilter () const
+  {
+    return filter.get ();
+  }
+
   /**
    * Waits (up to our predefined timeout) until the state changes.  Returns
    * immediately if the current state does not match the given known ID.
@@ -326,13 +550,67 @@ public:
   Json::Value WaitForChange (const Json::Value& known);
 
   /**
-   * Returns a pubsub ItemCallback that will set our state to the passed in
-   * new state and notify waiters.
+   * Checks if the current state does not match the given known ID, i.e.
+   * a wait would return immediately.  If so, returns true and sets
+   * the current state.
+   */
+  bool CheckOutdated (const Json::Value& known, Json::Value& current);
+
+  /**
+   * Returns the current state.
+   */
+  Json::Value GetState ();
+
+  /**
+   * Processes a received pubsub item with an update, setting our state to
+   * the new state and notifying waiters and listeners.
+   */
+  void ProcessItem (const gloox::Tag& t);
+
+  /**
+   * Returns a pubsub ItemCallback that processes the items with ProcessItem.
+   */
+  PubSubImpl::ItemCallback
+  GetItemCallback ()
+  {
+    return [this] (const gloox::Tag& t)
+      {
+        ProcessItem (t);
+      };
+  }
+
+  /**
+   * Returns the lag histograms as JSON.
    */
-  PubSubImpl::ItemCallback GetItemCallback ();
+  Json::Value GetLagStats () const;
 
 };
 
+void
+NotificationState::RecordLag (const NotificationUpdate& upd)
+{
+  const std::int64_t now = GetTimestampMs () + clockOffset;
+
+  const auto total = std::max<std::int64_t> (0, now - upd.GetReceived ());
+  const auto delivery = std::max<std::int64_t> (0, now - upd.GetPublished ());
+
+  VLOG (1)
+      << "Lag for " << notification->GetType () << ": " << total
+      << " ms total, " << delivery << " ms delivery";
+
+  lagTotal.Record (total);
+  lagDelivery.Record (delivery);
+}
+
+Json::Value
+NotificationState::GetLagStats () const
+{
+  Json::Value res(Json::objectValue);
+  res["total"] = lagTotal.ToJson ();
+  res["delivery"] = lagDelivery.ToJson ();
+  return res;
+}
+
 Json::Value
 NotificationState::WaitForChange (const Json::Value& known)
 {
@@ -340,133 +618,514 @@ NotificationState::WaitForChange (const Json::Value& known)
 
   if (hasState && known != notification->AlwaysBlockId ())
     {
-      const auto stateId = notification->ExtractStateId (state);
       if (known != stateId)
         {
           VLOG (1)
               << "Current state ID " << stateId
               << " does not match known " << known;
-          return state;
+          return state.ToJson ();
         }
     }
 
   VLOG (1) << "Starting wait for " << notification->GetType () << "...";
 
   cv.wait_for (lock, WAITFORCHANGE_TIMEOUT);
-  return state;
+  return state.ToJson ();
+}
+
+bool
+NotificationState::CheckOutdated (const Json::Value& known,
+                                  Json::Value& current)
+{
+  std::lock_guard<std::mutex> lock(mut);
+
+  if (!hasState || known == notification->AlwaysBlockId ()
+        || known == stateId)
+    return false;
+
+  current = state.ToJson ();
+  return true;
+}
+
+Json::Value
+NotificationState::GetState ()
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return state.ToJson ();
 }
 
-PubSubImpl::ItemCallback
-NotificationState::GetItemCallback ()
+void
+NotificationState::ProcessItem (const gloox::Tag& t)
 {
-  return [this] (const gloox::Tag& t)
+  const auto& type = notification->GetType ();
+
+  VLOG (1)
+      << "Processing update notification for " << type << ":\n" << t.xml ();
+
+  const auto* updTag = t.findChild ("update");
+  if (updTag == nullptr)
+    {
+      LOG (WARNING)
+          << "Ignoring update without our payload:\n" << t.xml ();
+      return;
+    }
+
+  const NotificationUpdate upd(*updTag);
+  if (!upd.IsValid ())
     {
-      const auto& type = notification->GetType ();
+      LOG (WARNING)
+          << "Ignoring invalid payload update:\n" << t.xml ();
+      return;
+    }
 
-      VLOG (1)
-          << "Processing update notification for " << type << ":\n" << t.xml ();
+  if (upd.GetType () != type)
+    {
+      LOG (WARNING)
+          << "Ignoring update for different type (got " << upd.GetType ()
+          << ", waiting for " << type << "):\n"
+          << t.xml ();
+      return;
+    }
 
-      const auto* updTag = t.findChild ("update");
-      if (updTag == nullptr)
-        {
-          LOG (WARNING)
-              << "Ignoring update without our payload:\n" << t.xml ();
-          return;
-        }
+  if (upd.HasTimestamps ())
+    RecordLag (upd);
 
-      const NotificationUpdate upd(*updTag);
-      if (!upd.IsValid ())
-        {
-          LOG (WARNING)
-              << "Ignoring invalid payload update:\n" << t.xml ();
-          return;
-        }
+  /* We apply the filter also if the server already did, so that the
+     state is the same even if we fall back to the unfiltered node.  */
+  Json::Value newState = upd.GetState ();
+  if (filter != nullptr)
+    newState = filter->Apply (newState);
 
-      if (upd.GetType () != type)
-        {
-          LOG (WARNING)
-              << "Ignoring update for different type (got " << upd.GetType ()
-              << ", waiting for " << type << "):\n"
-              << t.xml ();
-          return;
-        }
+  CompactJson compact(newState);
+  const auto newId = notification->ExtractStateId (newState);
 
-      std::lock_guard<std::mutex> lock(mut);
-      hasState = true;
-      state = upd.GetState ();
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    /* An unchanged state can be seen if a filter removed the difference,
+       and also if the same update arrives both through the primary
+       and the standby subscription.  */
+    if (hasState && compact == state)
+      {
+        VLOG (1) << "State for " << type << " is unchanged";
+        return;
+      }
 
-      LOG (INFO) << "Found new state for " << type;
-      VLOG (1) << "New state:\n" << state;
+    hasState = true;
+    state = std::move (compact);
+    stateId = newId;
+
+    LOG (INFO) << "Found new state for " << type;
+    VLOG (1) << "New state:\n" << newState;
+
+    cv.notify_all ();
+  }
 
-      cv.notify_all ();
-    };
+  for (const auto& l : listeners)
+    l (type, newState);
 }
 
-} // anonymous namespace
+/* ************************************************************************** */
+
+/**
+ * Position in a result that the server split into pages:  The stream and
+ * server instance the call went to (which hold the remaining pages for
+ * us), and the cursor and offset for fetching the next one.
+ */
+struct PageCursor
+{
+
+  /** The stream through which the call was sent.  */
+  XmppClient* stream = nullptr;
+
+  /** The server instance that returned the result.  */
+  gloox::JID server;
+
+  /** The cursor for the next page, or empty if the result is complete.  */
+  std::string cursor;
+
+  /** Number of items received so far, i.e. the offset of the next page.  */
+  std::uint64_t offset = 0;
+
+  /** Deadline for fetching the next page (including retries).  */
+  Clock::time_point deadline;
+
+};
 
 /* ************************************************************************** */
 
 /**
- * Main implementation logic for the Client class.  This holds all the
- * stuff that is dependent on gloox and other private libraries.
+ * An additional XMPP connection of a client, which is used to send
+ * forwarded RPC calls (and possibly as standby for notifications).  Each
+ * lane has its own stream, receive thread and lock, and the IQ responses
+ * arriving on it are matched by gloox to the handlers of the calls sent
+ * through it.  Lanes may be on the same account as the main connection
+ * or on other accounts (e.g. on another XMPP server).
  */
-class Client::Impl : public XmppClient,
-                     private gloox::PresenceHandler
+class CallLane : public XmppClient
 {
 
 private:
 
-  class ConnectionAttempt;
-
-  /** Reference to the corresponding Client class.  */
-  Client& client;
+  /** Lock for serialising connection attempts.  */
+  std::mutex connectMut;
 
   /**
-   * Mutex used to synchronise all threads, as well as for the various
-   * condition variables.
+   * The server instance to which we have announced ourselves on the
+   * current connection (or an invalid JID if none).  This is only accessed
+   * through RunWithClient, so that it is synchronised with the receive
+   * thread (which may trigger HandleDisconnect).
    */
-  std::mutex mut;
+  gloox::JID pingedServer;
 
-  /** If true, then some thread is currently attempting to Connect to XMPP.  */
-  bool connecting = false;
-  /** Condition variable signalled when a connection attempt is done.  */
-  std::condition_variable cvConnecting;
+  /** Lock for standbyNodes.  */
+  std::mutex standbyMut;
 
   /**
-   * The selected, full JID of the server we talk to.  This may be equal to
-   * client.serverJid and not yet have an associated resource, in which case
-   * attempts to send requests will first send a ping and try to set a resource
-   * here from the processed pong message.
+   * Pubsub nodes to which the lane is subscribed as standby for the main
+   * connection, with their item callbacks.
    */
-  gloox::JID fullServerJid;
+  std::vector<std::pair<std::string, PubSubImpl::ItemCallback>> standbyNodes;
 
   /**
-   * Threads that are currently running pubsub subscriptions or have run some
-   * in the past.  We mostly just collect threads here that will finish by
-   * themselves and be joined in the destructor, although we also explicitly
-   * join them in some situations (e.g. when GetServerResource is called
-   * explicitly to force server selection).
+   * Subscribes to a standby node on the current connection.
    */
-  std::vector<std::thread> subscribeCalls;
+  void
+  SubscribeStandbyNode (const std::string& node,
+                        const PubSubImpl::ItemCallback& cb)
+  {
+    LOG (INFO)
+        << "Subscribing to node " << node << " as standby on "
+        << GetJID ().full ();
+    if (!GetPubSub ().SubscribeToNode (node, cb))
+      LOG (WARNING) << "Standby subscription to " << node << " failed";
+  }
 
-  /**
-   * If there is an on-going ping operation, then this holds a pointer to its
-   * condition variable.
-   */
-  std::weak_ptr<TimedConditionVariable> ongoingPing;
+protected:
 
-  /** Current states for all the enabled notifications.  */
-  std::map<std::string, std::unique_ptr<NotificationState>> states;
+  void
+  HandleDisconnect () override
+  {
+    RunWithClient ([this] (gloox::Client& c)
+      {
+        pingedServer = gloox::JID ();
+      });
+  }
 
-  void handlePresence (const gloox::Presence& p) override;
+public:
+
+  explicit CallLane (const gloox::JID& jid, const std::string& pwd)
+    : XmppClient(jid, pwd)
+  {
+    RunWithClient ([] (gloox::Client& c)
+      {
+        c.registerStanzaExtension (new RpcRequest ());
+        c.registerStanzaExtension (new RpcResponse ());
+        c.registerStanzaExtension (new PingMessage ());
+        c.registerStanzaExtension (new PongMessage ());
+        c.registerStanzaExtension (new PageRequest ());
+      });
+  }
 
   /**
-   * Returns true if we have a full server JID selected.
+   * Disconnects explicitly, so that the receive thread is stopped before
+   * our members are destructed.
    */
-  bool
-  HasFullServerJid () const
+  ~CallLane ()
   {
-    return !fullServerJid.resource ().empty ();
+    Disconnect ();
+  }
+
+  /**
+   * Connects the lane if it is not connected yet.  Returns false if
+   * that failed.  On a new connection, the standby subscriptions (if any)
+   * are renewed.
+   */
+  bool
+  EnsureConnected ()
+  {
+    std::lock_guard<std::mutex> lock(connectMut);
+    if (IsConnected ())
+      return true;
+
+    /* Like the main connection, lanes never want to receive stanzas
+       for the bare JID.  */
+    if (!Connect (-1))
+      return false;
+
+    std::lock_guard<std::mutex> standbyLock(standbyMut);
+    for (const auto& entry : standbyNodes)
+      SubscribeStandbyNode (entry.first, entry.second);
+
+    return true;
+  }
+
+  /**
+   * Sets the pubsub service for standby subscriptions, dropping any
+   * existing ones.  This must not be called while subscriptions through
+   * SubscribeStandby are running.
+   */
+  void
+  SetStandbyService (const gloox::JID& service)
+  {
+    std::lock_guard<std::mutex> lock(standbyMut);
+    standbyNodes.clear ();
+    AddPubSub (service);
+  }
+
+  /**
+   * Subscribes to the given node as standby for the main connection.
+   * If the lane is not connected, the subscription is done when
+   * it connects.
+   */
+  void
+  SubscribeStandby (const std::string& node,
+                    const PubSubImpl::ItemCallback& cb)
+  {
+    std::lock_guard<std::mutex> lock(standbyMut);
+    standbyNodes.emplace_back (node, cb);
+    if (IsConnected ())
+      SubscribeStandbyNode (node, cb);
+  }
+
+  /**
+   * Makes sure the lane is connected and that the given server instance
+   * knows about it, so that calls can be sent to the server through it.
+   * The server needs our ping for the capabilities to use in its responses,
+   * and our directed presence so that it notices when the lane goes away.
+   * Returns false if the lane is not usable.
+   */
+  bool
+  Prepare (const gloox::JID& server)
+  {
+    if (!EnsureConnected ())
+      return false;
+
+    RunWithClient ([this, &server] (gloox::Client& c)
+      {
+        if (pingedServer == server)
+          return;
+
+        gloox::Message msg(gloox::Message::Normal, server);
+        auto ping = std::make_unique<PingMessage> ();
+        ping->SetCapabilities (Capabilities::Own ());
+        msg.addExtension (ping.release ());
+        c.send (msg);
+
+        gloox::Presence pres(gloox::Presence::Available, server);
+        c.send (pres);
+
+        pingedServer = server;
+      });
+
+    return true;
+  }
+
+};
+
+/**
+ * Selects the pubsub service to subscribe on from those offered by
+ * a server (the main one and the alternatives that have nodes for all
+ * notifications), and returns it together with its nodes.  The first
+ * preferred service that is offered is used.  If there is none, one of
+ * the offered services is picked at random, so that subscribers are
+ * spread evenly over them.
+ */
+std::string
+SelectPubSubService (const SupportedNotifications& sn,
+                     const std::vector<std::string>& preferred,
+                     std::map<std::string, std::string>& nodes)
+{
+  const auto& main = sn.GetNotifications ();
+
+  std::map<std::string, const std::map<std::string, std::string>*> offered;
+  offered.emplace (sn.GetService (), &main);
+  for (const auto& entry : sn.GetAlternatives ())
+    {
+      bool complete = true;
+      for (const auto& n : main)
+        if (entry.second.count (n.first) == 0)
+          complete = false;
+
+      if (complete)
+        offered.emplace (entry.first, &entry.second);
+      else
+        LOG (WARNING)
+            << "Alternative pubsub service " << entry.first
+            << " does not have all notifications";
+    }
+
+  auto selected = offered.end ();
+  for (const auto& p : preferred)
+    {
+      selected = offered.find (p);
+      if (selected != offered.end ())
+        break;
+    }
+
+  if (selected == offered.end ())
+    {
+      std::random_device rnd;
+      std::uniform_int_distribution<size_t> dist(0, offered.size () - 1);
+      selected = std::next (offered.begin (), dist (rnd));
+    }
+
+  nodes = *selected->second;
+  return selected->first;
+}
+
+} // anonymous namespace
+
+/* ************************************************************************** */
+
+/**
+ * Main implementation logic for the Client class.  This holds all the
+ * stuff that is dependent on gloox and other private libraries.
+ */
+class Client::Impl : public XmppClient,
+                     private gloox::MessageHandler,
+                     private gloox::PresenceHandler
+{
+
+private:
+
+  class ConnectionAttempt;
+
+  /** Reference to the corresponding Client class.  */
+  Client& client;
+
+  /**
+   * Mutex used to synchronise all threads, as well as for the various
+   * condition variables.
+   */
+  std::mutex mut;
+
+  /** If true, then some thread is currently attempting to Connect to XMPP.  */
+  bool connecting = false;
+  /** Condition variable signalled when a connection attempt is done.  */
+  std::condition_variable cvConnecting;
+
+  /**
+   * The selected, full JID of the server we talk to.  This may be equal to
+   * client.serverJid and not yet have an associated resource, in which case
+   * attempts to send requests will first send a ping and try to set a resource
+   * here from the processed pong message.
+   */
+  gloox::JID fullServerJid;
+
+  /**
+   * Capabilities negotiated with the selected server, based on its pong.
+   * If no server is selected, this is the legacy set.
+   */
+  Capabilities serverCapabilities;
+
+  /**
+   * Threads that are currently running pubsub subscriptions or have run some
+   * in the past.  We mostly just collect threads here that will finish by
+   * themselves and be joined in the destructor, although we also explicitly
+   * join them in some situations (e.g. when GetServerResource is called
+   * explicitly to force server selection).
+   */
+  std::vector<std::thread> subscribeCalls;
+
+  /**
+   * If there is an on-going ping operation, then this holds a pointer to its
+   * condition variable.
+   */
+  std::weak_ptr<TimedConditionVariable> ongoingPing;
+
+  /** Current states for all the enabled notifications.  */
+  std::map<std::string, std::unique_ptr<NotificationState>> states;
+
+  /**
+   * Listeners for new notification states.  These are added before
+   * connecting and not modified afterwards.
+   */
+  std::vector<Client::NotificationListener> listeners;
+
+  /** Mutex for changeCounts.  */
+  std::mutex changeMut;
+
+  /** Condition variable signalled when any notification state changes.  */
+  std::condition_variable changeCv;
+
+  /**
+   * Number of state changes seen so far for each notification type.  This is
+   * used by WaitForAnyChange to detect which of the notifications changed.
+   */
+  std::map<std::string, uint64_t> changeCounts;
+
+  /** Time when the last ping was sent.  */
+  Clock::time_point pingSent;
+
+  /**
+   * Estimated offset of the selected server's clock relative to ours
+   * (in milliseconds), based on the ping/pong round trip.
+   */
+  std::atomic<std::int64_t> clockOffset;
+
+  /**
+   * Circuit breakers for the server instances we have talked to, keyed
+   * by their full JID.  This is only used if breakers are enabled.
+   */
+  std::map<std::string, std::unique_ptr<CircuitBreaker>> breakers;
+
+  /**
+   * Random prefix for the IDs of our requests.  This makes sure that IDs
+   * are not reused by a restarted client (with the same JID) while the
+   * server might still remember them.
+   */
+  std::string requestIdPrefix;
+
+  /** Counter for the IDs of our requests.  */
+  std::atomic<std::uint64_t> nextRequestId;
+
+  /** The password for our JID, which the call lanes use as well.  */
+  std::string password;
+
+  /** Root CA file configured for our streams (empty for the default).  */
+  std::string rootCA;
+
+  /** Whether stream compression is enabled for our streams.  */
+  bool streamCompression = true;
+
+  /**
+   * Additional connections over which forwarded calls are distributed
+   * (in addition to the main connection).  These are set up before
+   * connecting and not modified afterwards.
+   */
+  std::vector<std::unique_ptr<CallLane>> lanes;
+
+  /**
+   * Selector for the connection used by forwarded calls.  Lane zero is
+   * the main connection, and lane i is lanes[i - 1].
+   */
+  std::unique_ptr<LaneSelector> selector;
+
+  /**
+   * The lane that keeps standby subscriptions for our notifications, so
+   * that they continue if the main connection fails.  This is the first
+   * endpoint added (if any).
+   */
+  CallLane* standby = nullptr;
+
+  /**
+   * The last selected server instance.  Unlike fullServerJid, this is kept
+   * when the main connection is lost, so that calls can still be sent
+   * to it through other lanes meanwhile.
+   */
+  gloox::JID lastServerJid;
+
+  void handleMessage (const gloox::Message& msg,
+                      gloox::MessageSession* session) override;
+  void handlePresence (const gloox::Presence& p) override;
+
+  /**
+   * Returns true if we have a full server JID selected.
+   */
+  bool
+  HasFullServerJid () const
+  {
+    return !fullServerJid.resource ().empty ();
   }
 
   /**
@@ -482,18 +1141,70 @@ private:
    */
   void SetSelectedServer (std::unique_lock<std::mutex>& lock,
                           const gloox::JID& jid,
-                          const SupportedNotifications* sn);
+                          const SupportedNotifications* sn,
+                          const Capabilities& caps);
+
+  /**
+   * Returns the circuit breaker for the given server instance, creating
+   * it if necessary.  Returns null if breakers are not enabled.  Must be
+   * called with mut held.
+   */
+  CircuitBreaker* GetBreaker (const gloox::JID& jid);
+
+  /**
+   * Records the outcome of a call to the given server instance.  On failure,
+   * the server is also unselected (if it is still the selected one), so that
+   * the next call will select a server anew.
+   */
+  void ReportServerResult (const gloox::JID& jid, bool success);
 
   /**
    * Tries to ensure that we have an active XMPP connection and also a
    * fullServerJid set.  If none is set yet, we send a ping or wait for the
    * completion of an existing ping.  If the client is not even connected
-   * to XMPP yet, we connect.
+   * to XMPP yet, we connect.  Waiting for a ping is limited by the given
+   * deadline (if it is earlier than the ping's own timeout).
    *
    * Returns the server JID to send requests to, or an invalid JID if we
    * could not detect a server or connect.
    */
-  gloox::JID EnsureConnected ();
+  gloox::JID EnsureConnected (Clock::time_point deadline);
+
+  /**
+   * Calls EnsureConnected with the default timeout.
+   */
+  gloox::JID
+  EnsureConnected ()
+  {
+    return EnsureConnected (Clock::now () + client.timeout);
+  }
+
+  /**
+   * Performs a single attempt at forwarding an RPC call, using the given
+   * timeout for the response and deadline for server selection.  Returns
+   * true and sets the result on success.  Throws errors that should be
+   * returned to the caller directly, and returns false (with err set)
+   * for failures that may be retried with another server.
+   *
+   * If id is not empty, it is sent as request ID.  It should be the same
+   * for all attempts of the same call, so that the server can avoid
+   * executing it more than once.
+   *
+   * The call is sent through the given lane (as index into the selector).
+   * The main connection is used instead if the lane cannot be connected,
+   * in which case lane is updated to zero.
+   */
+  bool TryForwardMethod (const std::string& method, const Json::Value& params,
+                         const std::string& id, unsigned& lane,
+                         Client::Duration timeout, Clock::time_point deadline,
+                         Json::Value& result, PageCursor& pages,
+                         RpcServer::Error& err);
+
+  /**
+   * Makes sure that notifications are received, by connecting and
+   * selecting a server if needed.  Throws if that is not possible.
+   */
+  void EnsureNotifications ();
 
   /**
    * Forces all ongoing node subscriptions to be finished.  The caller is
@@ -502,6 +1213,34 @@ private:
    */
   void FinishSubscriptions (std::unique_lock<std::mutex>& lock);
 
+  /**
+   * Asks the given server instance to publish a filtered stream for
+   * a notification type, and waits for the response.  Returns the node
+   * of the filtered stream, or an empty string if the server did not
+   * provide one (e.g. because it does not support filters).
+   */
+  std::string RequestFilteredNode (const gloox::JID& jid,
+                                   const std::string& type,
+                                   const NotificationFilter& filter);
+
+  /**
+   * Asks the given server instance to push updates for all our
+   * notifications directly to us, and waits for the response.  Returns
+   * true if the server accepted the registration.
+   */
+  bool RequestDirectPush (const gloox::JID& jid);
+
+  /**
+   * Subscribes to the pubsub node for a notification (both on the main
+   * connection and the standby).  If a filter is given, a filtered stream
+   * is requested first from the server.  This blocks until the
+   * subscription is done.
+   */
+  void SubscribeNotification (const gloox::JID& jid, const std::string& type,
+                              const std::string& node,
+                              const NotificationFilter* filter,
+                              const PubSubImpl::ItemCallback& cb);
+
 protected:
 
   void HandleDisconnect () override;
@@ -515,7 +1254,81 @@ public:
   /**
    * Enables a new notification.
    */
-  void AddNotification (std::unique_ptr<NotificationType> n);
+  void AddNotification (std::unique_ptr<NotificationType> n,
+                        std::unique_ptr<NotificationFilter> f);
+
+  /**
+   * Adds a listener for new notification states.
+   */
+  void
+  AddNotificationListener (const Client::NotificationListener& l)
+  {
+    listeners.push_back (l);
+  }
+
+  /**
+   * Sets the root CA for all our streams.
+   */
+  void SetStreamsRootCA (const std::string& path);
+
+  /**
+   * Enables or disables compression for all our streams.
+   */
+  void SetStreamsCompression (bool enable);
+
+  /**
+   * Adds a call lane with the given JID and password.
+   */
+  void AddLane (const gloox::JID& jid, const std::string& pwd);
+
+  /**
+   * Adds the given number of call lanes on our own account.
+   */
+  void AddPoolLanes (unsigned n);
+
+  /**
+   * Adds a call lane on another account, which is also used as standby
+   * for notifications if it is the first.
+   */
+  void AddEndpoint (const gloox::JID& jid, const std::string& pwd);
+
+  /**
+   * Returns the JID of the account used by the given lane.
+   */
+  const gloox::JID& GetLaneJID (unsigned lane) const;
+
+  /**
+   * Picks the lane to use for the next forwarded call.
+   */
+  unsigned PickLane ();
+
+  /**
+   * Picks the lane for retrying a call that was last sent through the
+   * given lane.  Only lanes on the same account are considered, since
+   * the server recognises retries by the sender's account and request ID.
+   */
+  unsigned PickRetryLane (unsigned previous);
+
+  /**
+   * Connects the main connection and all call lanes.
+   */
+  void ConnectAll ();
+
+  /**
+   * Disconnects the main connection and all call lanes.
+   */
+  void DisconnectAll ();
+
+  /**
+   * Returns the traffic statistics summed over all our streams.
+   */
+  StreamStatistics GetTotalStreamStatistics ();
+
+  /**
+   * Returns the connection setup statistics of the main connection,
+   * with those of additional connections in "lanes" by their JID.
+   */
+  Json::Value GetAllConnectStats () const;
 
   /**
    * Returns the server's resource and tries to find one if none is there.
@@ -523,21 +1336,66 @@ public:
   std::string GetServerResource ();
 
   /**
-   * Forwards the given RPC call to the server.
+   * Forwards the given RPC call to the server.  If the server returned
+   * only the first page of the result, pages is set to where the rest
+   * can be fetched from (with the call's deadline).
+   */
+  Json::Value ForwardMethod (const std::string& method,
+                             const Json::Value& params, PageCursor& pages);
+
+  /**
+   * Forwards the given RPC call to the server and returns the full result
+   * (fetching all pages if the server split it).
    */
   Json::Value ForwardMethod (const std::string& method,
                              const Json::Value& params);
 
+  /**
+   * Sends a single request for the next page of a split result.  Returns
+   * true and sets page and the cursor for the following one on success.
+   * Returns false with err set if the request failed in a way that can be
+   * retried, and throws for other errors.
+   */
+  bool TryFetchPage (const PageCursor& pages, Client::Duration timeout,
+                     Json::Value& page, std::string& next,
+                     RpcServer::Error& err);
+
+  /**
+   * Fetches the next page of a split result from the server (retrying
+   * failed requests until the cursor's deadline), and updates the cursor.
+   * Throws RpcServer::Error if that fails.
+   */
+  Json::Value FetchPage (PageCursor& pages);
+
   /**
    * Waits for a state change of the given notification type.
    */
   Json::Value WaitForChange (const std::string& type, const Json::Value& known);
 
+  /**
+   * Waits for a state change of any of the given notifications.
+   */
+  bool WaitForAnyChange (const std::map<std::string, Json::Value>& known,
+                         std::string& type, Json::Value& state);
+
+  /**
+   * Returns the lag histograms of all notifications.
+   */
+  Json::Value GetNotificationLag () const;
+
 };
 
 Client::Impl::Impl (Client& p, const gloox::JID& jid, const std::string& pwd)
-  : XmppClient(jid, pwd), client(p), fullServerJid(client.serverJid)
+  : XmppClient(jid, pwd), client(p), fullServerJid(client.serverJid),
+    serverCapabilities(Capabilities::Legacy ()), clockOffset(0),
+    nextRequestId(0), password(pwd),
+    selector(std::make_unique<LaneSelector> (1, LANE_FAILURE_COOLDOWN))
 {
+  std::random_device rnd;
+  std::ostringstream prefix;
+  prefix << std::hex << rnd () << rnd ();
+  requestIdPrefix = prefix.str ();
+
   RunWithClient ([this] (gloox::Client& c)
     {
       c.registerStanzaExtension (new RpcRequest ());
@@ -545,9 +1403,21 @@ Client::Impl::Impl (Client& p, const gloox::JID& jid, const std::string& pwd)
       c.registerStanzaExtension (new PingMessage ());
       c.registerStanzaExtension (new PongMessage ());
       c.registerStanzaExtension (new SupportedNotifications ());
+      c.registerStanzaExtension (new FilterRegistration ());
+      c.registerStanzaExtension (new DirectRegistration ());
+      c.registerStanzaExtension (new PushedUpdate ());
+      c.registerStanzaExtension (new PageRequest ());
 
+      c.registerMessageHandler (this);
       c.registerPresenceHandler (this);
     });
+
+  listeners.push_back ([this] (const std::string& type, const Json::Value& s)
+    {
+      std::lock_guard<std::mutex> lock(changeMut);
+      ++changeCounts[type];
+      changeCv.notify_all ();
+    });
 }
 
 Client::Impl::~Impl ()
@@ -555,6 +1425,7 @@ Client::Impl::~Impl ()
   RunWithClient ([this] (gloox::Client& c)
     {
       c.removePresenceHandler (this);
+      c.removeMessageHandler (this);
     });
 
   std::unique_lock<std::mutex> lock(mut);
@@ -562,10 +1433,161 @@ Client::Impl::~Impl ()
 }
 
 void
-Client::Impl::AddNotification (std::unique_ptr<NotificationType> n)
+Client::Impl::SetStreamsRootCA (const std::string& path)
+{
+  rootCA = path;
+  SetRootCA (path);
+  for (auto& l : lanes)
+    l->SetRootCA (path);
+}
+
+void
+Client::Impl::SetStreamsCompression (const bool enable)
+{
+  streamCompression = enable;
+  SetStreamCompression (enable);
+  for (auto& l : lanes)
+    l->SetStreamCompression (enable);
+}
+
+void
+Client::Impl::AddLane (const gloox::JID& jid, const std::string& pwd)
+{
+  CHECK (!IsConnected ()) << "Call lanes must be set up before connecting";
+
+  auto lane = std::make_unique<CallLane> (jid, pwd);
+  if (!rootCA.empty ())
+    lane->SetRootCA (rootCA);
+  lane->SetStreamCompression (streamCompression);
+  lanes.push_back (std::move (lane));
+
+  selector = std::make_unique<LaneSelector> (lanes.size () + 1,
+                                             LANE_FAILURE_COOLDOWN);
+}
+
+void
+Client::Impl::AddPoolLanes (const unsigned n)
+{
+  for (unsigned i = 1; i <= n; ++i)
+    {
+      /* Without a configured resource, the XMPP server assigns a distinct
+         one to each connection.  Otherwise, we derive one per lane.  */
+      gloox::JID jid = GetJID ();
+      if (!jid.resource ().empty ())
+        jid.setResource (jid.resource () + "-" + std::to_string (i));
+
+      AddLane (jid, password);
+    }
+}
+
+void
+Client::Impl::AddEndpoint (const gloox::JID& jid, const std::string& pwd)
+{
+  AddLane (jid, pwd);
+  if (standby == nullptr)
+    standby = lanes.back ().get ();
+}
+
+const gloox::JID&
+Client::Impl::GetLaneJID (const unsigned lane) const
+{
+  if (lane == 0)
+    return GetJID ();
+
+  CHECK_LE (lane, lanes.size ());
+  return lanes[lane - 1]->GetJID ();
+}
+
+unsigned
+Client::Impl::PickLane ()
+{
+  /* Lanes are reconnected when a call is sent through them, and if that
+     fails, they are avoided for the cooldown period.  The main connection
+     is only preferred while it is connected, since reconnecting it is
+     what we want to avoid blocking calls on.  */
+  return selector->Pick ([this] (const unsigned lane)
+    {
+      return lane > 0 || IsConnected ();
+    });
+}
+
+unsigned
+Client::Impl::PickRetryLane (const unsigned previous)
+{
+  const std::string account = GetLaneJID (previous).bare ();
+  const unsigned lane = selector->Pick ([this, &account] (const unsigned l)
+    {
+      return (l > 0 || IsConnected ()) && GetLaneJID (l).bare () == account;
+    });
+
+  /* If no lane on the account is usable, the selector falls back to the
+     first lane, which may be on another account.  */
+  if (GetLaneJID (lane).bare () != account)
+    return previous;
+
+  return lane;
+}
+
+void
+Client::Impl::ConnectAll ()
+{
+  Connect (-1);
+
+  /* Lanes that fail to connect now are retried when calls are sent
+     through them.  */
+  for (auto& l : lanes)
+    if (!l->EnsureConnected ())
+      LOG (WARNING) << "Failed to connect call lane " << l->GetJID ().full ();
+}
+
+void
+Client::Impl::DisconnectAll ()
+{
+  for (auto& l : lanes)
+    l->Disconnect ();
+  Disconnect ();
+}
+
+StreamStatistics
+Client::Impl::GetTotalStreamStatistics ()
+{
+  auto res = GetStreamStatistics ();
+  for (auto& l : lanes)
+    {
+      const auto cur = l->GetStreamStatistics ();
+      res.xmlBytesSent += cur.xmlBytesSent;
+      res.xmlBytesReceived += cur.xmlBytesReceived;
+      res.wireBytesSent += cur.wireBytesSent;
+      res.wireBytesReceived += cur.wireBytesReceived;
+      res.stanzasSent += cur.stanzasSent;
+      res.stanzasReceived += cur.stanzasReceived;
+    }
+
+  return res;
+}
+
+Json::Value
+Client::Impl::GetAllConnectStats () const
+{
+  auto res = GetConnectStats ();
+  if (!lanes.empty ())
+    {
+      Json::Value laneStats(Json::objectValue);
+      for (const auto& l : lanes)
+        laneStats[l->GetJID ().full ()] = l->GetConnectStats ();
+      res["lanes"] = laneStats;
+    }
+
+  return res;
+}
+
+void
+Client::Impl::AddNotification (std::unique_ptr<NotificationType> n,
+                               std::unique_ptr<NotificationFilter> f)
 {
   const auto& type = n->GetType ();
-  auto s = std::make_unique<NotificationState> (std::move (n));
+  auto s = std::make_unique<NotificationState> (std::move (n), std::move (f),
+                                                 clockOffset, listeners);
   const auto res = states.emplace (type, std::move (s));
   CHECK (res.second) << "Duplicate notification of type " << type;
 }
@@ -605,7 +1627,7 @@ public:
 };
 
 gloox::JID
-Client::Impl::EnsureConnected ()
+Client::Impl::EnsureConnected (const Clock::time_point deadline)
 {
   std::unique_lock<std::mutex> lock(mut);
 
@@ -640,19 +1662,22 @@ Client::Impl::EnsureConnected ()
           const gloox::JID serverJid(client.serverJid);
 
           gloox::Message msg(gloox::Message::Normal, serverJid);
-          msg.addExtension (new PingMessage ());
+          auto ping = std::make_unique<PingMessage> ();
+          ping->SetCapabilities (Capabilities::Own ());
+          msg.addExtension (ping.release ());
 
           c.send (msg);
         });
 
       ongoingPing = ping;
+      pingSent = Clock::now ();
     }
 
   while (true)
     {
-      ping->Wait (lock);
+      ping->Wait (lock, deadline);
 
-      if (ping->IsTimedOut ())
+      if (ping->IsTimedOut () || Clock::now () >= deadline)
         {
           LOG (WARNING) << "Waiting for pong timed out";
           return gloox::JID ();
@@ -666,20 +1691,62 @@ Client::Impl::EnsureConnected ()
     }
 }
 
+CircuitBreaker*
+Client::Impl::GetBreaker (const gloox::JID& jid)
+{
+  if (client.breakerThreshold == 0)
+    return nullptr;
+
+  auto& entry = breakers[jid.full ()];
+  if (entry == nullptr)
+    entry = std::make_unique<CircuitBreaker> (client.breakerThreshold,
+                                              client.breakerCooldown);
+
+  return entry.get ();
+}
+
+void
+Client::Impl::ReportServerResult (const gloox::JID& jid, const bool success)
+{
+  std::lock_guard<std::mutex> lock(mut);
+
+  auto* breaker = GetBreaker (jid);
+  if (breaker != nullptr)
+    {
+      if (success)
+        breaker->RecordSuccess ();
+      else
+        breaker->RecordFailure ();
+    }
+
+  if (!success && lastServerJid == jid)
+    lastServerJid = gloox::JID ();
+
+  if (!success && fullServerJid == jid)
+    {
+      LOG (WARNING) << "Unselecting failed server " << jid.full ();
+      ClearSelectedServer ();
+    }
+}
+
 void
 Client::Impl::ClearSelectedServer ()
 {
   fullServerJid = client.serverJid;
+  serverCapabilities = Capabilities::Legacy ();
 }
 
 void
 Client::Impl::SetSelectedServer (std::unique_lock<std::mutex>& lock,
                                  const gloox::JID& jid,
-                                 const SupportedNotifications* sn)
+                                 const SupportedNotifications* sn,
+                                 const Capabilities& caps)
 {
   CHECK_EQ (jid.bareJID (), fullServerJid.bareJID ());
 
   fullServerJid = jid;
+  lastServerJid = jid;
+  serverCapabilities = caps;
   LOG (INFO)
       << "Found full server JID: " << fullServerJid.full ();
 
@@ -701,31 +1768,158 @@ Client::Impl::SetSelectedServer (std::unique_lock<std::mutex>& lock,
          corruption and race conditions.  */
       FinishSubscriptions (lock);
 
-      AddPubSub (sn->GetService ());
+      std::map<std::string, std::string> nodes;
+      const std::string service
+          = SelectPubSubService (*sn, client.preferredPubSubs, nodes);
+      LOG (INFO) << "Using pubsub service " << service;
+
+      /* Filtered streams are only served on the main service.  On others
+         (and for servers that do not support them at all), we subscribe
+         to the plain nodes and the filter is only applied locally.  */
+      const bool serverFilters
+          = caps.Has (CAPABILITY_FILTER) && service == sn->GetService ();
+
+      AddPubSub (service);
+      if (standby != nullptr)
+        standby->SetStandbyService (service);
+
+      /* With direct push, the server sends the updates to us and we only
+         fall back to the pubsub nodes if it does not accept us.  The standby
+         subscribes to the (plain) nodes in any case.  */
+      if (client.directPush && sn->SupportsDirect ())
+        {
+          std::vector<std::tuple<std::string, std::string,
+                                 const NotificationFilter*,
+                                 PubSubImpl::ItemCallback>> subs;
+          const auto& n = nodes;
+          for (auto& entry : states)
+            {
+              const auto mit = n.find (entry.first);
+              CHECK (mit != n.end ());
+              const auto* filter = entry.second->GetFilter ();
+              if (!serverFilters)
+                filter = nullptr;
+              subs.emplace_back (entry.first, mit->second, filter,
+                                 entry.second->GetItemCallback ());
+            }
+
+          subscribeCalls.emplace_back ([this, jid, subs] ()
+            {
+              if (RequestDirectPush (jid))
+                {
+                  LOG (INFO) << "Receiving notifications by direct push";
+                  if (standby != nullptr)
+                    for (const auto& sub : subs)
+                      standby->SubscribeStandby (std::get<1> (sub),
+                                                 std::get<3> (sub));
+                  return;
+                }
+
+              LOG (WARNING)
+                  << "Falling back to pubsub subscriptions for notifications";
+              for (const auto& sub : subs)
+                SubscribeNotification (jid, std::get<0> (sub),
+                                       std::get<1> (sub), std::get<2> (sub),
+                                       std::get<3> (sub));
+            });
+
+          return;
+        }
 
-      const auto& n = sn->GetNotifications ();
+      const auto& n = nodes;
       for (auto& entry : states)
         {
           const auto mit = n.find (entry.first);
           CHECK (mit != n.end ());
 
+          const std::string type = entry.first;
           const std::string node = mit->second;
+          const auto* filter = entry.second->GetFilter ();
+          if (!serverFilters)
+            filter = nullptr;
           auto cb = entry.second->GetItemCallback ();
 
-          LOG (INFO)
-              << "Subscribing to node " << node
-              << " for notification " << entry.first;
-
           /* The call to SubscribeToNode waits for the subscription
-             response from the server, so we have to do it async.  */
-          subscribeCalls.emplace_back ([this, node, cb] ()
+             response from the server, so we have to do it async.  The same
+             is true for registering our filter first (if any).  */
+          subscribeCalls.emplace_back ([this, jid, type, node, filter, cb] ()
             {
-              GetPubSub ().SubscribeToNode (node, cb);
+              SubscribeNotification (jid, type, node, filter, cb);
             });
         }
     }
 }
 
+void
+Client::Impl::SubscribeNotification (const gloox::JID& jid,
+                                     const std::string& type,
+                                     const std::string& node,
+                                     const NotificationFilter* filter,
+                                     const PubSubImpl::ItemCallback& cb)
+{
+  std::string subscribeNode = node;
+  if (filter != nullptr)
+    {
+      const auto filtered = RequestFilteredNode (jid, type, *filter);
+      if (filtered.empty ())
+        LOG (WARNING)
+            << "Falling back to unfiltered notifications for " << type;
+      else
+        subscribeNode = filtered;
+    }
+
+  LOG (INFO)
+      << "Subscribing to node " << subscribeNode
+      << " for notification " << type;
+  GetPubSub ().SubscribeToNode (subscribeNode, cb);
+
+  /* The standby subscribes to the same node, and duplicate
+     updates are ignored by the notification state.  */
+  if (standby != nullptr)
+    standby->SubscribeStandby (subscribeNode, cb);
+}
+
+void
+Client::Impl::handleMessage (const gloox::Message& msg,
+                             gloox::MessageSession* session)
+{
+  const auto* pushed = msg.findExtension<PushedUpdate> (PushedUpdate::EXT_TYPE);
+  if (pushed == nullptr)
+    return;
+  if (!pushed->IsValid ())
+    {
+      LOG (WARNING) << "Ignoring invalid pushed update";
+      return;
+    }
+
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    if (msg.from () != fullServerJid && msg.from () != lastServerJid)
+      {
+        LOG (WARNING)
+            << "Ignoring pushed update from " << msg.from ().full ()
+            << ", which is not our server";
+        return;
+      }
+  }
+
+  /* The states are only modified before connecting, so we can look up
+     the type without holding the lock.  */
+  const auto& type = pushed->GetUpdate ().findAttribute ("type");
+  const auto mit = states.find (type);
+  if (mit == states.end ())
+    {
+      LOG (WARNING) << "Ignoring pushed update for unknown type " << type;
+      return;
+    }
+
+  /* The notification state processes pubsub items, which have the update
+     as child.  So wrap it into one.  */
+  gloox::Tag item("item");
+  item.addChild (pushed->GetUpdate ().clone ());
+  mit->second->ProcessItem (item);
+}
+
 void
 Client::Impl::handlePresence (const gloox::Presence& p)
 {
@@ -779,7 +1973,33 @@ Client::Impl::handlePresence (const gloox::Presence& p)
 
         /* In case we get multiple replies, we pick the first only.  */
         if (!HasFullServerJid ())
-          SetSelectedServer (lock, p.from (), sn);
+          {
+            const auto* breaker = GetBreaker (p.from ());
+            if (breaker != nullptr && breaker->IsOpen ())
+              {
+                LOG (WARNING)
+                    << "Ignoring pong from " << p.from ().full ()
+                    << ", whose circuit is open";
+                return;
+              }
+
+            const auto caps
+                = Capabilities::Own ().Intersect (pong->GetCapabilities ());
+            SetSelectedServer (lock, p.from (), sn, caps);
+
+            /* Estimate the server's clock offset assuming that it sent the
+               pong halfway through the round trip of our ping.  */
+            if (pong->GetTime () > 0 && ongoingPing.lock () != nullptr)
+              {
+                const auto rtt
+                    = std::chrono::duration_cast<std::chrono::milliseconds> (
+                        Clock::now () - pingSent).count ();
+                clockOffset = pong->GetTime () - (GetTimestampMs () - rtt / 2);
+                LOG (INFO)
+                    << "Server clock offset is " << clockOffset
+                    << " ms (round trip " << rtt << " ms)";
+              }
+          }
 
         auto ping = ongoingPing.lock ();
         if (ping != nullptr)
@@ -791,6 +2011,8 @@ Client::Impl::handlePresence (const gloox::Presence& p)
     case gloox::Presence::Unavailable:
       {
         std::lock_guard<std::mutex> lock(mut);
+        if (p.from () == lastServerJid)
+          lastServerJid = gloox::JID ();
         if (p.from () == fullServerJid)
           {
             LOG (WARNING) << "Our server has become unavailable";
@@ -838,25 +2060,136 @@ Client::Impl::FinishSubscriptions (std::unique_lock<std::mutex>& lock)
   subscribeCalls.clear ();
 }
 
-Json::Value
-Client::Impl::ForwardMethod (const std::string& method,
-                             const Json::Value& params)
+std::string
+Client::Impl::RequestFilteredNode (const gloox::JID& jid,
+                                   const std::string& type,
+                                   const NotificationFilter& filter)
 {
-  const auto jid = EnsureConnected ();
+  auto call = std::make_shared<OngoingRegistration> (client.timeout);
+
+  gloox::IQ iq(gloox::IQ::Get, jid);
+  iq.addExtension (new FilterRegistration (type, filter.GetSpec ()));
+  RunWithClient ([&] (gloox::Client& c)
+    {
+      LOG (INFO)
+          << "Requesting filtered " << type << " notifications from "
+          << jid.full ();
+      c.send (iq, new FilterResultHandler (call), 0, true);
+    });
+
+  std::unique_lock<std::mutex> lock(call->mut);
+  while (!call->done && !call->cv.IsTimedOut ())
+    call->cv.Wait (lock);
+
+  if (!call->done)
+    LOG (WARNING) << "Timeout waiting for filter registration";
+
+  /* Mark the call as done, so that a late response is ignored.  */
+  call->done = true;
+  return call->node;
+}
+
+bool
+Client::Impl::RequestDirectPush (const gloox::JID& jid)
+{
+  auto call = std::make_shared<OngoingRegistration> (client.timeout);
+
+  gloox::IQ iq(gloox::IQ::Set, jid);
+  auto* reg = new DirectRegistration ();
+  for (const auto& entry : states)
+    {
+      const auto* filter = entry.second->GetFilter ();
+      reg->AddNotification (entry.first, filter == nullptr
+                                            ? Json::Value ()
+                                            : filter->GetSpec ());
+    }
+  iq.addExtension (reg);
+
+  RunWithClient ([&] (gloox::Client& c)
+    {
+      LOG (INFO) << "Requesting direct push from " << jid.full ();
+      c.send (iq, new DirectResultHandler (call), 0, true);
+    });
+
+  std::unique_lock<std::mutex> lock(call->mut);
+  while (!call->done && !call->cv.IsTimedOut ())
+    call->cv.Wait (lock);
+
+  if (!call->done)
+    LOG (WARNING) << "Timeout waiting for direct push registration";
+
+  /* Mark the call as done, so that a late response is ignored.  */
+  call->done = true;
+  return call->accepted;
+}
+
+bool
+Client::Impl::TryForwardMethod (const std::string& method,
+                                 const Json::Value& params,
+                                 const std::string& id, unsigned& lane,
+                                 const Client::Duration timeout,
+                                 const Clock::time_point deadline,
+                                 Json::Value& result, PageCursor& pages,
+                                 RpcServer::Error& err)
+{
+  gloox::JID jid;
+  XmppClient* stream = this;
+  if (lane > 0)
+    {
+      /* If the main connection is down, we send to the last selected server
+         instance through the lane, instead of blocking on reconnecting
+         the main connection first.  */
+      if (!IsConnected ())
+        {
+          std::lock_guard<std::mutex> lock(mut);
+          jid = lastServerJid;
+        }
+      if (!jid)
+        jid = EnsureConnected (deadline);
+
+      auto& l = *lanes[lane - 1];
+      if (jid && l.Prepare (jid))
+        stream = &l;
+      else if (jid)
+        {
+          LOG (WARNING)
+              << "Call lane " << l.GetJID ().full ()
+              << " is not usable, using the main connection";
+          selector->RecordFailure (lane);
+          lane = 0;
+          if (!IsConnected ())
+            jid = EnsureConnected (deadline);
+        }
+    }
+  else
+    jid = EnsureConnected (deadline);
+
   if (!jid)
     {
       std::ostringstream msg;
       msg << "could not discover full server JID for " << client.serverJid;
-      throw RpcServer::Error (jsonrpc::Errors::ERROR_RPC_INTERNAL_ERROR,
+      err = RpcServer::Error (jsonrpc::Errors::ERROR_RPC_INTERNAL_ERROR,
                               msg.str ());
+      return false;
     }
 
-  auto iq = std::make_unique<gloox::IQ> (gloox::IQ::Get, jid);
-  iq->addExtension (new RpcRequest (method, params));
+  XmlEncodingOptions encoding;
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    encoding = serverCapabilities.GetEncodingOptions ();
+  }
 
-  auto call = std::make_shared<OngoingRpcCall> (client.timeout);
+  auto iq = std::make_unique<gloox::IQ> (gloox::IQ::Get, jid);
+  auto req = std::make_unique<RpcRequest> (method, params);
+  req->SetEncoding (encoding);
+  if (!id.empty ())
+    req->SetId (id);
+  iq->addExtension (req.release ());
+
+  LaneSelector::Use use(*selector, lane);
+  auto call = std::make_shared<OngoingRpcCall> (timeout);
   call->serverJid = iq->to ();
-  RunWithClient ([&] (gloox::Client& c)
+  stream->RunWithClient ([&] (gloox::Client& c)
     {
       LOG (INFO)
           << "Sending IQ request for method " << method
@@ -874,14 +2207,38 @@ Client::Impl::ForwardMethod (const std::string& method,
         {
         case OngoingRpcCall::State::RESPONSE_SUCCESS:
           LOG (INFO) << "Received success call result";
-          return call->result;
+          callLock.unlock ();
+          use.Success ();
+          ReportServerResult (call->serverJid, true);
+          result = std::move (call->result);
+          pages.stream = stream;
+          pages.server = call->serverJid;
+          pages.cursor = call->cursor;
+          pages.offset = result.size ();
+          pages.deadline = deadline;
+          return true;
+
         case OngoingRpcCall::State::RESPONSE_ERROR:
           LOG (INFO) << "Received error call result";
+          use.Success ();
+          if (IsBackendFailure (call->error))
+            {
+              err = call->error;
+              callLock.unlock ();
+              ReportServerResult (call->serverJid, false);
+              return false;
+            }
+          callLock.unlock ();
+          ReportServerResult (call->serverJid, true);
           throw call->error;
 
         case OngoingRpcCall::State::UNAVAILABLE:
-          throw RpcServer::Error (jsonrpc::Errors::ERROR_RPC_INTERNAL_ERROR,
+          err = RpcServer::Error (jsonrpc::Errors::ERROR_RPC_INTERNAL_ERROR,
                                   "selected server is unavailable");
+          callLock.unlock ();
+          use.Success ();
+          ReportServerResult (call->serverJid, false);
+          return false;
 
         default:
           break;
@@ -892,15 +2249,197 @@ Client::Impl::ForwardMethod (const std::string& method,
           LOG (WARNING) << "Call to " << method << " timed out";
           std::ostringstream msg;
           msg << "timeout waiting for result from " << call->serverJid.full ();
+          err = RpcServer::Error (jsonrpc::Errors::ERROR_RPC_INTERNAL_ERROR,
+                                  msg.str ());
+          callLock.unlock ();
+          use.Failure ();
+          ReportServerResult (call->serverJid, false);
+          return false;
+        }
+    }
+}
+
+Json::Value
+Client::Impl::ForwardMethod (const std::string& method,
+                             const Json::Value& params, PageCursor& pages)
+{
+  const auto deadline = Clock::now () + client.timeout;
+
+  unsigned attempts = 1;
+  if (client.retryMethods.count (method) > 0)
+    attempts = std::max (client.maxAttempts, 1u);
+
+  /* Retried calls carry a request ID (the same for all attempts), so that
+     a server receiving the call again does not execute it twice.  */
+  std::string id;
+  if (attempts > 1)
+    id = requestIdPrefix + ":" + std::to_string (nextRequestId++);
+
+  /* The connection is picked based on health and RTT.  If the server
+     answered with a backend failure, retries stay on the same connection.
+     Otherwise they fail over to another one on the same account, since
+     the server recognises retries by the sender's account and the ID.  */
+  unsigned lane = PickLane ();
+
+  RpcServer::Error err(0);
+  for (unsigned i = 0; i < attempts; ++i)
+    {
+      const auto now = Clock::now ();
+      if (i > 0 && now >= deadline)
+        break;
+
+      auto timeout
+          = std::chrono::duration_cast<Client::Duration> (deadline - now);
+      if (attempts > 1)
+        timeout = std::min (timeout, client.attemptTimeout);
+
+      if (i > 0)
+        {
+          LOG (INFO)
+              << "Retrying call to " << method << " (attempt " << (i + 1)
+              << " of " << attempts << ")";
+          if (!IsBackendFailure (err))
+            lane = PickRetryLane (lane);
+        }
+
+      Json::Value result;
+      if (TryForwardMethod (method, params, id, lane, timeout, deadline,
+                            result, pages, err))
+        return result;
+
+      LOG (WARNING) << "Call to " << method << " failed: " << err.what ();
+    }
+
+  throw err;
+}
+
+Json::Value
+Client::Impl::ForwardMethod (const std::string& method,
+                             const Json::Value& params)
+{
+  PageCursor pages;
+  Json::Value result = ForwardMethod (method, params, pages);
+
+  while (!pages.cursor.empty ())
+    for (auto& item : FetchPage (pages))
+      result.append (std::move (item));
+
+  return result;
+}
+
+bool
+Client::Impl::TryFetchPage (const PageCursor& pages,
+                             const Client::Duration timeout,
+                             Json::Value& page, std::string& next,
+                             RpcServer::Error& err)
+{
+  gloox::IQ iq(gloox::IQ::Get, pages.server);
+  iq.addExtension (new PageRequest (pages.cursor, pages.offset));
+
+  auto call = std::make_shared<OngoingRpcCall> (timeout);
+  call->serverJid = pages.server;
+  pages.stream->RunWithClient ([&] (gloox::Client& c)
+    {
+      VLOG (1)
+          << "Requesting page at " << pages.offset << " of result "
+          << pages.cursor << " from " << pages.server.full ();
+      c.send (iq, new RpcResultHandler (call), 0, true);
+    });
+
+  std::unique_lock<std::mutex> callLock(call->mut);
+  while (true)
+    {
+      call->cv.Wait (callLock);
+
+      switch (call->state)
+        {
+        case OngoingRpcCall::State::RESPONSE_SUCCESS:
+          page = std::move (call->result);
+          next = call->cursor;
+          return true;
+
+        case OngoingRpcCall::State::RESPONSE_ERROR:
+          throw call->error;
+
+        case OngoingRpcCall::State::UNAVAILABLE:
+          /* The remaining pages are only held by this server instance,
+             so there is no point in retrying.  */
           throw RpcServer::Error (jsonrpc::Errors::ERROR_RPC_INTERNAL_ERROR,
+                                  "server of paged result is unavailable");
+
+        default:
+          break;
+        }
+
+      if (call->cv.IsTimedOut ())
+        {
+          std::ostringstream msg;
+          msg << "timeout waiting for result page from "
+              << pages.server.full ();
+          err = RpcServer::Error (jsonrpc::Errors::ERROR_RPC_INTERNAL_ERROR,
                                   msg.str ());
+          return false;
         }
     }
 }
 
 Json::Value
-Client::Impl::WaitForChange (const std::string& type, const Json::Value& known)
+Client::Impl::FetchPage (PageCursor& pages)
+{
+  CHECK (!pages.cursor.empty ());
+  CHECK (pages.stream != nullptr);
+
+  /* Page requests name the offset of the page explicitly, so the server
+     answers a repeated request with the same page.  Thus they can be
+     retried (e.g. if a response got lost) without skipping items.  */
+  const unsigned attempts = std::max (client.maxAttempts, 1u);
+
+  RpcServer::Error err(jsonrpc::Errors::ERROR_RPC_INTERNAL_ERROR,
+                       "deadline for fetching the result pages has passed");
+  for (unsigned i = 0; i < attempts; ++i)
+    {
+      const auto now = Clock::now ();
+      if (now >= pages.deadline)
+        break;
+
+      auto timeout
+          = std::chrono::duration_cast<Client::Duration> (
+              pages.deadline - now);
+      if (attempts > 1)
+        timeout = std::min (timeout, client.attemptTimeout);
+
+      if (i > 0)
+        LOG (INFO)
+            << "Retrying request for page at " << pages.offset
+            << " (attempt " << (i + 1) << " of " << attempts << ")";
+
+      Json::Value page;
+      std::string next;
+      if (TryFetchPage (pages, timeout, page, next, err))
+        {
+          pages.offset += page.size ();
+          pages.cursor = next;
+          return page;
+        }
+
+      LOG (WARNING) << "Request for result page failed: " << err.what ();
+    }
+
+  throw err;
+}
+
+void
+Client::Impl::EnsureNotifications ()
 {
+  /* While the main connection is down, a connected standby keeps receiving
+     the notifications, so that we need not block on reconnecting.  */
+  if (!IsConnected () && standby != nullptr && standby->IsConnected ())
+    {
+      std::lock_guard<std::mutex> lock(mut);
+      if (lastServerJid)
+        return;
+    }
+
   const auto jid = EnsureConnected ();
   if (!jid)
     {
@@ -909,12 +2448,76 @@ Client::Impl::WaitForChange (const std::string& type, const Json::Value& known)
       throw RpcServer::Error (jsonrpc::Errors::ERROR_RPC_INTERNAL_ERROR,
                               msg.str ());
     }
+}
+
+Json::Value
+Client::Impl::WaitForChange (const std::string& type, const Json::Value& known)
+{
+  EnsureNotifications ();
 
   const auto mit = states.find (type);
   CHECK (mit != states.end ()) << "Notification type not enabled: " << type;
   return mit->second->WaitForChange (known);
 }
 
+bool
+Client::Impl::WaitForAnyChange (const std::map<std::string, Json::Value>& known,
+                                std::string& type, Json::Value& state)
+{
+  EnsureNotifications ();
+
+  for (const auto& entry : known)
+    CHECK (states.count (entry.first) > 0)
+        << "Notification type not enabled: " << entry.first;
+
+  std::unique_lock<std::mutex> lock(changeMut);
+
+  /* Record the change counts before checking the current states, so that
+     we notice changes that happen between the check and the wait.  */
+  std::map<std::string, uint64_t> before;
+  for (const auto& entry : known)
+    before[entry.first] = changeCounts[entry.first];
+
+  for (const auto& entry : known)
+    if (states.at (entry.first)->CheckOutdated (entry.second, state))
+      {
+        VLOG (1) << "Known state of " << entry.first << " is outdated";
+        type = entry.first;
+        return true;
+      }
+
+  VLOG (1) << "Starting wait for " << known.size () << " notifications...";
+
+  std::string changed;
+  changeCv.wait_for (lock, WAITFORCHANGE_TIMEOUT, [&] ()
+    {
+      for (const auto& entry : before)
+        if (changeCounts[entry.first] != entry.second)
+          {
+            changed = entry.first;
+            return true;
+          }
+      return false;
+    });
+  lock.unlock ();
+
+  if (changed.empty ())
+    return false;
+
+  type = changed;
+  state = states.at (changed)->GetState ();
+  return true;
+}
+
+Json::Value
+Client::Impl::GetNotificationLag () const
+{
+  Json::Value res(Json::objectValue);
+  for (const auto& entry : states)
+    res[entry.first] = entry.second->GetLagStats ();
+  return res;
+}
+
 /* ************************************************************************** */
 
 Client::Client (const std::string& srv, const std::string& v,
@@ -933,7 +2536,43 @@ void
 Client::SetRootCA (const std::string& path)
 {
   CHECK (impl != nullptr);
-  impl->SetRootCA (path);
+  impl->SetStreamsRootCA (path);
+}
+
+void
+Client::SetStreamCompression (const bool enable)
+{
+  CHECK (impl != nullptr);
+  impl->SetStreamsCompression (enable);
+}
+
+void
+Client::SetConnections (const unsigned n)
+{
+  CHECK (impl != nullptr);
+  CHECK_GE (n, 1) << "The client needs at least one connection";
+  impl->AddPoolLanes (n - 1);
+}
+
+void
+Client::AddEndpoint (const std::string& jid, const std::string& password)
+{
+  CHECK (impl != nullptr);
+  impl->AddEndpoint (gloox::JID (jid), password);
+}
+
+StreamStatistics
+Client::GetStreamStatistics ()
+{
+  CHECK (impl != nullptr);
+  return impl->GetTotalStreamStatistics ();
+}
+
+Json::Value
+Client::GetConnectStats () const
+{
+  CHECK (impl != nullptr);
+  return impl->GetAllConnectStats ();
 }
 
 void
@@ -944,21 +2583,37 @@ Client::Connect ()
   /* We always connect with priority -1, because the client will never want
      to receive any messages for the bare JID.  It only communicates with
      its full JID.  */
-  impl->Connect (-1);
+  impl->ConnectAll ();
 }
 
 void
 Client::Disconnect ()
 {
   CHECK (impl != nullptr);
-  impl->Disconnect ();
+  impl->DisconnectAll ();
 }
 
 void
 Client::AddNotification (std::unique_ptr<NotificationType> n)
 {
   CHECK (impl != nullptr);
-  impl->AddNotification (std::move (n));
+  impl->AddNotification (std::move (n), nullptr);
+}
+
+void
+Client::AddFilteredNotification (std::unique_ptr<NotificationType> n,
+                                 const NotificationFilter& f)
+{
+  CHECK (impl != nullptr);
+  impl->AddNotification (std::move (n),
+                         std::make_unique<NotificationFilter> (f));
+}
+
+void
+Client::AddNotificationListener (const NotificationListener& l)
+{
+  CHECK (impl != nullptr);
+  impl->AddNotificationListener (l);
 }
 
 std::string
@@ -975,6 +2630,51 @@ Client::ForwardMethod (const std::string& method, const Json::Value& params)
   return impl->ForwardMethod (method, params);
 }
 
+std::unique_ptr<Client::PagedResult>
+Client::ForwardMethodPaged (const std::string& method,
+                            const Json::Value& params)
+{
+  CHECK (impl != nullptr);
+
+  auto pages = std::make_shared<PageCursor> ();
+  Json::Value first = impl->ForwardMethod (method, params, *pages);
+  if (!first.isArray ())
+    throw RpcServer::Error (jsonrpc::Errors::ERROR_RPC_INTERNAL_ERROR,
+                            "result of " + method + " is not an array");
+
+  PagedResult::PageFetcher fetch;
+  if (!pages->cursor.empty ())
+    fetch = [this, pages] (Json::Value& page)
+      {
+        /* Pages are fetched only as the caller consumes the items, which
+           may take arbitrarily long.  So each page gets its own deadline,
+           rather than the one of the original call.  */
+        pages->deadline = Clock::now () + timeout;
+        page = impl->FetchPage (*pages);
+        return !pages->cursor.empty ();
+      };
+
+  return std::unique_ptr<PagedResult> (
+      new PagedResult (std::move (first), std::move (fetch)));
+}
+
+bool
+Client::PagedResult::Next (Json::Value& item)
+{
+  while (pos >= page.size ())
+    {
+      if (!fetchPage)
+        return false;
+
+      pos = 0;
+      if (!fetchPage (page))
+        fetchPage = nullptr;
+    }
+
+  item = std::move (page[pos++]);
+  return true;
+}
+
 Json::Value
 Client::WaitForChange (const std::string& type, const Json::Value& known)
 {
@@ -982,6 +2682,21 @@ Client::WaitForChange (const std::string& type, const Json::Value& known)
   return impl->WaitForChange (type, known);
 }
 
+bool
+Client::WaitForAnyChange (const std::map<std::string, Json::Value>& known,
+                          std::string& type, Json::Value& state)
+{
+  CHECK (impl != nullptr);
+  return impl->WaitForAnyChange (known, type, state);
+}
+
+Json::Value
+Client::GetNotificationLag () const
+{
+  CHECK (impl != nullptr);
+  return impl->GetNotificationLag ();
+}
+
 /* ************************************************************************** */
 
 } // namespace charon
@@ -19,19 +19,26 @@
 #ifndef CHARON_CLIENT_HPP
 #define CHARON_CLIENT_HPP
 
+#include "notificationfilter.hpp"
 #include "notifications.hpp"
 #include "rpcserver.hpp"
 
 #include <json/json.h>
 
 #include <chrono>
+#include <functional>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace charon
 {
 
+struct StreamStatistics;
+
 /**
  * The client-side logic of Charon.  An instance of this class manages an
  * XMPP connection, and is able to forward RPC requests to the server-side
@@ -56,6 +63,30 @@ private:
   /** Current timeout when waiting for replies of the server JID.  */
   Duration timeout;
 
+  /** Maximum number of attempts for calls to retriable methods.  */
+  unsigned maxAttempts = 1;
+
+  /** Timeout for each single attempt if retries are enabled.  */
+  Duration attemptTimeout;
+
+  /** Methods that are idempotent and may be retried.  */
+  std::set<std::string> retryMethods;
+
+  /**
+   * Number of consecutive failures after which a server instance is
+   * avoided (zero to disable per-server circuit breakers).
+   */
+  unsigned breakerThreshold = 0;
+
+  /** Time for which a server instance with open circuit is avoided.  */
+  Duration breakerCooldown;
+
+  /** Whether to register with the server for direct push of notifications.  */
+  bool directPush = false;
+
+  /** Preferred pubsub services for notifications, in order.  */
+  std::vector<std::string> preferredPubSubs;
+
   /**
    * The class implementing the main logic.  Its internals depend on private
    * libraries like gloox, so that the definition is not exposed in the header.
@@ -64,6 +95,65 @@ private:
 
 public:
 
+  /**
+   * The result of a call forwarded with ForwardMethodPaged, through which
+   * the items of the returned array can be iterated.  If the server split
+   * the result into pages, further pages are only fetched from it once the
+   * items received so far have been consumed.
+   *
+   * Instances must not outlive the Client that created them, and must not
+   * be used from several threads at once.
+   */
+  class PagedResult
+  {
+
+  private:
+
+    /**
+     * Function that fetches the next page into the passed-in value,
+     * and returns true if there are more pages after it.  It throws
+     * RpcServer::Error if that fails.
+     */
+    using PageFetcher = std::function<bool (Json::Value& page)>;
+
+    /** The current page.  */
+    Json::Value page;
+
+    /** Index of the next item in the current page.  */
+    Json::ArrayIndex pos = 0;
+
+    /** Fetcher for further pages, or empty if there are none.  */
+    PageFetcher fetchPage;
+
+    explicit PagedResult (Json::Value&& first, PageFetcher&& f)
+      : page(std::move (first)), fetchPage(std::move (f))
+    {}
+
+    friend class Client;
+
+  public:
+
+    PagedResult () = delete;
+    PagedResult (const PagedResult&) = delete;
+    void operator= (const PagedResult&) = delete;
+
+    /**
+     * Sets item to the next item of the result and returns true, or
+     * returns false if all have been consumed.  If the next page cannot
+     * be fetched (e.g. because it expired on the server), this throws
+     * RpcServer::Error.
+     */
+    bool Next (Json::Value& item);
+
+  };
+
+  /**
+   * Callback invoked with the type and new state of a notification
+   * whenever the client receives a changed state for it.
+   */
+  using NotificationListener
+      = std::function<void (const std::string& type, const Json::Value& state)>;
+
   /**
    * Constructs the client instance (without connecting it).  Any requests
    * made (after the instance is connected) will be forwarded to the given
@@ -92,11 +182,137 @@ public:
     timeout = std::chrono::duration_cast<Duration> (t);
   }
 
+  /**
+   * Configures retries for methods marked with AllowRetries:  Calls to them
+   * are attempted up to the given number of times, each attempt timing out
+   * after the given duration.  If an attempt times out or the server is
+   * unavailable (or cannot reach its backend), a server is selected anew
+   * before the next attempt.  All attempts together are still limited
+   * by the overall timeout set with SetTimeout.
+   *
+   * This must be called before the client is connected.
+   */
+  template <typename Rep, typename Period>
+    void
+    SetRetryPolicy (const unsigned attempts,
+                    const std::chrono::duration<Rep, Period>& perAttempt)
+  {
+    maxAttempts = attempts;
+    attemptTimeout = std::chrono::duration_cast<Duration> (perAttempt);
+  }
+
+  /**
+   * Marks a method as idempotent, so that calls to it may be retried.
+   * This must be called before the client is connected.
+   */
+  void
+  AllowRetries (const std::string& method)
+  {
+    retryMethods.insert (method);
+  }
+
+  /**
+   * Enables per-server circuit breakers:  Once calls to a particular server
+   * instance (full JID) failed the given number of times in a row, that
+   * instance is no longer selected until the cooldown has passed.
+   *
+   * This must be called before the client is connected.
+   */
+  template <typename Rep, typename Period>
+    void
+    EnableServerBreakers (const unsigned threshold,
+                          const std::chrono::duration<Rep, Period>& cooldown)
+  {
+    breakerThreshold = threshold;
+    breakerCooldown = std::chrono::duration_cast<Duration> (cooldown);
+  }
+
+  /**
+   * Enables or disables direct push of the notifications:  If enabled and
+   * the server supports it, the client registers with the selected server
+   * instance to receive the updates as messages directly from it, instead
+   * of subscribing to its pubsub nodes.  If the server does not accept the
+   * registration (e.g. because it has too many clients already), the
+   * client falls back to the pubsub subscriptions.
+   *
+   * This must be called before the client is connected.
+   */
+  void
+  SetDirectPush (const bool enable)
+  {
+    directPush = enable;
+  }
+
+  /**
+   * Adds a preferred pubsub service for notifications, e.g. one on the XMPP
+   * cluster nearest to the client.  If the selected server publishes to
+   * several services, the client subscribes on the first offered one in
+   * the order they were added.  If none of them is offered, it picks one
+   * at random, which spreads the load evenly over the services.
+   *
+   * This must be called before the client is connected.
+   */
+  void
+  AddPreferredPubSub (const std::string& service)
+  {
+    preferredPubSubs.push_back (service);
+  }
+
   /**
    * Sets the root CA certificate to use for TLS verification.
    */
   void SetRootCA (const std::string& path);
 
+  /**
+   * Enables or disables XEP-0138 stream compression for the XMPP
+   * connection (if the XMPP server offers it).  It is enabled by default.
+   * This must be called before connecting.
+   */
+  void SetStreamCompression (bool enable);
+
+  /**
+   * Sets the number of XMPP connections the client opens on its own
+   * account (one by default).  Additional connections use distinct
+   * resources, and forwarded calls are distributed over all of them, so
+   * that throughput is not limited by a single stream and its receive
+   * thread.  Server discovery and notifications always use the first
+   * connection.
+   *
+   * This must be called at most once and before the client is connected.
+   */
+  void SetConnections (unsigned n);
+
+  /**
+   * Adds a connection with another XMPP account, typically on a different
+   * XMPP server, so that the client stays usable if the main one is slow
+   * or down.  Forwarded calls are routed over all connections based on
+   * their health and round-trip times, and fail over to another connection
+   * if one stops responding.  Retries of a call only fail over to
+   * connections on the same account as the previous attempt, since the
+   * server recognises retries by their sender.  The first endpoint added
+   * also keeps standby subscriptions for the notifications.
+   *
+   * The root CA and stream compression settings apply to all connections.
+   * This must be called before the client is connected.
+   */
+  void AddEndpoint (const std::string& jid, const std::string& password);
+
+  /**
+   * Returns traffic statistics for the XMPP stream (summed over all
+   * connections if there are several).  The full type of
+   * StreamStatistics is declared in xmppclient.hpp.
+   */
+  StreamStatistics GetStreamStatistics ();
+
+  /**
+   * Returns statistics about setting up the XMPP connection as JSON, with
+   * histograms of the time spent resolving the server, connecting, in the
+   * TLS handshake and logging in (see XmppClient::GetConnectStats).  If
+   * there are several connections, those of the additional ones are
+   * in "lanes" by their JID.
+   */
+  Json::Value GetConnectStats () const;
+
   /**
    * Connects to XMPP and starts a thread that processes any data we receive.
    */
@@ -113,6 +329,25 @@ public:
    */
   void AddNotification (std::unique_ptr<NotificationType> n);
 
+  /**
+   * Adds a notification type like AddNotification, but only for the parts
+   * of the state selected by the given filter.  The server is asked to
+   * publish a stream with only the filtered view, so that less data has to
+   * be transferred.  If it does not support that, the client subscribes to
+   * the full notifications and applies the filter locally.
+   */
+  void AddFilteredNotification (std::unique_ptr<NotificationType> n,
+                                const NotificationFilter& f);
+
+  /**
+   * Adds a listener that is invoked whenever a new state for one of the
+   * notifications is received.  This allows pushing updates on to
+   * consumers instead of having them call WaitForChange.  The listener
+   * is called on the thread processing XMPP messages, so it should not
+   * block.  This must only be called before the client is connected.
+   */
+  void AddNotificationListener (const NotificationListener& l);
+
   /**
    * Tries to find a full server JID if there is not already one.  This
    * performs the initial ping/pong handshake if not already done.
@@ -129,11 +364,27 @@ public:
    * Forwards the given RPC call to the server for replying, and returns
    * the server's JSON-RPC result.  In case of error, throws RpcServer::Error.
    * This can be called concurrently from multiple threads and the processing
-   * will be properly synchronised.
+   * will be properly synchronised.  If the server splits the result into
+   * pages, all of them are fetched within the call's timeout.
    */
   Json::Value ForwardMethod (const std::string& method,
                              const Json::Value& params);
 
+  /**
+   * Forwards a call like ForwardMethod, for a method that returns an array.
+   * If the server supports it, large results are transferred in pages,
+   * which the returned object fetches lazily while the items are iterated.
+   * This way, the first items are available early and the full result
+   * never has to be held in memory at once.  (ForwardMethod instead
+   * fetches all pages before returning.)  Each page fetch is bounded
+   * by the timeout on its own, and retried according to the retry policy.
+   *
+   * Throws RpcServer::Error if the call fails or the result is not
+   * an array.
+   */
+  std::unique_ptr<PagedResult> ForwardMethodPaged (const std::string& method,
+                                                   const Json::Value& params);
+
   /**
    * Waits for a state change of the given notification.  Returns immediately
    * if the passed-in known state does not match the actual current state.
@@ -145,6 +396,26 @@ public:
    */
   Json::Value WaitForChange (const std::string& type, const Json::Value& known);
 
+  /**
+   * Waits for a state change of any of several notifications at once, given
+   * as map from type to the respective known state ID.  Returns immediately
+   * if any of the known states does not match the actual current one.
+   *
+   * Returns true and sets type and state to the notification that changed
+   * and its new state, or false if the call timed out without any change.
+   */
+  bool WaitForAnyChange (const std::map<std::string, Json::Value>& known,
+                         std::string& type, Json::Value& state);
+
+  /**
+   * Returns histograms (in milliseconds) of the lag of notification updates
+   * per type, as JSON.  For each type, "total" is the lag from the server
+   * receiving the state from its backend until we received the update, and
+   * "delivery" from the server publishing it.  The server's timestamps are
+   * corrected for the clock offset estimated from the ping round trip.
+   */
+  Json::Value GetNotificationLag () const;
+
 };
 
 } // namespace charon
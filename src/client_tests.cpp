@@ -28,6 +28,8 @@
 #include <gloox/presence.h>
 #include <gloox/presencehandler.h>
 
+#include <jsonrpccpp/common/errors.h>
+
 #include <gtest/gtest.h>
 
 #include <glog/logging.h>
@@ -276,7 +278,8 @@ TEST_F (ClientServerDiscoveryTests, ConnectionFailure)
 
 /**
  * RpcServer that uses TestBackend, but applies a configurable delay on top
- * of it (i.e. delays responding to methods).
+ * of it (i.e. delays responding to methods).  It can also be made to fail
+ * a given number of calls as if the real backend were unreachable.
  */
 class DelayedTestBackend : public TestBackend
 {
@@ -286,12 +289,24 @@ private:
   /** The delay for each method call.  */
   std::chrono::milliseconds delay;
 
+  /** Number of upcoming calls that should fail.  */
+  std::atomic<unsigned> failures;
+
 public:
 
   DelayedTestBackend ()
-    : delay(0)
+    : delay(0), failures(0)
   {}
 
+  /**
+   * Makes the next n calls fail with a backend connection error.
+   */
+  void
+  SetFailures (const unsigned n)
+  {
+    failures = n;
+  }
+
   template <typename Rep, typename Period>
     void
     SetDelay (const std::chrono::duration<Rep, Period>& d)
@@ -303,6 +318,13 @@ public:
   HandleMethod (const std::string& method, const Json::Value& params) override
   {
     std::this_thread::sleep_for (delay);
+
+    unsigned cur = failures;
+    while (cur > 0)
+      if (failures.compare_exchange_weak (cur, cur - 1))
+        throw RpcServer::Error (jsonrpc::Errors::ERROR_CLIENT_CONNECTOR,
+                                "backend is unreachable");
+
     return TestBackend::HandleMethod (method, params);
   }
 
@@ -345,6 +367,46 @@ protected:
     client.Connect ();
   }
 
+  /**
+   * Constructs another client (not yet connected) for the same server
+   * and with the same account as the main one.
+   */
+  static std::unique_ptr<Client>
+  CreateOtherClient ()
+  {
+    auto res = std::make_unique<Client> (
+        JIDWithoutResource (GetTestAccount (accServer)).bare (),
+        SERVER_VERSION,
+        JIDWithoutResource (GetTestAccount (accClient)).full (),
+        GetTestAccount (accClient).password);
+    res->SetRootCA (GetTestCA ());
+    return res;
+  }
+
+  /**
+   * Adds an endpoint to the client.  The test environment has no other
+   * account for it, so we use the client account with the given resource.
+   */
+  void
+  AddEndpoint (const std::string& resource)
+  {
+    const auto& acc = GetTestAccount (accClient);
+    client.AddEndpoint (JIDWithResource (acc, resource).full (),
+                        acc.password);
+  }
+
+  /**
+   * Adds an endpoint to the client with a wrong password, so that it
+   * cannot connect.
+   */
+  void
+  AddBrokenEndpoint ()
+  {
+    const auto& acc = GetTestAccount (accClient);
+    client.AddEndpoint (JIDWithResource (acc, "broken").full (),
+                        "wrong password");
+  }
+
   /**
    * Sets up a server connection.
    */
@@ -470,6 +532,342 @@ TEST_F (ClientRpcForwardingTests, ServerReselectionNotAvailable)
                 RpcServer::Error);
 }
 
+/**
+ * Tests for large array results that the server returns in pages.
+ */
+class ClientPaginationTests : public ClientRpcForwardingTests
+{
+
+protected:
+
+  std::unique_ptr<Server> srv;
+
+  ClientPaginationTests ()
+  {
+    srv = ConnectServer ();
+    EnablePagination (std::chrono::seconds (10));
+  }
+
+  /**
+   * Enables pagination with two items per page and the given time-to-live
+   * on the server (reconnecting it).
+   */
+  void
+  EnablePagination (const std::chrono::milliseconds ttl)
+  {
+    srv->Disconnect ();
+    srv->EnablePagination (2, ttl);
+    CHECK (srv->Connect (0));
+  }
+
+  /**
+   * Calls the "chars" method with the given argument through
+   * ForwardMethodPaged.
+   */
+  std::unique_ptr<Client::PagedResult>
+  CallChars (const std::string& arg)
+  {
+    Json::Value params(Json::arrayValue);
+    params.append (arg);
+    return client.ForwardMethodPaged ("chars", params);
+  }
+
+  /**
+   * Iterates all items of a paged result and returns them concatenated.
+   */
+  static std::string
+  Collect (Client::PagedResult& res)
+  {
+    std::string str;
+    Json::Value item;
+    while (res.Next (item))
+      str += item.asString ();
+    return str;
+  }
+
+};
+
+TEST_F (ClientPaginationTests, ForwardMethodFetchesAllPages)
+{
+  EXPECT_EQ (client.ForwardMethod ("chars", ParseJson (R"(["abcde"])")),
+             ParseJson (R"(["a", "b", "c", "d", "e"])"));
+}
+
+TEST_F (ClientPaginationTests, Iteration)
+{
+  EXPECT_EQ (Collect (*CallChars ("abcde")), "abcde");
+  EXPECT_EQ (Collect (*CallChars ("abcd")), "abcd");
+  EXPECT_EQ (Collect (*CallChars ("a")), "a");
+  EXPECT_EQ (Collect (*CallChars ("")), "");
+}
+
+TEST_F (ClientPaginationTests, NotAnArray)
+{
+  EXPECT_THROW (client.ForwardMethodPaged ("echo", ParseJson (R"(["foo"])")),
+                RpcServer::Error);
+}
+
+TEST_F (ClientPaginationTests, WithoutPagination)
+{
+  srv.reset ();
+  std::this_thread::sleep_for (std::chrono::milliseconds (500));
+
+  srv = ConnectServer ();
+  EXPECT_EQ (Collect (*CallChars ("abcde")), "abcde");
+}
+
+TEST_F (ClientPaginationTests, ExpiredPages)
+{
+  EnablePagination (std::chrono::milliseconds (100));
+
+  auto res = CallChars ("abcde");
+  Json::Value item;
+  ASSERT_TRUE (res->Next (item));
+  EXPECT_EQ (item, "a");
+  ASSERT_TRUE (res->Next (item));
+  EXPECT_EQ (item, "b");
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (300));
+  EXPECT_THROW (res->Next (item), RpcServer::Error);
+}
+
+/**
+ * Tests for retries of failed calls and per-server circuit breakers.
+ */
+class ClientRetryTests : public ClientRpcForwardingTests
+{
+
+protected:
+
+  ClientRetryTests ()
+  {
+    client.SetTimeout (std::chrono::seconds (2));
+    client.SetRetryPolicy (3, std::chrono::milliseconds (200));
+    client.AllowRetries ("echo");
+  }
+
+};
+
+TEST_F (ClientRetryTests, RetriesBackendFailure)
+{
+  auto srv = ConnectServer ();
+  backend.SetFailures (2);
+  EXPECT_EQ (client.ForwardMethod ("echo", ParseJson (R"(["foo"])")), "foo");
+}
+
+TEST_F (ClientRetryTests, TooManyFailures)
+{
+  auto srv = ConnectServer ();
+  backend.SetFailures (3);
+  EXPECT_THROW (client.ForwardMethod ("echo", ParseJson (R"(["foo"])")),
+                RpcServer::Error);
+  EXPECT_EQ (client.ForwardMethod ("echo", ParseJson (R"(["foo"])")), "foo");
+}
+
+TEST_F (ClientRetryTests, OnlyIdempotentMethods)
+{
+  auto srv = ConnectServer ();
+  backend.SetFailures (1);
+  EXPECT_THROW (client.ForwardMethod ("error", ParseJson (R"(["foo"])")),
+                RpcServer::Error);
+  EXPECT_EQ (client.ForwardMethod ("echo", ParseJson (R"(["foo"])")), "foo");
+}
+
+TEST_F (ClientRetryTests, RetriesTimeout)
+{
+  auto srv = ConnectServer ();
+  backend.SetDelay (std::chrono::milliseconds (500));
+
+  /* All attempts time out, but together they must not exceed the
+     overall timeout.  */
+  client.SetTimeout (std::chrono::milliseconds (300));
+  const auto start = std::chrono::steady_clock::now ();
+  EXPECT_THROW (client.ForwardMethod ("echo", ParseJson (R"(["foo"])")),
+                RpcServer::Error);
+  EXPECT_LT (std::chrono::steady_clock::now () - start,
+             std::chrono::milliseconds (400));
+}
+
+TEST_F (ClientRetryTests, RetryExecutedOnce)
+{
+  auto srv = ConnectServer ();
+  client.AllowRetries ("count");
+
+  /* The first attempt times out, but the retry is answered with the
+     result of the original call rather than executing it again.  */
+  backend.SetDelay (std::chrono::milliseconds (300));
+  EXPECT_EQ (client.ForwardMethod ("count", ParseJson (R"(["foo"])")),
+             "foo 1");
+
+  backend.SetDelay (std::chrono::milliseconds (0));
+  EXPECT_EQ (client.ForwardMethod ("count", ParseJson (R"(["foo"])")),
+             "foo 2");
+}
+
+TEST_F (ClientRetryTests, ServerBreaker)
+{
+  client.EnableServerBreakers (1, std::chrono::milliseconds (500));
+  client.SetTimeout (std::chrono::milliseconds (300));
+
+  auto srv = ConnectServer ();
+  EXPECT_EQ (client.ForwardMethod ("echo", ParseJson (R"(["foo"])")), "foo");
+
+  /* After the failure, the only server instance is avoided, so that
+     the retries cannot find one.  */
+  backend.SetFailures (1);
+  EXPECT_THROW (client.ForwardMethod ("echo", ParseJson (R"(["foo"])")),
+                RpcServer::Error);
+  EXPECT_EQ (client.GetServerResource (), "");
+
+  /* Once the cooldown has passed, it is used again.  */
+  std::this_thread::sleep_for (std::chrono::milliseconds (500));
+  EXPECT_EQ (client.ForwardMethod ("echo", ParseJson (R"(["foo"])")), "foo");
+}
+
+/* ************************************************************************** */
+
+/**
+ * Tests forwarding of calls with a client using multiple XMPP connections.
+ */
+class ClientConnectionPoolTests : public ClientTestWithServer
+{
+
+protected:
+
+  ClientConnectionPoolTests ()
+  {
+    client.SetConnections (3);
+    ConnectClient ();
+  }
+
+};
+
+TEST_F (ClientConnectionPoolTests, CallsOnAllConnections)
+{
+  auto srv = ConnectServer ();
+
+  /* Consecutive calls are spread over the connections.  */
+  for (unsigned i = 0; i < 6; ++i)
+    EXPECT_EQ (client.ForwardMethod ("echo", ParseJson (R"(["foo"])")),
+               "foo");
+  EXPECT_THROW (client.ForwardMethod ("error", ParseJson (R"(["foo"])")),
+                RpcServer::Error);
+}
+
+TEST_F (ClientConnectionPoolTests, MultipleThreads)
+{
+  auto srv = ConnectServer ();
+
+  client.SetTimeout (std::chrono::milliseconds (500));
+  backend.SetDelay (std::chrono::milliseconds (10));
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < 10; ++i)
+    threads.emplace_back ([this, i] ()
+      {
+        for (unsigned j = 0; j < 3; ++j)
+          {
+            const std::string val = std::to_string (i) + "/"
+                                      + std::to_string (j);
+            Json::Value params(Json::arrayValue);
+            params.append (val);
+            EXPECT_EQ (client.ForwardMethod ("echo", params), val);
+          }
+      });
+
+  for (auto& t : threads)
+    t.join ();
+}
+
+TEST_F (ClientConnectionPoolTests, Reconnect)
+{
+  client.Disconnect ();
+  client.Connect ();
+
+  auto srv = ConnectServer ();
+  for (unsigned i = 0; i < 3; ++i)
+    EXPECT_EQ (client.ForwardMethod ("echo", ParseJson (R"(["foo"])")),
+               "foo");
+}
+
+TEST_F (ClientConnectionPoolTests, RetryExecutedOnce)
+{
+  client.SetTimeout (std::chrono::seconds (2));
+  client.SetRetryPolicy (3, std::chrono::milliseconds (200));
+  client.AllowRetries ("count");
+
+  auto srv = ConnectServer ();
+
+  /* Retries may be sent through another connection than the first attempt,
+     but the server still recognises them.  */
+  backend.SetDelay (std::chrono::milliseconds (300));
+  for (unsigned i = 1; i <= 3; ++i)
+    EXPECT_EQ (client.ForwardMethod ("count", ParseJson (R"(["foo"])")),
+               "foo " + std::to_string (i));
+}
+
+/* ************************************************************************** */
+
+/**
+ * Tests forwarding of calls with a client that has additional endpoints.
+ */
+using ClientEndpointTests = ClientTestWithServer;
+
+TEST_F (ClientEndpointTests, Calls)
+{
+  AddEndpoint ("endpoint");
+  ConnectClient ();
+  auto srv = ConnectServer ();
+
+  client.SetTimeout (std::chrono::milliseconds (500));
+  backend.SetDelay (std::chrono::milliseconds (10));
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < 5; ++i)
+    threads.emplace_back ([this] ()
+      {
+        for (unsigned j = 0; j < 3; ++j)
+          EXPECT_EQ (client.ForwardMethod ("echo", ParseJson (R"(["foo"])")),
+                     "foo");
+      });
+
+  for (auto& t : threads)
+    t.join ();
+}
+
+TEST_F (ClientEndpointTests, UnusableEndpoint)
+{
+  AddBrokenEndpoint ();
+  ConnectClient ();
+  auto srv = ConnectServer ();
+
+  /* Calls routed to the broken endpoint fall back to the main connection,
+     and afterwards it is avoided.  */
+  for (unsigned i = 0; i < 5; ++i)
+    EXPECT_EQ (client.ForwardMethod ("echo", ParseJson (R"(["foo"])")),
+               "foo");
+}
+
+TEST_F (ClientEndpointTests, FailsOverFromTimeout)
+{
+  AddEndpoint ("endpoint");
+  client.SetTimeout (std::chrono::seconds (2));
+  client.SetRetryPolicy (3, std::chrono::milliseconds (200));
+  client.AllowRetries ("echo");
+  ConnectClient ();
+  auto srv = ConnectServer ();
+
+  /* A connection on which an attempt timed out is avoided, but the call
+     is answered through the other one.  */
+  backend.SetDelay (std::chrono::milliseconds (300));
+  EXPECT_EQ (client.ForwardMethod ("echo", ParseJson (R"(["foo"])")), "foo");
+
+  backend.SetDelay (std::chrono::milliseconds (0));
+  for (unsigned i = 0; i < 3; ++i)
+    EXPECT_EQ (client.ForwardMethod ("echo", ParseJson (R"(["foo"])")),
+               "foo");
+}
+
 /* ************************************************************************** */
 
 /**
@@ -689,6 +1087,30 @@ TEST_F (ClientNotificationTests, AlwaysBlock)
   w->Expect ("b", "second");
 }
 
+TEST_F (ClientNotificationTests, NotificationLag)
+{
+  ConnectClient ({"foo"});
+
+  auto s = ConnectServer ();
+  s->AddPubSub (GetServerConfig ().pubsub);
+
+  auto upd = UpdatableState::Create ();
+  s->AddNotification (upd->NewWaiter ("foo"));
+
+  client.GetServerResource ();
+  EXPECT_EQ (client.GetNotificationLag ()["foo"]["total"]["count"], 0);
+
+  auto w = CallWaitForChange ("foo", "always block");
+  upd->SetState ("a", "value");
+  w->Expect ("a", "value");
+
+  const auto lag = client.GetNotificationLag ()["foo"];
+  EXPECT_EQ (lag["total"]["count"], 1);
+  EXPECT_EQ (lag["delivery"]["count"], 1);
+  EXPECT_GE (lag["total"]["sum"].asDouble (),
+             lag["delivery"]["sum"].asDouble ());
+}
+
 TEST_F (ClientNotificationTests, Reconnect)
 {
   ConnectClient ({"foo"});
@@ -812,6 +1234,295 @@ TEST_F (ClientNotificationTests, ServerReselection)
   w->Expect ("b", "value 2");
 }
 
+TEST_F (ClientNotificationTests, FilteredNotification)
+{
+  NotificationFilter filter;
+  ASSERT_TRUE (filter.Parse (ParseJson (R"({
+    "path": "",
+    "keys": ["id"]
+  })")));
+  client.AddFilteredNotification (
+      std::make_unique<UpdatableState::Notification> ("foo"), filter);
+  ConnectClient ({});
+
+  auto s = ConnectServer ();
+  s->AddPubSub (GetServerConfig ().pubsub);
+
+  auto upd = UpdatableState::Create ();
+  s->AddNotification (upd->NewWaiter ("foo"));
+
+  client.GetServerResource ();
+
+  auto w = CallWaitForChange ("foo", "always block");
+  w->ExpectRunning ();
+  upd->SetState ("a", "first");
+  w->Expect (ParseJson (R"({"id": "a"})"));
+
+  /* Changes outside of the filtered view do not wake up waiters.  */
+  w = CallWaitForChange ("foo", "always block");
+  upd->SetState ("a", "second");
+  w->ExpectRunning ();
+  upd->SetState ("b", "third");
+  w->Expect (ParseJson (R"({"id": "b"})"));
+}
+
+TEST_F (ClientNotificationTests, Listener)
+{
+  ReceivedMessages received;
+  client.AddNotificationListener ([&received] (const std::string& type,
+                                               const Json::Value& state)
+    {
+      received.Add (type + " " + state["id"].asString ());
+    });
+  ConnectClient ({"foo"});
+
+  auto s = ConnectServer ();
+  s->AddPubSub (GetServerConfig ().pubsub);
+
+  auto upd = UpdatableState::Create ();
+  s->AddNotification (upd->NewWaiter ("foo"));
+
+  client.GetServerResource ();
+
+  upd->SetState ("a", "first");
+  received.Expect ({"foo a"});
+  upd->SetState ("b", "second");
+  received.Expect ({"foo b"});
+}
+
+TEST_F (ClientNotificationTests, StandbyWithoutDuplicates)
+{
+  ReceivedMessages received;
+  client.AddNotificationListener ([&received] (const std::string& type,
+                                               const Json::Value& state)
+    {
+      received.Add (type + " " + state["id"].asString ());
+    });
+  AddEndpoint ("standby");
+  ConnectClient ({"foo"});
+
+  auto s = ConnectServer ();
+  s->AddPubSub (GetServerConfig ().pubsub);
+
+  auto upd = UpdatableState::Create ();
+  s->AddNotification (upd->NewWaiter ("foo"));
+
+  client.GetServerResource ();
+
+  /* Updates arrive through both subscriptions, but are only reported once
+     each.  */
+  upd->SetState ("a", "first");
+  received.Expect ({"foo a"});
+  upd->SetState ("b", "second");
+  received.Expect ({"foo b"});
+
+  auto call = CallWaitForChange ("foo", "b");
+  call->ExpectRunning ();
+  upd->SetState ("c", "third");
+  call->Expect ("c", "third");
+  received.Expect ({"foo c"});
+}
+
+TEST_F (ClientNotificationTests, WaitForAnyChange)
+{
+  ConnectClient ({"foo", "bar"});
+
+  auto s = ConnectServer ();
+  s->AddPubSub (GetServerConfig ().pubsub);
+
+  auto upd1 = UpdatableState::Create ();
+  s->AddNotification (upd1->NewWaiter ("foo"));
+  auto upd2 = UpdatableState::Create ();
+  s->AddNotification (upd2->NewWaiter ("bar"));
+
+  client.GetServerResource ();
+
+  auto w = CallWaitForChange ("foo", "always block");
+  upd1->SetState ("a", "first");
+  w->Expect ("a", "first");
+
+  std::string type;
+  Json::Value state;
+  ASSERT_TRUE (client.WaitForAnyChange ({{"foo", "x"},
+                                         {"bar", "always block"}},
+                                        type, state));
+  EXPECT_EQ (type, "foo");
+  EXPECT_EQ (state, UpdatableState::GetStateJson ("a", "first"));
+
+  std::atomic<bool> done(false);
+  bool changed;
+  std::thread caller([&] ()
+    {
+      changed = client.WaitForAnyChange ({{"foo", "a"},
+                                          {"bar", "always block"}},
+                                         type, state);
+      done = true;
+    });
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (100));
+  EXPECT_FALSE (done);
+
+  upd2->SetState ("b", "second");
+  caller.join ();
+  ASSERT_TRUE (changed);
+  EXPECT_EQ (type, "bar");
+  EXPECT_EQ (state, UpdatableState::GetStateJson ("b", "second"));
+}
+
+TEST_F (ClientNotificationTests, AlternativePubSub)
+{
+  const char* alt = GetServerConfig ().altPubsub;
+  if (alt == nullptr)
+    {
+      LOG (WARNING) << "No alternative pubsub service available";
+      return;
+    }
+
+  auto other = CreateOtherClient ();
+  other->AddPreferredPubSub (alt);
+  other->AddNotification (
+      std::make_unique<UpdatableState::Notification> ("foo"));
+  other->Connect ();
+
+  client.AddPreferredPubSub ("unknown service");
+  client.AddPreferredPubSub (GetServerConfig ().pubsub);
+  ConnectClient ({"foo"});
+
+  auto s = ConnectServer ();
+  s->AddPubSub (GetServerConfig ().pubsub);
+  s->AddPubSub (alt);
+
+  auto upd = UpdatableState::Create ();
+  s->AddNotification (upd->NewWaiter ("foo"));
+
+  client.GetServerResource ();
+  other->GetServerResource ();
+
+  /* Both clients receive the updates, each through its own service.  */
+  auto w = CallWaitForChange ("foo", "always block");
+  auto wOther = std::make_unique<WaitForChangeCall> (*other, "foo",
+                                                     "always block");
+  w->ExpectRunning ();
+  wOther->ExpectRunning ();
+
+  upd->SetState ("a", "first");
+  w->Expect ("a", "first");
+  wOther->Expect ("a", "first");
+}
+
+TEST_F (ClientNotificationTests, DirectPush)
+{
+  client.SetDirectPush (true);
+  ConnectClient ({"foo"});
+
+  auto s = ConnectServer ();
+  s->AddPubSub (GetServerConfig ().pubsub);
+
+  auto upd = UpdatableState::Create ();
+  s->AddNotification (upd->NewWaiter ("foo"));
+  s->EnableDirectPush (10);
+
+  upd->SetState ("a", "first");
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+
+  client.GetServerResource ();
+
+  /* The current state is pushed on registration.  */
+  auto w = CallWaitForChange ("foo", "x");
+  w->Expect ("a", "first");
+
+  w = CallWaitForChange ("foo", "a");
+  w->ExpectRunning ();
+  upd->SetState ("b", "second");
+  w->Expect ("b", "second");
+}
+
+TEST_F (ClientNotificationTests, DirectPushFiltered)
+{
+  NotificationFilter filter;
+  ASSERT_TRUE (filter.Parse (ParseJson (R"({
+    "path": "",
+    "keys": ["id"]
+  })")));
+  client.AddFilteredNotification (
+      std::make_unique<UpdatableState::Notification> ("foo"), filter);
+  client.SetDirectPush (true);
+  ConnectClient ({});
+
+  auto s = ConnectServer ();
+  s->AddPubSub (GetServerConfig ().pubsub);
+
+  auto upd = UpdatableState::Create ();
+  s->AddNotification (upd->NewWaiter ("foo"));
+  s->EnableDirectPush (10);
+
+  client.GetServerResource ();
+
+  auto w = CallWaitForChange ("foo", "always block");
+  w->ExpectRunning ();
+  upd->SetState ("a", "first");
+  w->Expect (ParseJson (R"({"id": "a"})"));
+
+  w = CallWaitForChange ("foo", "always block");
+  upd->SetState ("a", "second");
+  w->ExpectRunning ();
+  upd->SetState ("b", "third");
+  w->Expect (ParseJson (R"({"id": "b"})"));
+}
+
+TEST_F (ClientNotificationTests, DirectPushNotSupported)
+{
+  client.SetDirectPush (true);
+  ConnectClient ({"foo"});
+
+  auto s = ConnectServer ();
+  s->AddPubSub (GetServerConfig ().pubsub);
+
+  auto upd = UpdatableState::Create ();
+  s->AddNotification (upd->NewWaiter ("foo"));
+
+  client.GetServerResource ();
+
+  auto w = CallWaitForChange ("foo", "always block");
+  w->ExpectRunning ();
+  upd->SetState ("a", "first");
+  w->Expect ("a", "first");
+}
+
+TEST_F (ClientNotificationTests, DirectPushFallback)
+{
+  auto other = CreateOtherClient ();
+  other->SetDirectPush (true);
+  other->AddNotification (
+      std::make_unique<UpdatableState::Notification> ("foo"));
+  other->Connect ();
+
+  client.SetDirectPush (true);
+  ConnectClient ({"foo"});
+
+  auto s = ConnectServer ();
+  s->AddPubSub (GetServerConfig ().pubsub);
+
+  auto upd = UpdatableState::Create ();
+  s->AddNotification (upd->NewWaiter ("foo"));
+  s->EnableDirectPush (1);
+
+  /* The other client takes the only slot for direct push, so that our
+     registration is refused and we use the pubsub node instead.  */
+  ASSERT_NE (other->GetServerResource (), "");
+  client.GetServerResource ();
+
+  auto w = CallWaitForChange ("foo", "always block");
+  auto wOther = std::make_unique<WaitForChangeCall> (*other, "foo",
+                                                     "always block");
+  w->ExpectRunning ();
+  wOther->ExpectRunning ();
+
+  upd->SetState ("a", "first");
+  w->Expect ("a", "first");
+  wOther->Expect ("a", "first");
+}
+
 /* ************************************************************************** */
 
 } // anonymous namespace
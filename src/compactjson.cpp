@@ -0,0 +1,327 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "compactjson.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace charon
+{
+
+namespace
+{
+
+/*
+ * The encoding of a value starts with one byte for its type, followed by:
+ *
+ *  - nothing for null, false and true
+ *  - eight bytes for an integer, unsigned integer or double
+ *  - a 32-bit length and the raw bytes for a string
+ *  - a 32-bit element count and a table with 32-bit offsets (from the start
+ *    of the buffer) of the elements for an array
+ *  - a 32-bit member count and a table with pairs of 32-bit offsets of the
+ *    key and value for each member (sorted by key) for an object
+ *
+ * Keys are stored as a 32-bit length and the raw bytes.  The tables are
+ * followed by the data of the elements themselves.  All numbers are in the
+ * native byte order, since the encoding is never persisted or sent.
+ */
+
+enum class Type : char
+{
+  NUL = 0,
+  FALSE = 1,
+  TRUE = 2,
+  INT = 3,
+  UINT = 4,
+  REAL = 5,
+  STRING = 6,
+  ARRAY = 7,
+  OBJECT = 8,
+};
+
+using Offset = std::uint32_t;
+
+/**
+ * Helper class for encoding a Json::Value.
+ */
+class Encoder
+{
+
+private:
+
+  /** The buffer being written.  */
+  std::string& out;
+
+  /**
+   * Returns the current end of the buffer as offset.
+   */
+  Offset
+  GetOffset () const
+  {
+    CHECK_LE (out.size (), std::numeric_limits<Offset>::max ())
+        << "JSON value too large for compact representation";
+    return out.size ();
+  }
+
+  template <typename T>
+    void
+    Write (const T val)
+  {
+    out.append (reinterpret_cast<const char*> (&val), sizeof (val));
+  }
+
+  template <typename T>
+    void
+    Patch (const size_t pos, const T val)
+  {
+    std::memcpy (&out[pos], &val, sizeof (val));
+  }
+
+  void
+  WriteString (const std::string& str)
+  {
+    CHECK_LE (str.size (), std::numeric_limits<Offset>::max ());
+    Write<Offset> (str.size ());
+    out.append (str);
+  }
+
+public:
+
+  explicit Encoder (std::string& o)
+    : out(o)
+  {}
+
+  Encoder () = delete;
+  Encoder (const Encoder&) = delete;
+  void operator= (const Encoder&) = delete;
+
+  /**
+   * Appends the encoding of the given value to the buffer.
+   */
+  void Encode (const Json::Value& val);
+
+};
+
+void
+Encoder::Encode (const Json::Value& val)
+{
+  switch (val.type ())
+    {
+    case Json::nullValue:
+      Write (Type::NUL);
+      return;
+
+    case Json::booleanValue:
+      Write (val.asBool () ? Type::TRUE : Type::FALSE);
+      return;
+
+    case Json::intValue:
+      Write (Type::INT);
+      Write<std::int64_t> (val.asInt64 ());
+      return;
+
+    case Json::uintValue:
+      Write (Type::UINT);
+      Write<std::uint64_t> (val.asUInt64 ());
+      return;
+
+    case Json::realValue:
+      Write (Type::REAL);
+      Write<double> (val.asDouble ());
+      return;
+
+    case Json::stringValue:
+      Write (Type::STRING);
+      WriteString (val.asString ());
+      return;
+
+    case Json::arrayValue:
+      {
+        Write (Type::ARRAY);
+        Write<Offset> (val.size ());
+        const size_t table = out.size ();
+        out.resize (table + val.size () * sizeof (Offset));
+
+        for (Json::ArrayIndex i = 0; i < val.size (); ++i)
+          {
+            Patch (table + i * sizeof (Offset), GetOffset ());
+            Encode (val[i]);
+          }
+        return;
+      }
+
+    case Json::objectValue:
+      {
+        auto keys = val.getMemberNames ();
+        std::sort (keys.begin (), keys.end ());
+
+        Write (Type::OBJECT);
+        Write<Offset> (keys.size ());
+        const size_t table = out.size ();
+        out.resize (table + keys.size () * 2 * sizeof (Offset));
+
+        for (size_t i = 0; i < keys.size (); ++i)
+          {
+            const size_t entry = table + i * 2 * sizeof (Offset);
+            Patch (entry, GetOffset ());
+            WriteString (keys[i]);
+            Patch (entry + sizeof (Offset), GetOffset ());
+            Encode (val[keys[i]]);
+          }
+        return;
+      }
+    }
+
+  LOG (FATAL) << "Unexpected JSON value type: " << val.type ();
+}
+
+/**
+ * Helper class for decoding a buffer back into Json::Value.  The buffer
+ * is known to be valid (since we encoded it ourselves), so no error
+ * checking is done.
+ */
+class Decoder
+{
+
+private:
+
+  /** The buffer being read.  */
+  const std::string& in;
+
+  template <typename T>
+    T
+    Read (const size_t pos) const
+  {
+    T res;
+    std::memcpy (&res, &in[pos], sizeof (res));
+    return res;
+  }
+
+  std::string
+  ReadString (const size_t pos) const
+  {
+    const auto len = Read<Offset> (pos);
+    return in.substr (pos + sizeof (Offset), len);
+  }
+
+public:
+
+  explicit Decoder (const std::string& i)
+    : in(i)
+  {}
+
+  Decoder () = delete;
+  Decoder (const Decoder&) = delete;
+  void operator= (const Decoder&) = delete;
+
+  /**
+   * Decodes the value starting at the given offset.
+   */
+  Json::Value Decode (size_t pos) const;
+
+};
+
+Json::Value
+Decoder::Decode (const size_t pos) const
+{
+  const auto type = Read<Type> (pos);
+  const size_t payload = pos + sizeof (Type);
+
+  switch (type)
+    {
+    case Type::NUL:
+      return Json::Value ();
+    case Type::FALSE:
+      return false;
+    case Type::TRUE:
+      return true;
+
+    case Type::INT:
+      return static_cast<Json::Int64> (Read<std::int64_t> (payload));
+    case Type::UINT:
+      return static_cast<Json::UInt64> (Read<std::uint64_t> (payload));
+    case Type::REAL:
+      return Read<double> (payload);
+
+    case Type::STRING:
+      return ReadString (payload);
+
+    case Type::ARRAY:
+      {
+        const auto n = Read<Offset> (payload);
+        const size_t table = payload + sizeof (Offset);
+
+        Json::Value res(Json::arrayValue);
+        if (n > 0)
+          res.resize (n);
+        for (Offset i = 0; i < n; ++i)
+          res[i] = Decode (Read<Offset> (table + i * sizeof (Offset)));
+        return res;
+      }
+
+    case Type::OBJECT:
+      {
+        const auto n = Read<Offset> (payload);
+        const size_t table = payload + sizeof (Offset);
+
+        Json::Value res(Json::objectValue);
+        for (Offset i = 0; i < n; ++i)
+          {
+            const size_t entry = table + i * 2 * sizeof (Offset);
+            const auto key = ReadString (Read<Offset> (entry));
+            res[key] = Decode (Read<Offset> (entry + sizeof (Offset)));
+          }
+        return res;
+      }
+    }
+
+  LOG (FATAL) << "Invalid compact JSON type: " << static_cast<int> (type);
+}
+
+} // anonymous namespace
+
+CompactJson::CompactJson (const Json::Value& val)
+{
+  if (val.isNull ())
+    return;
+
+  auto buf = std::make_shared<std::string> ();
+  Encoder (*buf).Encode (val);
+  buf->shrink_to_fit ();
+
+  data = std::move (buf);
+}
+
+Json::Value
+CompactJson::ToJson () const
+{
+  if (data == nullptr)
+    return Json::Value ();
+
+  return Decoder (*data).Decode (0);
+}
+
+} // namespace charon
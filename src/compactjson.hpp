@@ -0,0 +1,118 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_COMPACTJSON_HPP
+#define CHARON_COMPACTJSON_HPP
+
+#include <json/json.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace charon
+{
+
+/**
+ * An immutable JSON value stored in a single contiguous buffer.  This is
+ * meant for values that are kept around for a long time (like the current
+ * state of a notification or cached results).  Compared to a Json::Value
+ * tree, it needs much less memory (no heap node per value) and can be
+ * compared with a simple memcmp.
+ *
+ * Arrays and objects are stored with a table of offsets to their elements,
+ * and object members are sorted by key.  The encoding is canonical, i.e.
+ * two instances are equal if and only if the Json::Value's they were
+ * constructed from are equal (with the exception of the sign of zero
+ * in floating-point numbers).
+ *
+ * Copies share the underlying buffer, so they are cheap and can be handed
+ * to other threads.
+ */
+class CompactJson
+{
+
+private:
+
+  /**
+   * The encoded data.  This is null for an instance representing JSON null,
+   * so that the default-constructed instance does not allocate.
+   */
+  std::shared_ptr<const std::string> data;
+
+public:
+
+  /**
+   * Constructs an instance representing JSON null.
+   */
+  CompactJson () = default;
+
+  /**
+   * Encodes the given JSON value.
+   */
+  explicit CompactJson (const Json::Value& val);
+
+  CompactJson (const CompactJson&) = default;
+  CompactJson (CompactJson&&) = default;
+  CompactJson& operator= (const CompactJson&) = default;
+  CompactJson& operator= (CompactJson&&) = default;
+
+  /**
+   * Returns true if this represents JSON null.
+   */
+  bool
+  IsNull () const
+  {
+    return data == nullptr;
+  }
+
+  /**
+   * Returns the size of the encoded data in bytes.
+   */
+  std::size_t
+  GetSize () const
+  {
+    return data == nullptr ? 0 : data->size ();
+  }
+
+  /**
+   * Decodes the value back into a Json::Value.
+   */
+  Json::Value ToJson () const;
+
+  friend bool
+  operator== (const CompactJson& a, const CompactJson& b)
+  {
+    if (a.data == b.data)
+      return true;
+    if (a.data == nullptr || b.data == nullptr)
+      return false;
+    return *a.data == *b.data;
+  }
+
+  friend bool
+  operator!= (const CompactJson& a, const CompactJson& b)
+  {
+    return !(a == b);
+  }
+
+};
+
+} // namespace charon
+
+#endif // CHARON_COMPACTJSON_HPP
@@ -0,0 +1,131 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "compactjson.hpp"
+
+#include "memorytags.hpp"
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <glog/logging.h>
+
+#include <string>
+
+namespace charon
+{
+namespace
+{
+
+using CompactJsonTests = testing::Test;
+
+TEST_F (CompactJsonTests, Null)
+{
+  const CompactJson def;
+  EXPECT_TRUE (def.IsNull ());
+  EXPECT_EQ (def.GetSize (), 0);
+  EXPECT_TRUE (def.ToJson ().isNull ());
+
+  const CompactJson fromNull((Json::Value ()));
+  EXPECT_TRUE (fromNull.IsNull ());
+  EXPECT_EQ (fromNull, def);
+
+  EXPECT_FALSE (CompactJson (Json::Value (0)).IsNull ());
+}
+
+TEST_F (CompactJsonTests, Roundtrip)
+{
+  const std::string tests[] =
+    {
+      "false",
+      "true",
+      "0",
+      "-42",
+      "18446744073709551615",
+      "-9223372036854775808",
+      "1.5",
+      "-1e100",
+      R"("")",
+      R"("foo\nbar\u0000baz")",
+      "[]",
+      "{}",
+      "[null, [[]], {}]",
+      R"(
+        {
+          "z": 1,
+          "a": [1, 2.5, "x", {"nested": {"deep": [true]}}],
+          "": "empty key",
+          "m": null
+        }
+      )",
+    };
+
+  for (const auto& t : tests)
+    {
+      VLOG (1) << "Testing with:\n" << t;
+      const auto value = ParseJson (t);
+      const CompactJson compact(value);
+
+      const auto decoded = compact.ToJson ();
+      EXPECT_EQ (decoded, value);
+      EXPECT_EQ (decoded.type (), value.type ());
+    }
+}
+
+TEST_F (CompactJsonTests, Equality)
+{
+  const auto a = ParseJson (R"({"foo": [1, 2], "bar": "x"})");
+  const auto b = ParseJson (R"({"bar": "x", "foo": [1, 2]})");
+  const auto c = ParseJson (R"({"bar": "x", "foo": [2, 1]})");
+
+  EXPECT_EQ (CompactJson (a), CompactJson (b));
+  EXPECT_NE (CompactJson (a), CompactJson (c));
+  EXPECT_NE (CompactJson (a), CompactJson ());
+  EXPECT_NE (CompactJson (ParseJson ("1")), CompactJson (ParseJson ("1.0")));
+  EXPECT_NE (CompactJson (ParseJson ("[]")), CompactJson (ParseJson ("{}")));
+}
+
+TEST_F (CompactJsonTests, CopiesShareData)
+{
+  const CompactJson a(ParseJson (R"({"foo": "bar"})"));
+  CompactJson b;
+  b = a;
+
+  EXPECT_EQ (a, b);
+  EXPECT_EQ (b.ToJson (), ParseJson (R"({"foo": "bar"})"));
+}
+
+TEST_F (CompactJsonTests, SmallerThanTree)
+{
+  Json::Value val(Json::arrayValue);
+  for (unsigned i = 0; i < 1'000; ++i)
+    {
+      Json::Value entry(Json::objectValue);
+      entry["id"] = i;
+      entry["name"] = "entry " + std::to_string (i);
+      entry["flag"] = (i % 2 == 0);
+      val.append (entry);
+    }
+
+  const CompactJson compact(val);
+  EXPECT_EQ (compact.ToJson (), val);
+  EXPECT_LT (compact.GetSize (), EstimateJsonSize (val) / 2);
+}
+
+} // anonymous namespace
+} // namespace charon
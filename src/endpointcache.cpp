@@ -0,0 +1,375 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include "endpointcache.hpp"
+
+#include <glog/logging.h>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#ifdef HAVE_LIBRESOLV
+# include <arpa/nameser.h>
+# include <resolv.h>
+#endif // HAVE_LIBRESOLV
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace charon
+{
+
+namespace
+{
+
+/** Minimum time for which resolved endpoints are cached.  */
+constexpr auto MIN_TTL = std::chrono::seconds (10);
+
+/** Maximum time for which resolved endpoints are cached.  */
+constexpr auto MAX_TTL = std::chrono::hours (1);
+
+/**
+ * Time after which another refresh is attempted, if refreshing an expired
+ * entry failed and the stale endpoints are used instead.
+ */
+constexpr auto STALE_RETRY = std::chrono::seconds (30);
+
+/** Cache time for endpoints of domains without SRV records.  */
+constexpr auto FALLBACK_TTL = std::chrono::minutes (5);
+
+/** Default port for XMPP client connections.  */
+constexpr int DEFAULT_PORT = 5222;
+
+#ifdef HAVE_LIBRESOLV
+
+/** Size of the buffer for DNS answers.  */
+constexpr int ANSWER_SIZE = 4'096;
+
+/**
+ * Looks up the SRV records for a given name.  Returns false if the lookup
+ * failed, and true if it succeeded (including if there are no records).
+ * ttl is set to the smallest TTL of the records.
+ */
+bool
+LookupSrv (const std::string& name, std::vector<SrvRecord>& records,
+           EndpointCache::Clock::duration& ttl)
+{
+  records.clear ();
+
+  /* res_query uses the global resolver state, which is not thread-safe.
+     Endpoints are resolved from the threads of all clients, so each
+     lookup uses its own state instead.  */
+  struct __res_state state;
+  std::memset (&state, 0, sizeof (state));
+  if (res_ninit (&state) != 0)
+    {
+      LOG (WARNING) << "Failed to initialise the resolver for " << name;
+      return false;
+    }
+
+  unsigned char answer[ANSWER_SIZE];
+  const int len = res_nquery (&state, name.c_str (), ns_c_in, ns_t_srv,
+                              answer, sizeof (answer));
+  const int err = state.res_h_errno;
+  res_nclose (&state);
+
+  if (len < 0)
+    {
+      if (err == HOST_NOT_FOUND || err == NO_DATA)
+        return true;
+
+      LOG (WARNING) << "SRV lookup for " << name << " failed: " << err;
+      return false;
+    }
+
+  ns_msg msg;
+  if (ns_initparse (answer, len, &msg) < 0)
+    {
+      LOG (WARNING) << "Invalid DNS answer for " << name;
+      return false;
+    }
+
+  bool first = true;
+  for (int i = 0; i < ns_msg_count (msg, ns_s_an); ++i)
+    {
+      ns_rr rr;
+      if (ns_parserr (&msg, ns_s_an, i, &rr) < 0)
+        continue;
+      if (ns_rr_type (rr) != ns_t_srv || ns_rr_rdlen (rr) < 7)
+        continue;
+
+      const unsigned char* rdata = ns_rr_rdata (rr);
+      char target[NS_MAXDNAME];
+      if (dn_expand (ns_msg_base (msg), ns_msg_end (msg), rdata + 6,
+                     target, sizeof (target)) < 0)
+        continue;
+
+      const std::chrono::seconds cur(ns_rr_ttl (rr));
+      if (first || cur < ttl)
+        ttl = cur;
+      first = false;
+
+      /* A target of "." means that the service is decidedly not
+         available at the domain.  */
+      if (target[0] == '\0')
+        continue;
+
+      SrvRecord r;
+      r.target = target;
+      r.priority = ns_get16 (rdata);
+      r.weight = ns_get16 (rdata + 2);
+      r.port = ns_get16 (rdata + 4);
+      records.push_back (r);
+    }
+
+  return true;
+}
+
+#else // HAVE_LIBRESOLV
+
+/**
+ * Without the resolver library, SRV records cannot be looked up.  We then
+ * report that there are none, so that the domain itself is used.
+ */
+bool
+LookupSrv (const std::string& name, std::vector<SrvRecord>& records,
+           EndpointCache::Clock::duration&)
+{
+  VLOG (1) << "Built without libresolv, not looking up " << name;
+  records.clear ();
+  return true;
+}
+
+#endif // HAVE_LIBRESOLV
+
+/**
+ * Resolves the numeric addresses of a host and adds them as endpoints
+ * with the given port.
+ */
+void
+AddAddresses (const std::string& host, const int port,
+              std::vector<XmppEndpoint>& endpoints)
+{
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  addrinfo* res;
+  const int rc = getaddrinfo (host.c_str (), nullptr, &hints, &res);
+  if (rc != 0)
+    {
+      LOG (WARNING)
+          << "Failed to resolve " << host << ": " << gai_strerror (rc);
+      return;
+    }
+
+  for (const addrinfo* p = res; p != nullptr; p = p->ai_next)
+    {
+      char buf[NI_MAXHOST];
+      if (getnameinfo (p->ai_addr, p->ai_addrlen, buf, sizeof (buf),
+                       nullptr, 0, NI_NUMERICHOST) != 0)
+        continue;
+
+      XmppEndpoint ep;
+      ep.host = host;
+      ep.address = buf;
+      ep.port = port;
+      if (std::find (endpoints.begin (), endpoints.end (), ep)
+            == endpoints.end ())
+        endpoints.push_back (ep);
+    }
+
+  freeaddrinfo (res);
+}
+
+} // anonymous namespace
+
+EndpointCache::EndpointCache (const Resolver& r)
+  : resolver(r)
+{}
+
+EndpointCache&
+EndpointCache::Default ()
+{
+  static EndpointCache instance(&ResolveXmppEndpoints);
+  return instance;
+}
+
+void
+EndpointCache::PromoteLastGood (Entry& e)
+{
+  if (e.lastGood == nullptr)
+    return;
+
+  auto it = std::find (e.endpoints.begin (), e.endpoints.end (), *e.lastGood);
+  if (it != e.endpoints.end ())
+    std::rotate (e.endpoints.begin (), it, it + 1);
+}
+
+std::vector<XmppEndpoint>
+EndpointCache::Get (const std::string& domain, bool& cached)
+{
+  /* We hold the lock also while resolving.  This blocks other lookups
+     for a moment, but it also means that several connections reconnecting
+     at the same time share a single resolution.  */
+  std::lock_guard<std::mutex> lock(mut);
+  const auto now = Clock::now ();
+
+  auto mit = entries.find (domain);
+  const bool haveStale
+      = mit != entries.end () && !mit->second.endpoints.empty ();
+  if (haveStale && now < mit->second.expiry)
+    {
+      cached = true;
+      return mit->second.endpoints;
+    }
+
+  std::vector<XmppEndpoint> resolved;
+  Clock::duration ttl;
+  if (!resolver (domain, resolved, ttl) || resolved.empty ())
+    {
+      if (!haveStale)
+        {
+          cached = false;
+          return {};
+        }
+
+      LOG (WARNING)
+          << "Could not refresh the endpoints of " << domain
+          << ", using stale ones";
+      mit->second.expiry = now + STALE_RETRY;
+      cached = true;
+      return mit->second.endpoints;
+    }
+
+  ttl = std::max<Clock::duration> (ttl, MIN_TTL);
+  ttl = std::min<Clock::duration> (ttl, MAX_TTL);
+
+  auto& e = entries[domain];
+  e.endpoints = std::move (resolved);
+  e.expiry = now + ttl;
+  PromoteLastGood (e);
+
+  cached = false;
+  return e.endpoints;
+}
+
+void
+EndpointCache::MarkGood (const std::string& domain, const XmppEndpoint& ep)
+{
+  std::lock_guard<std::mutex> lock(mut);
+  auto& e = entries[domain];
+  e.lastGood = std::make_unique<XmppEndpoint> (ep);
+  PromoteLastGood (e);
+}
+
+void
+EndpointCache::Invalidate (const std::string& domain)
+{
+  std::lock_guard<std::mutex> lock(mut);
+  auto mit = entries.find (domain);
+  if (mit != entries.end ())
+    mit->second.expiry = Clock::time_point ();
+}
+
+std::vector<SrvRecord>
+OrderSrvRecords (std::vector<SrvRecord> records, std::mt19937& rnd)
+{
+  std::stable_sort (records.begin (), records.end (),
+                    [] (const SrvRecord& a, const SrvRecord& b)
+                      {
+                        return a.priority < b.priority;
+                      });
+
+  std::vector<SrvRecord> res;
+  auto groupBegin = records.begin ();
+  while (groupBegin != records.end ())
+    {
+      auto groupEnd = groupBegin;
+      while (groupEnd != records.end ()
+               && groupEnd->priority == groupBegin->priority)
+        ++groupEnd;
+
+      /* Within the group, records with zero weight are put first, so that
+         they have a very small chance of being selected (RFC 2782).  */
+      std::vector<SrvRecord> group(groupBegin, groupEnd);
+      std::stable_partition (group.begin (), group.end (),
+                             [] (const SrvRecord& r)
+                               {
+                                 return r.weight == 0;
+                               });
+
+      while (!group.empty ())
+        {
+          std::uint64_t sum = 0;
+          for (const auto& r : group)
+            sum += r.weight;
+
+          std::uniform_int_distribution<std::uint64_t> dist(0, sum);
+          const auto selected = dist (rnd);
+
+          auto it = group.begin ();
+          std::uint64_t running = it->weight;
+          while (running < selected)
+            {
+              ++it;
+              running += it->weight;
+            }
+
+          res.push_back (*it);
+          group.erase (it);
+        }
+
+      groupBegin = groupEnd;
+    }
+
+  return res;
+}
+
+bool
+ResolveXmppEndpoints (const std::string& domain,
+                      std::vector<XmppEndpoint>& endpoints,
+                      EndpointCache::Clock::duration& ttl)
+{
+  std::vector<SrvRecord> records;
+  if (!LookupSrv ("_xmpp-client._tcp." + domain, records, ttl))
+    return false;
+
+  endpoints.clear ();
+  if (records.empty ())
+    {
+      VLOG (1) << "No SRV records for " << domain << ", using the domain";
+      AddAddresses (domain, DEFAULT_PORT, endpoints);
+      ttl = FALLBACK_TTL;
+      return !endpoints.empty ();
+    }
+
+  thread_local std::mt19937 rnd(std::random_device{} ());
+  for (const auto& r : OrderSrvRecords (std::move (records), rnd))
+    AddAddresses (r.target, r.port, endpoints);
+
+  VLOG (1)
+      << "Resolved " << endpoints.size () << " endpoints for " << domain;
+  return !endpoints.empty ();
+}
+
+} // namespace charon
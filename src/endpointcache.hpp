@@ -0,0 +1,199 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_ENDPOINTCACHE_HPP
+#define CHARON_ENDPOINTCACHE_HPP
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace charon
+{
+
+/**
+ * A network endpoint of an XMPP server that a client can connect to.
+ */
+struct XmppEndpoint
+{
+
+  /** Host name (e.g. the SRV target) the address belongs to.  */
+  std::string host;
+
+  /** Numeric network address to connect to.  */
+  std::string address;
+
+  /** Port to connect to.  */
+  int port;
+
+  friend bool
+  operator== (const XmppEndpoint& a, const XmppEndpoint& b)
+  {
+    return a.address == b.address && a.port == b.port;
+  }
+
+};
+
+/**
+ * A single DNS SRV record.
+ */
+struct SrvRecord
+{
+
+  /** The target host.  */
+  std::string target;
+
+  /** The target port.  */
+  int port;
+
+  /** The record's priority (lower values are preferred).  */
+  unsigned priority;
+
+  /** The record's weight within its priority.  */
+  unsigned weight;
+
+};
+
+/**
+ * Cache of the network endpoints for XMPP domains, so that reconnects do not
+ * have to go through the DNS SRV and address lookups each time.  Endpoints
+ * are kept in the order in which they should be tried, and the last one to
+ * which a connection succeeded is moved to the front (also across
+ * refreshes of the entry).  If refreshing an expired entry fails, e.g.
+ * because the network is flaky, the stale endpoints are used for a while
+ * longer instead.
+ *
+ * This class is thread-safe.
+ */
+class EndpointCache
+{
+
+public:
+
+  /** Clock used for the expiry of entries.  */
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Function that resolves the endpoints for a domain.  It returns false
+   * if the resolution failed, and otherwise fills in the endpoints in the
+   * order they should be tried and the time for which they may be cached.
+   */
+  using Resolver
+      = std::function<bool (const std::string& domain,
+                            std::vector<XmppEndpoint>& endpoints,
+                            Clock::duration& ttl)>;
+
+private:
+
+  /**
+   * Data cached for one domain.
+   */
+  struct Entry
+  {
+
+    /** The endpoints in the order they should be tried.  */
+    std::vector<XmppEndpoint> endpoints;
+
+    /** Time at which the entry needs to be refreshed.  */
+    Clock::time_point expiry;
+
+    /** The last endpoint that worked (if any).  */
+    std::unique_ptr<XmppEndpoint> lastGood;
+
+  };
+
+  /** The resolver used to fill the cache.  */
+  const Resolver resolver;
+
+  /** Mutex for the internal state.  */
+  std::mutex mut;
+
+  /** Cache entries by domain.  */
+  std::map<std::string, Entry> entries;
+
+  /**
+   * Moves the last-good endpoint of an entry to the front of its list,
+   * if it is in the list.
+   */
+  static void PromoteLastGood (Entry& e);
+
+public:
+
+  /**
+   * Constructs an empty cache that uses the given resolver.
+   */
+  explicit EndpointCache (const Resolver& r);
+
+  EndpointCache () = delete;
+  EndpointCache (const EndpointCache&) = delete;
+  void operator= (const EndpointCache&) = delete;
+
+  /**
+   * Returns the process-wide cache that resolves endpoints through DNS
+   * with ResolveXmppEndpoints.
+   */
+  static EndpointCache& Default ();
+
+  /**
+   * Returns the endpoints for the given domain, in the order in which
+   * they should be tried.  They are resolved if they are not cached yet
+   * or the entry expired, and cached is set to whether or not that was
+   * the case.  Returns an empty list if the domain could not be resolved.
+   */
+  std::vector<XmppEndpoint> Get (const std::string& domain, bool& cached);
+
+  /**
+   * Notes that a connection to the given endpoint of a domain succeeded,
+   * so that it is tried first from now on.
+   */
+  void MarkGood (const std::string& domain, const XmppEndpoint& ep);
+
+  /**
+   * Marks the cached endpoints of a domain as expired, so that they are
+   * resolved again on the next lookup.  They are still used if that fails.
+   */
+  void Invalidate (const std::string& domain);
+
+};
+
+/**
+ * Orders SRV records as described in RFC 2782, i.e. by ascending priority,
+ * and randomly (weighted) among records of the same priority.
+ */
+std::vector<SrvRecord> OrderSrvRecords (std::vector<SrvRecord> records,
+                                        std::mt19937& rnd);
+
+/**
+ * Resolves the endpoints for XMPP clients of a domain through DNS:  It looks
+ * up the _xmpp-client._tcp SRV records (falling back to the domain itself
+ * on the default port if there are none), and the addresses of all targets.
+ * The TTL is the smallest one of the SRV records.  This can be used
+ * as EndpointCache::Resolver.
+ */
+bool ResolveXmppEndpoints (const std::string& domain,
+                           std::vector<XmppEndpoint>& endpoints,
+                           EndpointCache::Clock::duration& ttl);
+
+} // namespace charon
+
+#endif // CHARON_ENDPOINTCACHE_HPP
@@ -0,0 +1,270 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "endpointcache.hpp"
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+namespace charon
+{
+namespace
+{
+
+/**
+ * Constructs an endpoint with the given address (also used as host name)
+ * and port.
+ */
+XmppEndpoint
+Endpoint (const std::string& address, const int port = 5222)
+{
+  XmppEndpoint res;
+  res.host = address;
+  res.address = address;
+  res.port = port;
+  return res;
+}
+
+/* ************************************************************************** */
+
+class EndpointCacheTests : public testing::Test
+{
+
+protected:
+
+  /** Endpoints returned by the fake resolver.  */
+  std::vector<XmppEndpoint> records;
+
+  /** TTL returned by the fake resolver.  */
+  EndpointCache::Clock::duration ttl = std::chrono::minutes (1);
+
+  /** Whether the fake resolver fails.  */
+  bool fail = false;
+
+  /** Number of resolutions done.  */
+  unsigned resolutions = 0;
+
+  EndpointCache cache;
+
+  EndpointCacheTests ()
+    : cache([this] (const std::string& domain,
+                    std::vector<XmppEndpoint>& endpoints,
+                    EndpointCache::Clock::duration& t)
+        {
+          ++resolutions;
+          if (fail)
+            return false;
+          endpoints = records;
+          t = ttl;
+          return true;
+        })
+  {}
+
+};
+
+TEST_F (EndpointCacheTests, ResolvesOnce)
+{
+  records = {Endpoint ("a"), Endpoint ("b")};
+
+  bool cached;
+  EXPECT_EQ (cache.Get ("domain", cached), records);
+  EXPECT_FALSE (cached);
+  EXPECT_EQ (cache.Get ("domain", cached), records);
+  EXPECT_TRUE (cached);
+  EXPECT_EQ (resolutions, 1u);
+
+  cache.Get ("other", cached);
+  EXPECT_FALSE (cached);
+  EXPECT_EQ (resolutions, 2u);
+}
+
+TEST_F (EndpointCacheTests, ResolutionFailure)
+{
+  fail = true;
+
+  bool cached;
+  EXPECT_TRUE (cache.Get ("domain", cached).empty ());
+  EXPECT_FALSE (cached);
+  EXPECT_TRUE (cache.Get ("domain", cached).empty ());
+  EXPECT_EQ (resolutions, 2u);
+}
+
+TEST_F (EndpointCacheTests, EmptyResolutionNotCached)
+{
+  bool cached;
+  EXPECT_TRUE (cache.Get ("domain", cached).empty ());
+  EXPECT_TRUE (cache.Get ("domain", cached).empty ());
+  EXPECT_EQ (resolutions, 2u);
+}
+
+TEST_F (EndpointCacheTests, Refresh)
+{
+  records = {Endpoint ("a")};
+  bool cached;
+  cache.Get ("domain", cached);
+
+  records = {Endpoint ("b")};
+  cache.Invalidate ("domain");
+  EXPECT_EQ (cache.Get ("domain", cached), records);
+  EXPECT_FALSE (cached);
+  EXPECT_EQ (resolutions, 2u);
+}
+
+TEST_F (EndpointCacheTests, StaleOnFailure)
+{
+  records = {Endpoint ("a"), Endpoint ("b")};
+  bool cached;
+  cache.Get ("domain", cached);
+
+  fail = true;
+  cache.Invalidate ("domain");
+  EXPECT_EQ (cache.Get ("domain", cached), records);
+  EXPECT_TRUE (cached);
+  EXPECT_EQ (resolutions, 2u);
+
+  /* The stale entry is not refreshed again right away.  */
+  EXPECT_EQ (cache.Get ("domain", cached), records);
+  EXPECT_EQ (resolutions, 2u);
+
+  /* An empty resolution does not replace the stale entry either.  */
+  fail = false;
+  records.clear ();
+  cache.Invalidate ("domain");
+  EXPECT_EQ (cache.Get ("domain", cached).size (), 2u);
+  EXPECT_EQ (resolutions, 3u);
+}
+
+TEST_F (EndpointCacheTests, LastGoodFirst)
+{
+  records = {Endpoint ("a"), Endpoint ("b"), Endpoint ("c")};
+  bool cached;
+  cache.Get ("domain", cached);
+
+  cache.MarkGood ("domain", Endpoint ("c"));
+  const std::vector<XmppEndpoint> expected
+      = {Endpoint ("c"), Endpoint ("a"), Endpoint ("b")};
+  EXPECT_EQ (cache.Get ("domain", cached), expected);
+  EXPECT_TRUE (cached);
+
+  /* The last-good endpoint is kept across a refresh.  */
+  cache.Invalidate ("domain");
+  EXPECT_EQ (cache.Get ("domain", cached), expected);
+  EXPECT_FALSE (cached);
+
+  /* If it is gone after the refresh, the resolved order is used.  */
+  records = {Endpoint ("a"), Endpoint ("b")};
+  cache.Invalidate ("domain");
+  EXPECT_EQ (cache.Get ("domain", cached), records);
+}
+
+TEST_F (EndpointCacheTests, PortDistinguishesEndpoints)
+{
+  records = {Endpoint ("a", 1), Endpoint ("a", 2)};
+  bool cached;
+  cache.Get ("domain", cached);
+
+  cache.MarkGood ("domain", Endpoint ("a", 2));
+  const std::vector<XmppEndpoint> expected
+      = {Endpoint ("a", 2), Endpoint ("a", 1)};
+  EXPECT_EQ (cache.Get ("domain", cached), expected);
+}
+
+/* ************************************************************************** */
+
+class OrderSrvRecordsTests : public testing::Test
+{
+
+protected:
+
+  std::mt19937 rnd;
+
+  static SrvRecord
+  Record (const std::string& target, const unsigned priority,
+          const unsigned weight)
+  {
+    SrvRecord res;
+    res.target = target;
+    res.port = 5222;
+    res.priority = priority;
+    res.weight = weight;
+    return res;
+  }
+
+  /**
+   * Orders the records and returns the targets.
+   */
+  std::vector<std::string>
+  Order (const std::vector<SrvRecord>& records)
+  {
+    std::vector<std::string> res;
+    for (const auto& r : OrderSrvRecords (records, rnd))
+      res.push_back (r.target);
+    return res;
+  }
+
+};
+
+TEST_F (OrderSrvRecordsTests, Empty)
+{
+  EXPECT_TRUE (Order ({}).empty ());
+}
+
+TEST_F (OrderSrvRecordsTests, ByPriority)
+{
+  const std::vector<std::string> expected = {"a", "b", "c"};
+  EXPECT_EQ (Order ({
+    Record ("c", 30, 10),
+    Record ("a", 10, 10),
+    Record ("b", 20, 10),
+  }), expected);
+}
+
+TEST_F (OrderSrvRecordsTests, ZeroWeights)
+{
+  const std::vector<std::string> expected = {"a", "b"};
+  EXPECT_EQ (Order ({Record ("a", 10, 0), Record ("b", 20, 0)}), expected);
+
+  const auto res = Order ({Record ("a", 10, 0), Record ("b", 10, 0)});
+  EXPECT_EQ (res.size (), 2u);
+}
+
+TEST_F (OrderSrvRecordsTests, WeightedWithinPriority)
+{
+  std::map<std::string, unsigned> firsts;
+  constexpr unsigned trials = 1'000;
+  for (unsigned i = 0; i < trials; ++i)
+    {
+      const auto res = Order ({
+        Record ("low", 10, 1),
+        Record ("high", 10, 9),
+        Record ("backup", 20, 100),
+      });
+      ASSERT_EQ (res.size (), 3u);
+      EXPECT_EQ (res[2], "backup");
+      ++firsts[res[0]];
+    }
+
+  EXPECT_GT (firsts["high"], firsts["low"] * 3);
+  EXPECT_GT (firsts["low"], 0u);
+}
+
+/* ************************************************************************** */
+
+} // anonymous namespace
+} // namespace charon
@@ -0,0 +1,94 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "health.hpp"
+
+#include <glog/logging.h>
+
+namespace charon
+{
+
+BackendHealth::BackendHealth (const unsigned maxF,
+                              const Clock::duration expiry)
+  : maxFailures(maxF), failureExpiry(expiry)
+{
+  CHECK_GT (maxFailures, 0);
+}
+
+void
+BackendHealth::RecordCall (const bool success)
+{
+  std::lock_guard<std::mutex> lock(mut);
+
+  if (success)
+    failures = 0;
+  else
+    {
+      ++failures;
+      lastFailure = Clock::now ();
+    }
+}
+
+void
+BackendHealth::AddWaiter (const WaiterThread& w)
+{
+  std::lock_guard<std::mutex> lock(mut);
+
+  auto& entry = waiters[w.GetType ()];
+  CHECK (entry.thread == nullptr)
+      << "Duplicate waiter thread for " << w.GetType ();
+  entry.thread = &w;
+}
+
+bool
+BackendHealth::IsHealthy () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+
+  if (failures >= maxFailures
+        && Clock::now () < lastFailure + failureExpiry)
+    {
+      VLOG (1) << "Backend had " << failures << " failed calls in a row";
+      return false;
+    }
+
+  for (const auto& entry : waiters)
+    {
+      const auto* thread = entry.second.thread;
+      if (thread == nullptr)
+        continue;
+
+      if (thread->IsBackingOff ())
+        {
+          VLOG (1) << "Waiter for " << entry.first << " is backing off";
+          return false;
+        }
+
+      const auto& maxStaleness = entry.second.maxStaleness;
+      if (maxStaleness > Clock::duration::zero ()
+            && thread->GetTimeSinceChange () > maxStaleness)
+        {
+          VLOG (1) << "State for " << entry.first << " is stale";
+          return false;
+        }
+    }
+
+  return true;
+}
+
+} // namespace charon
@@ -0,0 +1,140 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_HEALTH_HPP
+#define CHARON_HEALTH_HPP
+
+#include "waiterthread.hpp"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace charon
+{
+
+/**
+ * Tracker for the health of the backend GSP behind a Charon server.  It
+ * combines the results of forwarded calls with the state of the notification
+ * waiter threads, so that the server can stop accepting clients while
+ * the backend is not able to answer them.
+ */
+class BackendHealth
+{
+
+public:
+
+  /** Clock used for the staleness checks.  */
+  using Clock = WaiterThread::Clock;
+
+private:
+
+  /**
+   * Data about one of the watched waiter threads.
+   */
+  struct WatchedWaiter
+  {
+
+    /** The waiter thread itself (may be null if not added yet).  */
+    const WaiterThread* thread = nullptr;
+
+    /**
+     * Maximum time without state change before we consider the backend
+     * unhealthy.  Zero means that staleness is not checked.
+     */
+    Clock::duration maxStaleness = Clock::duration::zero ();
+
+  };
+
+  /**
+   * Number of consecutive failed calls after which the backend is
+   * considered unhealthy.
+   */
+  const unsigned maxFailures;
+
+  /** Mutex for the internal state.  */
+  mutable std::mutex mut;
+
+  /**
+   * Time after the last failed call at which the failures no longer make
+   * the backend unhealthy.  Since clients do not send calls to a server
+   * that withdrew, this lets it try again instead of staying withdrawn.
+   */
+  const Clock::duration failureExpiry;
+
+  /** Current number of consecutive failed calls.  */
+  unsigned failures = 0;
+
+  /** Time of the last failed call.  */
+  Clock::time_point lastFailure;
+
+  /** Watched waiter threads by notification type.  */
+  std::map<std::string, WatchedWaiter> waiters;
+
+public:
+
+  /**
+   * Constructs an instance that considers the backend unhealthy after
+   * the given number of consecutive failed calls, until the given time
+   * has passed since the last of them.  If the next call after that
+   * fails as well, the backend is unhealthy again right away.
+   */
+  explicit BackendHealth (unsigned maxF, Clock::duration expiry);
+
+  BackendHealth () = delete;
+  BackendHealth (const BackendHealth&) = delete;
+  void operator= (const BackendHealth&) = delete;
+
+  /**
+   * Records the result of a forwarded call to the backend.  Only failures
+   * to talk to the backend at all (not JSON-RPC errors) should be recorded
+   * as unsuccessful.
+   */
+  void RecordCall (bool success);
+
+  /**
+   * Adds a waiter thread to be watched.  The thread must stay alive as long
+   * as this instance is used.
+   */
+  void AddWaiter (const WaiterThread& w);
+
+  /**
+   * Sets the maximum staleness for the notification of the given type.
+   * If its state has not changed for longer than that, we consider the
+   * backend unhealthy (e.g. because it is still syncing or stuck).
+   */
+  template <typename Rep, typename Period>
+    void
+    SetMaxStaleness (const std::string& type,
+                     const std::chrono::duration<Rep, Period>& d)
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    waiters[type].maxStaleness = std::chrono::duration_cast<Clock::duration> (d);
+  }
+
+  /**
+   * Evaluates the current health of the backend.
+   */
+  bool IsHealthy () const;
+
+};
+
+} // namespace charon
+
+#endif // CHARON_HEALTH_HPP
@@ -0,0 +1,137 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "health.hpp"
+
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+namespace charon
+{
+namespace
+{
+
+class BackendHealthTests : public testing::Test
+{
+
+protected:
+
+  UpdatableState::Handle state;
+  std::unique_ptr<WaiterThread> thread;
+
+  BackendHealth health;
+
+  BackendHealthTests ()
+    : health(3, std::chrono::hours (1))
+  {
+    state = UpdatableState::Create ();
+    thread = state->NewWaiter ("foo");
+    thread->SetBackoff (std::chrono::milliseconds (100));
+    thread->Start ();
+  }
+
+  ~BackendHealthTests ()
+  {
+    thread->Stop ();
+  }
+
+};
+
+TEST_F (BackendHealthTests, FailedCalls)
+{
+  EXPECT_TRUE (health.IsHealthy ());
+
+  health.RecordCall (false);
+  health.RecordCall (false);
+  EXPECT_TRUE (health.IsHealthy ());
+  health.RecordCall (false);
+  EXPECT_FALSE (health.IsHealthy ());
+  health.RecordCall (false);
+  EXPECT_FALSE (health.IsHealthy ());
+
+  health.RecordCall (true);
+  EXPECT_TRUE (health.IsHealthy ());
+}
+
+TEST_F (BackendHealthTests, FailuresExpire)
+{
+  BackendHealth h(2, std::chrono::milliseconds (100));
+
+  h.RecordCall (false);
+  h.RecordCall (false);
+  EXPECT_FALSE (h.IsHealthy ());
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (150));
+  EXPECT_TRUE (h.IsHealthy ());
+
+  /* The next failure makes it unhealthy again immediately.  */
+  h.RecordCall (false);
+  EXPECT_FALSE (h.IsHealthy ());
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (150));
+  h.RecordCall (true);
+  h.RecordCall (false);
+  EXPECT_TRUE (h.IsHealthy ());
+}
+
+TEST_F (BackendHealthTests, WaiterBackoff)
+{
+  health.AddWaiter (*thread);
+  EXPECT_TRUE (health.IsHealthy ());
+
+  state->SetShouldFail (true);
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+  EXPECT_FALSE (health.IsHealthy ());
+
+  state->SetShouldFail (false);
+  std::this_thread::sleep_for (std::chrono::milliseconds (200));
+  EXPECT_TRUE (health.IsHealthy ());
+}
+
+TEST_F (BackendHealthTests, Staleness)
+{
+  health.AddWaiter (*thread);
+  health.SetMaxStaleness ("foo", std::chrono::milliseconds (100));
+
+  state->SetState ("a", "1");
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+  EXPECT_TRUE (health.IsHealthy ());
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (100));
+  EXPECT_FALSE (health.IsHealthy ());
+
+  state->SetState ("b", "2");
+  std::this_thread::sleep_for (std::chrono::milliseconds (20));
+  EXPECT_TRUE (health.IsHealthy ());
+}
+
+TEST_F (BackendHealthTests, StalenessOnlyForConfiguredTypes)
+{
+  health.AddWaiter (*thread);
+  health.SetMaxStaleness ("bar", std::chrono::milliseconds (10));
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+  EXPECT_TRUE (health.IsHealthy ());
+}
+
+} // anonymous namespace
+} // namespace charon
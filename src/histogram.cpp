@@ -0,0 +1,112 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "histogram.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace charon
+{
+
+namespace
+{
+
+/** Default bucket bounds for latencies in milliseconds.  */
+const std::vector<double> LATENCY_BOUNDS_MS
+    = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1'000, 2'000, 5'000, 10'000};
+
+} // anonymous namespace
+
+Histogram::Histogram (const std::vector<double>& b)
+  : bounds(b), counts(b.size () + 1, 0)
+{
+  CHECK (std::is_sorted (bounds.begin (), bounds.end ()))
+      << "Histogram bounds must be sorted";
+}
+
+Histogram::Histogram ()
+  : Histogram(LATENCY_BOUNDS_MS)
+{}
+
+void
+Histogram::Record (const double value)
+{
+  const auto it = std::lower_bound (bounds.begin (), bounds.end (), value);
+
+  std::lock_guard<std::mutex> lock(mut);
+  ++counts[it - bounds.begin ()];
+  ++total;
+  sum += value;
+  if (total == 1 || value > max)
+    max = value;
+}
+
+std::uint64_t
+Histogram::GetCount () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return total;
+}
+
+double
+Histogram::GetQuantile (const double q) const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  if (total == 0)
+    return 0.0;
+
+  const auto rank = static_cast<std::uint64_t> (std::ceil (q * total));
+  std::uint64_t seen = 0;
+  for (size_t i = 0; i < bounds.size (); ++i)
+    {
+      seen += counts[i];
+      if (seen >= rank && seen > 0)
+        return bounds[i];
+    }
+
+  return max;
+}
+
+Json::Value
+Histogram::ToJson () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+
+  Json::Value res(Json::objectValue);
+  res["count"] = static_cast<Json::UInt64> (total);
+  res["sum"] = sum;
+  res["max"] = max;
+
+  Json::Value buckets(Json::arrayValue);
+  for (size_t i = 0; i < counts.size (); ++i)
+    {
+      Json::Value b(Json::objectValue);
+      if (i < bounds.size ())
+        b["le"] = bounds[i];
+      b["count"] = static_cast<Json::UInt64> (counts[i]);
+      buckets.append (b);
+    }
+  res["buckets"] = buckets;
+
+  return res;
+}
+
+} // namespace charon
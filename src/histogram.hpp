@@ -0,0 +1,105 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_HISTOGRAM_HPP
+#define CHARON_HISTOGRAM_HPP
+
+#include <json/json.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace charon
+{
+
+/**
+ * A thread-safe histogram of values (e.g. latencies in milliseconds) with
+ * fixed bucket bounds.
+ */
+class Histogram
+{
+
+private:
+
+  /** Upper bounds (inclusive) of the buckets, in ascending order.  */
+  const std::vector<double> bounds;
+
+  /** Mutex for the internal state.  */
+  mutable std::mutex mut;
+
+  /**
+   * Counts of values per bucket.  This has one more element than bounds,
+   * for values above the largest bound.
+   */
+  std::vector<std::uint64_t> counts;
+
+  /** Total number of values.  */
+  std::uint64_t total = 0;
+
+  /** Sum of all values.  */
+  double sum = 0.0;
+
+  /** Largest value recorded.  */
+  double max = 0.0;
+
+public:
+
+  /**
+   * Constructs an empty histogram with the given bucket bounds.
+   */
+  explicit Histogram (const std::vector<double>& b);
+
+  /**
+   * Constructs an empty histogram with bounds suitable for latencies
+   * in milliseconds.
+   */
+  Histogram ();
+
+  Histogram (const Histogram&) = delete;
+  void operator= (const Histogram&) = delete;
+
+  /**
+   * Records a value.
+   */
+  void Record (double value);
+
+  /**
+   * Returns the number of recorded values.
+   */
+  std::uint64_t GetCount () const;
+
+  /**
+   * Returns an upper bound for the given quantile (between 0 and 1), i.e.
+   * the upper bound of the bucket containing it.  For the overflow bucket,
+   * the largest recorded value is returned.
+   */
+  double GetQuantile (double q) const;
+
+  /**
+   * Returns the histogram as JSON, with "count", "sum", "max" and
+   * the "buckets" as array of objects with "le" (the bucket bound,
+   * missing for the overflow bucket) and "count".
+   */
+  Json::Value ToJson () const;
+
+};
+
+} // namespace charon
+
+#endif // CHARON_HISTOGRAM_HPP
@@ -0,0 +1,105 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "histogram.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace charon
+{
+namespace
+{
+
+class HistogramTests : public testing::Test
+{
+
+protected:
+
+  /**
+   * Expects that the JSON form of the histogram has the given count and
+   * per-bucket counts.
+   */
+  static void
+  ExpectCounts (const Histogram& h, const unsigned count,
+                const std::vector<unsigned>& buckets)
+  {
+    const auto val = h.ToJson ();
+    EXPECT_EQ (val["count"].asUInt (), count);
+
+    const auto& b = val["buckets"];
+    ASSERT_EQ (b.size (), buckets.size ());
+    for (unsigned i = 0; i < buckets.size (); ++i)
+      EXPECT_EQ (b[i]["count"].asUInt (), buckets[i]) << "Bucket " << i;
+  }
+
+};
+
+TEST_F (HistogramTests, Empty)
+{
+  const Histogram h({1, 10});
+  EXPECT_EQ (h.GetCount (), 0u);
+  EXPECT_EQ (h.GetQuantile (0.5), 0.0);
+  ExpectCounts (h, 0, {0, 0, 0});
+}
+
+TEST_F (HistogramTests, Buckets)
+{
+  Histogram h({1, 10});
+  h.Record (0.5);
+  h.Record (1);
+  h.Record (5);
+  h.Record (20);
+
+  EXPECT_EQ (h.GetCount (), 4u);
+  ExpectCounts (h, 4, {2, 1, 1});
+
+  const auto val = h.ToJson ();
+  EXPECT_EQ (val["sum"].asDouble (), 26.5);
+  EXPECT_EQ (val["max"].asDouble (), 20.0);
+  EXPECT_EQ (val["buckets"][0]["le"].asDouble (), 1.0);
+  EXPECT_EQ (val["buckets"][1]["le"].asDouble (), 10.0);
+  EXPECT_FALSE (val["buckets"][2].isMember ("le"));
+}
+
+TEST_F (HistogramTests, Quantiles)
+{
+  Histogram h({1, 10, 100});
+  for (unsigned i = 0; i < 90; ++i)
+    h.Record (5);
+  for (unsigned i = 0; i < 9; ++i)
+    h.Record (50);
+  h.Record (500);
+
+  EXPECT_EQ (h.GetQuantile (0.0), 10.0);
+  EXPECT_EQ (h.GetQuantile (0.5), 10.0);
+  EXPECT_EQ (h.GetQuantile (0.9), 10.0);
+  EXPECT_EQ (h.GetQuantile (0.95), 100.0);
+  EXPECT_EQ (h.GetQuantile (1.0), 500.0);
+}
+
+TEST_F (HistogramTests, DefaultBounds)
+{
+  Histogram h;
+  h.Record (3);
+  EXPECT_EQ (h.GetQuantile (1.0), 5.0);
+}
+
+} // anonymous namespace
+} // namespace charon
@@ -0,0 +1,106 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "hotqueries.hpp"
+
+#include "resultcache.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace charon
+{
+
+HotQueries::HotQueries (const size_t maxT)
+  : maxTracked(maxT)
+{
+  CHECK_GT (maxTracked, 0);
+}
+
+void
+HotQueries::Record (const std::string& method, const Json::Value& params)
+{
+  const std::string key = ResultCache::GetKey (method, params);
+
+  std::lock_guard<std::mutex> lock(mut);
+
+  auto mit = entries.find (key);
+  if (mit != entries.end ())
+    {
+      ++mit->second.count;
+      return;
+    }
+
+  while (entries.size () >= maxTracked)
+    DecayLocked ();
+
+  Entry e;
+  e.query.method = method;
+  e.query.params = params;
+  e.count = 1;
+  entries.emplace (key, std::move (e));
+}
+
+void
+HotQueries::DecayLocked ()
+{
+  for (auto it = entries.begin (); it != entries.end (); )
+    {
+      it->second.count /= 2;
+      if (it->second.count == 0)
+        it = entries.erase (it);
+      else
+        ++it;
+    }
+}
+
+void
+HotQueries::Decay ()
+{
+  std::lock_guard<std::mutex> lock(mut);
+  DecayLocked ();
+}
+
+std::vector<HotQueries::Query>
+HotQueries::GetTop (const size_t n) const
+{
+  std::vector<const Entry*> sorted;
+  std::vector<Query> res;
+
+  std::lock_guard<std::mutex> lock(mut);
+
+  sorted.reserve (entries.size ());
+  for (const auto& e : entries)
+    sorted.push_back (&e.second);
+
+  const size_t num = std::min (n, sorted.size ());
+  std::partial_sort (sorted.begin (), sorted.begin () + num, sorted.end (),
+                     [] (const Entry* a, const Entry* b)
+                       {
+                         return a->count > b->count;
+                       });
+
+  res.reserve (num);
+  for (size_t i = 0; i < num; ++i)
+    res.push_back (sorted[i]->query);
+
+  return res;
+}
+
+} // namespace charon
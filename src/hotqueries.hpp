@@ -0,0 +1,125 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_HOTQUERIES_HPP
+#define CHARON_HOTQUERIES_HPP
+
+#include <json/json.h>
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace charon
+{
+
+/**
+ * Tracks how often each (method, params) combination is called, so that
+ * the most popular ones can be determined.  Counts decay over time (each
+ * time Decay is called, typically once per block), so that the ranking
+ * follows the current usage pattern.
+ *
+ * This class is thread-safe.
+ */
+class HotQueries
+{
+
+public:
+
+  /**
+   * A single tracked call.
+   */
+  struct Query
+  {
+
+    /** The method name.  */
+    std::string method;
+
+    /** The call's params.  */
+    Json::Value params;
+
+  };
+
+private:
+
+  /**
+   * Data tracked for each call.
+   */
+  struct Entry
+  {
+
+    /** The actual call.  */
+    Query query;
+
+    /** Number of times it was called (with decay applied).  */
+    unsigned count;
+
+  };
+
+  /**
+   * Maximum number of distinct calls that we track.  If more are recorded,
+   * counts are decayed early to make room.
+   */
+  const size_t maxTracked;
+
+  /** Mutex for the internal state.  */
+  mutable std::mutex mut;
+
+  /** The tracked calls by their ResultCache key.  */
+  std::unordered_map<std::string, Entry> entries;
+
+  /**
+   * Halves all counts and removes entries that drop to zero.  Must be
+   * called with the lock held.
+   */
+  void DecayLocked ();
+
+public:
+
+  /**
+   * Constructs an instance that tracks at most the given number of
+   * distinct calls at any time.
+   */
+  explicit HotQueries (size_t maxT);
+
+  HotQueries () = delete;
+  HotQueries (const HotQueries&) = delete;
+  void operator= (const HotQueries&) = delete;
+
+  /**
+   * Records a call.
+   */
+  void Record (const std::string& method, const Json::Value& params);
+
+  /**
+   * Halves all counts, so that old popularity fades out.
+   */
+  void Decay ();
+
+  /**
+   * Returns up to n calls with the highest counts, the most popular first.
+   */
+  std::vector<Query> GetTop (size_t n) const;
+
+};
+
+} // namespace charon
+
+#endif // CHARON_HOTQUERIES_HPP
@@ -0,0 +1,111 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "hotqueries.hpp"
+
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace charon
+{
+namespace
+{
+
+class HotQueriesTests : public testing::Test
+{
+
+protected:
+
+  /**
+   * Records a call to method "foo" with the given params n times.
+   */
+  static void
+  Call (HotQueries& hot, const std::string& params, const unsigned n)
+  {
+    for (unsigned i = 0; i < n; ++i)
+      hot.Record ("foo", ParseJson (params));
+  }
+
+  /**
+   * Extracts the params of the given top queries.
+   */
+  static std::vector<Json::Value>
+  GetParams (const std::vector<HotQueries::Query>& queries)
+  {
+    std::vector<Json::Value> res;
+    for (const auto& q : queries)
+      {
+        EXPECT_EQ (q.method, "foo");
+        res.push_back (q.params);
+      }
+    return res;
+  }
+
+};
+
+TEST_F (HotQueriesTests, Empty)
+{
+  HotQueries hot(10);
+  EXPECT_TRUE (hot.GetTop (5).empty ());
+}
+
+TEST_F (HotQueriesTests, Ranking)
+{
+  HotQueries hot(10);
+  Call (hot, "[1]", 2);
+  Call (hot, "[2]", 5);
+  Call (hot, "[3]", 1);
+  Call (hot, "[4]", 3);
+
+  EXPECT_EQ (GetParams (hot.GetTop (2)),
+             (std::vector<Json::Value> {ParseJson ("[2]"), ParseJson ("[4]")}));
+  EXPECT_EQ (hot.GetTop (10).size (), 4u);
+}
+
+TEST_F (HotQueriesTests, Decay)
+{
+  HotQueries hot(10);
+  Call (hot, "[1]", 8);
+  Call (hot, "[2]", 1);
+
+  hot.Decay ();
+  EXPECT_EQ (GetParams (hot.GetTop (10)),
+             std::vector<Json::Value> {ParseJson ("[1]")});
+
+  Call (hot, "[2]", 5);
+  EXPECT_EQ (GetParams (hot.GetTop (1)),
+             std::vector<Json::Value> {ParseJson ("[2]")});
+}
+
+TEST_F (HotQueriesTests, MaxTracked)
+{
+  HotQueries hot(2);
+  Call (hot, "[1]", 4);
+  Call (hot, "[2]", 1);
+  Call (hot, "[3]", 1);
+
+  EXPECT_EQ (GetParams (hot.GetTop (10)),
+             (std::vector<Json::Value> {ParseJson ("[1]"), ParseJson ("[3]")}));
+}
+
+} // anonymous namespace
+} // namespace charon
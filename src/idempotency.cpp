@@ -0,0 +1,186 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "idempotency.hpp"
+
+#include "memorytags.hpp"
+
+#include <glog/logging.h>
+
+namespace charon
+{
+
+namespace
+{
+
+/** Memory tag for memoised outcomes.  */
+MemoryTag memIdempotency("idempotency");
+
+/**
+ * Returns the estimated memory size of a call outcome.
+ */
+std::size_t
+EstimateOutcomeSize (const CallOutcome& outcome)
+{
+  return sizeof (outcome)
+            + EstimateJsonSize (outcome.result)
+            + outcome.errorMessage.size ()
+            + EstimateJsonSize (outcome.errorData);
+}
+
+} // anonymous namespace
+
+/**
+ * Data for a single memo entry.
+ */
+struct IdempotencyMemo::Entry
+{
+
+  Entry ()
+    : memory(memIdempotency)
+  {}
+
+  /** The method of the call.  */
+  std::string method;
+
+  /** The parameters of the call.  */
+  Json::Value params;
+
+  /** The call's outcome.  */
+  CallOutcome outcome;
+
+  /** Size of the entry counted against the memo's byte budget.  */
+  std::size_t bytes = 0;
+
+  /** Accounting of the memory used by this entry.  */
+  TrackedMemory memory;
+
+};
+
+IdempotencyMemo::~IdempotencyMemo () = default;
+
+void
+IdempotencyMemo::Prune ()
+{
+  const auto now = Clock::now ();
+  while (!expiry.empty () && expiry.front ().first <= now)
+    {
+      const auto mit = entries.find (expiry.front ().second);
+      CHECK (mit != entries.end ());
+      CHECK_GE (totalBytes, mit->second->bytes);
+      totalBytes -= mit->second->bytes;
+
+      entries.erase (mit);
+      expiry.pop_front ();
+    }
+}
+
+CallOutcome
+IdempotencyMemo::Execute (const std::string& client, const std::string& id,
+                          const std::string& method, const Json::Value& params,
+                          const Call& call, bool& executed)
+{
+  const Key key(client, id);
+
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    Prune ();
+
+    const auto mit = entries.find (key);
+    if (mit != entries.end ())
+      {
+        const auto& e = *mit->second;
+        if (e.method == method && e.params == params)
+          {
+            VLOG (1)
+                << "Returning memoised outcome for request " << id
+                << " of " << client;
+            executed = false;
+            return e.outcome;
+          }
+
+        /* The ID is reused for a different call.  This is not a retry,
+           so just execute it (without replacing the memoised outcome).  */
+        LOG (WARNING)
+            << "Request " << id << " of " << client
+            << " does not match the memoised call, executing it";
+        executed = true;
+        return call ();
+      }
+  }
+
+  executed = true;
+  const CallOutcome outcome = call ();
+
+  /* Stale results are served only while the backend is down, and a retry
+     after it is back should get fresh data.  */
+  if (outcome.transient || outcome.stale)
+    return outcome;
+
+  /* Build the entry and estimate its size before taking the lock, as that
+     walks through the entire (possibly large) result.  */
+  auto entry = std::make_shared<Entry> ();
+  entry->method = method;
+  entry->params = params;
+  entry->outcome = outcome;
+  entry->bytes = EstimateOutcomeSize (outcome) + client.size () + id.size ()
+                  + method.size () + EstimateJsonSize (params);
+  entry->memory.Set (entry->bytes);
+
+  std::lock_guard<std::mutex> lock(mut);
+  if (entries.count (key) > 0)
+    return outcome;
+
+  if (entries.size () >= maxEntries)
+    {
+      LOG (WARNING)
+          << "Idempotency memo is full, not memoising request " << id
+          << " of " << client;
+      return outcome;
+    }
+
+  if (totalBytes + entry->bytes > maxBytes)
+    {
+      LOG (WARNING)
+          << "Idempotency memo has no room for " << entry->bytes << " bytes,"
+          << " not memoising request " << id << " of " << client;
+      return outcome;
+    }
+
+  totalBytes += entry->bytes;
+  entries.emplace (key, std::move (entry));
+  expiry.emplace_back (Clock::now () + ttl, key);
+
+  return outcome;
+}
+
+std::size_t
+IdempotencyMemo::Size () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return entries.size ();
+}
+
+std::size_t
+IdempotencyMemo::Bytes () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return totalBytes;
+}
+
+} // namespace charon
@@ -0,0 +1,178 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_IDEMPOTENCY_HPP
+#define CHARON_IDEMPOTENCY_HPP
+
+#include <json/json.h>
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace charon
+{
+
+/**
+ * The outcome of an RPC call as it is memoised by IdempotencyMemo, either
+ * a successful result or a JSON-RPC error.
+ */
+struct CallOutcome
+{
+
+  /** Whether or not the call succeeded.  */
+  bool success = false;
+
+  /** The result on success.  */
+  Json::Value result;
+
+  /** Whether the result is a stale fallback.  */
+  bool stale = false;
+
+  /** The error code on failure.  */
+  int errorCode = 0;
+
+  /** The error message on failure.  */
+  std::string errorMessage;
+
+  /** The error data on failure.  */
+  Json::Value errorData;
+
+  /**
+   * Set to true if this is a transient failure (e.g. the backend could not
+   * be reached).  Such an outcome is not memoised, so that a retry of the
+   * call executes it again.
+   */
+  bool transient = false;
+
+};
+
+/**
+ * A short-lived memo of RPC call outcomes keyed by the requesting client
+ * and a request ID chosen by the client.  Clients reuse the request ID when
+ * they retry a call (e.g. after a timeout), so that the server can answer
+ * the retry without executing the backend call again, as long as the
+ * outcome is still within the memo's time-to-live.
+ *
+ * The method and parameters of the original call are stored as well.  If a
+ * request with a known ID does not match them, it is treated as a fresh call
+ * instead of a retry.
+ *
+ * The number of memoised outcomes and their total (estimated) size are
+ * bounded; if the memo is full, calls are simply executed without
+ * memoisation.
+ *
+ * This class is thread-safe.
+ */
+class IdempotencyMemo
+{
+
+public:
+
+  /** Clock used for expiry.  */
+  using Clock = std::chrono::steady_clock;
+
+  /** A call that is executed (at most once per key).  */
+  using Call = std::function<CallOutcome ()>;
+
+private:
+
+  /** Key of a memo entry:  The client's JID and the request ID.  */
+  using Key = std::pair<std::string, std::string>;
+
+  struct Entry;
+
+  /** Time for which outcomes are kept.  */
+  const Clock::duration ttl;
+
+  /** Maximum number of entries.  */
+  const std::size_t maxEntries;
+
+  /** Maximum total size of memoised entries in bytes.  */
+  const std::size_t maxBytes;
+
+  /** Current total size of memoised entries.  */
+  std::size_t totalBytes = 0;
+
+  /** Mutex for the internal state.  */
+  mutable std::mutex mut;
+
+  /** All current entries by key.  */
+  std::map<Key, std::shared_ptr<Entry>> entries;
+
+  /** Entries with their expiry times, in order of expiry.  */
+  std::deque<std::pair<Clock::time_point, Key>> expiry;
+
+  /**
+   * Removes all expired entries.  The caller must hold the lock on mut.
+   */
+  void Prune ();
+
+public:
+
+  /**
+   * Constructs an empty memo with the given time-to-live for outcomes,
+   * maximum number of entries and maximum total size of entries.
+   */
+  template <typename Rep, typename Period>
+    explicit IdempotencyMemo (const std::chrono::duration<Rep, Period>& t,
+                              const std::size_t maxE, const std::size_t maxB)
+    : ttl(std::chrono::duration_cast<Clock::duration> (t)),
+      maxEntries(maxE), maxBytes(maxB)
+  {}
+
+  IdempotencyMemo () = delete;
+  IdempotencyMemo (const IdempotencyMemo&) = delete;
+  void operator= (const IdempotencyMemo&) = delete;
+
+  ~IdempotencyMemo ();
+
+  /**
+   * Returns the outcome for the given client's request ID with the given
+   * method and parameters, executing the call if there is no memoised
+   * outcome for it.  executed is set to true if the call was executed by
+   * this invocation.
+   *
+   * If the call throws or its outcome is transient or stale, it is passed on
+   * to the caller but not memoised, so that a retry executes it again.
+   */
+  CallOutcome Execute (const std::string& client, const std::string& id,
+                       const std::string& method, const Json::Value& params,
+                       const Call& call, bool& executed);
+
+  /**
+   * Returns the number of current entries (for testing).
+   */
+  std::size_t Size () const;
+
+  /**
+   * Returns the total size of memoised entries (for testing).
+   */
+  std::size_t Bytes () const;
+
+};
+
+} // namespace charon
+
+#endif // CHARON_IDEMPOTENCY_HPP
@@ -0,0 +1,306 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "idempotency.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace charon
+{
+namespace
+{
+
+using namespace std::chrono_literals;
+
+class IdempotencyMemoTests : public testing::Test
+{
+
+protected:
+
+  /** Number of times the call has been executed.  */
+  std::atomic<unsigned> calls{0};
+
+  /**
+   * Returns a call that counts its executions and returns the given
+   * result (after an optional delay).
+   */
+  IdempotencyMemo::Call
+  MakeCall (const int value,
+            const std::chrono::milliseconds delay = 0ms)
+  {
+    return [this, value, delay] ()
+      {
+        std::this_thread::sleep_for (delay);
+        ++calls;
+
+        CallOutcome res;
+        res.success = true;
+        res.result = value;
+        return res;
+      };
+  }
+
+  /**
+   * Executes a call through the memo for a fixed client and method
+   * without parameters.
+   */
+  static CallOutcome
+  Execute (IdempotencyMemo& memo, const std::string& id,
+           const IdempotencyMemo::Call& call, bool& executed)
+  {
+    return memo.Execute ("client@example.com", id, "method", Json::Value (),
+                         call, executed);
+  }
+
+};
+
+TEST_F (IdempotencyMemoTests, MemoisesOutcome)
+{
+  IdempotencyMemo memo(1h, 10, 1 << 20);
+  bool executed;
+
+  auto res = Execute (memo, "id", MakeCall (42), executed);
+  EXPECT_TRUE (executed);
+  EXPECT_EQ (res.result, 42);
+
+  res = Execute (memo, "id", MakeCall (100), executed);
+  EXPECT_FALSE (executed);
+  EXPECT_EQ (res.result, 42);
+
+  EXPECT_EQ (calls, 1);
+}
+
+TEST_F (IdempotencyMemoTests, MemoisesErrors)
+{
+  IdempotencyMemo memo(1h, 10, 1 << 20);
+  bool executed;
+
+  Execute (memo, "id", [] ()
+    {
+      CallOutcome res;
+      res.success = false;
+      res.errorCode = -5;
+      res.errorMessage = "failed";
+      return res;
+    }, executed);
+  EXPECT_TRUE (executed);
+
+  const auto res = Execute (memo, "id", MakeCall (1), executed);
+  EXPECT_FALSE (executed);
+  EXPECT_FALSE (res.success);
+  EXPECT_EQ (res.errorCode, -5);
+  EXPECT_EQ (res.errorMessage, "failed");
+}
+
+TEST_F (IdempotencyMemoTests, TransientNotMemoised)
+{
+  IdempotencyMemo memo(1h, 10, 1 << 20);
+  bool executed;
+
+  auto res = Execute (memo, "id", [] ()
+    {
+      CallOutcome res;
+      res.success = false;
+      res.transient = true;
+      return res;
+    }, executed);
+  EXPECT_TRUE (executed);
+  EXPECT_FALSE (res.success);
+  EXPECT_EQ (memo.Size (), 0);
+
+  res = Execute (memo, "id", MakeCall (5), executed);
+  EXPECT_TRUE (executed);
+  EXPECT_EQ (res.result, 5);
+}
+
+TEST_F (IdempotencyMemoTests, StaleNotMemoised)
+{
+  IdempotencyMemo memo(1h, 10, 1 << 20);
+  bool executed;
+
+  auto res = Execute (memo, "id", [] ()
+    {
+      CallOutcome res;
+      res.success = true;
+      res.result = 1;
+      res.stale = true;
+      return res;
+    }, executed);
+  EXPECT_TRUE (res.stale);
+  EXPECT_EQ (memo.Size (), 0);
+
+  res = Execute (memo, "id", MakeCall (2), executed);
+  EXPECT_TRUE (executed);
+  EXPECT_FALSE (res.stale);
+  EXPECT_EQ (res.result, 2);
+}
+
+TEST_F (IdempotencyMemoTests, KeyedByClientAndId)
+{
+  IdempotencyMemo memo(1h, 10, 1 << 20);
+  bool executed;
+
+  const Json::Value params;
+  memo.Execute ("a@example.com", "id", "method", params, MakeCall (1),
+                executed);
+
+  EXPECT_EQ (memo.Execute ("a@example.com", "other", "method", params,
+                           MakeCall (2), executed).result, 2);
+  EXPECT_TRUE (executed);
+  EXPECT_EQ (memo.Execute ("b@example.com", "id", "method", params,
+                           MakeCall (3), executed).result, 3);
+  EXPECT_TRUE (executed);
+  EXPECT_EQ (memo.Execute ("a@example.com", "id", "method", params,
+                           MakeCall (4), executed).result, 1);
+  EXPECT_FALSE (executed);
+
+  EXPECT_EQ (calls, 3);
+  EXPECT_EQ (memo.Size (), 3);
+}
+
+TEST_F (IdempotencyMemoTests, MismatchedRequest)
+{
+  IdempotencyMemo memo(1h, 10, 1 << 20);
+  bool executed;
+
+  Json::Value params(Json::arrayValue);
+  params.append (1);
+  memo.Execute ("client", "id", "method", params, MakeCall (1), executed);
+
+  EXPECT_EQ (memo.Execute ("client", "id", "other", params,
+                           MakeCall (2), executed).result, 2);
+  EXPECT_TRUE (executed);
+
+  Json::Value otherParams(Json::arrayValue);
+  otherParams.append (2);
+  EXPECT_EQ (memo.Execute ("client", "id", "method", otherParams,
+                           MakeCall (3), executed).result, 3);
+  EXPECT_TRUE (executed);
+
+  /* The original call is still memoised.  */
+  EXPECT_EQ (memo.Execute ("client", "id", "method", params,
+                           MakeCall (4), executed).result, 1);
+  EXPECT_FALSE (executed);
+
+  EXPECT_EQ (calls, 3);
+  EXPECT_EQ (memo.Size (), 1);
+}
+
+TEST_F (IdempotencyMemoTests, Expiry)
+{
+  IdempotencyMemo memo(10ms, 10, 1 << 20);
+  bool executed;
+
+  Execute (memo, "id", MakeCall (1), executed);
+  std::this_thread::sleep_for (20ms);
+
+  const auto res = Execute (memo, "id", MakeCall (2), executed);
+  EXPECT_TRUE (executed);
+  EXPECT_EQ (res.result, 2);
+  EXPECT_EQ (memo.Size (), 1);
+}
+
+TEST_F (IdempotencyMemoTests, ExceptionNotMemoised)
+{
+  IdempotencyMemo memo(1h, 10, 1 << 20);
+  bool executed;
+
+  EXPECT_THROW (Execute (memo, "id", [] () -> CallOutcome
+    {
+      throw std::runtime_error ("failed");
+    }, executed), std::runtime_error);
+  EXPECT_EQ (memo.Size (), 0);
+
+  EXPECT_EQ (Execute (memo, "id", MakeCall (5), executed).result, 5);
+  EXPECT_TRUE (executed);
+}
+
+TEST_F (IdempotencyMemoTests, Full)
+{
+  IdempotencyMemo memo(1h, 1, 1 << 20);
+  bool executed;
+
+  Execute (memo, "a", MakeCall (1), executed);
+  Execute (memo, "b", MakeCall (2), executed);
+  EXPECT_TRUE (executed);
+  EXPECT_EQ (memo.Size (), 1);
+
+  Execute (memo, "b", MakeCall (2), executed);
+  EXPECT_TRUE (executed);
+  Execute (memo, "a", MakeCall (1), executed);
+  EXPECT_FALSE (executed);
+
+  EXPECT_EQ (calls, 3);
+}
+
+TEST_F (IdempotencyMemoTests, ByteBudget)
+{
+  IdempotencyMemo memo(1h, 10, 1'000);
+  bool executed;
+
+  const auto bigCall = [this] ()
+    {
+      ++calls;
+
+      CallOutcome res;
+      res.success = true;
+      res.result = std::string (2'000, 'x');
+      return res;
+    };
+
+  auto res = Execute (memo, "big", bigCall, executed);
+  EXPECT_TRUE (executed);
+  EXPECT_EQ (res.result.asString ().size (), 2'000);
+  EXPECT_EQ (memo.Size (), 0);
+  EXPECT_EQ (memo.Bytes (), 0);
+
+  Execute (memo, "big", bigCall, executed);
+  EXPECT_TRUE (executed);
+
+  Execute (memo, "small", MakeCall (1), executed);
+  EXPECT_EQ (memo.Size (), 1);
+  EXPECT_GT (memo.Bytes (), 0);
+  Execute (memo, "small", MakeCall (1), executed);
+  EXPECT_FALSE (executed);
+
+  EXPECT_EQ (calls, 3);
+}
+
+TEST_F (IdempotencyMemoTests, ExpiryReleasesBytes)
+{
+  IdempotencyMemo memo(10ms, 10, 1 << 20);
+  bool executed;
+
+  Execute (memo, "id", MakeCall (1), executed);
+  const auto bytes = memo.Bytes ();
+  EXPECT_GT (bytes, 0);
+  std::this_thread::sleep_for (20ms);
+
+  Execute (memo, "id", MakeCall (1), executed);
+  EXPECT_TRUE (executed);
+  EXPECT_EQ (memo.Bytes (), bytes);
+}
+
+} // anonymous namespace
+} // namespace charon
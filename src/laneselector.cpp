@@ -0,0 +1,171 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "laneselector.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace charon
+{
+
+namespace
+{
+
+/**
+ * Minimum RTT assumed for a lane.  Lanes without any sample yet use this
+ * as well, so that they are tried early on.
+ */
+constexpr auto MIN_RTT = std::chrono::milliseconds (1);
+
+/**
+ * Weight of a new sample in the moving average of the RTT, as the inverse
+ * (i.e. a new sample counts for 1/RTT_SMOOTHING).
+ */
+constexpr int RTT_SMOOTHING = 4;
+
+} // anonymous namespace
+
+double
+LaneSelector::GetScore (const unsigned lane) const
+{
+  const auto& l = lanes[lane];
+  const auto rtt = std::max<Clock::duration> (l.rtt, MIN_RTT);
+  return static_cast<double> (rtt.count ()) * (l.inFlight + 1);
+}
+
+unsigned
+LaneSelector::Pick (const UsablePredicate& usable)
+{
+  std::lock_guard<std::mutex> lock(mut);
+  CHECK (!lanes.empty ());
+
+  const auto now = Clock::now ();
+  const unsigned n = lanes.size ();
+
+  /* We look for the best lane in two tiers:  Healthy lanes first, and if
+     there is none, any usable one.  */
+  int best = -1;
+  bool bestHealthy = false;
+  for (unsigned i = 0; i < n; ++i)
+    {
+      const unsigned cur = (nextStart + i) % n;
+      if (!usable (cur))
+        continue;
+
+      const bool healthy = lanes[cur].downUntil <= now;
+      if (best == -1 || (healthy && !bestHealthy)
+            || (healthy == bestHealthy && GetScore (cur) < GetScore (best)))
+        {
+          best = cur;
+          bestHealthy = healthy;
+        }
+    }
+
+  nextStart = (nextStart + 1) % n;
+
+  if (best == -1)
+    {
+      VLOG (1) << "No usable lane, falling back to the first";
+      return 0;
+    }
+
+  if (!bestHealthy)
+    VLOG (1) << "All usable lanes are cooling down, using " << best;
+
+  return best;
+}
+
+void
+LaneSelector::RecordFailure (const unsigned lane)
+{
+  std::lock_guard<std::mutex> lock(mut);
+  CHECK_LT (lane, lanes.size ());
+
+  LOG (WARNING) << "Call on lane " << lane << " failed, avoiding it";
+  lanes[lane].downUntil = Clock::now () + cooldown;
+}
+
+LaneSelector::Clock::duration
+LaneSelector::GetRtt (const unsigned lane) const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  CHECK_LT (lane, lanes.size ());
+  return lanes[lane].rtt;
+}
+
+unsigned
+LaneSelector::GetInFlight (const unsigned lane) const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  CHECK_LT (lane, lanes.size ());
+  return lanes[lane].inFlight;
+}
+
+bool
+LaneSelector::IsDown (const unsigned lane) const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  CHECK_LT (lane, lanes.size ());
+  return lanes[lane].downUntil > Clock::now ();
+}
+
+LaneSelector::Use::Use (LaneSelector& s, const unsigned l)
+  : selector(s), lane(l), start(Clock::now ())
+{
+  std::lock_guard<std::mutex> lock(selector.mut);
+  CHECK_LT (lane, selector.lanes.size ());
+  ++selector.lanes[lane].inFlight;
+}
+
+LaneSelector::Use::~Use ()
+{
+  std::lock_guard<std::mutex> lock(selector.mut);
+  auto& l = selector.lanes[lane];
+  CHECK_GT (l.inFlight, 0);
+  --l.inFlight;
+}
+
+void
+LaneSelector::Use::Success ()
+{
+  CHECK (!done);
+  done = true;
+
+  const auto rtt = Clock::now () - start;
+
+  std::lock_guard<std::mutex> lock(selector.mut);
+  auto& l = selector.lanes[lane];
+  if (l.rtt == Clock::duration::zero ())
+    l.rtt = rtt;
+  else
+    l.rtt += (rtt - l.rtt) / RTT_SMOOTHING;
+  l.downUntil = Clock::time_point ();
+}
+
+void
+LaneSelector::Use::Failure ()
+{
+  CHECK (!done);
+  done = true;
+
+  selector.RecordFailure (lane);
+}
+
+} // namespace charon
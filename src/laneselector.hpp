@@ -0,0 +1,198 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_LANESELECTOR_HPP
+#define CHARON_LANESELECTOR_HPP
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace charon
+{
+
+/**
+ * Chooses over which of several connections ("lanes") a call is sent,
+ * based on their observed health and round-trip times.  Each lane keeps
+ * a moving average of its RTT and the number of calls currently in flight
+ * on it; the lane with the lowest product of the two is picked, so that
+ * load is spread over lanes of similar speed while slow ones get less.
+ * A lane on which a call failed is avoided for a cooldown period, as long
+ * as other lanes are available.
+ *
+ * This class is thread-safe.
+ */
+class LaneSelector
+{
+
+public:
+
+  /** Clock used for RTTs and the cooldown.  */
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Predicate telling whether a lane can be used at all right now
+   * (e.g. whether it is connected).
+   */
+  using UsablePredicate = std::function<bool (unsigned lane)>;
+
+  class Use;
+
+private:
+
+  /**
+   * Data kept about each lane.
+   */
+  struct Lane
+  {
+
+    /** Moving average of the RTT (zero if there is no sample yet).  */
+    Clock::duration rtt = Clock::duration::zero ();
+
+    /** Number of calls currently in flight on the lane.  */
+    unsigned inFlight = 0;
+
+    /** Time until which the lane is avoided after a failure.  */
+    Clock::time_point downUntil;
+
+  };
+
+  /** Time for which a lane is avoided after a failure.  */
+  const Clock::duration cooldown;
+
+  /** Mutex for the internal state.  */
+  mutable std::mutex mut;
+
+  /** The data for all lanes.  */
+  std::vector<Lane> lanes;
+
+  /**
+   * Lane at which the next search starts.  This rotates, so that ties
+   * are broken round-robin.
+   */
+  unsigned nextStart = 0;
+
+  /**
+   * Returns the score of the given lane (lower is better).  Must be called
+   * with mut held.
+   */
+  double GetScore (unsigned lane) const;
+
+public:
+
+  /**
+   * Constructs a selector for the given number of lanes (which must be
+   * at least one when picking) and with the given failure cooldown.
+   */
+  template <typename Rep, typename Period>
+    explicit LaneSelector (const unsigned n,
+                           const std::chrono::duration<Rep, Period>& c)
+    : cooldown(std::chrono::duration_cast<Clock::duration> (c)), lanes(n)
+  {}
+
+  LaneSelector () = delete;
+  LaneSelector (const LaneSelector&) = delete;
+  void operator= (const LaneSelector&) = delete;
+
+  /**
+   * Returns the number of lanes.
+   */
+  unsigned
+  GetNumLanes () const
+  {
+    return lanes.size ();
+  }
+
+  /**
+   * Picks the lane to use for a new call.  Usable lanes that are not
+   * cooling down after a failure are preferred, then usable lanes in general.
+   * If no lane is usable, lane zero is returned.
+   */
+  unsigned Pick (const UsablePredicate& usable);
+
+  /**
+   * Records that a lane failed, so that it is avoided for the cooldown.
+   */
+  void RecordFailure (unsigned lane);
+
+  /**
+   * Returns the current RTT estimate of a lane (zero if unknown).
+   */
+  Clock::duration GetRtt (unsigned lane) const;
+
+  /**
+   * Returns the number of calls in flight on a lane.
+   */
+  unsigned GetInFlight (unsigned lane) const;
+
+  /**
+   * Returns true if the lane is currently cooling down after a failure.
+   */
+  bool IsDown (unsigned lane) const;
+
+};
+
+/**
+ * RAII helper for a call sent over a lane.  It counts the call as being in
+ * flight while the instance exists.  The outcome can be reported through
+ * Success (which also records the RTT since construction) or Failure; if
+ * neither is called, the call does not affect the lane's health.
+ */
+class LaneSelector::Use
+{
+
+private:
+
+  /** The selector this belongs to.  */
+  LaneSelector& selector;
+
+  /** The lane used.  */
+  const unsigned lane;
+
+  /** Time when the call was started.  */
+  const Clock::time_point start;
+
+  /** Set to true once the outcome has been reported.  */
+  bool done = false;
+
+public:
+
+  explicit Use (LaneSelector& s, unsigned l);
+  ~Use ();
+
+  Use () = delete;
+  Use (const Use&) = delete;
+  void operator= (const Use&) = delete;
+
+  /**
+   * Records that the call on the lane succeeded (i.e. a response came
+   * back over it), updating the lane's RTT.
+   */
+  void Success ();
+
+  /**
+   * Records that the call failed on the lane.
+   */
+  void Failure ();
+
+};
+
+} // namespace charon
+
+#endif // CHARON_LANESELECTOR_HPP
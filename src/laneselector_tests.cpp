@@ -0,0 +1,227 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "laneselector.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <thread>
+
+namespace charon
+{
+namespace
+{
+
+class LaneSelectorTests : public testing::Test
+{
+
+protected:
+
+  /** Cooldown period used for the tested selector.  */
+  static constexpr auto COOLDOWN = std::chrono::milliseconds (50);
+
+  /** Predicate that accepts all lanes.  */
+  static bool
+  AllUsable (const unsigned lane)
+  {
+    return true;
+  }
+
+  /**
+   * Runs a call that takes the given time on the lane picked by the
+   * selector, and returns the lane.
+   */
+  static unsigned
+  Call (LaneSelector& sel, const std::chrono::milliseconds duration)
+  {
+    const unsigned lane = sel.Pick (&AllUsable);
+    LaneSelector::Use use(sel, lane);
+    std::this_thread::sleep_for (duration);
+    use.Success ();
+    return lane;
+  }
+
+};
+
+constexpr std::chrono::milliseconds LaneSelectorTests::COOLDOWN;
+
+TEST_F (LaneSelectorTests, SingleLane)
+{
+  LaneSelector sel(1, COOLDOWN);
+  EXPECT_EQ (sel.Pick (&AllUsable), 0u);
+
+  sel.RecordFailure (0);
+  EXPECT_EQ (sel.Pick (&AllUsable), 0u);
+  EXPECT_EQ (sel.Pick ([] (unsigned) { return false; }), 0u);
+}
+
+TEST_F (LaneSelectorTests, RotatesBetweenEqualLanes)
+{
+  LaneSelector sel(3, COOLDOWN);
+
+  std::map<unsigned, unsigned> counts;
+  for (unsigned i = 0; i < 6; ++i)
+    ++counts[sel.Pick (&AllUsable)];
+
+  EXPECT_EQ (counts.size (), 3u);
+  for (const auto& entry : counts)
+    EXPECT_EQ (entry.second, 2u);
+}
+
+TEST_F (LaneSelectorTests, PrefersLowRtt)
+{
+  LaneSelector sel(2, COOLDOWN);
+
+  {
+    LaneSelector::Use use(sel, 0);
+    std::this_thread::sleep_for (std::chrono::milliseconds (20));
+    use.Success ();
+  }
+  {
+    LaneSelector::Use use(sel, 1);
+    use.Success ();
+  }
+
+  EXPECT_GT (sel.GetRtt (0), sel.GetRtt (1));
+  for (unsigned i = 0; i < 5; ++i)
+    EXPECT_EQ (Call (sel, std::chrono::milliseconds (0)), 1u);
+}
+
+TEST_F (LaneSelectorTests, InFlightSpreadsLoad)
+{
+  LaneSelector sel(2, COOLDOWN);
+
+  const unsigned first = sel.Pick (&AllUsable);
+  LaneSelector::Use use(sel, first);
+  EXPECT_EQ (sel.GetInFlight (first), 1u);
+
+  /* Even if the search would start at the busy lane, the other one
+     is chosen.  */
+  for (unsigned i = 0; i < 4; ++i)
+    EXPECT_NE (sel.Pick (&AllUsable), first);
+}
+
+TEST_F (LaneSelectorTests, UseTracksInFlight)
+{
+  LaneSelector sel(1, COOLDOWN);
+
+  {
+    LaneSelector::Use a(sel, 0);
+    LaneSelector::Use b(sel, 0);
+    EXPECT_EQ (sel.GetInFlight (0), 2u);
+  }
+
+  EXPECT_EQ (sel.GetInFlight (0), 0u);
+  EXPECT_EQ (sel.GetRtt (0), LaneSelector::Clock::duration::zero ());
+}
+
+TEST_F (LaneSelectorTests, FailureAvoidsLane)
+{
+  LaneSelector sel(2, COOLDOWN);
+
+  {
+    LaneSelector::Use use(sel, 0);
+    use.Failure ();
+  }
+  EXPECT_TRUE (sel.IsDown (0));
+  EXPECT_FALSE (sel.IsDown (1));
+
+  for (unsigned i = 0; i < 4; ++i)
+    EXPECT_EQ (sel.Pick (&AllUsable), 1u);
+
+  /* After the cooldown, the lane is used again.  */
+  std::this_thread::sleep_for (COOLDOWN);
+  EXPECT_FALSE (sel.IsDown (0));
+
+  std::map<unsigned, unsigned> counts;
+  for (unsigned i = 0; i < 4; ++i)
+    ++counts[sel.Pick (&AllUsable)];
+  EXPECT_EQ (counts[0], 2u);
+}
+
+TEST_F (LaneSelectorTests, SuccessClearsFailure)
+{
+  LaneSelector sel(2, COOLDOWN);
+
+  sel.RecordFailure (0);
+  EXPECT_TRUE (sel.IsDown (0));
+
+  {
+    LaneSelector::Use use(sel, 0);
+    use.Success ();
+  }
+  EXPECT_FALSE (sel.IsDown (0));
+}
+
+TEST_F (LaneSelectorTests, AllDown)
+{
+  LaneSelector sel(2, COOLDOWN);
+
+  sel.RecordFailure (0);
+  sel.RecordFailure (1);
+
+  /* If all lanes are cooling down, they are still used.  */
+  std::map<unsigned, unsigned> counts;
+  for (unsigned i = 0; i < 4; ++i)
+    ++counts[sel.Pick (&AllUsable)];
+  EXPECT_EQ (counts[0], 2u);
+  EXPECT_EQ (counts[1], 2u);
+}
+
+TEST_F (LaneSelectorTests, UsablePredicate)
+{
+  LaneSelector sel(3, COOLDOWN);
+
+  const auto onlyTwo = [] (const unsigned lane)
+    {
+      return lane == 2;
+    };
+  for (unsigned i = 0; i < 4; ++i)
+    EXPECT_EQ (sel.Pick (onlyTwo), 2u);
+
+  /* A usable lane that is cooling down is preferred over unusable ones.  */
+  sel.RecordFailure (2);
+  EXPECT_EQ (sel.Pick (onlyTwo), 2u);
+
+  /* Without any usable lane, the first is returned.  */
+  EXPECT_EQ (sel.Pick ([] (unsigned) { return false; }), 0u);
+}
+
+TEST_F (LaneSelectorTests, MultipleThreads)
+{
+  LaneSelector sel(4, COOLDOWN);
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < 8; ++i)
+    threads.emplace_back ([&sel] ()
+      {
+        for (unsigned j = 0; j < 20; ++j)
+          Call (sel, std::chrono::milliseconds (1));
+      });
+  for (auto& t : threads)
+    t.join ();
+
+  for (unsigned i = 0; i < sel.GetNumLanes (); ++i)
+    EXPECT_EQ (sel.GetInFlight (i), 0u);
+}
+
+} // anonymous namespace
+} // namespace charon
@@ -0,0 +1,161 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "memorytags.hpp"
+
+#include <glog/logging.h>
+
+#include <map>
+#include <mutex>
+
+namespace charon
+{
+
+namespace
+{
+
+/**
+ * The global list of all memory tags.
+ */
+struct TagRegistry
+{
+
+  /** The registered tags by name.  */
+  std::map<std::string, const MemoryTag*> tags;
+
+  /** Mutex for the list.  */
+  std::mutex mut;
+
+};
+
+/**
+ * Returns the global tag registry.  It is constructed on first use, so that
+ * it is available for static MemoryTag instances in any translation unit
+ * and outlives them.
+ */
+TagRegistry&
+GetRegistry ()
+{
+  static TagRegistry registry;
+  return registry;
+}
+
+} // anonymous namespace
+
+MemoryTag::MemoryTag (const std::string& n)
+  : name(n), bytes(0), objects(0)
+{
+  auto& reg = GetRegistry ();
+  std::lock_guard<std::mutex> lock(reg.mut);
+  const auto res = reg.tags.emplace (name, this);
+  CHECK (res.second) << "Duplicate memory tag: " << name;
+}
+
+MemoryTag::~MemoryTag ()
+{
+  auto& reg = GetRegistry ();
+  std::lock_guard<std::mutex> lock(reg.mut);
+  reg.tags.erase (name);
+}
+
+Json::Value
+MemoryTag::GetSnapshot ()
+{
+  auto& reg = GetRegistry ();
+  std::lock_guard<std::mutex> lock(reg.mut);
+
+  Json::Value res(Json::objectValue);
+  for (const auto& entry : reg.tags)
+    {
+      Json::Value cur(Json::objectValue);
+      cur["bytes"] = static_cast<Json::Int64> (entry.second->GetBytes ());
+      cur["objects"] = static_cast<Json::Int64> (entry.second->GetObjects ());
+      res[entry.first] = cur;
+    }
+
+  return res;
+}
+
+TrackedMemory::TrackedMemory (TrackedMemory&& o)
+  : tag(o.tag), size(o.size)
+{
+  o.size = 0;
+}
+
+TrackedMemory&
+TrackedMemory::operator= (TrackedMemory&& o)
+{
+  if (this != &o)
+    {
+      Set (0);
+      tag = o.tag;
+      size = o.size;
+      o.size = 0;
+    }
+
+  return *this;
+}
+
+TrackedMemory::~TrackedMemory ()
+{
+  Set (0);
+}
+
+void
+TrackedMemory::Set (const std::size_t s)
+{
+  std::int64_t deltaObjects = 0;
+  if (size == 0 && s > 0)
+    deltaObjects = 1;
+  else if (size > 0 && s == 0)
+    deltaObjects = -1;
+
+  tag->Add (static_cast<std::int64_t> (s) - static_cast<std::int64_t> (size),
+            deltaObjects);
+  size = s;
+}
+
+std::size_t
+EstimateJsonSize (const Json::Value& val)
+{
+  std::size_t res = sizeof (Json::Value);
+
+  switch (val.type ())
+    {
+    case Json::stringValue:
+      res += val.asString ().size ();
+      break;
+
+    case Json::arrayValue:
+      for (const auto& entry : val)
+        res += EstimateJsonSize (entry);
+      break;
+
+    case Json::objectValue:
+      for (auto it = val.begin (); it != val.end (); ++it)
+        res += it.name ().size () + EstimateJsonSize (*it);
+      break;
+
+    default:
+      break;
+    }
+
+  return res;
+}
+
+} // namespace charon
@@ -0,0 +1,140 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_MEMORYTAGS_HPP
+#define CHARON_MEMORYTAGS_HPP
+
+#include <json/json.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace charon
+{
+
+/**
+ * Accounting of the live memory held by some subsystem (e.g. the result
+ * cache), identified by a tag name.  The numbers are estimates reported by
+ * the subsystem itself through TrackedMemory instances, not measured from
+ * the allocator.
+ *
+ * Tags are typically static objects in the source file of the subsystem.
+ * All existing tags register themselves in a global list, so that they can
+ * be dumped with GetSnapshot.
+ */
+class MemoryTag
+{
+
+private:
+
+  /** The tag's name.  */
+  const std::string name;
+
+  /** Number of bytes currently held.  */
+  std::atomic<std::int64_t> bytes;
+
+  /** Number of tracked objects currently holding memory.  */
+  std::atomic<std::int64_t> objects;
+
+public:
+
+  explicit MemoryTag (const std::string& n);
+  ~MemoryTag ();
+
+  MemoryTag () = delete;
+  MemoryTag (const MemoryTag&) = delete;
+  void operator= (const MemoryTag&) = delete;
+
+  /**
+   * Adjusts the counters by the given (possibly negative) amounts.
+   */
+  void
+  Add (const std::int64_t deltaBytes, const std::int64_t deltaObjects)
+  {
+    bytes += deltaBytes;
+    objects += deltaObjects;
+  }
+
+  std::int64_t
+  GetBytes () const
+  {
+    return bytes;
+  }
+
+  std::int64_t
+  GetObjects () const
+  {
+    return objects;
+  }
+
+  /**
+   * Returns the current counters of all tags as JSON object, mapping
+   * each tag name to an object with "bytes" and "objects".
+   */
+  static Json::Value GetSnapshot ();
+
+};
+
+/**
+ * An object (e.g. a cache entry) holding some amount of memory that is
+ * accounted for in a MemoryTag.  The amount is released from the tag when
+ * the instance is destructed.
+ */
+class TrackedMemory
+{
+
+private:
+
+  /** The tag this is accounted in.  */
+  MemoryTag* tag;
+
+  /** The current size in bytes.  */
+  std::size_t size = 0;
+
+public:
+
+  explicit TrackedMemory (MemoryTag& t)
+    : tag(&t)
+  {}
+
+  TrackedMemory (TrackedMemory&& o);
+  TrackedMemory& operator= (TrackedMemory&& o);
+
+  ~TrackedMemory ();
+
+  TrackedMemory () = delete;
+  TrackedMemory (const TrackedMemory&) = delete;
+  void operator= (const TrackedMemory&) = delete;
+
+  /**
+   * Updates the size of memory held by the object.
+   */
+  void Set (std::size_t s);
+
+};
+
+/**
+ * Returns a rough estimate of the memory used by a JSON value.
+ */
+std::size_t EstimateJsonSize (const Json::Value& val);
+
+} // namespace charon
+
+#endif // CHARON_MEMORYTAGS_HPP
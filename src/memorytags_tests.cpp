@@ -0,0 +1,113 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "memorytags.hpp"
+
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <utility>
+#include <vector>
+
+namespace charon
+{
+namespace
+{
+
+using MemoryTagTests = testing::Test;
+
+TEST_F (MemoryTagTests, TrackedMemory)
+{
+  MemoryTag tag("test");
+
+  {
+    TrackedMemory a(tag);
+    EXPECT_EQ (tag.GetObjects (), 0);
+
+    a.Set (100);
+    TrackedMemory b(tag);
+    b.Set (20);
+    EXPECT_EQ (tag.GetBytes (), 120);
+    EXPECT_EQ (tag.GetObjects (), 2);
+
+    a.Set (50);
+    EXPECT_EQ (tag.GetBytes (), 70);
+    EXPECT_EQ (tag.GetObjects (), 2);
+
+    b.Set (0);
+    EXPECT_EQ (tag.GetBytes (), 50);
+    EXPECT_EQ (tag.GetObjects (), 1);
+  }
+
+  EXPECT_EQ (tag.GetBytes (), 0);
+  EXPECT_EQ (tag.GetObjects (), 0);
+}
+
+TEST_F (MemoryTagTests, Moving)
+{
+  MemoryTag tag("test");
+
+  std::vector<TrackedMemory> objs;
+  for (unsigned i = 1; i <= 10; ++i)
+    {
+      TrackedMemory m(tag);
+      m.Set (i);
+      objs.push_back (std::move (m));
+    }
+  EXPECT_EQ (tag.GetBytes (), 55);
+  EXPECT_EQ (tag.GetObjects (), 10);
+
+  objs[0] = std::move (objs[9]);
+  objs.pop_back ();
+  EXPECT_EQ (tag.GetBytes (), 54);
+  EXPECT_EQ (tag.GetObjects (), 9);
+
+  objs.clear ();
+  EXPECT_EQ (tag.GetBytes (), 0);
+  EXPECT_EQ (tag.GetObjects (), 0);
+}
+
+TEST_F (MemoryTagTests, Snapshot)
+{
+  MemoryTag foo("foo");
+  MemoryTag bar("bar");
+
+  TrackedMemory m(foo);
+  m.Set (42);
+
+  const auto snapshot = MemoryTag::GetSnapshot ();
+  ASSERT_TRUE (snapshot.isMember ("foo"));
+  EXPECT_EQ (snapshot["foo"]["bytes"].asInt64 (), 42);
+  EXPECT_EQ (snapshot["foo"]["objects"].asInt64 (), 1);
+  ASSERT_TRUE (snapshot.isMember ("bar"));
+  EXPECT_EQ (snapshot["bar"]["bytes"].asInt64 (), 0);
+}
+
+TEST_F (MemoryTagTests, EstimateJsonSize)
+{
+  const size_t base = sizeof (Json::Value);
+  EXPECT_EQ (EstimateJsonSize (ParseJson ("42")), base);
+  EXPECT_EQ (EstimateJsonSize (ParseJson (R"("abc")")), base + 3);
+  EXPECT_EQ (EstimateJsonSize (ParseJson (R"([1, "ab"])")), 3 * base + 2);
+  EXPECT_EQ (EstimateJsonSize (ParseJson (R"({"foo": {"x": null}})")),
+             3 * base + 4);
+}
+
+} // anonymous namespace
+} // namespace charon
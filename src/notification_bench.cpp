@@ -0,0 +1,224 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Benchmark for the delivery of notifications:  Publishes a series of state
+   updates from a Server to several Clients connected to the test XMPP
+   server, once through the pubsub service and once with direct push, and
+   reports the notification lag seen by the clients as well as the traffic
+   of all streams (as proxy for the load on the XMPP server).
+
+   Usage:  notification-bench [UPDATES [CLIENTS]]  */
+
+#include "client.hpp"
+#include "server.hpp"
+#include "testutils.hpp"
+#include "xmppclient.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace charon
+{
+namespace
+{
+
+/** Default number of updates per run.  */
+constexpr unsigned DEFAULT_UPDATES = 100;
+
+/** Default number of clients.  */
+constexpr unsigned DEFAULT_CLIENTS = 5;
+
+/** Backend version used.  */
+const std::string VERSION = "bench";
+
+/** Notification type used.  */
+const std::string TYPE = "bench";
+
+/**
+ * Results of one benchmark run.
+ */
+struct RunResult
+{
+  StreamStatistics clients;
+  StreamStatistics server;
+  double lagTotalMs;
+  double lagMaxMs;
+  std::uint64_t lagCount;
+  double wallMs;
+};
+
+/**
+ * Adds the traffic counters of b to a.
+ */
+void
+AddStatistics (StreamStatistics& a, const StreamStatistics& b)
+{
+  a.xmlBytesSent += b.xmlBytesSent;
+  a.xmlBytesReceived += b.xmlBytesReceived;
+  a.wireBytesSent += b.wireBytesSent;
+  a.wireBytesReceived += b.wireBytesReceived;
+  a.stanzasSent += b.stanzasSent;
+  a.stanzasReceived += b.stanzasReceived;
+}
+
+RunResult
+RunUpdates (const bool direct, const unsigned updates, const unsigned clients)
+{
+  TestBackend backend;
+  Server srv(VERSION, backend,
+             JIDWithResource (GetTestAccount (0), "bench").full (),
+             GetTestAccount (0).password);
+  srv.SetRootCA (GetTestCA ());
+  CHECK (srv.Connect (0));
+
+  auto upd = UpdatableState::Create ();
+  srv.AddPubSub (GetServerConfig ().pubsub);
+  srv.AddNotification (upd->NewWaiter (TYPE));
+  srv.EnableDirectPush (clients);
+
+  std::vector<std::unique_ptr<Client>> cl;
+  for (unsigned i = 0; i < clients; ++i)
+    {
+      auto c = std::make_unique<Client> (
+          JIDWithoutResource (GetTestAccount (0)).bare (), VERSION,
+          JIDWithResource (GetTestAccount (1),
+                           "bench " + std::to_string (i)).full (),
+          GetTestAccount (1).password);
+      c->SetRootCA (GetTestCA ());
+      c->SetDirectPush (direct);
+      c->AddNotification (
+          std::make_unique<UpdatableState::Notification> (TYPE));
+      c->Connect ();
+      CHECK_EQ (c->GetServerResource (), "bench");
+      cl.push_back (std::move (c));
+    }
+
+  /* Only count the traffic of the updates themselves.  */
+  StreamStatistics clientsBefore;
+  for (auto& c : cl)
+    AddStatistics (clientsBefore, c->GetStreamStatistics ());
+  const auto serverBefore = srv.GetStreamStatistics ();
+
+  const auto startWall = std::chrono::steady_clock::now ();
+
+  Json::Value known = "";
+  for (unsigned i = 0; i < updates; ++i)
+    {
+      const std::string id = "update " + std::to_string (i);
+      upd->SetState (id, std::string (100, 'x'));
+
+      for (auto& c : cl)
+        while (c->WaitForChange (TYPE, known)["id"] != id)
+          continue;
+      known = id;
+    }
+
+  RunResult res;
+  res.wallMs = std::chrono::duration<double, std::milli> (
+      std::chrono::steady_clock::now () - startWall).count ();
+
+  res.lagTotalMs = 0.0;
+  res.lagMaxMs = 0.0;
+  res.lagCount = 0;
+  for (auto& c : cl)
+    {
+      AddStatistics (res.clients, c->GetStreamStatistics ());
+
+      const auto lag = c->GetNotificationLag ()[TYPE]["total"];
+      res.lagTotalMs += lag["sum"].asDouble ();
+      res.lagMaxMs = std::max (res.lagMaxMs, lag["max"].asDouble ());
+      res.lagCount += lag["count"].asUInt64 ();
+    }
+  res.server = srv.GetStreamStatistics ();
+
+  res.clients.stanzasSent -= clientsBefore.stanzasSent;
+  res.clients.stanzasReceived -= clientsBefore.stanzasReceived;
+  res.clients.wireBytesSent -= clientsBefore.wireBytesSent;
+  res.clients.wireBytesReceived -= clientsBefore.wireBytesReceived;
+  res.server.stanzasSent -= serverBefore.stanzasSent;
+  res.server.stanzasReceived -= serverBefore.stanzasReceived;
+  res.server.wireBytesSent -= serverBefore.wireBytesSent;
+  res.server.wireBytesReceived -= serverBefore.wireBytesReceived;
+
+  for (auto& c : cl)
+    c->Disconnect ();
+  srv.Disconnect ();
+
+  return res;
+}
+
+void
+PrintResult (const std::string& name, const RunResult& res,
+             const unsigned updates)
+{
+  /* Every stanza sent by one of our streams is processed by the XMPP
+     server (and for pubsub, fanned out to the subscribers).  */
+  const auto stanzas = res.server.stanzasSent + res.clients.stanzasSent
+                          + res.clients.stanzasReceived;
+  const auto wire = res.server.wireBytesSent + res.server.wireBytesReceived
+                      + res.clients.wireBytesSent
+                      + res.clients.wireBytesReceived;
+
+  std::cout
+      << name << "\n"
+      << "  lag (mean):     "
+      << (res.lagCount > 0 ? res.lagTotalMs / res.lagCount : 0.0) << " ms\n"
+      << "  lag (max):      " << res.lagMaxMs << " ms\n"
+      << "  server stanzas: " << res.server.stanzasSent << " sent, "
+      << res.server.stanzasReceived << " received\n"
+      << "  XMPP stanzas:   " << stanzas
+      << " (" << stanzas / updates << " per update)\n"
+      << "  wire bytes:     " << wire
+      << " (" << wire / updates << " per update)\n"
+      << "  wall time:      " << res.wallMs << " ms" << std::endl;
+}
+
+} // anonymous namespace
+} // namespace charon
+
+int
+main (int argc, char** argv)
+{
+  google::InitGoogleLogging (argv[0]);
+
+  unsigned updates = charon::DEFAULT_UPDATES;
+  if (argc > 1)
+    updates = std::atoi (argv[1]);
+  CHECK_GT (updates, 0);
+
+  unsigned clients = charon::DEFAULT_CLIENTS;
+  if (argc > 2)
+    clients = std::atoi (argv[2]);
+  CHECK_GT (clients, 0);
+
+  const auto pubsub = charon::RunUpdates (false, updates, clients);
+  charon::PrintResult ("pubsub", pubsub, updates);
+
+  const auto direct = charon::RunUpdates (true, updates, clients);
+  charon::PrintResult ("direct", direct, updates);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "notificationfilter.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace charon
+{
+
+namespace
+{
+
+/** Default member of array elements that is compared to the keys.  */
+const std::string DEFAULT_FIELD = "name";
+
+/**
+ * Looks up a reference token in the given JSON value.  Returns null if
+ * the target does not exist.
+ */
+const Json::Value*
+Resolve (const Json::Value& val, const std::string& token)
+{
+  if (val.isObject ())
+    {
+      if (!val.isMember (token))
+        return nullptr;
+      return &val[token];
+    }
+
+  if (val.isArray ())
+    {
+      if (token.empty ()
+            || token.find_first_not_of ("0123456789") != std::string::npos
+            || (token.size () > 1 && token[0] == '0'))
+        return nullptr;
+
+      /* The token comes from the client, so we parse it by hand and stop
+         as soon as it is out of range.  This way, long tokens can neither
+         throw nor overflow.  */
+      std::uint64_t ind = 0;
+      for (const char c : token)
+        {
+          ind = 10 * ind + (c - '0');
+          if (ind >= val.size ())
+            return nullptr;
+        }
+
+      return &val[static_cast<Json::ArrayIndex> (ind)];
+    }
+
+  return nullptr;
+}
+
+} // anonymous namespace
+
+bool
+NotificationFilter::ParsePointer (const std::string& str,
+                                  std::vector<std::string>& tokens)
+{
+  tokens.clear ();
+  if (str.empty ())
+    return true;
+  if (str[0] != '/')
+    return false;
+
+  std::string cur;
+  for (size_t i = 1; i <= str.size (); ++i)
+    {
+      if (i == str.size () || str[i] == '/')
+        {
+          tokens.push_back (cur);
+          cur.clear ();
+          continue;
+        }
+
+      if (str[i] != '~')
+        {
+          cur.push_back (str[i]);
+          continue;
+        }
+
+      ++i;
+      if (i == str.size ())
+        return false;
+      switch (str[i])
+        {
+        case '0':
+          cur.push_back ('~');
+          break;
+        case '1':
+          cur.push_back ('/');
+          break;
+        default:
+          return false;
+        }
+    }
+
+  return true;
+}
+
+bool
+NotificationFilter::Parse (const Json::Value& s)
+{
+  if (!s.isObject ())
+    return false;
+
+  const auto& pathVal = s["path"];
+  if (!pathVal.isString () || !ParsePointer (pathVal.asString (), path))
+    return false;
+
+  const auto& keysVal = s["keys"];
+  if (!keysVal.isArray ())
+    return false;
+  keys.clear ();
+  for (const auto& k : keysVal)
+    {
+      if (!k.isString ())
+        return false;
+      keys.insert (k.asString ());
+    }
+
+  field = DEFAULT_FIELD;
+  if (s.isMember ("field"))
+    {
+      if (!s["field"].isString ())
+        return false;
+      field = s["field"].asString ();
+    }
+
+  for (const auto& m : s.getMemberNames ())
+    if (m != "path" && m != "keys" && m != "field")
+      return false;
+
+  spec = Json::Value (Json::objectValue);
+  spec["path"] = pathVal.asString ();
+  spec["field"] = field;
+  spec["keys"] = Json::Value (Json::arrayValue);
+  for (const auto& k : keys)
+    spec["keys"].append (k);
+
+  return true;
+}
+
+std::string
+NotificationFilter::GetKey () const
+{
+  Json::StreamWriterBuilder wbuilder;
+  wbuilder["commentStyle"] = "None";
+  wbuilder["indentation"] = "";
+
+  return Json::writeString (wbuilder, spec);
+}
+
+Json::Value
+NotificationFilter::Apply (const Json::Value& state) const
+{
+  Json::Value res = state;
+
+  Json::Value* target = ResolvePointer (res, path);
+  if (target == nullptr)
+    return res;
+
+  if (target->isObject ())
+    {
+      for (const auto& m : target->getMemberNames ())
+        if (keys.count (m) == 0)
+          target->removeMember (m);
+    }
+  else if (target->isArray ())
+    {
+      Json::Value filtered(Json::arrayValue);
+      for (const auto& entry : *target)
+        {
+          if (!entry.isObject ())
+            continue;
+          const auto& val = entry[field];
+          if (val.isString () && keys.count (val.asString ()) > 0)
+            filtered.append (entry);
+        }
+      *target = std::move (filtered);
+    }
+
+  return res;
+}
+
+const Json::Value*
+NotificationFilter::ResolvePointer (const Json::Value& val,
+                                    const std::vector<std::string>& tokens)
+{
+  const Json::Value* cur = &val;
+  for (const auto& token : tokens)
+    {
+      cur = Resolve (*cur, token);
+      if (cur == nullptr)
+        return nullptr;
+    }
+
+  return cur;
+}
+
+Json::Value*
+NotificationFilter::ResolvePointer (Json::Value& val,
+                                    const std::vector<std::string>& tokens)
+{
+  const Json::Value& constVal = val;
+  return const_cast<Json::Value*> (ResolvePointer (constVal, tokens));
+}
+
+} // namespace charon
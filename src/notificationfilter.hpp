@@ -0,0 +1,118 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_NOTIFICATIONFILTER_HPP
+#define CHARON_NOTIFICATIONFILTER_HPP
+
+#include <json/json.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace charon
+{
+
+/**
+ * A filter that derives a reduced view from a notification state, so that
+ * clients only receive the parts relevant to them (e.g. the pending moves
+ * of particular players).  A filter is specified by JSON of the form:
+ *
+ *  {
+ *    "path": "/pending/players",
+ *    "keys": ["domob", "andy"],
+ *    "field": "name"
+ *  }
+ *
+ * "path" is a JSON pointer (RFC 6901) to the part of the state that is
+ * filtered; everything outside of it is kept as is.  If the value there is
+ * an object, only members whose name is in "keys" are kept.  If it is an
+ * array, only elements that are objects with a string member "field"
+ * (defaulting to "name") whose value is in "keys" are kept.
+ */
+class NotificationFilter
+{
+
+private:
+
+  /** The reference tokens of the JSON pointer.  */
+  std::vector<std::string> path;
+
+  /** The keys to keep.  */
+  std::set<std::string> keys;
+
+  /** The member of array elements compared to keys.  */
+  std::string field;
+
+  /** The normalised specification of this filter.  */
+  Json::Value spec;
+
+public:
+
+  NotificationFilter () = default;
+  NotificationFilter (const NotificationFilter&) = default;
+  NotificationFilter& operator= (const NotificationFilter&) = default;
+
+  /**
+   * Parses a filter from its JSON specification.  Returns false if the
+   * specification is invalid.
+   */
+  bool Parse (const Json::Value& s);
+
+  /**
+   * Returns the normalised JSON specification of this filter.
+   */
+  const Json::Value&
+  GetSpec () const
+  {
+    return spec;
+  }
+
+  /**
+   * Returns a string that uniquely identifies this filter, i.e. that is the
+   * same for two specifications if and only if they filter the same way.
+   */
+  std::string GetKey () const;
+
+  /**
+   * Applies the filter to a given state and returns the filtered view.
+   */
+  Json::Value Apply (const Json::Value& state) const;
+
+  /**
+   * Splits a JSON pointer into its (unescaped) reference tokens.  Returns
+   * false if the string is not a valid JSON pointer.
+   */
+  static bool ParsePointer (const std::string& str,
+                            std::vector<std::string>& tokens);
+
+  /**
+   * Resolves the reference tokens of a JSON pointer (as returned by
+   * ParsePointer) in the given value.  Returns null if the target
+   * does not exist.
+   */
+  static const Json::Value* ResolvePointer (
+      const Json::Value& val, const std::vector<std::string>& tokens);
+  static Json::Value* ResolvePointer (
+      Json::Value& val, const std::vector<std::string>& tokens);
+
+};
+
+} // namespace charon
+
+#endif // CHARON_NOTIFICATIONFILTER_HPP
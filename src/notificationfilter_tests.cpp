@@ -0,0 +1,196 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "notificationfilter.hpp"
+
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace charon
+{
+namespace
+{
+
+class NotificationFilterTests : public testing::Test
+{
+
+protected:
+
+  /**
+   * Parses a filter from the given JSON string and expects it to be valid.
+   */
+  static NotificationFilter
+  ParseFilter (const std::string& str)
+  {
+    NotificationFilter res;
+    EXPECT_TRUE (res.Parse (ParseJson (str))) << "Invalid filter: " << str;
+    return res;
+  }
+
+};
+
+TEST_F (NotificationFilterTests, ParsePointer)
+{
+  std::vector<std::string> tokens;
+
+  ASSERT_TRUE (NotificationFilter::ParsePointer ("", tokens));
+  EXPECT_TRUE (tokens.empty ());
+
+  ASSERT_TRUE (NotificationFilter::ParsePointer ("/", tokens));
+  EXPECT_EQ (tokens, std::vector<std::string> ({""}));
+
+  ASSERT_TRUE (NotificationFilter::ParsePointer ("/foo/0/a~1b/m~0n", tokens));
+  EXPECT_EQ (tokens, std::vector<std::string> ({"foo", "0", "a/b", "m~n"}));
+
+  EXPECT_FALSE (NotificationFilter::ParsePointer ("foo", tokens));
+  EXPECT_FALSE (NotificationFilter::ParsePointer ("/foo~", tokens));
+  EXPECT_FALSE (NotificationFilter::ParsePointer ("/foo~2", tokens));
+}
+
+TEST_F (NotificationFilterTests, ResolvePointer)
+{
+  const auto val = ParseJson (R"({
+    "foo": [{"a/b": 42}, "x"],
+    "": {"0": true}
+  })");
+
+  std::vector<std::string> tokens;
+  const auto resolve = [&] (const std::string& ptr)
+    {
+      EXPECT_TRUE (NotificationFilter::ParsePointer (ptr, tokens));
+      return NotificationFilter::ResolvePointer (val, tokens);
+    };
+
+  ASSERT_NE (resolve (""), nullptr);
+  EXPECT_EQ (*resolve (""), val);
+  ASSERT_NE (resolve ("/foo/0/a~1b"), nullptr);
+  EXPECT_EQ (*resolve ("/foo/0/a~1b"), 42);
+  ASSERT_NE (resolve ("/foo/1"), nullptr);
+  EXPECT_EQ (*resolve ("/foo/1"), "x");
+  ASSERT_NE (resolve ("//0"), nullptr);
+  EXPECT_EQ (*resolve ("//0"), true);
+
+  EXPECT_EQ (resolve ("/bar"), nullptr);
+  EXPECT_EQ (resolve ("/foo/2"), nullptr);
+  EXPECT_EQ (resolve ("/foo/01"), nullptr);
+  EXPECT_EQ (resolve ("/foo/-"), nullptr);
+  EXPECT_EQ (resolve ("/foo/4294967296"), nullptr);
+  EXPECT_EQ (resolve ("/foo/4294967297"), nullptr);
+  EXPECT_EQ (resolve ("/foo/123456789012345678901234567890"), nullptr);
+  EXPECT_EQ (resolve ("/foo/1/x"), nullptr);
+}
+
+TEST_F (NotificationFilterTests, InvalidSpec)
+{
+  NotificationFilter f;
+  for (const std::string str : {
+          "[]",
+          R"({"keys": []})",
+          R"({"path": "/foo"})",
+          R"({"path": 42, "keys": []})",
+          R"({"path": "foo", "keys": []})",
+          R"({"path": "/foo", "keys": [1]})",
+          R"({"path": "/foo", "keys": [], "field": 5})",
+          R"({"path": "/foo", "keys": [], "other": 5})",
+       })
+    EXPECT_FALSE (f.Parse (ParseJson (str))) << str;
+}
+
+TEST_F (NotificationFilterTests, KeyIsNormalised)
+{
+  const auto a = ParseFilter (R"({"path": "/x", "keys": ["b", "a", "b"]})");
+  const auto b = ParseFilter (R"({
+    "field": "name",
+    "keys": ["a", "b"],
+    "path": "/x"
+  })");
+  const auto c = ParseFilter (R"({"path": "/x", "keys": ["a"]})");
+
+  EXPECT_EQ (a.GetKey (), b.GetKey ());
+  EXPECT_EQ (a.GetSpec (), b.GetSpec ());
+  EXPECT_NE (a.GetKey (), c.GetKey ());
+}
+
+TEST_F (NotificationFilterTests, ObjectMembers)
+{
+  const auto f = ParseFilter (R"({"path": "/pending", "keys": ["a", "c"]})");
+  EXPECT_EQ (f.Apply (ParseJson (R"({
+    "version": 5,
+    "pending": {"a": [1], "b": [2], "c": [3]}
+  })")), ParseJson (R"({
+    "version": 5,
+    "pending": {"a": [1], "c": [3]}
+  })"));
+}
+
+TEST_F (NotificationFilterTests, ArrayElements)
+{
+  const auto f = ParseFilter (R"({
+    "path": "/pending/moves",
+    "keys": ["a"],
+    "field": "player"
+  })");
+  EXPECT_EQ (f.Apply (ParseJson (R"({
+    "version": 5,
+    "pending": {"moves": [
+      {"player": "a", "mv": 1},
+      {"player": "b", "mv": 2},
+      {"name": "a", "mv": 3},
+      42,
+      {"player": "a", "mv": 4}
+    ]}
+  })")), ParseJson (R"({
+    "version": 5,
+    "pending": {"moves": [
+      {"player": "a", "mv": 1},
+      {"player": "a", "mv": 4}
+    ]}
+  })"));
+}
+
+TEST_F (NotificationFilterTests, ArrayIndexInPath)
+{
+  const auto f = ParseFilter (R"({"path": "/list/1", "keys": ["x"]})");
+  EXPECT_EQ (f.Apply (ParseJson (R"({"list": [{"x": 1, "y": 2}, {"x": 3, "y": 4}]})")),
+             ParseJson (R"({"list": [{"x": 1, "y": 2}, {"x": 3}]})"));
+}
+
+TEST_F (NotificationFilterTests, HugeArrayIndexInPath)
+{
+  const auto f = ParseFilter (R"({
+    "path": "/list/123456789012345678901234567890",
+    "keys": ["x"]
+  })");
+  const auto state = ParseJson (R"({"list": [{"x": 1, "y": 2}]})");
+  EXPECT_EQ (f.Apply (state), state);
+}
+
+TEST_F (NotificationFilterTests, MissingPath)
+{
+  const auto f = ParseFilter (R"({"path": "/pending/foo", "keys": ["a"]})");
+  const auto state = ParseJson (R"({"pending": {"bar": 5}})");
+  EXPECT_EQ (f.Apply (state), state);
+  EXPECT_EQ (f.Apply (ParseJson ("42")), ParseJson ("42"));
+}
+
+} // anonymous namespace
+} // namespace charon
@@ -18,6 +18,8 @@
 
 #include "notifications.hpp"
 
+#include "notificationfilter.hpp"
+
 #include <glog/logging.h>
 
 namespace charon
@@ -53,4 +55,32 @@ PendingChangeNotification::AlwaysBlockId () const
   return 0;
 }
 
+ConfigurableNotification::ConfigurableNotification (
+    const std::string& t, const std::string& idPointer, const Json::Value& ab)
+  : NotificationType(t), alwaysBlock(ab)
+{
+  CHECK (NotificationFilter::ParsePointer (idPointer, idPath))
+      << "Invalid JSON pointer for state ID: " << idPointer;
+}
+
+Json::Value
+ConfigurableNotification::ExtractStateId (const Json::Value& fullState) const
+{
+  const auto* id = NotificationFilter::ResolvePointer (fullState, idPath);
+  if (id == nullptr)
+    {
+      LOG (WARNING)
+          << "State for " << GetType () << " has no ID:\n" << fullState;
+      return Json::Value ();
+    }
+
+  return *id;
+}
+
+Json::Value
+ConfigurableNotification::AlwaysBlockId () const
+{
+  return alwaysBlock;
+}
+
 } // namespace charon
@@ -22,6 +22,7 @@
 #include <json/json.h>
 
 #include <string>
+#include <vector>
 
 namespace charon
 {
@@ -125,6 +126,43 @@ public:
 
 };
 
+/**
+ * NotificationType implementation that is defined at runtime (e.g. from
+ * a config file), for arbitrary long-polling methods of a GSP.  The state ID
+ * is a JSON value within the state, given by a JSON pointer.
+ */
+class ConfigurableNotification : public NotificationType
+{
+
+private:
+
+  /** Reference tokens of the JSON pointer to the state ID.  */
+  std::vector<std::string> idPath;
+
+  /** The ID value that indicates "always block".  */
+  const Json::Value alwaysBlock;
+
+public:
+
+  /**
+   * Constructs the notification with the given type, JSON pointer
+   * (RFC 6901) for the state ID and the "always block" ID value.
+   * The pointer must be valid.
+   */
+  explicit ConfigurableNotification (const std::string& t,
+                                     const std::string& idPointer,
+                                     const Json::Value& ab);
+
+  /**
+   * Returns the value pointed to by the ID pointer, or null if the
+   * state does not contain it.
+   */
+  Json::Value ExtractStateId (const Json::Value& fullState) const override;
+
+  Json::Value AlwaysBlockId () const override;
+
+};
+
 } // namespace charon
 
 #endif // CHARON_NOTIFICATIONS_HPP
@@ -0,0 +1,70 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "notifications.hpp"
+
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+namespace charon
+{
+namespace
+{
+
+using ConfigurableNotificationTests = testing::Test;
+
+TEST_F (ConfigurableNotificationTests, Basic)
+{
+  const ConfigurableNotification n("stats", "/info/version", -1);
+
+  EXPECT_EQ (n.GetType (), "stats");
+  EXPECT_EQ (n.AlwaysBlockId (), -1);
+  EXPECT_EQ (n.ExtractStateId (ParseJson (R"({
+    "info": {"version": 42, "foo": "bar"},
+    "data": [1, 2, 3]
+  })")), 42);
+}
+
+TEST_F (ConfigurableNotificationTests, WholeState)
+{
+  const ConfigurableNotification n("hash", "", "");
+  EXPECT_EQ (n.ExtractStateId ("abc"), "abc");
+}
+
+TEST_F (ConfigurableNotificationTests, ArrayIndex)
+{
+  const ConfigurableNotification n("list", "/ids/1", Json::Value ());
+  EXPECT_EQ (n.ExtractStateId (ParseJson (R"({"ids": ["a", "b"]})")), "b");
+}
+
+TEST_F (ConfigurableNotificationTests, MissingId)
+{
+  const ConfigurableNotification n("stats", "/version", 0);
+  EXPECT_TRUE (n.ExtractStateId (ParseJson (R"({"foo": 42})")).isNull ());
+  EXPECT_TRUE (n.ExtractStateId (ParseJson ("[1, 2]")).isNull ());
+  EXPECT_TRUE (n.ExtractStateId ("string").isNull ());
+}
+
+TEST_F (ConfigurableNotificationTests, InvalidPointer)
+{
+  EXPECT_DEATH (ConfigurableNotification ("x", "version", 0), "JSON pointer");
+}
+
+} // anonymous namespace
+} // namespace charon
@@ -0,0 +1,263 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "payloadbuffer.hpp"
+
+#include <glog/logging.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace charon
+{
+
+namespace
+{
+
+/**
+ * Allocates disk space for the file to have (at least) the given size.
+ * Returns false (and logs a warning) if that fails.
+ */
+bool
+ReserveFile (const int fd, const size_t size)
+{
+  /* Unlike ftruncate, this fails right away if there is not enough space,
+     rather than leaving a sparse file that raises SIGBUS later on.  */
+  const int err = posix_fallocate (fd, 0, size);
+  if (err == 0)
+    return true;
+
+  LOG (WARNING)
+      << "Failed to allocate " << size << " bytes for temporary payload"
+      << " file: " << std::strerror (err);
+  return false;
+}
+
+} // anonymous namespace
+
+PayloadBuffer::PayloadBuffer (const size_t spill)
+  : spillSize(spill)
+{}
+
+PayloadBuffer::~PayloadBuffer ()
+{
+  if (mapped != nullptr)
+    munmap (mapped, capacity);
+  if (fd != -1)
+    close (fd);
+}
+
+bool
+PayloadBuffer::Spill (const size_t minCapacity)
+{
+  CHECK (mapped == nullptr);
+
+  const char* tmpDir = std::getenv ("TMPDIR");
+  std::string path = (tmpDir != nullptr && *tmpDir != '\0') ? tmpDir : "/tmp";
+  path += "/charon-payload-XXXXXX";
+
+  std::vector<char> name(path.begin (), path.end ());
+  name.push_back ('\0');
+
+  fd = mkstemp (name.data ());
+  if (fd == -1)
+    {
+      LOG (WARNING)
+          << "Failed to create temporary file for payload: "
+          << std::strerror (errno);
+      spillFailed = true;
+      return false;
+    }
+
+  /* The file is only accessed through our descriptor and mapping, so we
+     can unlink it right away.  */
+  unlink (name.data ());
+
+  const size_t cap = std::max (minCapacity, 2 * mem.size ());
+  if (!ReserveFile (fd, cap))
+    {
+      close (fd);
+      fd = -1;
+      spillFailed = true;
+      return false;
+    }
+
+  void* ptr = mmap (nullptr, cap, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (ptr == MAP_FAILED)
+    {
+      LOG (WARNING)
+          << "Failed to map temporary payload file: " << std::strerror (errno);
+      close (fd);
+      fd = -1;
+      spillFailed = true;
+      return false;
+    }
+
+  VLOG (1) << "Moving payload of " << mem.size () << " bytes to a file";
+
+  mapped = static_cast<char*> (ptr);
+  capacity = cap;
+  used = mem.size ();
+  std::memcpy (mapped, mem.data (), used);
+
+  /* Free the memory instead of just clearing the string.  */
+  std::string ().swap (mem);
+
+  return true;
+}
+
+bool
+PayloadBuffer::Grow (const size_t minCapacity)
+{
+  CHECK (mapped != nullptr);
+  if (minCapacity <= capacity)
+    return true;
+
+  const size_t cap = std::max (minCapacity, 2 * capacity);
+  if (!ReserveFile (fd, cap))
+    {
+      Unspill ();
+      return false;
+    }
+
+  /* The new mapping is created before removing the old one, so that the
+     data is still accessible if it fails.  */
+  void* ptr = mmap (nullptr, cap, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (ptr == MAP_FAILED)
+    {
+      LOG (WARNING)
+          << "Failed to map temporary payload file: " << std::strerror (errno);
+      Unspill ();
+      return false;
+    }
+
+  munmap (mapped, capacity);
+  mapped = static_cast<char*> (ptr);
+  capacity = cap;
+
+  return true;
+}
+
+void
+PayloadBuffer::Unspill ()
+{
+  CHECK (mapped != nullptr);
+
+  LOG (WARNING)
+      << "Moving payload of " << used << " bytes from file back to memory";
+
+  mem.assign (mapped, used);
+  munmap (mapped, capacity);
+  close (fd);
+
+  mapped = nullptr;
+  fd = -1;
+  capacity = 0;
+  used = 0;
+  spillFailed = true;
+}
+
+char*
+PayloadBuffer::Extend (const size_t n)
+{
+  if (mapped != nullptr && Grow (used + n))
+    {
+      char* res = mapped + used;
+      used += n;
+      return res;
+    }
+
+  const size_t oldSize = mem.size ();
+  if (oldSize + n > spillSize && !spillFailed && Spill (oldSize + n))
+    return Extend (n);
+
+  mem.resize (oldSize + n);
+  return &mem[oldSize];
+}
+
+void
+PayloadBuffer::Append (const char* data, const size_t n)
+{
+  if (n > 0)
+    std::memcpy (Extend (n), data, n);
+}
+
+void
+PayloadBuffer::Truncate (const size_t n)
+{
+  CHECK_LE (n, GetSize ());
+  if (mapped != nullptr)
+    used = n;
+  else
+    mem.resize (n);
+}
+
+const char*
+PayloadBuffer::GetData () const
+{
+  if (mapped != nullptr)
+    return mapped;
+  return mem.data ();
+}
+
+size_t
+PayloadBuffer::GetSize () const
+{
+  if (mapped != nullptr)
+    return used;
+  return mem.size ();
+}
+
+std::string
+PayloadBuffer::TakeString ()
+{
+  if (mapped != nullptr)
+    return std::string (mapped, used);
+
+  std::string res;
+  res.swap (mem);
+  return res;
+}
+
+PayloadStreamBuf::int_type
+PayloadStreamBuf::overflow (const int_type c)
+{
+  if (!traits_type::eq_int_type (c, traits_type::eof ()))
+    {
+      const char ch = traits_type::to_char_type (c);
+      buffer.Append (&ch, 1);
+    }
+
+  return traits_type::not_eof (c);
+}
+
+std::streamsize
+PayloadStreamBuf::xsputn (const char* s, const std::streamsize n)
+{
+  buffer.Append (s, n);
+  return n;
+}
+
+} // namespace charon
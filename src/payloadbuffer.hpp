@@ -0,0 +1,172 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_PAYLOADBUFFER_HPP
+#define CHARON_PAYLOADBUFFER_HPP
+
+#include <cstddef>
+#include <streambuf>
+#include <string>
+
+namespace charon
+{
+
+/**
+ * A growable byte buffer for (potentially large) payloads.  Small data is
+ * kept in memory.  Once the size exceeds a threshold, the data is moved
+ * to a memory-mapped temporary file instead, so that the kernel can page
+ * it out as needed and large payloads do not pin their full size in
+ * resident memory.
+ *
+ * The temporary file is unlinked right after creation, so it is cleaned
+ * up automatically even if the process crashes.  Disk space for it is
+ * allocated up front, so that a full disk does not lead to SIGBUS when
+ * writing to the mapping.  If the file cannot be created or grown, the
+ * data is kept in memory instead.
+ */
+class PayloadBuffer
+{
+
+private:
+
+  /** Size above which data is moved to a file.  */
+  const size_t spillSize;
+
+  /** The in-memory data (while not spilled).  */
+  std::string mem;
+
+  /** File descriptor of the temporary file, or -1 if not spilled.  */
+  int fd = -1;
+
+  /** The mapped file data, if spilled.  */
+  char* mapped = nullptr;
+
+  /** Size of the file and mapping.  */
+  size_t capacity = 0;
+
+  /** Number of bytes used (if spilled).  */
+  size_t used = 0;
+
+  /** Set to true if creating a file failed, so we do not retry.  */
+  bool spillFailed = false;
+
+  /**
+   * Moves the data to a temporary file with at least the given capacity.
+   * Returns false if that failed.
+   */
+  bool Spill (size_t minCapacity);
+
+  /**
+   * Grows the file and mapping to at least the given capacity.  If that
+   * fails, the data is moved back to memory and false is returned.
+   */
+  bool Grow (size_t minCapacity);
+
+  /**
+   * Moves the data from the file back to memory, and closes the file.
+   */
+  void Unspill ();
+
+public:
+
+  /**
+   * Constructs an empty buffer, which moves to a file once its size
+   * exceeds the given threshold.
+   */
+  explicit PayloadBuffer (size_t spill);
+
+  ~PayloadBuffer ();
+
+  PayloadBuffer () = delete;
+  PayloadBuffer (const PayloadBuffer&) = delete;
+  void operator= (const PayloadBuffer&) = delete;
+
+  /**
+   * Extends the buffer by n bytes and returns a pointer to the start of
+   * the new region, which the caller should fill in.  The pointer (and any
+   * pointer returned by GetData) is only valid until the next call to
+   * Extend or Append.
+   */
+  char* Extend (size_t n);
+
+  /**
+   * Appends the given data.
+   */
+  void Append (const char* data, size_t n);
+
+  /**
+   * Shrinks the buffer to the given size, which must not be larger than
+   * the current size.
+   */
+  void Truncate (size_t n);
+
+  /**
+   * Returns a view of the data.
+   */
+  const char* GetData () const;
+
+  /**
+   * Returns the size of the data.
+   */
+  size_t GetSize () const;
+
+  /**
+   * Returns true if the data has been moved to a file.
+   */
+  bool
+  IsSpilled () const
+  {
+    return mapped != nullptr;
+  }
+
+  /**
+   * Returns the data as string.  If the data is in memory, it is moved out
+   * of the buffer (which is left empty).  Otherwise it is copied.
+   */
+  std::string TakeString ();
+
+};
+
+/**
+ * A std::streambuf that appends everything written to a PayloadBuffer.
+ * This allows streaming serialisers to write into the buffer directly.
+ */
+class PayloadStreamBuf : public std::streambuf
+{
+
+private:
+
+  /** The buffer we write to.  */
+  PayloadBuffer& buffer;
+
+protected:
+
+  int_type overflow (int_type c) override;
+  std::streamsize xsputn (const char* s, std::streamsize n) override;
+
+public:
+
+  explicit PayloadStreamBuf (PayloadBuffer& b)
+    : buffer(b)
+  {}
+
+};
+
+} // namespace charon
+
+#endif // CHARON_PAYLOADBUFFER_HPP
@@ -0,0 +1,163 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "payloadbuffer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <ostream>
+#include <string>
+
+namespace charon
+{
+namespace
+{
+
+using PayloadBufferTests = testing::Test;
+
+std::string
+GetContent (const PayloadBuffer& buf)
+{
+  return std::string (buf.GetData (), buf.GetSize ());
+}
+
+TEST_F (PayloadBufferTests, InMemory)
+{
+  PayloadBuffer buf(100);
+  EXPECT_EQ (buf.GetSize (), 0u);
+
+  buf.Append ("foo", 3);
+  std::copy_n ("bar", 3, buf.Extend (3));
+  buf.Append ("baz", 3);
+  buf.Truncate (7);
+
+  EXPECT_FALSE (buf.IsSpilled ());
+  EXPECT_EQ (GetContent (buf), "foobarb");
+  EXPECT_EQ (buf.TakeString (), "foobarb");
+  EXPECT_EQ (buf.GetSize (), 0u);
+}
+
+TEST_F (PayloadBufferTests, Spilling)
+{
+  PayloadBuffer buf(10);
+
+  buf.Append ("abcdefgh", 8);
+  EXPECT_FALSE (buf.IsSpilled ());
+
+  buf.Append ("ijk", 3);
+  EXPECT_TRUE (buf.IsSpilled ());
+  EXPECT_EQ (GetContent (buf), "abcdefghijk");
+
+  std::string expected = "abcdefghijk";
+  for (unsigned i = 0; i < 1000; ++i)
+    {
+      const std::string cur = std::to_string (i);
+      buf.Append (cur.data (), cur.size ());
+      expected += cur;
+    }
+
+  EXPECT_TRUE (buf.IsSpilled ());
+  EXPECT_EQ (GetContent (buf), expected);
+
+  buf.Truncate (5);
+  EXPECT_EQ (GetContent (buf), "abcde");
+  EXPECT_EQ (buf.TakeString (), "abcde");
+}
+
+TEST_F (PayloadBufferTests, LargeExtend)
+{
+  PayloadBuffer buf(10);
+
+  const std::string data(1 << 20, 'x');
+  buf.Append (data.data (), data.size ());
+
+  EXPECT_TRUE (buf.IsSpilled ());
+  EXPECT_EQ (GetContent (buf), data);
+}
+
+TEST_F (PayloadBufferTests, SpillFailure)
+{
+  const char* oldTmp = std::getenv ("TMPDIR");
+  const std::string oldValue = (oldTmp == nullptr ? "" : oldTmp);
+  setenv ("TMPDIR", "/nonexistent/charon-tests", 1);
+
+  PayloadBuffer buf(10);
+  const std::string data(1'000, 'x');
+  buf.Append (data.data (), data.size ());
+  buf.Append ("abc", 3);
+
+  if (oldTmp == nullptr)
+    unsetenv ("TMPDIR");
+  else
+    setenv ("TMPDIR", oldValue.c_str (), 1);
+
+  EXPECT_FALSE (buf.IsSpilled ());
+  EXPECT_EQ (GetContent (buf), data + "abc");
+}
+
+TEST_F (PayloadBufferTests, GrowFailure)
+{
+  /* Limit the file size, so that growing the spilled file fails after
+     some point.  The data should then be moved back to memory.  */
+  rlimit oldLimit;
+  ASSERT_EQ (getrlimit (RLIMIT_FSIZE, &oldLimit), 0);
+  rlimit newLimit = oldLimit;
+  newLimit.rlim_cur = 1 << 16;
+  ASSERT_EQ (setrlimit (RLIMIT_FSIZE, &newLimit), 0);
+  const auto oldHandler = std::signal (SIGXFSZ, SIG_IGN);
+
+  PayloadBuffer buf(10);
+  std::string expected;
+  for (unsigned i = 0; i < 100; ++i)
+    {
+      const std::string cur(1'000, 'a' + (i % 26));
+      buf.Append (cur.data (), cur.size ());
+      expected += cur;
+    }
+
+  std::signal (SIGXFSZ, oldHandler);
+  ASSERT_EQ (setrlimit (RLIMIT_FSIZE, &oldLimit), 0);
+
+  EXPECT_FALSE (buf.IsSpilled ());
+  EXPECT_EQ (GetContent (buf), expected);
+
+  buf.Append ("xyz", 3);
+  EXPECT_FALSE (buf.IsSpilled ());
+  EXPECT_EQ (GetContent (buf), expected + "xyz");
+}
+
+TEST_F (PayloadBufferTests, StreamBuf)
+{
+  PayloadBuffer buf(16);
+  PayloadStreamBuf sb(buf);
+  std::ostream out(&sb);
+
+  out << "foo " << 42 << ' ' << std::string (20, 'y');
+  out.flush ();
+
+  EXPECT_TRUE (buf.IsSpilled ());
+  EXPECT_EQ (GetContent (buf), "foo 42 " + std::string (20, 'y'));
+}
+
+} // anonymous namespace
+} // namespace charon
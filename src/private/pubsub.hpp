@@ -70,6 +70,12 @@ private:
   /** Nodes owned by this pubsub instance.  */
   std::set<std::string> ownedNodes;
 
+  /**
+   * Mutex for ownedNodes, since nodes may be created and deleted from
+   * other threads while publishing is going on.
+   */
+  std::mutex mutNodes;
+
   /** Nodes subscribed to and the corresponding callbacks for items.  */
   std::map<std::string, ItemCallback> subscriptions;
 
@@ -123,6 +129,13 @@ public:
    */
   std::string CreateNode ();
 
+  /**
+   * Deletes a node that we own.  This does not wait for the server's
+   * response, so it can be called also from the XMPP receive thread.
+   * Nodes not owned (e.g. already deleted) are ignored.
+   */
+  void DeleteNode (const std::string& node);
+
   /**
    * Publishes a given tag to the given node.  It must be a node we own
    * (i.e. created before).
@@ -19,11 +19,14 @@
 #ifndef CHARON_STANZAS_HPP
 #define CHARON_STANZAS_HPP
 
+#include "xmldata.hpp"
+
 #include <gloox/stanzaextension.h>
 #include <gloox/tag.h>
 
 #include <json/json.h>
 
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
@@ -31,6 +34,120 @@
 namespace charon
 {
 
+/**
+ * Returns the current system time in milliseconds since the Unix epoch,
+ * as used for timestamps in our stanzas.
+ */
+std::int64_t GetTimestampMs ();
+
+/** Capability: success responses may be marked as stale.  */
+constexpr const char* CAPABILITY_STALE = "stale";
+/** Capability: filtered notification streams.  */
+constexpr const char* CAPABILITY_FILTER = "filter";
+/** Capability: timestamps on notification updates and pongs.  */
+constexpr const char* CAPABILITY_TIMESTAMPS = "timestamps";
+/** Capability: zlib-compressed payloads.  */
+constexpr const char* CAPABILITY_ZLIB = "zlib";
+/** Capability: array results split into pages fetched with a cursor.  */
+constexpr const char* CAPABILITY_PAGES = "pages";
+
+/**
+ * A set of protocol capabilities (optional features by name, each with
+ * a version) supported by a peer.  They are exchanged as part of ping and
+ * pong stanzas as children of the form:
+ *
+ *  <capability name="zlib" version="1" />
+ *
+ * Peers that do not send any capabilities are assumed to support the
+ * legacy set, i.e. everything that was part of the protocol before
+ * capabilities were introduced.
+ */
+class Capabilities
+{
+
+private:
+
+  /** The supported capabilities and their versions.  */
+  std::map<std::string, unsigned> versions;
+
+public:
+
+  Capabilities () = default;
+  Capabilities (const Capabilities&) = default;
+  Capabilities& operator= (const Capabilities&) = default;
+
+  /**
+   * Sets the version of a capability.  A version of zero removes it.
+   */
+  void Set (const std::string& name, unsigned version);
+
+  /**
+   * Returns the supported version of a capability, or zero if it is
+   * not supported.
+   */
+  unsigned Get (const std::string& name) const;
+
+  /**
+   * Returns true if the capability is supported in at least the given
+   * version.
+   */
+  bool
+  Has (const std::string& name, const unsigned minVersion = 1) const
+  {
+    return Get (name) >= minVersion;
+  }
+
+  /**
+   * Returns true if there are no capabilities at all.
+   */
+  bool
+  IsEmpty () const
+  {
+    return versions.empty ();
+  }
+
+  /**
+   * Returns the negotiated capabilities with a peer, i.e. the ones
+   * supported by both, with the lower of both versions.
+   */
+  Capabilities Intersect (const Capabilities& other) const;
+
+  /**
+   * Returns the XML encoding options for payloads sent to a peer with
+   * these capabilities.
+   */
+  XmlEncodingOptions GetEncodingOptions () const;
+
+  /**
+   * Adds the capabilities as children to the given tag.
+   */
+  void AddToTag (gloox::Tag& t) const;
+
+  /**
+   * Parses the capabilities from children of the given tag.  Invalid
+   * entries are ignored.  If there are none at all, then the result
+   * is the legacy set.
+   */
+  static Capabilities FromTag (const gloox::Tag& t);
+
+  /**
+   * Returns the capabilities supported by this implementation.
+   */
+  static const Capabilities& Own ();
+
+  /**
+   * Returns the capabilities assumed for peers that do not send any.
+   */
+  static const Capabilities& Legacy ();
+
+  friend bool
+  operator== (const Capabilities& a, const Capabilities& b)
+  {
+    return a.versions == b.versions;
+  }
+
+};
+
 /**
  * A general gloox StanzaExtension which has a "valid" flag.  This allows us
  * to check incoming stanzas for whether or not they have been parsed correctly.
@@ -80,6 +197,10 @@ public:
  *    <method>mymethod</method>
  *    <params>["json params", 42]</params>
  *  </request>
+ *
+ * The request tag may carry an optional id attribute, which the client
+ * keeps the same when retrying a call.  It allows the server to avoid
+ * executing the same call more than once.
  */
 class RpcRequest : public ValidatedStanzaExtension
 {
@@ -89,9 +210,15 @@ private:
   /** The method name being called.  */
   std::string method;
 
+  /** The request ID (empty if none).  */
+  std::string id;
+
   /** The params data for the call.  */
   Json::Value params;
 
+  /** Options for encoding the params payload.  */
+  XmlEncodingOptions encoding;
+
 public:
 
   /** Extension type for RPC request extensions.  */
@@ -125,6 +252,33 @@ public:
     return params;
   }
 
+  /**
+   * Returns the request ID, or an empty string if the request has none.
+   */
+  const std::string&
+  GetId () const
+  {
+    return id;
+  }
+
+  /**
+   * Sets the request ID.  It must not be longer than MAX_ID_LENGTH.
+   */
+  void SetId (const std::string& i);
+
+  /**
+   * Sets the options for encoding the payload (e.g. based on the
+   * capabilities of the receiving peer).
+   */
+  void
+  SetEncoding (const XmlEncodingOptions& opt)
+  {
+    encoding = opt;
+  }
+
+  /** Maximum length of request IDs we accept.  */
+  static constexpr size_t MAX_ID_LENGTH = 64;
+
   const std::string& filterString () const override;
   gloox::StanzaExtension* newInstance (const gloox::Tag* tag) const override;
   gloox::StanzaExtension* clone () const override;
@@ -141,6 +295,15 @@ public:
  *    <result>{"some": "json result"}</result>
  *  </response>
  *
+ * A successful result may carry a stale="true" attribute on the response
+ * tag, which means that the server could not reach its backend and returned
+ * the last known good result instead.
+ *
+ * If the result is a large array, the server may return only its first
+ * part and a cursor attribute on the response tag.  The remaining items
+ * can then be fetched with PageRequest, whose response is again of this
+ * form (with a cursor as long as there are more items).
+ *
  *  <response xmlns="https://xaya.io/charon/">
  *    <error code="42">
  *      <message>error message</message>
@@ -159,6 +322,15 @@ private:
   /** On success, the result data.  */
   Json::Value result;
 
+  /** On success, whether the result is possibly outdated.  */
+  bool stale = false;
+
+  /**
+   * On success, the cursor for fetching more items of the result (empty
+   * if the result is complete).
+   */
+  std::string cursor;
+
   /** On error, the error code.  */
   int errorCode;
   /** On error, the error message.  */
@@ -166,6 +338,9 @@ private:
   /** On error, the extra data.  */
   Json::Value errorData;
 
+  /** Options for encoding the payloads.  */
+  XmlEncodingOptions encoding;
+
 public:
 
   /** Extension type for RPC response extensions.  */
@@ -200,6 +375,45 @@ public:
 
   const Json::Value& GetResult () const;
 
+  /**
+   * Marks a success response as stale.
+   */
+  void SetStale (bool s);
+
+  /**
+   * Sets the options for encoding the payloads (e.g. based on the
+   * capabilities of the receiving peer).
+   */
+  void
+  SetEncoding (const XmlEncodingOptions& opt)
+  {
+    encoding = opt;
+  }
+
+  /**
+   * Returns true if this is a success response with stale data.
+   */
+  bool
+  IsStale () const
+  {
+    return success && stale;
+  }
+
+  /**
+   * Sets the cursor for the remaining items of a success response.
+   */
+  void SetCursor (const std::string& c);
+
+  /**
+   * Returns the cursor for the remaining items, or an empty string if
+   * the result is complete (or this is an error response).
+   */
+  const std::string&
+  GetCursor () const
+  {
+    return cursor;
+  }
+
   int GetErrorCode () const;
   const std::string& GetErrorMessage () const;
   const Json::Value& GetErrorData () const;
@@ -215,10 +429,17 @@ public:
  * A gloox StanzaExtension representing a "ping" message:
  *
  *  <ping xmlns="https://xaya.io/charon/" />
+ *
+ * It may contain the client's capabilities as children.
  */
 class PingMessage : public ValidatedStanzaExtension
 {
 
+private:
+
+  /** The client's capabilities.  */
+  Capabilities capabilities;
+
 public:
 
   /** Extension type for ping extensions.  */
@@ -230,6 +451,23 @@ public:
    */
   PingMessage ();
 
+  /**
+   * Constructs an instance from a given tag.
+   */
+  explicit PingMessage (const gloox::Tag& t);
+
+  void
+  SetCapabilities (const Capabilities& c)
+  {
+    capabilities = c;
+  }
+
+  const Capabilities&
+  GetCapabilities () const
+  {
+    return capabilities;
+  }
+
   const std::string& filterString () const override;
   gloox::StanzaExtension* newInstance (const gloox::Tag* tag) const override;
   gloox::StanzaExtension* clone () const override;
@@ -240,7 +478,12 @@ public:
 /**
  * A gloox StanzaExtension representing a "pong" message/presence:
  *
- *  <pong xmlns="https://xaya.io/charon/" version="server version" />
+ *  <pong xmlns="https://xaya.io/charon/" version="server version"
+ *        time="1700000000000" />
+ *
+ * The optional time is the server's clock (see GetTimestampMs) when
+ * sending the pong, which clients can use to estimate the clock offset.
+ * The pong may also contain the server's capabilities as children.
  */
 class PongMessage : public ValidatedStanzaExtension
 {
@@ -250,6 +493,12 @@ private:
   /** The server version string.  */
   std::string version;
 
+  /** The server's timestamp (or zero if not present).  */
+  std::int64_t time = 0;
+
+  /** The server's capabilities.  */
+  Capabilities capabilities;
+
 public:
 
   /** Extension type for pong extensions.  */
@@ -280,6 +529,36 @@ public:
     return version;
   }
 
+  /**
+   * Sets the server timestamp.
+   */
+  void
+  SetTime (const std::int64_t t)
+  {
+    time = t;
+  }
+
+  /**
+   * Returns the server timestamp, or zero if none was included.
+   */
+  std::int64_t
+  GetTime () const
+  {
+    return time;
+  }
+
+  void
+  SetCapabilities (const Capabilities& c)
+  {
+    capabilities = c;
+  }
+
+  const Capabilities&
+  GetCapabilities () const
+  {
+    return capabilities;
+  }
+
   const std::string& filterString () const override;
   gloox::StanzaExtension* newInstance (const gloox::Tag* tag) const override;
   gloox::StanzaExtension* clone () const override;
@@ -291,10 +570,23 @@ public:
  * Gloox StanzaExtension for the supported notifications and PubSub nodes
  * of a Charon server (sent together with a pong presence):
  *
- *  <notifications xmlns="https://xaya.io/charon/" service="pubsub.service">
+ *  <notifications xmlns="https://xaya.io/charon/" service="pubsub.service"
+ *                 direct="true">
  *    <notification type="state">node-state</notification>
  *    <notification type="pending">node-pending</notification>
+ *    <alternative service="pubsub.other">
+ *      <notification type="state">other-state</notification>
+ *      <notification type="pending">other-pending</notification>
+ *    </alternative>
  *  </notifications>
+ *
+ * The optional direct attribute indicates that clients may register
+ * for direct push of the updates (see DirectRegistration) instead of
+ * subscribing to the nodes.
+ *
+ * Alternative elements list further pubsub services to which the server
+ * publishes the same updates, with their nodes.  Clients may subscribe
+ * on any of them instead of the main service.
  */
 class SupportedNotifications : public ValidatedStanzaExtension
 {
@@ -307,6 +599,15 @@ private:
   /** Notification nodes keyed by the type string.  */
   std::map<std::string, std::string> notifications;
 
+  /** Whether the server accepts registrations for direct push.  */
+  bool direct = false;
+
+  /**
+   * Alternative pubsub services, mapped to their notification nodes
+   * keyed by type.
+   */
+  std::map<std::string, std::map<std::string, std::string>> alternatives;
+
 public:
 
   /** Extension type for notifications data extensions.  */
@@ -353,6 +654,293 @@ public:
    */
   void AddNotification (const std::string& type, const std::string& node);
 
+  /**
+   * Returns the alternative pubsub services, each with its map of
+   * notification types to nodes.
+   */
+  const std::map<std::string, std::map<std::string, std::string>>&
+  GetAlternatives () const
+  {
+    return alternatives;
+  }
+
+  /**
+   * Adds the node for a notification type on an alternative pubsub service.
+   * The service must not be the main one, and the type must not yet be set
+   * for it.
+   */
+  void AddAlternative (const std::string& srv, const std::string& type,
+                       const std::string& node);
+
+  /**
+   * Sets whether the server accepts registrations for direct push.
+   */
+  void
+  SetDirect (const bool d)
+  {
+    direct = d;
+  }
+
+  /**
+   * Returns true if the server accepts registrations for direct push.
+   */
+  bool
+  SupportsDirect () const
+  {
+    return direct;
+  }
+
+  const std::string& filterString () const override;
+  gloox::StanzaExtension* newInstance (const gloox::Tag* tag) const override;
+  gloox::StanzaExtension* clone () const override;
+  gloox::Tag* tag () const override;
+
+};
+
+/**
+ * Gloox StanzaExtension for registering a filtered notification stream
+ * with a server.  A client sends an IQ get request with it (containing
+ * the filter specification), and the server responds with an IQ result
+ * containing the pubsub node for the filtered stream:
+ *
+ *  <filter xmlns="https://xaya.io/charon/" type="pending">
+ *    <spec>{"path": "/pending", "keys": ["domob"]}</spec>
+ *  </filter>
+ *
+ *  <filter xmlns="https://xaya.io/charon/" type="pending" node="node-id" />
+ */
+class FilterRegistration : public ValidatedStanzaExtension
+{
+
+private:
+
+  /** The notification type.  */
+  std::string type;
+
+  /** The filter specification (null if not present).  */
+  Json::Value spec;
+
+  /** The pubsub node (empty if not present).  */
+  std::string node;
+
+public:
+
+  /** Extension type for filter registration extensions.  */
+  static constexpr int EXT_TYPE = gloox::ExtUser + 6;
+
+  /**
+   * Constructs an empty instance (for use as factory).  It will be marked
+   * as invalid.
+   */
+  FilterRegistration ();
+
+  /**
+   * Constructs a request for the given notification type and filter.
+   */
+  explicit FilterRegistration (const std::string& t, const Json::Value& s);
+
+  /**
+   * Constructs a response for the given type with the given node.
+   */
+  explicit FilterRegistration (const std::string& t, const std::string& n);
+
+  /**
+   * Constructs an instance from a given tag.
+   */
+  explicit FilterRegistration (const gloox::Tag& t);
+
+  const std::string&
+  GetType () const
+  {
+    return type;
+  }
+
+  const Json::Value&
+  GetSpec () const
+  {
+    return spec;
+  }
+
+  const std::string&
+  GetNode () const
+  {
+    return node;
+  }
+
+  const std::string& filterString () const override;
+  gloox::StanzaExtension* newInstance (const gloox::Tag* tag) const override;
+  gloox::StanzaExtension* clone () const override;
+  gloox::Tag* tag () const override;
+
+};
+
+/**
+ * Gloox StanzaExtension for registering with a server for direct push
+ * of notification updates, i.e. as messages sent by the server to the
+ * client's full JID instead of through the pubsub service.  A client sends
+ * an IQ set request with the notification types it wants (and optionally
+ * a filter specification for each), and the server responds with an empty
+ * IQ result if it accepted the registration:
+ *
+ *  <direct xmlns="https://xaya.io/charon/">
+ *    <notification type="state" />
+ *    <notification type="pending">
+ *      <spec>{"path": "/pending", "keys": ["domob"]}</spec>
+ *    </notification>
+ *  </direct>
+ *
+ * The registration lasts until the client sends unavailable presence to
+ * the server (or disconnects, after having sent directed presence).
+ */
+class DirectRegistration : public ValidatedStanzaExtension
+{
+
+private:
+
+  /**
+   * The requested notification types with their filter specification
+   * (null if unfiltered).
+   */
+  std::map<std::string, Json::Value> notifications;
+
+public:
+
+  /** Extension type for direct registration extensions.  */
+  static constexpr int EXT_TYPE = gloox::ExtUser + 7;
+
+  /**
+   * Constructs an empty instance, which can be used as a factory as well
+   * as a valid response (or request to be filled in).
+   */
+  DirectRegistration ();
+
+  /**
+   * Constructs an instance from a given tag.
+   */
+  explicit DirectRegistration (const gloox::Tag& t);
+
+  /**
+   * Adds a requested notification type with the given filter specification
+   * (null for none).  The type must not yet be set.
+   */
+  void AddNotification (const std::string& type, const Json::Value& spec);
+
+  /**
+   * Returns the requested notification types and their filters.
+   */
+  const std::map<std::string, Json::Value>&
+  GetNotifications () const
+  {
+    return notifications;
+  }
+
+  const std::string& filterString () const override;
+  gloox::StanzaExtension* newInstance (const gloox::Tag* tag) const override;
+  gloox::StanzaExtension* clone () const override;
+  gloox::Tag* tag () const override;
+
+};
+
+/**
+ * Gloox StanzaExtension for a notification update pushed directly to a
+ * registered client as message.  The payload is the "update" tag as
+ * described for NotificationUpdate, which is just kept as tag here and
+ * parsed by the receiver.
+ */
+class PushedUpdate : public ValidatedStanzaExtension
+{
+
+private:
+
+  /** The update tag.  */
+  std::unique_ptr<gloox::Tag> update;
+
+public:
+
+  /** Extension type for pushed update extensions.  */
+  static constexpr int EXT_TYPE = gloox::ExtUser + 8;
+
+  /**
+   * Constructs an empty instance (for use as factory).  It will be marked
+   * as invalid.
+   */
+  PushedUpdate ();
+
+  /**
+   * Constructs an instance from a given tag, which is the update tag
+   * itself.  It can also be used to construct a valid instance from
+   * NotificationUpdate::CreateTag.
+   */
+  explicit PushedUpdate (const gloox::Tag& t);
+
+  /**
+   * Returns the update tag.  Must only be called on a valid instance.
+   */
+  const gloox::Tag& GetUpdate () const;
+
+  const std::string& filterString () const override;
+  gloox::StanzaExtension* newInstance (const gloox::Tag* tag) const override;
+  gloox::StanzaExtension* clone () const override;
+  gloox::Tag* tag () const override;
+
+};
+
+/**
+ * Gloox StanzaExtension for requesting the next part of a result that the
+ * server split into pages (see RpcResponse).  A client sends an IQ get
+ * request with the cursor it received and the index of the first item it
+ * wants (i.e. the number of items received so far), and the server responds
+ * with an RpcResponse holding the items from there:
+ *
+ *  <page xmlns="https://xaya.io/charon/" cursor="cursor-id" offset="42" />
+ *
+ * Since the offset is explicit, a request can be repeated (e.g. after
+ * a timeout) and yields the same page again.
+ */
+class PageRequest : public ValidatedStanzaExtension
+{
+
+private:
+
+  /** The cursor of the result.  */
+  std::string cursor;
+
+  /** Index of the first requested item.  */
+  std::uint64_t offset = 0;
+
+public:
+
+  /** Extension type for page request extensions.  */
+  static constexpr int EXT_TYPE = gloox::ExtUser + 9;
+
+  /**
+   * Constructs an empty instance (for use as factory).  It will be marked
+   * as invalid.
+   */
+  PageRequest ();
+
+  /**
+   * Constructs a request for the given cursor and offset.
+   */
+  explicit PageRequest (const std::string& c, std::uint64_t o);
+
+  /**
+   * Constructs an instance from a given tag.
+   */
+  explicit PageRequest (const gloox::Tag& t);
+
+  const std::string&
+  GetCursor () const
+  {
+    return cursor;
+  }
+
+  std::uint64_t
+  GetOffset () const
+  {
+    return offset;
+  }
+
   const std::string& filterString () const override;
   gloox::StanzaExtension* newInstance (const gloox::Tag* tag) const override;
   gloox::StanzaExtension* clone () const override;
@@ -369,6 +957,10 @@ public:
  *  <update xmlns="https://xaya.io/charon/" type="state">
  *    JSON string of new state
  *  </update>
+ *
+ * Optionally, it can also have "received" and "published" attributes with
+ * the server's timestamps (see GetTimestampMs) of when the backend returned
+ * the state and when it was published.
  */
 class NotificationUpdate
 {
@@ -384,6 +976,12 @@ private:
   /** The new JSON data.  */
   Json::Value newState;
 
+  /** When the state was received by the server (zero if unknown).  */
+  std::int64_t received = 0;
+
+  /** When the state was published by the server (zero if unknown).  */
+  std::int64_t published = 0;
+
 public:
 
   /**
@@ -427,6 +1025,37 @@ public:
     return newState;
   }
 
+  /**
+   * Sets the server-side timestamps.
+   */
+  void
+  SetTimestamps (const std::int64_t r, const std::int64_t p)
+  {
+    received = r;
+    published = p;
+  }
+
+  /**
+   * Returns true if the update has (both) server-side timestamps.
+   */
+  bool
+  HasTimestamps () const
+  {
+    return received > 0 && published > 0;
+  }
+
+  std::int64_t
+  GetReceived () const
+  {
+    return received;
+  }
+
+  std::int64_t
+  GetPublished () const
+  {
+    return published;
+  }
+
   /**
    * Serialises the object into a tag.
    */
@@ -382,6 +382,7 @@ PubSubImpl::~PubSubImpl ()
         manager.removeID (manager.unsubscribe (service, entry.first, "",
                                                &handler));
 
+      std::lock_guard<std::mutex> lock(mutNodes);
       LOG (INFO) << "Deleting " << ownedNodes.size () << " owned nodes...";
       for (const auto& node : ownedNodes)
         manager.removeID (manager.deleteNode (service, node, &handler));
@@ -409,6 +410,11 @@ PubSubImpl::handleMessage (const gloox::Message& msg,
   if (pse == nullptr || pse->type () != gloox::PubSub::EventItems)
     return;
 
+  /* There may be several instances for different services on the same
+     client, each of which only handles its own events.  */
+  if (msg.from ().bareJID () != service.bareJID ())
+    return;
+
   LOG (INFO)
       << "Received pubsub item for node " << pse->node ()
       << " from " << msg.from ().full ();
@@ -443,7 +449,10 @@ PubSubImpl::CreateNode ()
   if (node.empty ())
     LOG (WARNING) << "Failed to create pubsub node";
   else
-    ownedNodes.insert (node);
+    {
+      std::lock_guard<std::mutex> lock(mutNodes);
+      ownedNodes.insert (node);
+    }
 
   /* Be extra safe and make sure that the handler is no longer tracked by
      gloox before it goes out of scope.  It will typically be removed already
@@ -454,11 +463,35 @@ PubSubImpl::CreateNode ()
   return node;
 }
 
+void
+PubSubImpl::DeleteNode (const std::string& node)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutNodes);
+    if (ownedNodes.erase (node) == 0)
+      {
+        LOG (WARNING) << "Not deleting non-owned node " << node;
+        return;
+      }
+  }
+
+  client.RunWithClient ([this, &node] (gloox::Client& c)
+    {
+      /* We do not wait for the response, so the handler is not actually
+         used (since we remove the ID right away).  */
+      CleanUpResultHandler handler;
+      manager.removeID (manager.deleteNode (service, node, &handler));
+    });
+}
+
 void
 PubSubImpl::Publish (const std::string& node, std::unique_ptr<gloox::Tag> data)
 {
-  CHECK_GT (ownedNodes.count (node), 0)
-      << "Can't publish to non-owned node " << node;
+  {
+    std::lock_guard<std::mutex> lock(mutNodes);
+    CHECK_GT (ownedNodes.count (node), 0)
+        << "Can't publish to non-owned node " << node;
+  }
 
   auto item = std::make_unique<gloox::PubSub::Item> ();
   item->setPayload (data.release ());
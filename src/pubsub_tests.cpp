@@ -254,6 +254,19 @@ TEST_F (PubSubTests, ServerCleansUpNode)
   EXPECT_FALSE (client.Subscribe (node));
 }
 
+TEST_F (PubSubTests, DeleteNode)
+{
+  const auto node = server.GetPubSub ().CreateNode ();
+  const auto other = server.GetPubSub ().CreateNode ();
+  server.GetPubSub ().DeleteNode (node);
+
+  /* Deletion is not waited for, see ServerCleansUpNode.  */
+  std::this_thread::sleep_for (std::chrono::milliseconds (500));
+
+  EXPECT_FALSE (client.Subscribe (node));
+  EXPECT_TRUE (client.Subscribe (other));
+}
+
 TEST_F (PubSubTests, TwoServers)
 {
   const auto node1 = server.GetPubSub ().CreateNode ();
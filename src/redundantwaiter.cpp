@@ -0,0 +1,202 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "redundantwaiter.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace charon
+{
+
+namespace
+{
+
+/** The default backoff time for failing sources.  */
+const auto DEFAULT_BACKOFF = std::chrono::seconds (5);
+
+/**
+ * Maximum time that a WaitForUpdate call waits before returning null,
+ * so that the WaiterThread can be stopped in a timely manner.
+ */
+const auto MAX_WAIT = std::chrono::seconds (1);
+
+/**
+ * Number of recent state IDs kept for deduplication, and also the maximum
+ * number of states queued up for WaitForUpdate.
+ */
+constexpr size_t MAX_RECENT = 16;
+
+} // anonymous namespace
+
+RedundantUpdateWaiter::RedundantUpdateWaiter (
+    std::unique_ptr<NotificationType> t,
+    std::vector<std::unique_ptr<UpdateWaiter>> s)
+  : type(std::move (t)), sources(std::move (s)),
+    backoff(DEFAULT_BACKOFF), shouldStop(false)
+{
+  CHECK (!sources.empty ()) << "No sources for RedundantUpdateWaiter";
+}
+
+RedundantUpdateWaiter::~RedundantUpdateWaiter ()
+{
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    shouldStop = true;
+    cv.notify_all ();
+  }
+
+  for (auto& t : threads)
+    t.join ();
+}
+
+void
+RedundantUpdateWaiter::SetHeightFunction (HeightFunction f)
+{
+  std::lock_guard<std::mutex> lock(mut);
+  CHECK (threads.empty ()) << "Height function set after starting";
+  heightFunction = std::move (f);
+}
+
+void
+RedundantUpdateWaiter::ProcessState (const Json::Value& state,
+                                     const uint64_t height)
+{
+  const Json::Value id = type->ExtractStateId (state);
+  if (std::find (recentIds.begin (), recentIds.end (), id) != recentIds.end ())
+    return;
+
+  if (heightFunction)
+    {
+      if (height < lastHeight)
+        {
+          VLOG (1)
+              << "Ignoring state " << id << " at height " << height
+              << " for " << type->GetType ()
+              << ", which is behind " << lastHeight;
+          return;
+        }
+      lastHeight = height;
+    }
+
+  VLOG (1)
+      << "First arrival of state " << id << " for " << type->GetType ();
+
+  recentIds.push_back (id);
+  if (recentIds.size () > MAX_RECENT)
+    recentIds.pop_front ();
+
+  pending.push_back (state);
+  if (pending.size () > MAX_RECENT)
+    pending.pop_front ();
+
+  cv.notify_all ();
+}
+
+void
+RedundantUpdateWaiter::RunSource (const size_t index)
+{
+  auto& source = *sources[index];
+  bool failed = false;
+
+  while (!shouldStop)
+    {
+      Json::Value state;
+      const bool ok = source.WaitForUpdate (state);
+
+      /* The height function is fixed once the threads are running.  Since
+         it may call the backend, we use it before locking.  */
+      uint64_t height = 0;
+      bool haveHeight = true;
+      if (ok && !state.isNull () && heightFunction)
+        haveHeight = heightFunction (index, state, height);
+
+      std::unique_lock<std::mutex> lock(mut);
+
+      if (ok == failed)
+        {
+          if (ok)
+            --failing;
+          else
+            ++failing;
+          failed = !ok;
+          cv.notify_all ();
+        }
+
+      if (!ok)
+        {
+          LOG (WARNING)
+              << "Source " << index << " for " << type->GetType ()
+              << " failed, backing off";
+          cv.wait_for (lock, backoff, [this] () { return shouldStop.load (); });
+          continue;
+        }
+
+      if (state.isNull ())
+        continue;
+
+      if (!haveHeight)
+        {
+          LOG (WARNING)
+              << "Could not determine height of state from source " << index
+              << " for " << type->GetType () << ", ignoring it";
+          continue;
+        }
+
+      ProcessState (state, height);
+    }
+}
+
+bool
+RedundantUpdateWaiter::WaitForUpdate (Json::Value& newState)
+{
+  std::unique_lock<std::mutex> lock(mut);
+
+  if (threads.empty ())
+    {
+      LOG (INFO)
+          << "Starting " << sources.size () << " redundant waiters for "
+          << type->GetType ();
+      for (size_t i = 0; i < sources.size (); ++i)
+        threads.emplace_back ([this, i] ()
+          {
+            RunSource (i);
+          });
+    }
+
+  const auto until = std::chrono::steady_clock::now () + MAX_WAIT;
+  while (pending.empty ())
+    {
+      if (failing == sources.size ())
+        return false;
+
+      if (cv.wait_until (lock, until) == std::cv_status::timeout)
+        {
+          newState = Json::Value ();
+          return true;
+        }
+    }
+
+  newState = std::move (pending.front ());
+  pending.pop_front ();
+
+  return true;
+}
+
+} // namespace charon
@@ -0,0 +1,168 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_REDUNDANTWAITER_HPP
+#define CHARON_REDUNDANTWAITER_HPP
+
+#include "notifications.hpp"
+#include "waiterthread.hpp"
+
+#include <json/json.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace charon
+{
+
+/**
+ * UpdateWaiter that combines multiple other waiters (e.g. long-polling
+ * replicas of the same GSP).  All of them are polled in parallel, and each
+ * new state (as identified by its state ID) is forwarded as soon as the first
+ * of them returns it.  This hides stalls of individual backends, and reduces
+ * notification latency to that of the fastest one.
+ *
+ * The sources must agree on the state IDs, so this is only suitable for
+ * states that are the same on all replicas (i.e. block states and not
+ * e.g. pending versions, which are local to each backend).
+ */
+class RedundantUpdateWaiter : public UpdateWaiter
+{
+
+public:
+
+  /**
+   * Function that determines the block height of a state returned by the
+   * source with the given index.  It returns false if that fails.
+   */
+  using HeightFunction = std::function<bool (size_t source,
+                                             const Json::Value& state,
+                                             uint64_t& height)>;
+
+private:
+
+  /** The notification type, used to extract state IDs.  */
+  std::unique_ptr<NotificationType> type;
+
+  /** The underlying waiters.  */
+  std::vector<std::unique_ptr<UpdateWaiter>> sources;
+
+  /** Threads polling each of the sources.  */
+  std::vector<std::thread> threads;
+
+  /**
+   * The "back off" time for a source after one of its calls failed.
+   */
+  std::chrono::milliseconds backoff;
+
+  /** Mutex for the shared state.  */
+  std::mutex mut;
+
+  /** Condition variable notified when new states arrive or on stop.  */
+  std::condition_variable cv;
+
+  /** Set to true when the source threads should stop.  */
+  std::atomic<bool> shouldStop;
+
+  /** States that have been received but not yet returned.  */
+  std::deque<Json::Value> pending;
+
+  /** State IDs that have been forwarded recently, for deduplication.  */
+  std::deque<Json::Value> recentIds;
+
+  /** Number of sources whose last call failed.  */
+  unsigned failing = 0;
+
+  /** If set, the function used to order states by their height.  */
+  HeightFunction heightFunction;
+
+  /** Highest height of a state forwarded so far.  */
+  uint64_t lastHeight = 0;
+
+  /**
+   * Polls the source with the given index until we are stopped.
+   */
+  void RunSource (size_t index);
+
+  /**
+   * Processes a state received from one of the sources, with its height
+   * (if a height function is set).  Must be called with mut held.
+   */
+  void ProcessState (const Json::Value& state, uint64_t height);
+
+public:
+
+  /**
+   * Constructs the waiter for the given notification type, combining
+   * the given underlying waiters.
+   */
+  explicit RedundantUpdateWaiter (
+      std::unique_ptr<NotificationType> t,
+      std::vector<std::unique_ptr<UpdateWaiter>> s);
+
+  RedundantUpdateWaiter () = delete;
+  RedundantUpdateWaiter (const RedundantUpdateWaiter&) = delete;
+  void operator= (const RedundantUpdateWaiter&) = delete;
+
+  /**
+   * Stops all polling threads.  This waits for the calls currently running
+   * on the sources to return.
+   */
+  ~RedundantUpdateWaiter ();
+
+  /**
+   * Sets the backoff time for failing sources to a custom value.  This must
+   * be called before the first call to WaitForUpdate.
+   */
+  template <typename Rep, typename Period>
+    void
+    SetBackoff (const std::chrono::duration<Rep, Period>& val)
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    backoff = val;
+  }
+
+  /**
+   * Sets a function for determining the height of states.  If set, states
+   * below the highest height forwarded so far are ignored, so that
+   * lagging sources do not make the state go back.  Different states at
+   * the same height are still forwarded (they may be from a reorg).
+   * This must be called before the first call to WaitForUpdate.
+   */
+  void SetHeightFunction (HeightFunction f);
+
+  /**
+   * Returns the next new state received from any source.  This fails if all
+   * sources are failing, and returns JSON null if no new state arrives
+   * within a short time (so that the caller can check for stopping).
+   */
+  bool WaitForUpdate (Json::Value& newState) override;
+
+};
+
+} // namespace charon
+
+#endif // CHARON_REDUNDANTWAITER_HPP
@@ -0,0 +1,155 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "redundantwaiter.hpp"
+
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace charon
+{
+namespace
+{
+
+class RedundantUpdateWaiterTests : public testing::Test
+{
+
+protected:
+
+  UpdatableState::Handle s1;
+  UpdatableState::Handle s2;
+
+  std::unique_ptr<RedundantUpdateWaiter> waiter;
+
+  RedundantUpdateWaiterTests ()
+  {
+    s1 = UpdatableState::Create ();
+    s2 = UpdatableState::Create ();
+
+    std::vector<std::unique_ptr<UpdateWaiter>> sources;
+    sources.push_back (s1->NewUpdateWaiter ());
+    sources.push_back (s2->NewUpdateWaiter ());
+
+    waiter = std::make_unique<RedundantUpdateWaiter> (
+        std::make_unique<UpdatableState::Notification> ("test"),
+        std::move (sources));
+    waiter->SetBackoff (std::chrono::milliseconds (10));
+  }
+
+  /**
+   * Calls WaitForUpdate and expects a successful result with
+   * the given state.
+   */
+  void
+  ExpectUpdate (const std::string& id, const std::string& value)
+  {
+    Json::Value state;
+    ASSERT_TRUE (waiter->WaitForUpdate (state));
+    EXPECT_EQ (state, UpdatableState::GetStateJson (id, value));
+  }
+
+};
+
+TEST_F (RedundantUpdateWaiterTests, NoUpdate)
+{
+  Json::Value state;
+  ASSERT_TRUE (waiter->WaitForUpdate (state));
+  EXPECT_TRUE (state.isNull ());
+}
+
+TEST_F (RedundantUpdateWaiterTests, FirstArrivalWins)
+{
+  s1->SetState ("a", "fast");
+  ExpectUpdate ("a", "fast");
+
+  /* The same state ID from the slower source is ignored.  */
+  s2->SetState ("a", "slow");
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+  s2->SetState ("b", "second");
+  ExpectUpdate ("b", "second");
+
+  s1->SetState ("b", "late");
+  s1->SetState ("c", "third");
+  ExpectUpdate ("c", "third");
+}
+
+TEST_F (RedundantUpdateWaiterTests, OneSourceFailing)
+{
+  s1->SetShouldFail (true);
+  s2->SetState ("a", "value");
+  ExpectUpdate ("a", "value");
+}
+
+TEST_F (RedundantUpdateWaiterTests, AllSourcesFailing)
+{
+  s1->SetShouldFail (true);
+  s2->SetShouldFail (true);
+
+  Json::Value state;
+  EXPECT_FALSE (waiter->WaitForUpdate (state));
+
+  s2->SetShouldFail (false);
+  s2->SetState ("a", "value");
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+  ExpectUpdate ("a", "value");
+}
+
+TEST_F (RedundantUpdateWaiterTests, LaggingSourceIgnored)
+{
+  /* The values are the heights of the states.  */
+  waiter->SetHeightFunction ([] (const size_t source, const Json::Value& state,
+                                 uint64_t& height)
+    {
+      const std::string value = state["value"].asString ();
+      if (value.empty ())
+        return false;
+      height = std::stoul (value);
+      return true;
+    });
+
+  s1->SetState ("a", "10");
+  ExpectUpdate ("a", "10");
+  s1->SetState ("b", "11");
+  ExpectUpdate ("b", "11");
+
+  /* A state below the current height is not forwarded, even if it is
+     not one of the recent IDs (e.g. from a lagging source that is far
+     behind or on another branch).  */
+  s2->SetState ("old", "9");
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+
+  /* States at the same height are forwarded, since they can be reorgs.  */
+  s2->SetState ("reorg", "11");
+  ExpectUpdate ("reorg", "11");
+
+  /* If the height cannot be determined, the state is ignored as well.  */
+  s2->SetState ("unknown", "");
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+
+  s1->SetState ("c", "12");
+  ExpectUpdate ("c", "12");
+}
+
+} // anonymous namespace
+} // namespace charon
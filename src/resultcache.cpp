@@ -0,0 +1,120 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "resultcache.hpp"
+
+#include <glog/logging.h>
+
+namespace charon
+{
+
+namespace
+{
+
+/** Memory tag for cached results.  */
+MemoryTag memCache("resultcache");
+
+} // anonymous namespace
+
+ResultCache::ResultCache (const size_t maxE)
+  : maxEntries(maxE)
+{
+  CHECK_GT (maxEntries, 0);
+}
+
+std::string
+ResultCache::GetKey (const std::string& method, const Json::Value& params)
+{
+  Json::StreamWriterBuilder wbuilder;
+  wbuilder["commentStyle"] = "None";
+  wbuilder["indentation"] = "";
+
+  /* The method name can not contain a newline (as it comes from an XML
+     element's text), so this is unambiguous.  */
+  return method + "\n" + Json::writeString (wbuilder, params);
+}
+
+void
+ResultCache::Store (const std::string& method, const Json::Value& params,
+                    const Json::Value& result)
+{
+  const std::string key = GetKey (method, params);
+
+  std::lock_guard<std::mutex> lock(mut);
+
+  auto mit = entries.find (key);
+  if (mit != entries.end ())
+    {
+      order.erase (mit->second.orderPos);
+      entries.erase (mit);
+    }
+
+  while (entries.size () >= maxEntries)
+    {
+      CHECK (!order.empty ());
+      entries.erase (order.front ());
+      order.pop_front ();
+    }
+
+  Entry e(memCache);
+  e.result = CompactJson (result);
+  /* The key is stored twice, in the map and the eviction order.  */
+  e.memory.Set (2 * key.size () + e.result.GetSize ());
+  e.orderPos = order.insert (order.end (), key);
+  entries.emplace (key, std::move (e));
+}
+
+bool
+ResultCache::Lookup (const std::string& method, const Json::Value& params,
+                     Json::Value& result) const
+{
+  const std::string key = GetKey (method, params);
+
+  CompactJson found;
+  {
+    std::lock_guard<std::mutex> lock(mut);
+
+    const auto mit = entries.find (key);
+    if (mit == entries.end ())
+      return false;
+
+    /* Copying the compact value just shares its buffer, so we can do
+       the (more expensive) decoding without holding the lock.  */
+    found = mit->second.result;
+  }
+
+  result = found.ToJson ();
+  return true;
+}
+
+void
+ResultCache::Clear ()
+{
+  std::lock_guard<std::mutex> lock(mut);
+  entries.clear ();
+  order.clear ();
+}
+
+size_t
+ResultCache::Size () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return entries.size ();
+}
+
+} // namespace charon
@@ -0,0 +1,123 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_RESULTCACHE_HPP
+#define CHARON_RESULTCACHE_HPP
+
+#include "compactjson.hpp"
+#include "memorytags.hpp"
+
+#include <json/json.h>
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace charon
+{
+
+/**
+ * A bounded, thread-safe cache of RPC results keyed by the method and
+ * its params.  When the cache is full, the least recently stored entry
+ * is evicted.
+ */
+class ResultCache
+{
+
+private:
+
+  /**
+   * Data stored for each cached call.
+   */
+  struct Entry
+  {
+
+    /** The cached result.  */
+    CompactJson result;
+
+    /** Position of the key in the eviction order.  */
+    std::list<std::string>::iterator orderPos;
+
+    /** Accounting of the memory used by this entry.  */
+    TrackedMemory memory;
+
+    explicit Entry (MemoryTag& tag)
+      : memory(tag)
+    {}
+
+  };
+
+  /** Maximum number of entries.  */
+  const size_t maxEntries;
+
+  /** Mutex for the internal state.  */
+  mutable std::mutex mut;
+
+  /** The cached entries by key.  */
+  std::unordered_map<std::string, Entry> entries;
+
+  /** Keys in the order they have been stored (oldest first).  */
+  std::list<std::string> order;
+
+public:
+
+  /**
+   * Constructs an empty cache that holds at most the given number of entries.
+   */
+  explicit ResultCache (size_t maxE);
+
+  ResultCache () = delete;
+  ResultCache (const ResultCache&) = delete;
+  void operator= (const ResultCache&) = delete;
+
+  /**
+   * Stores (or replaces) the result for the given call.
+   */
+  void Store (const std::string& method, const Json::Value& params,
+              const Json::Value& result);
+
+  /**
+   * Looks up the result for a given call.  Returns true and sets the result
+   * if one is found, and returns false otherwise.
+   */
+  bool Lookup (const std::string& method, const Json::Value& params,
+               Json::Value& result) const;
+
+  /**
+   * Removes all entries.
+   */
+  void Clear ();
+
+  /**
+   * Returns the number of entries in the cache.
+   */
+  size_t Size () const;
+
+  /**
+   * Returns the key string used internally for a given call.
+   */
+  static std::string GetKey (const std::string& method,
+                             const Json::Value& params);
+
+};
+
+} // namespace charon
+
+#endif // CHARON_RESULTCACHE_HPP
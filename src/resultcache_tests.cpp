@@ -0,0 +1,100 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "resultcache.hpp"
+
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+namespace charon
+{
+namespace
+{
+
+using ResultCacheTests = testing::Test;
+
+TEST_F (ResultCacheTests, StoreAndLookup)
+{
+  ResultCache cache(10);
+
+  Json::Value res;
+  EXPECT_FALSE (cache.Lookup ("foo", ParseJson ("[1]"), res));
+
+  cache.Store ("foo", ParseJson ("[1]"), ParseJson (R"({"a": 1})"));
+  cache.Store ("foo", ParseJson ("[2]"), ParseJson (R"({"a": 2})"));
+  cache.Store ("bar", ParseJson ("[1]"), ParseJson (R"({"b": 1})"));
+  EXPECT_EQ (cache.Size (), 3u);
+
+  ASSERT_TRUE (cache.Lookup ("foo", ParseJson ("[1]"), res));
+  EXPECT_EQ (res, ParseJson (R"({"a": 1})"));
+  ASSERT_TRUE (cache.Lookup ("foo", ParseJson ("[2]"), res));
+  EXPECT_EQ (res, ParseJson (R"({"a": 2})"));
+  ASSERT_TRUE (cache.Lookup ("bar", ParseJson ("[1]"), res));
+  EXPECT_EQ (res, ParseJson (R"({"b": 1})"));
+
+  EXPECT_FALSE (cache.Lookup ("bar", ParseJson ("[2]"), res));
+}
+
+TEST_F (ResultCacheTests, Replace)
+{
+  ResultCache cache(10);
+  cache.Store ("foo", ParseJson ("[]"), ParseJson ("1"));
+  cache.Store ("foo", ParseJson ("[]"), ParseJson ("2"));
+  EXPECT_EQ (cache.Size (), 1u);
+
+  Json::Value res;
+  ASSERT_TRUE (cache.Lookup ("foo", ParseJson ("[]"), res));
+  EXPECT_EQ (res, 2);
+}
+
+TEST_F (ResultCacheTests, Clear)
+{
+  ResultCache cache(10);
+  cache.Store ("foo", ParseJson ("[]"), ParseJson ("1"));
+  cache.Clear ();
+  EXPECT_EQ (cache.Size (), 0u);
+
+  Json::Value res;
+  EXPECT_FALSE (cache.Lookup ("foo", ParseJson ("[]"), res));
+}
+
+TEST_F (ResultCacheTests, KeyIgnoresFormatting)
+{
+  EXPECT_EQ (ResultCache::GetKey ("foo", ParseJson (R"({"a": 1, "b": 2})")),
+             ResultCache::GetKey ("foo", ParseJson (R"({ "b":2,"a":1 })")));
+  EXPECT_NE (ResultCache::GetKey ("foo", ParseJson ("[1]")),
+             ResultCache::GetKey ("bar", ParseJson ("[1]")));
+}
+
+TEST_F (ResultCacheTests, Eviction)
+{
+  ResultCache cache(2);
+  cache.Store ("foo", ParseJson ("[1]"), ParseJson ("1"));
+  cache.Store ("foo", ParseJson ("[2]"), ParseJson ("2"));
+  cache.Store ("foo", ParseJson ("[3]"), ParseJson ("3"));
+  EXPECT_EQ (cache.Size (), 2u);
+
+  Json::Value res;
+  EXPECT_FALSE (cache.Lookup ("foo", ParseJson ("[1]"), res));
+  EXPECT_TRUE (cache.Lookup ("foo", ParseJson ("[2]"), res));
+  EXPECT_TRUE (cache.Lookup ("foo", ParseJson ("[3]"), res));
+}
+
+} // anonymous namespace
+} // namespace charon
@@ -0,0 +1,145 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "resultpages.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+namespace charon
+{
+
+void
+ResultPages::Prune ()
+{
+  const auto now = Clock::now ();
+  for (auto it = entries.begin (); it != entries.end (); )
+    if (it->second.expiry <= now)
+      {
+        VLOG (1) << "Dropping expired result pages " << it->first;
+        it = entries.erase (it);
+      }
+    else
+      ++it;
+}
+
+std::string
+ResultPages::NewCursor ()
+{
+  while (true)
+    {
+      std::ostringstream out;
+      out << std::hex << std::setfill ('0')
+          << std::setw (16) << rnd () << std::setw (16) << rnd ();
+
+      const std::string res = out.str ();
+      if (entries.count (res) == 0)
+        return res;
+    }
+}
+
+std::string
+ResultPages::Split (const std::string& owner, Json::Value& result)
+{
+  if (!result.isArray () || result.size () <= pageSize)
+    return "";
+
+  std::lock_guard<std::mutex> lock(mut);
+  Prune ();
+
+  if (entries.size () >= maxEntries)
+    {
+      LOG (WARNING)
+          << "Result pages buffer is full, returning " << result.size ()
+          << " items for " << owner << " at once";
+      return "";
+    }
+
+  const std::string cursor = NewCursor ();
+  auto& e = entries[cursor];
+  e.owner = owner;
+  e.items = std::move (result);
+  e.released = pageSize;
+  e.expiry = Clock::now () + ttl;
+
+  /* The first page is returned with the call's response, so its items
+     are moved out right away.  */
+  result = Json::Value (Json::arrayValue);
+  for (Json::ArrayIndex i = 0; i < pageSize; ++i)
+    result.append (std::move (e.items[i]));
+  VLOG (1)
+      << "Split result of " << e.items.size () << " items for " << owner
+      << " into pages, cursor " << cursor;
+
+  return cursor;
+}
+
+bool
+ResultPages::Next (const std::string& owner, const std::string& cursor,
+                   const std::uint64_t offset, Json::Value& page,
+                   std::string& next)
+{
+  std::lock_guard<std::mutex> lock(mut);
+  Prune ();
+
+  const auto mit = entries.find (cursor);
+  if (mit == entries.end () || mit->second.owner != owner)
+    return false;
+
+  auto& e = mit->second;
+  const Json::ArrayIndex size = e.items.size ();
+  if (offset < e.released || offset >= size)
+    {
+      LOG (WARNING)
+          << "Invalid offset " << offset << " requested for result pages "
+          << cursor << " (released " << e.released << ", size " << size << ")";
+      return false;
+    }
+
+  /* The client has received everything before the requested offset.  */
+  for (; e.released < offset; ++e.released)
+    e.items[e.released] = Json::Value ();
+
+  const Json::ArrayIndex begin = offset;
+  const Json::ArrayIndex end = std::min<std::uint64_t> (offset + pageSize,
+                                                        size);
+  page = Json::Value (Json::arrayValue);
+  for (Json::ArrayIndex i = begin; i < end; ++i)
+    page.append (e.items[i]);
+
+  e.expiry = Clock::now () + ttl;
+  if (end >= size)
+    next.clear ();
+  else
+    next = cursor;
+
+  return true;
+}
+
+std::size_t
+ResultPages::Size () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return entries.size ();
+}
+
+} // namespace charon
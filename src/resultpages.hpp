@@ -0,0 +1,164 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_RESULTPAGES_HPP
+#define CHARON_RESULTPAGES_HPP
+
+#include <json/json.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+
+namespace charon
+{
+
+/**
+ * Short-lived server-side buffer for the remaining items of large array
+ * results.  Instead of sending a huge array in a single response, the
+ * server sends only its first page together with a cursor, and keeps the
+ * rest here until the client fetches it page by page with that cursor.
+ * This way, clients can start processing items early and need not hold
+ * the whole response stanza in memory at once.
+ *
+ * Pages are requested by the offset of their first item, so that a request
+ * can be repeated (e.g. if the response got lost) and yields the same page.
+ * Items before the requested offset are released, since the client has
+ * already received them.  After the last page, the result is kept until it
+ * expires, so that the last page can be requested again as well.
+ *
+ * Buffered results are bound to the client that requested them, and are
+ * dropped if they have not been accessed within the time-to-live.  The
+ * number of buffered results is bounded; if the buffer is full, results
+ * are not split and just returned in full.
+ *
+ * This class is thread-safe.
+ */
+class ResultPages
+{
+
+public:
+
+  /** Clock used for expiry.  */
+  using Clock = std::chrono::steady_clock;
+
+private:
+
+  /**
+   * Data for a buffered result.
+   */
+  struct Entry
+  {
+
+    /** The client to whom the result belongs.  */
+    std::string owner;
+
+    /**
+     * The full result array.  Items before the released index are set
+     * to null to free their memory.
+     */
+    Json::Value items;
+
+    /** Index of the first item that has not been released.  */
+    Json::ArrayIndex released;
+
+    /** Time when the entry expires if it is not accessed.  */
+    Clock::time_point expiry;
+
+  };
+
+  /** Maximum number of items per page.  */
+  const Json::ArrayIndex pageSize;
+
+  /** Time for which results are kept after the last access.  */
+  const Clock::duration ttl;
+
+  /** Maximum number of buffered results.  */
+  const std::size_t maxEntries;
+
+  /** Mutex for the internal state.  */
+  mutable std::mutex mut;
+
+  /** The buffered results by their cursor.  */
+  std::map<std::string, Entry> entries;
+
+  /** Random generator for the cursors.  */
+  std::mt19937_64 rnd;
+
+  /**
+   * Removes all expired entries.  The caller must hold the lock on mut.
+   */
+  void Prune ();
+
+  /**
+   * Returns a fresh random cursor.  The caller must hold the lock on mut.
+   */
+  std::string NewCursor ();
+
+
+public:
+
+  /**
+   * Constructs an empty buffer that splits results into pages of the given
+   * size, and keeps them for the given time-to-live after the last access.
+   */
+  template <typename Rep, typename Period>
+    explicit ResultPages (const std::size_t size,
+                          const std::chrono::duration<Rep, Period>& t,
+                          const std::size_t maxE)
+    : pageSize(size), ttl(std::chrono::duration_cast<Clock::duration> (t)),
+      maxEntries(maxE), rnd(std::random_device () ())
+  {}
+
+  ResultPages () = delete;
+  ResultPages (const ResultPages&) = delete;
+  void operator= (const ResultPages&) = delete;
+
+  /**
+   * Splits a result for the given client if it is an array with more items
+   * than fit on a page:  The rest is buffered, result is replaced by the
+   * first page, and the cursor for fetching the rest is returned.  If the
+   * result is not split, it is left as is and an empty string returned.
+   */
+  std::string Split (const std::string& owner, Json::Value& result);
+
+  /**
+   * Fetches the page starting at the given offset of a buffered result
+   * for the given client.  Returns false if there is no such result (e.g.
+   * because it expired or belongs to another client), or if the offset is
+   * invalid or refers to items that have already been released.  Otherwise,
+   * page is set to the items and next to the cursor for the remaining ones
+   * (or empty if this was the last page).
+   */
+  bool Next (const std::string& owner, const std::string& cursor,
+             std::uint64_t offset, Json::Value& page, std::string& next);
+
+  /**
+   * Returns the number of currently buffered results (for testing).
+   */
+  std::size_t Size () const;
+
+};
+
+} // namespace charon
+
+#endif // CHARON_RESULTPAGES_HPP
@@ -0,0 +1,216 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "resultpages.hpp"
+
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+namespace charon
+{
+namespace
+{
+
+using namespace std::chrono_literals;
+
+class ResultPagesTests : public testing::Test
+{
+
+protected:
+
+  /**
+   * Returns an array with the integers 0..n-1.
+   */
+  static Json::Value
+  MakeArray (const int n)
+  {
+    Json::Value res(Json::arrayValue);
+    for (int i = 0; i < n; ++i)
+      res.append (i);
+    return res;
+  }
+
+};
+
+TEST_F (ResultPagesTests, SmallResultNotSplit)
+{
+  ResultPages pages(3, 1h, 10);
+
+  Json::Value result = MakeArray (3);
+  EXPECT_EQ (pages.Split ("client", result), "");
+  EXPECT_EQ (result, MakeArray (3));
+
+  result = ParseJson (R"({"foo": [1, 2, 3, 4, 5]})");
+  EXPECT_EQ (pages.Split ("client", result), "");
+  EXPECT_EQ (result, ParseJson (R"({"foo": [1, 2, 3, 4, 5]})"));
+
+  EXPECT_EQ (pages.Size (), 0);
+}
+
+TEST_F (ResultPagesTests, FetchesAllPages)
+{
+  ResultPages pages(2, 1h, 10);
+
+  Json::Value result = MakeArray (5);
+  const auto cursor = pages.Split ("client", result);
+  ASSERT_NE (cursor, "");
+  EXPECT_EQ (result, ParseJson ("[0, 1]"));
+  EXPECT_EQ (pages.Size (), 1);
+
+  Json::Value page;
+  std::string next;
+  ASSERT_TRUE (pages.Next ("client", cursor, 2, page, next));
+  EXPECT_EQ (page, ParseJson ("[2, 3]"));
+  EXPECT_EQ (next, cursor);
+
+  ASSERT_TRUE (pages.Next ("client", next, 4, page, next));
+  EXPECT_EQ (page, ParseJson ("[4]"));
+  EXPECT_EQ (next, "");
+
+  /* The result is kept (until it expires), so that the last page can
+     be requested again.  */
+  EXPECT_EQ (pages.Size (), 1);
+}
+
+TEST_F (ResultPagesTests, RepeatedRequests)
+{
+  ResultPages pages(2, 1h, 10);
+
+  Json::Value result = MakeArray (7);
+  const auto cursor = pages.Split ("client", result);
+
+  Json::Value page;
+  std::string next;
+  ASSERT_TRUE (pages.Next ("client", cursor, 2, page, next));
+  EXPECT_EQ (page, ParseJson ("[2, 3]"));
+  ASSERT_TRUE (pages.Next ("client", cursor, 2, page, next));
+  EXPECT_EQ (page, ParseJson ("[2, 3]"));
+  EXPECT_EQ (next, cursor);
+
+  /* Offsets need not be at page boundaries.  */
+  ASSERT_TRUE (pages.Next ("client", cursor, 3, page, next));
+  EXPECT_EQ (page, ParseJson ("[3, 4]"));
+
+  ASSERT_TRUE (pages.Next ("client", cursor, 6, page, next));
+  EXPECT_EQ (page, ParseJson ("[6]"));
+  EXPECT_EQ (next, "");
+  ASSERT_TRUE (pages.Next ("client", cursor, 6, page, next));
+  EXPECT_EQ (page, ParseJson ("[6]"));
+  EXPECT_EQ (next, "");
+}
+
+TEST_F (ResultPagesTests, InvalidOffset)
+{
+  ResultPages pages(2, 1h, 10);
+
+  Json::Value result = MakeArray (7);
+  const auto cursor = pages.Split ("client", result);
+
+  Json::Value page;
+  std::string next;
+
+  /* The first page has been returned with the result already.  */
+  EXPECT_FALSE (pages.Next ("client", cursor, 0, page, next));
+  EXPECT_FALSE (pages.Next ("client", cursor, 1, page, next));
+
+  /* Beyond the end.  */
+  EXPECT_FALSE (pages.Next ("client", cursor, 7, page, next));
+  EXPECT_FALSE (pages.Next ("client", cursor, 1ull << 40, page, next));
+
+  /* Items before a requested offset are released.  */
+  ASSERT_TRUE (pages.Next ("client", cursor, 4, page, next));
+  EXPECT_FALSE (pages.Next ("client", cursor, 2, page, next));
+  EXPECT_TRUE (pages.Next ("client", cursor, 4, page, next));
+}
+
+TEST_F (ResultPagesTests, DistinctCursors)
+{
+  ResultPages pages(1, 1h, 10);
+
+  Json::Value first = MakeArray (2);
+  Json::Value second = MakeArray (3);
+  const auto c1 = pages.Split ("client", first);
+  const auto c2 = pages.Split ("client", second);
+  EXPECT_NE (c1, c2);
+
+  Json::Value page;
+  std::string next;
+  ASSERT_TRUE (pages.Next ("client", c2, 1, page, next));
+  EXPECT_EQ (page, ParseJson ("[1]"));
+  ASSERT_TRUE (pages.Next ("client", c1, 1, page, next));
+  EXPECT_EQ (page, ParseJson ("[1]"));
+  EXPECT_EQ (next, "");
+}
+
+TEST_F (ResultPagesTests, WrongOwner)
+{
+  ResultPages pages(1, 1h, 10);
+
+  Json::Value result = MakeArray (2);
+  const auto cursor = pages.Split ("client", result);
+
+  Json::Value page;
+  std::string next;
+  EXPECT_FALSE (pages.Next ("other", cursor, 1, page, next));
+  EXPECT_FALSE (pages.Next ("client", "invalid", 1, page, next));
+  EXPECT_TRUE (pages.Next ("client", cursor, 1, page, next));
+}
+
+TEST_F (ResultPagesTests, Expiry)
+{
+  ResultPages pages(1, 100ms, 10);
+
+  Json::Value result = MakeArray (3);
+  const auto cursor = pages.Split ("client", result);
+
+  /* Accessing the result extends its lifetime.  */
+  std::this_thread::sleep_for (60ms);
+  Json::Value page;
+  std::string next;
+  ASSERT_TRUE (pages.Next ("client", cursor, 1, page, next));
+  std::this_thread::sleep_for (60ms);
+  ASSERT_TRUE (pages.Next ("client", cursor, 2, page, next));
+  EXPECT_EQ (page, ParseJson ("[2]"));
+
+  result = MakeArray (3);
+  const auto other = pages.Split ("client", result);
+  std::this_thread::sleep_for (200ms);
+  EXPECT_FALSE (pages.Next ("client", other, 1, page, next));
+  EXPECT_FALSE (pages.Next ("client", cursor, 2, page, next));
+  EXPECT_EQ (pages.Size (), 0);
+}
+
+TEST_F (ResultPagesTests, Full)
+{
+  ResultPages pages(1, 1h, 1);
+
+  Json::Value result = MakeArray (2);
+  EXPECT_NE (pages.Split ("client", result), "");
+
+  result = MakeArray (2);
+  EXPECT_EQ (pages.Split ("client", result), "");
+  EXPECT_EQ (result, MakeArray (2));
+  EXPECT_EQ (pages.Size (), 1);
+}
+
+} // anonymous namespace
+} // namespace charon
@@ -18,19 +18,109 @@
 
 #include "rpcserver.hpp"
 
+#include "notifications.hpp"
+
 #include <jsonrpccpp/common/errors.h>
 
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <atomic>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 namespace charon
 {
 
-ForwardingRpcServer::ForwardingRpcServer (const std::string& url)
-  : http(url), target(http)
+namespace
+{
+
+/** Maximum number of last good results we keep for serving stale data.  */
+constexpr size_t MAX_STALE_RESULTS = 10000;
+
+/** Maximum number of results we cache for the current state.  */
+constexpr size_t MAX_FRESH_RESULTS = 10000;
+
+} // anonymous namespace
+
+bool
+IsBackendFailure (const RpcServer::Error& exc)
+{
+  switch (exc.GetCode ())
+    {
+    case jsonrpc::Errors::ERROR_CLIENT_CONNECTOR:
+    case jsonrpc::Errors::ERROR_CLIENT_INVALID_RESPONSE:
+      return true;
+
+    default:
+      return false;
+    }
+}
+
+constexpr size_t ForwardingRpcServer::MAX_TRACKED_PER_PREWARMED;
+
+ForwardingRpcServer::ForwardingRpcServer (const std::string& u)
+  : url(u), http(url), target(http), lastGood(MAX_STALE_RESULTS),
+    fresh(MAX_FRESH_RESULTS)
 {}
 
+ForwardingRpcServer::~ForwardingRpcServer ()
+{
+  if (!prewarmThread.joinable ())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutFresh);
+    stopPrewarming = true;
+    cvPrewarm.notify_all ();
+  }
+
+  prewarmThread.join ();
+}
+
+void
+ForwardingRpcServer::CheckAllowed (const std::string& method) const
+{
+  if (methods.count (method) == 0)
+    {
+      std::ostringstream msg;
+      msg << "method not found or not allowed: " << method;
+      throw Error (jsonrpc::Errors::ERROR_RPC_METHOD_NOT_FOUND, msg.str ());
+    }
+}
+
+Json::Value
+ForwardingRpcServer::CallBackend (const std::string& method,
+                                  const Json::Value& params)
+{
+  if (breaker != nullptr && !breaker->AllowRequest ())
+    {
+      VLOG (1) << "Circuit is open, failing call to " << method;
+      throw Error (jsonrpc::Errors::ERROR_CLIENT_CONNECTOR,
+                   "backend is unavailable");
+    }
+
+  try
+    {
+      Json::Value res = target.CallMethod (method, params);
+      if (breaker != nullptr)
+        breaker->RecordSuccess ();
+      return res;
+    }
+  catch (const Error& exc)
+    {
+      if (breaker != nullptr)
+        {
+          if (IsBackendFailure (exc))
+            breaker->RecordFailure ();
+          else
+            breaker->RecordSuccess ();
+        }
+      throw;
+    }
+}
+
 Json::Value
 ForwardingRpcServer::HandleMethod (const std::string& method,
                                    const Json::Value& params)
@@ -38,14 +128,190 @@ ForwardingRpcServer::HandleMethod (const std::string& method,
   VLOG (1) << "Attempted forwarding call to " << method;
   VLOG (2) << "Parameters: " << params;
 
-  if (methods.count (method) == 0)
+  CheckAllowed (method);
+
+  const bool cacheable = (hot != nullptr && prewarmMethods.count (method) > 0);
+  uint64_t gen = 0;
+  if (cacheable)
     {
-      std::ostringstream msg;
-      msg << "method not found or not allowed: " << method;
-      throw Error (jsonrpc::Errors::ERROR_RPC_METHOD_NOT_FOUND, msg.str ());
+      hot->Record (method, params);
+
+      Json::Value res;
+      std::lock_guard<std::mutex> lock(mutFresh);
+      gen = generation;
+      if (fresh.Lookup (method, params, res))
+        {
+          VLOG (1) << "Answering " << method << " from the cache";
+          return res;
+        }
+    }
+
+  Json::Value res = CallBackend (method, params);
+  if (staleMethods.count (method) > 0)
+    lastGood.Store (method, params, res);
+  if (cacheable)
+    StoreFresh (method, params, res, gen);
+
+  return res;
+}
+
+Json::Value
+ForwardingRpcServer::HandleMethodAllowStale (const std::string& method,
+                                             const Json::Value& params,
+                                             bool& stale)
+{
+  stale = false;
+  try
+    {
+      return HandleMethod (method, params);
+    }
+  catch (const Error& exc)
+    {
+      Json::Value res;
+      if (staleMethods.count (method) == 0 || !IsBackendFailure (exc)
+            || !lastGood.Lookup (method, params, res))
+        throw;
+
+      LOG (WARNING)
+          << "Backend is unavailable, serving stale result for " << method;
+      stale = true;
+      return res;
     }
+}
+
+void
+ForwardingRpcServer::StoreFresh (const std::string& method,
+                                 const Json::Value& params,
+                                 const Json::Value& result, const uint64_t gen)
+{
+  std::lock_guard<std::mutex> lock(mutFresh);
+  if (gen == generation)
+    fresh.Store (method, params, result);
+}
+
+void
+ForwardingRpcServer::HandleStateUpdate (const std::string& type,
+                                        const Json::Value& state)
+{
+  if (hot == nullptr || type != StateChangeNotification ().GetType ())
+    return;
+
+  std::lock_guard<std::mutex> lock(mutFresh);
+  ++generation;
+  fresh.Clear ();
+  cvPrewarm.notify_all ();
+}
+
+void
+ForwardingRpcServer::StartPrewarming ()
+{
+  CHECK (!prewarmThread.joinable ()) << "Pre-warming is already enabled";
+
+  prewarmThread = std::thread ([this] ()
+    {
+      std::unique_lock<std::mutex> lock(mutFresh);
+      while (true)
+        {
+          cvPrewarm.wait (lock, [this] ()
+            {
+              return stopPrewarming || generation != prewarmedGeneration;
+            });
+          if (stopPrewarming)
+            return;
+
+          /* If several updates came in while we were busy, only the
+             latest state is pre-warmed.  */
+          const uint64_t gen = generation;
+          lock.unlock ();
+          Prewarm (gen);
+          lock.lock ();
+
+          prewarmedGeneration = gen;
+          cvPrewarm.notify_all ();
+        }
+    });
+}
+
+void
+ForwardingRpcServer::WaitForPrewarming ()
+{
+  std::unique_lock<std::mutex> lock(mutFresh);
+  cvPrewarm.wait (lock, [this] ()
+    {
+      return prewarmedGeneration == generation;
+    });
+}
+
+void
+ForwardingRpcServer::Prewarm (const uint64_t gen)
+{
+  const auto queries = hot->GetTop (prewarmTop);
+  hot->Decay ();
+
+  if (queries.empty ())
+    return;
+  if (breaker != nullptr
+        && breaker->GetState () != CircuitBreaker::State::CLOSED)
+    {
+      VLOG (1) << "Backend is unavailable, not pre-warming";
+      return;
+    }
+
+  const auto deadline = std::chrono::steady_clock::now () + prewarmBudget;
+  std::atomic<size_t> next(0);
+  std::atomic<size_t> done(0);
+
+  /* Each worker uses its own connection, since the main one may be used
+     concurrently to answer client requests (and jsonrpc::Client is not
+     thread-safe).  */
+  const auto worker = [&] ()
+    {
+      jsonrpc::HttpClient conn(url);
+      if (backendTimeoutMs > 0)
+        conn.SetTimeout (backendTimeoutMs);
+      jsonrpc::Client client(conn);
+
+      while (std::chrono::steady_clock::now () < deadline)
+        {
+          /* Stop early if there is already a newer state.  */
+          {
+            std::lock_guard<std::mutex> lock(mutFresh);
+            if (gen != generation)
+              break;
+          }
+
+          const size_t idx = next++;
+          if (idx >= queries.size ())
+            break;
+
+          const auto& q = queries[idx];
+          try
+            {
+              const Json::Value res = client.CallMethod (q.method, q.params);
+              if (staleMethods.count (q.method) > 0)
+                lastGood.Store (q.method, q.params, res);
+              StoreFresh (q.method, q.params, res, gen);
+              ++done;
+            }
+          catch (const Error& exc)
+            {
+              VLOG (1)
+                  << "Pre-warming " << q.method << " failed: " << exc.what ();
+            }
+        }
+    };
+
+  const size_t numWorkers
+      = std::min<size_t> (std::max (prewarmConcurrency, 1u), queries.size ());
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < numWorkers; ++i)
+    workers.emplace_back (worker);
+  for (auto& w : workers)
+    w.join ();
 
-  return target.CallMethod (method, params);
+  VLOG (1)
+      << "Pre-warmed " << done.load () << " of " << queries.size ()
+      << " popular calls";
 }
 
 } // namespace charon
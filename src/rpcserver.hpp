@@ -19,13 +19,24 @@
 #ifndef CHARON_RPCSERVER_HPP
 #define CHARON_RPCSERVER_HPP
 
+#include "circuitbreaker.hpp"
+#include "hotqueries.hpp"
+#include "resultcache.hpp"
+
 #include <json/json.h>
 #include <jsonrpccpp/client.h>
 #include <jsonrpccpp/client/connectors/httpclient.h>
 #include <jsonrpccpp/common/exception.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <unordered_set>
 #include <string>
+#include <thread>
 
 namespace charon
 {
@@ -58,8 +69,41 @@ public:
   virtual Json::Value HandleMethod (const std::string& method,
                                     const Json::Value& params) = 0;
 
+  /**
+   * Answers a call like HandleMethod, but may return a possibly outdated
+   * result instead of an error (e.g. from a cache while the real backend
+   * is unavailable).  In that case, stale is set to true.
+   *
+   * By default, this just calls HandleMethod and never returns stale data.
+   */
+  virtual Json::Value
+  HandleMethodAllowStale (const std::string& method, const Json::Value& params,
+                          bool& stale)
+  {
+    stale = false;
+    return HandleMethod (method, params);
+  }
+
+  /**
+   * Called by the server when one of its notifications reports a new state
+   * (before the update is published to clients).  Implementations may use
+   * this to invalidate or refresh cached data.  Since publishing waits for
+   * this call, longer work should be done asynchronously.  By default,
+   * it does nothing.
+   */
+  virtual void
+  HandleStateUpdate (const std::string& type, const Json::Value& state)
+  {}
+
 };
 
+/**
+ * Returns true if the given error indicates a failure to talk to the
+ * backend itself (e.g. a connection error or timeout), as opposed to a
+ * JSON-RPC error returned by a working backend for the particular call.
+ */
+bool IsBackendFailure (const RpcServer::Error& exc);
+
 /**
  * Implementation of RpcServer that just forwards calls to a certain list
  * of "allowed" methods to another JSON-RPC endpoint, and answers all others
@@ -70,15 +114,122 @@ class ForwardingRpcServer : public RpcServer
 
 private:
 
+  /**
+   * Number of distinct calls tracked for popularity, relative to the number
+   * of calls that are pre-warmed.
+   */
+  static constexpr size_t MAX_TRACKED_PER_PREWARMED = 16;
+
+  /** URL of the backend, used to open extra connections for pre-warming.  */
+  const std::string url;
+
+  /** Timeout for backend calls in milliseconds (if set).  */
+  long backendTimeoutMs = 0;
+
   /** The list of allowed methods.  */
   std::unordered_set<std::string> methods;
 
+  /**
+   * Methods for which we keep the last good result, and serve it (marked
+   * as stale) while the backend is unavailable.
+   */
+  std::unordered_set<std::string> staleMethods;
+
   /** HTTP connector for the backend target.  */
   jsonrpc::HttpClient http;
 
   /** The RPC client we forward calls to.  */
   jsonrpc::Client target;
 
+  /** The circuit breaker for backend calls (if enabled).  */
+  std::unique_ptr<CircuitBreaker> breaker;
+
+  /** Last good results for the methods in staleMethods.  */
+  ResultCache lastGood;
+
+  /**
+   * Methods whose results only depend on the current game state.  If
+   * pre-warming is enabled, their results are cached until the next
+   * state update, and the most popular calls are evaluated right
+   * after each new state.
+   */
+  std::unordered_set<std::string> prewarmMethods;
+
+  /** Popularity tracker for pre-warming (null if disabled).  */
+  std::unique_ptr<HotQueries> hot;
+
+  /** Number of most popular calls that are pre-warmed.  */
+  size_t prewarmTop;
+
+  /** Number of parallel backend calls used for pre-warming.  */
+  unsigned prewarmConcurrency;
+
+  /** Time budget for pre-warming after each state update.  */
+  std::chrono::milliseconds prewarmBudget;
+
+  /** Results for the current state.  */
+  ResultCache fresh;
+
+  /**
+   * Mutex protecting the generation counter, and making sure no result
+   * from an old generation gets stored into the fresh cache.
+   */
+  std::mutex mutFresh;
+
+  /** Counter that is incremented on each state update.  */
+  uint64_t generation = 0;
+
+  /**
+   * Last generation for which pre-warming has finished.  This is protected
+   * by mutFresh as well.
+   */
+  uint64_t prewarmedGeneration = 0;
+
+  /** Set to true when the pre-warming thread should stop.  */
+  bool stopPrewarming = false;
+
+  /**
+   * Condition variable (with mutFresh) signalled when the generation
+   * changes or pre-warming for one has finished.
+   */
+  std::condition_variable cvPrewarm;
+
+  /**
+   * Thread that pre-warms the popular calls after each state update, so
+   * that publishing the update to clients is not delayed by it.
+   */
+  std::thread prewarmThread;
+
+  /**
+   * Throws the "method not found" error if the given method is not allowed.
+   */
+  void CheckAllowed (const std::string& method) const;
+
+  /**
+   * Performs the actual call to the backend, taking the circuit breaker
+   * into account (if enabled).
+   */
+  Json::Value CallBackend (const std::string& method,
+                           const Json::Value& params);
+
+  /**
+   * Stores a result into the fresh cache, if it was computed for the given
+   * generation and that is still the current one.
+   */
+  void StoreFresh (const std::string& method, const Json::Value& params,
+                   const Json::Value& result, uint64_t gen);
+
+  /**
+   * Evaluates the currently most popular calls against the backend and
+   * stores their results in the fresh cache for the given generation.
+   */
+  void Prewarm (uint64_t gen);
+
+  /**
+   * Starts the thread that runs the pre-warming.
+   */
+  void StartPrewarming ();
+
 public:
 
   /**
@@ -87,6 +238,8 @@ public:
    */
   explicit ForwardingRpcServer (const std::string& url);
 
+  ~ForwardingRpcServer ();
+
   /**
    * Allows the given method.
    */
@@ -96,8 +249,92 @@ public:
     methods.insert (method);
   }
 
+  /**
+   * Allows the given method and enables serving of stale results for it,
+   * i.e. the last good result for each params will be returned if the
+   * backend is not available.
+   */
+  void
+  AllowStaleResults (const std::string& method)
+  {
+    AllowMethod (method);
+    staleMethods.insert (method);
+  }
+
+  /**
+   * Sets the timeout for HTTP calls to the backend.
+   */
+  template <typename Rep, typename Period>
+    void
+    SetBackendTimeout (const std::chrono::duration<Rep, Period>& t)
+  {
+    backendTimeoutMs
+        = std::chrono::duration_cast<std::chrono::milliseconds> (t).count ();
+    http.SetTimeout (backendTimeoutMs);
+  }
+
+  /**
+   * Enables a circuit breaker for backend calls.  After the given number of
+   * consecutive failures to reach the backend, further calls fail fast
+   * until a probe call after the cooldown period succeeds.
+   */
+  template <typename Rep, typename Period>
+    void
+    EnableCircuitBreaker (const unsigned threshold,
+                          const std::chrono::duration<Rep, Period>& cooldown)
+  {
+    breaker = std::make_unique<CircuitBreaker> (threshold, cooldown);
+  }
+
+  /**
+   * Marks an allowed method as depending only on the current game state,
+   * so that its results can be cached and pre-warmed per state (if
+   * pre-warming is enabled).
+   */
+  void
+  AllowPrewarming (const std::string& method)
+  {
+    prewarmMethods.insert (method);
+  }
+
+  /**
+   * Enables pre-warming:  Calls to methods marked with AllowPrewarming are
+   * tracked by popularity, and right after each new game state, the top
+   * ones are evaluated against the backend (using up to concurrency
+   * parallel connections and for at most the given time budget).
+   * Their results are then served to clients until the next state update.
+   * This is done on a separate thread, so that the state update itself
+   * is not delayed.
+   *
+   * Only updates of the "state" notification invalidate the cached
+   * results, so this must only be enabled if the server has it.
+   */
+  template <typename Rep, typename Period>
+    void
+    EnablePrewarming (const size_t top, const unsigned concurrency,
+                      const std::chrono::duration<Rep, Period>& budget)
+  {
+    hot = std::make_unique<HotQueries> (MAX_TRACKED_PER_PREWARMED * top);
+    prewarmTop = top;
+    prewarmConcurrency = concurrency;
+    prewarmBudget
+        = std::chrono::duration_cast<std::chrono::milliseconds> (budget);
+    StartPrewarming ();
+  }
+
+  /**
+   * Blocks until pre-warming for the latest state update is done.  This
+   * is used in tests.
+   */
+  void WaitForPrewarming ();
+
   Json::Value HandleMethod (const std::string& method,
                             const Json::Value& params) override;
+  Json::Value HandleMethodAllowStale (const std::string& method,
+                                      const Json::Value& params,
+                                      bool& stale) override;
+  void HandleStateUpdate (const std::string& type,
+                          const Json::Value& state) override;
 
 };
 
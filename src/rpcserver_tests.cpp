@@ -27,6 +27,10 @@
 
 #include <glog/logging.h>
 
+#include <chrono>
+#include <memory>
+#include <thread>
+
 namespace charon
 {
 namespace
@@ -112,20 +116,30 @@ class ForwardingRpcServerTests : public testing::Test
 
 private:
 
-  TestBackendServer backend;
+  std::unique_ptr<TestBackendServer> backend;
 
 protected:
 
   ForwardingRpcServer server;
 
   ForwardingRpcServerTests ()
-    : server(RPC_URL)
+    : backend(std::make_unique<TestBackendServer> ()),
+      server(RPC_URL)
   {
-    server.AllowMethod ("echobypos");
+    server.AllowStaleResults ("echobypos");
     server.AllowMethod ("echobyname");
     server.AllowMethod ("error");
   }
 
+  /**
+   * Shuts down the test backend, so that further calls fail.
+   */
+  void
+  StopBackend ()
+  {
+    backend.reset ();
+  }
+
 };
 
 TEST_F (ForwardingRpcServerTests, PositionalArguments)
@@ -179,6 +193,85 @@ TEST_F (ForwardingRpcServerTests, MethodNotAllowed)
     }
 }
 
+TEST_F (ForwardingRpcServerTests, StaleResults)
+{
+  bool stale;
+  EXPECT_EQ (server.HandleMethodAllowStale ("echobypos", ParseJson ("[5]"),
+                                            stale), 5);
+  EXPECT_FALSE (stale);
+  EXPECT_EQ (server.HandleMethodAllowStale ("echobyname",
+                                            ParseJson (R"({"value": 10})"),
+                                            stale), 10);
+  EXPECT_FALSE (stale);
+
+  StopBackend ();
+
+  EXPECT_EQ (server.HandleMethodAllowStale ("echobypos", ParseJson ("[5]"),
+                                            stale), 5);
+  EXPECT_TRUE (stale);
+
+  EXPECT_THROW (server.HandleMethod ("echobypos", ParseJson ("[5]")),
+                RpcServer::Error);
+  EXPECT_THROW (server.HandleMethodAllowStale ("echobypos", ParseJson ("[6]"),
+                                               stale),
+                RpcServer::Error);
+  EXPECT_THROW (server.HandleMethodAllowStale ("echobyname",
+                                               ParseJson (R"({"value": 10})"),
+                                               stale),
+                RpcServer::Error);
+}
+
+TEST_F (ForwardingRpcServerTests, CircuitBreaker)
+{
+  server.EnableCircuitBreaker (2, std::chrono::milliseconds (50));
+  StopBackend ();
+
+  for (unsigned i = 0; i < 5; ++i)
+    try
+      {
+        server.HandleMethod ("echobyname", ParseJson (R"({"value": 10})"));
+        FAIL () << "Expected error not thrown";
+      }
+    catch (const RpcServer::Error& exc)
+      {
+        EXPECT_TRUE (IsBackendFailure (exc));
+      }
+
+  /* Once the backend is back, calls are let through again after
+     the cooldown period.  */
+  TestBackendServer restarted;
+  std::this_thread::sleep_for (std::chrono::milliseconds (100));
+  EXPECT_EQ (server.HandleMethod ("echobyname", ParseJson (R"({"value": 10})")),
+             10);
+}
+
+TEST_F (ForwardingRpcServerTests, Prewarming)
+{
+  server.AllowPrewarming ("echobypos");
+  server.EnablePrewarming (1, 2, std::chrono::seconds (1));
+
+  for (unsigned i = 0; i < 3; ++i)
+    EXPECT_EQ (server.HandleMethod ("echobypos", ParseJson ("[5]")), 5);
+  EXPECT_EQ (server.HandleMethod ("echobypos", ParseJson ("[6]")), 6);
+
+  /* Pending updates do not affect the cache.  */
+  server.HandleStateUpdate ("pending", ParseJson ("{}"));
+
+  /* After a new state, the most popular call is pre-warmed and can be
+     answered even without the backend, while the cache for others
+     is cleared.  */
+  server.HandleStateUpdate ("state", ParseJson ("{}"));
+  server.WaitForPrewarming ();
+  StopBackend ();
+  EXPECT_EQ (server.HandleMethod ("echobypos", ParseJson ("[5]")), 5);
+  EXPECT_THROW (server.HandleMethod ("echobypos", ParseJson ("[6]")),
+                RpcServer::Error);
+
+  server.HandleStateUpdate ("state", ParseJson ("{}"));
+  EXPECT_THROW (server.HandleMethod ("echobypos", ParseJson ("[5]")),
+                RpcServer::Error);
+}
+
 /* ************************************************************************** */
 
 } // anonymous namespace
@@ -59,4 +59,41 @@ RpcUpdateWaiter::ShortTimeout ()
   http.SetTimeout (50);
 }
 
+RpcBlockHeights::RpcBlockHeights (const std::string& url)
+  : http(url), target(http)
+{}
+
+bool
+RpcBlockHeights::GetHeight (const Json::Value& blockHash, uint64_t& height)
+{
+  Json::Value state;
+  try
+    {
+      state = target.CallMethod ("getnullstate", Json::Value ());
+    }
+  catch (const jsonrpc::JsonRpcException& exc)
+    {
+      LOG (WARNING) << "Failed to query backend for block height: "
+                    << exc.what ();
+      return false;
+    }
+
+  if (!state.isObject () || !state["height"].isUInt64 ())
+    {
+      LOG (WARNING) << "Invalid getnullstate response:\n" << state;
+      return false;
+    }
+
+  if (state["blockhash"] != blockHash)
+    {
+      VLOG (1)
+          << "Backend is at " << state["blockhash"] << " instead of "
+          << blockHash;
+      return false;
+    }
+
+  height = state["height"].asUInt64 ();
+  return true;
+}
+
 } // namespace charon
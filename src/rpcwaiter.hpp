@@ -25,6 +25,7 @@
 #include <jsonrpccpp/client.h>
 #include <jsonrpccpp/client/connectors/httpclient.h>
 
+#include <cstdint>
 #include <mutex>
 #include <string>
 
@@ -82,6 +83,40 @@ public:
 
 };
 
+/**
+ * Helper class that looks up the block height for a state returned by
+ * waitforchange (i.e. a block hash) on a GSP, through its getnullstate
+ * method.  This is used to order the states returned by replicas.
+ * Instances must not be used by multiple threads concurrently.
+ */
+class RpcBlockHeights
+{
+
+private:
+
+  /** HTTP connector for the backend.  */
+  jsonrpc::HttpClient http;
+
+  /** The RPC client for the backend.  */
+  jsonrpc::Client target;
+
+public:
+
+  explicit RpcBlockHeights (const std::string& url);
+
+  RpcBlockHeights () = delete;
+  RpcBlockHeights (const RpcBlockHeights&) = delete;
+  void operator= (const RpcBlockHeights&) = delete;
+
+  /**
+   * Looks up the height of the given block hash.  This fails if the call
+   * fails, or if the backend is no longer at that block (in which case
+   * the next waitforchange returns right away with the new one).
+   */
+  bool GetHeight (const Json::Value& blockHash, uint64_t& height);
+
+};
+
 } // namespace charon
 
 #endif // CHARON_RPCWAITER_HPP
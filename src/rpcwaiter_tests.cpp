@@ -62,6 +62,11 @@ private:
       const jsonrpc::Procedure proc("wait", jsonrpc::PARAMS_BY_POSITION,
                                     jsonrpc::JSON_STRING, nullptr);
       bindAndAddMethod (proc, &Implementation::wait);
+
+      const jsonrpc::Procedure nullState("getnullstate",
+                                         jsonrpc::PARAMS_BY_NAME,
+                                         jsonrpc::JSON_OBJECT, nullptr);
+      bindAndAddMethod (nullState, &Implementation::getnullstate);
     }
 
     void
@@ -76,6 +81,17 @@ private:
       res = "new state";
     }
 
+    void
+    getnullstate (const Json::Value& params, Json::Value& res)
+    {
+      res = ParseJson (R"({
+        "gameid": "test",
+        "blockhash": "new state",
+        "height": 42,
+        "state": "up-to-date"
+      })");
+    }
+
   };
 
   /** The underlying HTTP server connector.  */
@@ -161,5 +177,44 @@ TEST_F (RpcUpdateWaiterTests, ConcurrentCalls)
 
 /* ************************************************************************** */
 
+class RpcBlockHeightsTests : public testing::Test
+{
+
+private:
+
+  TestBackendServer backend;
+
+protected:
+
+  RpcBlockHeights heights;
+
+  RpcBlockHeightsTests ()
+    : heights(RPC_URL)
+  {}
+
+};
+
+TEST_F (RpcBlockHeightsTests, CurrentBlock)
+{
+  uint64_t height;
+  ASSERT_TRUE (heights.GetHeight ("new state", height));
+  EXPECT_EQ (height, 42);
+}
+
+TEST_F (RpcBlockHeightsTests, OtherBlock)
+{
+  uint64_t height;
+  EXPECT_FALSE (heights.GetHeight ("other state", height));
+}
+
+TEST_F (RpcBlockHeightsTests, CallFails)
+{
+  RpcBlockHeights unreachable("http://localhost:1");
+  uint64_t height;
+  EXPECT_FALSE (unreachable.GetHeight ("new state", height));
+}
+
+/* ************************************************************************** */
+
 } // anonymous namespace
 } // namespace charon
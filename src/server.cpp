@@ -18,19 +18,39 @@
 
 #include "server.hpp"
 
+#include "compactjson.hpp"
+#include "health.hpp"
+#include "idempotency.hpp"
+#include "notificationfilter.hpp"
 #include "private/pubsub.hpp"
 #include "private/stanzas.hpp"
+#include "resultpages.hpp"
+#include "trafficlog.hpp"
 #include "xmppclient.hpp"
 
+#include <gloox/error.h>
 #include <gloox/iq.h>
 #include <gloox/iqhandler.h>
 #include <gloox/message.h>
 #include <gloox/messagehandler.h>
 #include <gloox/presence.h>
+#include <gloox/presencehandler.h>
+
+#include <jsonrpccpp/common/errors.h>
 
 #include <glog/logging.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
 #include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
 
 /* Windows systems define a GetMessage macro, which makes this file fail to
    compile because of JsonRpcException::GetMessage.  We cannot rename the
@@ -45,10 +65,56 @@ namespace charon
 namespace
 {
 
+/**
+ * Time for which outcomes of requests with an ID are kept, so that retries
+ * of them can be answered without calling the backend again.  This should
+ * cover the typical total timeout of clients (including all retries).
+ */
+constexpr auto IDEMPOTENCY_WINDOW = std::chrono::seconds (30);
+
+/** Maximum number of requests kept in the idempotency memo.  */
+constexpr size_t IDEMPOTENCY_MAX_ENTRIES = 10'000;
+
+/**
+ * Maximum total size (estimated) of outcomes kept in the idempotency memo.
+ * Larger results are not memoised, so that a few huge results cannot tie
+ * up lots of memory for the whole window.
+ */
+constexpr size_t IDEMPOTENCY_MAX_BYTES = 64 << 20;
+
+/** Maximum number of results kept for paged responses at a time.  */
+constexpr size_t RESULT_PAGES_MAX_ENTRIES = 1'000;
+
+/**
+ * Maximum number of filter registrations being processed at the same time
+ * (each of them runs on its own thread).
+ */
+constexpr size_t MAX_FILTER_CALLS = 64;
+
+/** Maximum number of filtered streams per notification.  */
+constexpr size_t MAX_FILTERED_STREAMS = 1'000;
+
+/**
+ * Returns the size of the compact JSON serialisation of a value.  This is
+ * used for recording traffic.
+ */
+std::uint64_t
+GetJsonSize (const Json::Value& val)
+{
+  Json::StreamWriterBuilder wbuilder;
+  wbuilder["commentStyle"] = "None";
+  wbuilder["indentation"] = "";
+  return Json::writeString (wbuilder, val).size ();
+}
+
 /**
  * An enabled notification on the server.  This mostly wraps the corresponding
  * WaiterThread instance, but also has some more data like the pubsub node's
- * name for updates if the server is connected to XMPP.
+ * name for updates if the server is connected to XMPP.  Updates may be
+ * published to several pubsub services, each with its own node.
+ *
+ * Besides publishing to the pubsub node, updates can also be pushed
+ * directly to clients that registered for it (if enabled).
  */
 class ServerNotification
 {
@@ -58,15 +124,40 @@ private:
   /** The underlying WaiterThread doing most of the work.  */
   std::unique_ptr<WaiterThread> thread;
 
+  /** The backend, which is informed about state updates.  */
+  RpcServer& backend;
+
+  /** The XMPP client through which updates are pushed directly.  */
+  XmppClient& xmpp;
+
+  /**
+   * A PubSub service we publish our updates to.
+   */
+  struct Publication
+  {
+
+    /** The PubSubImpl instance for the service.  */
+    PubSubImpl* pubsub;
+
+    /** Our node on the service.  */
+    std::string node;
+
+  };
+
   /**
-   * The PubSubImpl we use to send notifications or null if the
-   * XMPP client is not connected and we are not sending out notifications
-   * for now.
+   * The PubSub services we use to send notifications, with the main one
+   * first.  This is empty if the XMPP client is not connected and we are
+   * not sending out notifications for now.  Filtered streams are only
+   * served on the main service.
    */
-  PubSubImpl* pubsub = nullptr;
+  std::vector<Publication> publications;
 
-  /** The PubSub node name (if any).  */
-  std::string node;
+  /**
+   * Counter incremented each time the main PubSub is connected.  This is
+   * used to detect if the PubSub instance has changed while we were
+   * creating a node on it without holding the lock.
+   */
+  unsigned pubsubGeneration = 0;
 
   /**
    * Mutex to lock this between the waiter thread's update handler
@@ -74,13 +165,155 @@ private:
    */
   std::mutex mut;
 
+  /**
+   * A filtered stream of this notification, which gets published to
+   * its own node for the clients that requested it.
+   */
+  struct FilteredStream
+  {
+
+    /** The filter applied to updates.  */
+    NotificationFilter filter;
+
+    /** The PubSub node for this stream.  */
+    std::string node;
+
+    /** Full JIDs of the clients using this stream.  */
+    std::set<std::string> users;
+
+    /** The last published view (null if none yet).  */
+    Json::Value lastView;
+
+  };
+
+  /** Active filtered streams, keyed by the filter's key.  */
+  std::map<std::string, FilteredStream> filtered;
+
+  /**
+   * Nodes of filtered streams that are no longer used, and will be deleted
+   * by the waiter thread's update handler (after it is done publishing).
+   */
+  std::vector<std::string> unusedNodes;
+
+  /**
+   * The latest state seen by the update handler, from which the initial
+   * view of newly created filtered streams is computed.
+   */
+  Json::Value filterState;
+
+  /** Server timestamp of when the backend returned filterState.  */
+  std::int64_t filterReceived = 0;
+
+  /**
+   * Mutex for the filtered streams.  This is always acquired after mut
+   * if both are needed.
+   */
+  std::mutex mutFiltered;
+
+  /**
+   * A client registered for direct push of the updates.
+   */
+  struct DirectUser
+  {
+
+    /** The filter to apply for this user (null if none).  */
+    std::unique_ptr<NotificationFilter> filter;
+
+    /**
+     * The last view pushed to the user (null if none yet).  This shares
+     * its buffer with all other users of the same filter.
+     */
+    CompactJson lastView;
+
+  };
+
+  /**
+   * The view of a state for one filter key, which is computed at most once
+   * per update and shared between all direct users with that filter.
+   */
+  struct DirectView
+  {
+
+    /** Whether the view has been computed yet.  */
+    bool computed = false;
+
+    /** The filtered view (unused for the unfiltered state).  */
+    Json::Value filtered;
+
+    /** The encoded view, which is compared to and stored for users.  */
+    CompactJson compact;
+
+    /** The payload for pushing the view (if created yet).  */
+    std::unique_ptr<gloox::Tag> payload;
+
+  };
+
+  /** Shared views for direct users of one update, by filter key.  */
+  using DirectViewCache = std::map<std::string, DirectView>;
+
+  /** Whether direct push is enabled.  */
+  std::atomic<bool> directEnabled{false};
+
+  /** Clients registered for direct push, by full JID.  */
+  std::map<std::string, DirectUser> directUsers;
+
+  /**
+   * The last state seen by the update handler (if direct push is enabled),
+   * so that it can be pushed to newly registered users.  We cannot ask the
+   * waiter thread for it, since the update handler holds the waiter's lock
+   * while waiting for the XMPP client's.
+   */
+  Json::Value lastState;
+
+  /** Server timestamp of when the backend returned lastState.  */
+  std::int64_t lastReceived = 0;
+
+  /**
+   * Mutex for the direct push state.  It is always acquired while holding
+   * the XMPP client's lock (i.e. inside RunWithClient), so that pushes
+   * are sent in the order the updates were processed.
+   */
+  std::mutex mutDirect;
+
+  /**
+   * Publishes the filtered views of a new state to their nodes, and
+   * deletes nodes that are no longer used.
+   */
+  void PublishFiltered (PubSubImpl& p, const Json::Value& data,
+                        std::int64_t received);
+
+  /**
+   * Pushes a new state to all clients registered for direct push.
+   */
+  void PushDirect (const Json::Value& data, std::int64_t received);
+
+  /**
+   * Sends the view of the given state for a direct user, if it changed
+   * from the last one sent.  Views and payloads are computed only once for
+   * all users with the same filter through the given cache.  Must be called
+   * with mutDirect held and access to the XMPP client.
+   */
+  void SendDirect (gloox::Client& c, const std::string& user, DirectUser& u,
+                   const Json::Value& data, std::int64_t received,
+                   DirectViewCache& cache);
+
+  /**
+   * Returns true if the given user may be added to the filtered stream
+   * with the given key, i.e. if no limits would be exceeded by that.
+   * Must be called with mutFiltered held.
+   */
+  bool CanAddFilterUser (const std::string& key,
+                         const std::string& user) const;
+
 public:
 
   /**
    * Constructs a new instance for the given WaiterThread.  This also sets
-   * up the update handler and starts the waiter thread.
+   * up the update handler and starts the waiter thread.  Updates are
+   * passed on to the backend's HandleStateUpdate before being published.
    */
-  explicit ServerNotification (std::unique_ptr<WaiterThread> t);
+  explicit ServerNotification (std::unique_ptr<WaiterThread> t,
+                               RpcServer& b, XmppClient& x);
 
   /**
    * Stops the waiter thread and cleans everything up.
@@ -92,29 +325,96 @@ public:
   void operator= (const ServerNotification&) = delete;
 
   /**
-   * Connects a PubSub implementation and starts publishing there.
+   * Connects a PubSub implementation and starts publishing there.  The first
+   * one connected is the main service, and further ones receive the
+   * same updates as alternatives.
    */
   void ConnectPubSub (PubSubImpl& p);
 
   /**
-   * Disconnects the PubSub instance and stops publishing updates.
+   * Disconnects all PubSub instances and stops publishing updates.
    */
   void DisconnectPubSub ();
 
   /**
-   * Returns the associated node string.
+   * Registers a user (full JID) of the filtered stream for the given filter,
+   * creating the stream and its PubSub node if needed.  Returns the node,
+   * or an empty string on failure.  This may wait for the PubSub service,
+   * so it must not be called from the XMPP receive thread.
+   */
+  std::string AddFilterUser (const NotificationFilter& f,
+                             const std::string& user);
+
+  /**
+   * Sends the current view of the filtered stream for the given filter
+   * directly to a user (if there is one yet).  This is used right after
+   * a registration, since the user would otherwise only get an update
+   * once the view changes.  Must be called with access to the XMPP client.
+   */
+  void SendFilteredView (gloox::Client& c, const std::string& user,
+                         const NotificationFilter& f);
+
+  /**
+   * Removes the given user from all filtered streams.  Streams that are no
+   * longer used are dropped, and their nodes deleted later on.
+   */
+  void RemoveFilterUser (const std::string& user);
+
+  /**
+   * Enables direct push for this notification.  This must be done before
+   * users are added, and must not be called from the update handler
+   * or while holding the XMPP client's lock.
+   */
+  void EnableDirectPush ();
+
+  /**
+   * Registers a user (full JID) for direct push of the updates, with the
+   * given filter (null for the full state).  The current state is sent
+   * to the user right away.  A previous registration of the same user
+   * is replaced.
+   */
+  void AddDirectUser (const std::string& user,
+                      std::unique_ptr<NotificationFilter> f);
+
+  /**
+   * Removes a user from direct push (if registered).
+   */
+  void RemoveDirectUser (const std::string& user);
+
+  /**
+   * Removes all users registered for direct push.
+   */
+  void ClearDirectUsers ();
+
+  /**
+   * Returns the underlying waiter thread.
+   */
+  const WaiterThread&
+  GetThread () const
+  {
+    return *thread;
+  }
+
+  /**
+   * Returns the associated node string on the main service.
    */
   const std::string&
   GetNode () const
   {
-    CHECK (pubsub != nullptr) << "PubSub is not connected";
-    return node;
+    CHECK (!publications.empty ()) << "PubSub is not connected";
+    return publications.front ().node;
   }
 
+  /**
+   * Returns our nodes on the alternative services, keyed by the service.
+   */
+  std::map<std::string, std::string> GetAlternativeNodes () const;
+
 };
 
-ServerNotification::ServerNotification (std::unique_ptr<WaiterThread> t)
-  : thread(std::move (t))
+ServerNotification::ServerNotification (std::unique_ptr<WaiterThread> t,
+                                        RpcServer& b, XmppClient& x)
+  : thread(std::move (t)), backend(b), xmpp(x)
 {
   thread->SetUpdateHandler ([this] (const Json::Value& data)
     {
@@ -122,6 +422,10 @@ ServerNotification::ServerNotification (std::unique_ptr<WaiterThread> t)
           << "Notifying update for " << thread->GetType ()
           << ":\n" << data;
 
+      /* Let the backend invalidate its caches (if any) before clients
+         get notified and start sending requests for the new state.  */
+      backend.HandleStateUpdate (thread->GetType (), data);
+
       /* Locking is a bit tricky here.  The Publish call below may block
          for some time, because it is waiting for the server response.
          If the XMPP client is disconnected in the mean time, the waiter
@@ -133,20 +437,43 @@ ServerNotification::ServerNotification (std::unique_ptr<WaiterThread> t)
          the data we need, and then process the data without keeping
          onto the lock.  */
 
-      PubSubImpl* p;
-      std::string n;
+      const auto received
+          = std::chrono::duration_cast<std::chrono::milliseconds> (
+              thread->GetReceivedTime ().time_since_epoch ()).count ();
+
+      {
+        std::lock_guard<std::mutex> lock(mutFiltered);
+        filterState = data;
+        filterReceived = received;
+      }
+
+      /* Direct pushes are only queued for sending on the XMPP stream and
+         do not wait for anything, so they go out first.  */
+      if (directEnabled)
+        PushDirect (data, received);
+
+      std::vector<Publication> pubs;
       {
         std::lock_guard<std::mutex> lock(mut);
-        p = pubsub;
-        n = node;
+        pubs = publications;
       }
 
-      if (p == nullptr)
+      if (pubs.empty ())
         return;
-      CHECK (!n.empty ());
 
-      const NotificationUpdate payload(thread->GetType (), data);
-      p->Publish (n, payload.CreateTag ());
+      /* Each Publish call waits for the response of its service.  We
+         publish to the main service (and the filtered streams on it)
+         first, and then to the alternatives in turn.  This keeps the order
+         of updates on each service without needing extra threads.  */
+      for (size_t i = 0; i < pubs.size (); ++i)
+        {
+          NotificationUpdate payload(thread->GetType (), data);
+          payload.SetTimestamps (received, GetTimestampMs ());
+          pubs[i].pubsub->Publish (pubs[i].node, payload.CreateTag ());
+
+          if (i == 0)
+            PublishFiltered (*pubs[i].pubsub, data, received);
+        }
     });
 
   thread->Start ();
@@ -158,18 +485,344 @@ ServerNotification::~ServerNotification ()
   thread->ClearUpdateHandler ();
 }
 
+void
+ServerNotification::PublishFiltered (PubSubImpl& p, const Json::Value& data,
+                                     const std::int64_t received)
+{
+  std::vector<std::pair<std::string, Json::Value>> views;
+  std::vector<std::string> toDelete;
+  {
+    std::lock_guard<std::mutex> lock(mutFiltered);
+
+    for (auto& entry : filtered)
+      {
+        auto& stream = entry.second;
+        Json::Value view = stream.filter.Apply (data);
+        if (view == stream.lastView)
+          continue;
+
+        stream.lastView = view;
+        views.emplace_back (stream.node, std::move (view));
+      }
+
+    toDelete.swap (unusedNodes);
+  }
+
+  /* The nodes we publish to can only be deleted by ourselves below,
+     so it is fine to do this without holding the lock.  */
+  for (const auto& v : views)
+    {
+      VLOG (1) << "Publishing filtered update to " << v.first;
+      NotificationUpdate payload(thread->GetType (), v.second);
+      payload.SetTimestamps (received, GetTimestampMs ());
+      p.Publish (v.first, payload.CreateTag ());
+    }
+
+  for (const auto& n : toDelete)
+    {
+      LOG (INFO) << "Deleting unused filtered node " << n;
+      p.DeleteNode (n);
+    }
+}
+
+void
+ServerNotification::SendDirect (
+    gloox::Client& c, const std::string& user, DirectUser& u,
+    const Json::Value& data, const std::int64_t received,
+    DirectViewCache& cache)
+{
+  const std::string key = (u.filter == nullptr ? "" : u.filter->GetKey ());
+
+  auto& v = cache[key];
+  const Json::Value& view = (u.filter == nullptr ? data : v.filtered);
+  if (!v.computed)
+    {
+      if (u.filter != nullptr)
+        v.filtered = u.filter->Apply (data);
+      v.compact = CompactJson (view);
+      v.computed = true;
+    }
+
+  if (v.compact == u.lastView)
+    return;
+  u.lastView = v.compact;
+
+  if (v.payload == nullptr)
+    {
+      NotificationUpdate upd(thread->GetType (), view);
+      upd.SetTimestamps (received, GetTimestampMs ());
+      v.payload = upd.CreateTag ();
+    }
+
+  VLOG (1) << "Pushing " << thread->GetType () << " update to " << user;
+  gloox::Message msg(gloox::Message::Normal, gloox::JID (user));
+  msg.addExtension (new PushedUpdate (*v.payload));
+  c.send (msg);
+}
+
+void
+ServerNotification::PushDirect (const Json::Value& data,
+                                const std::int64_t received)
+{
+  xmpp.RunWithClient ([&] (gloox::Client& c)
+    {
+      std::lock_guard<std::mutex> lock(mutDirect);
+      lastState = data;
+      lastReceived = received;
+
+      DirectViewCache cache;
+      for (auto& entry : directUsers)
+        SendDirect (c, entry.first, entry.second, data, received, cache);
+    });
+}
+
+void
+ServerNotification::EnableDirectPush ()
+{
+  directEnabled = true;
+
+  /* Updates from now on are recorded by the update handler.  In case there
+     was none yet since enabling, take over the waiter's current state.
+     This must be done without holding mutDirect.  */
+  const Json::Value current = thread->GetCurrentState ();
+  const auto received
+      = std::chrono::duration_cast<std::chrono::milliseconds> (
+          thread->GetReceivedTime ().time_since_epoch ()).count ();
+
+  std::lock_guard<std::mutex> lock(mutDirect);
+  if (lastState.isNull ())
+    {
+      lastState = current;
+      lastReceived = received;
+    }
+}
+
+void
+ServerNotification::AddDirectUser (const std::string& user,
+                                   std::unique_ptr<NotificationFilter> f)
+{
+  xmpp.RunWithClient ([&] (gloox::Client& c)
+    {
+      std::lock_guard<std::mutex> lock(mutDirect);
+      CHECK (directEnabled);
+
+      auto& u = directUsers[user];
+      u.filter = std::move (f);
+      u.lastView = CompactJson ();
+
+      if (!lastState.isNull ())
+        {
+          DirectViewCache cache;
+          SendDirect (c, user, u, lastState, lastReceived, cache);
+        }
+    });
+
+  LOG (INFO)
+      << "Pushing " << thread->GetType () << " notifications directly to "
+      << user;
+}
+
+void
+ServerNotification::RemoveDirectUser (const std::string& user)
+{
+  std::lock_guard<std::mutex> lock(mutDirect);
+  if (directUsers.erase (user) > 0)
+    VLOG (1) << "Stopped direct push to " << user;
+}
+
+void
+ServerNotification::ClearDirectUsers ()
+{
+  std::lock_guard<std::mutex> lock(mutDirect);
+  directUsers.clear ();
+}
+
+bool
+ServerNotification::CanAddFilterUser (const std::string& key,
+                                      const std::string& user) const
+{
+  size_t others = 0;
+  for (const auto& entry : filtered)
+    if (entry.second.users.count (user) > 0)
+      {
+        if (entry.first == key)
+          return true;
+        ++others;
+      }
+
+  if (others >= Server::MAX_FILTERS_PER_CLIENT)
+    {
+      LOG (WARNING)
+          << "Too many filtered " << thread->GetType ()
+          << " streams for " << user;
+      return false;
+    }
+
+  if (filtered.count (key) == 0 && filtered.size () >= MAX_FILTERED_STREAMS)
+    {
+      LOG (WARNING)
+          << "Too many filtered " << thread->GetType () << " streams";
+      return false;
+    }
+
+  return true;
+}
+
+std::string
+ServerNotification::AddFilterUser (const NotificationFilter& f,
+                                   const std::string& user)
+{
+  const std::string key = f.GetKey ();
+
+  {
+    std::lock_guard<std::mutex> lock(mutFiltered);
+    if (!CanAddFilterUser (key, user))
+      return "";
+    auto mit = filtered.find (key);
+    if (mit != filtered.end ())
+      {
+        mit->second.users.insert (user);
+        return mit->second.node;
+      }
+  }
+
+  PubSubImpl* p;
+  unsigned gen;
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    if (publications.empty ())
+      return "";
+    p = publications.front ().pubsub;
+    gen = pubsubGeneration;
+  }
+
+  /* Creating the node waits for the server, so we must not hold any of
+     the locks while doing so.  */
+  const std::string newNode = p->CreateNode ();
+  if (newNode.empty ())
+    return "";
+
+  std::lock_guard<std::mutex> lock(mut);
+  if (publications.empty () || pubsubGeneration != gen)
+    {
+      LOG (WARNING) << "PubSub changed while creating filtered node";
+      return "";
+    }
+
+  std::lock_guard<std::mutex> lockFiltered(mutFiltered);
+  if (!CanAddFilterUser (key, user))
+    {
+      unusedNodes.push_back (newNode);
+      return "";
+    }
+
+  auto res = filtered.emplace (key, FilteredStream ());
+  auto& stream = res.first->second;
+  if (res.second)
+    {
+      stream.filter = f;
+      stream.node = newNode;
+      /* The node itself gets the first update when the view changes,
+         while registered users are sent the current view directly.  */
+      if (!filterState.isNull ())
+        stream.lastView = f.Apply (filterState);
+      LOG (INFO)
+          << "Serving filtered " << thread->GetType ()
+          << " notifications for " << key << " on node " << newNode;
+    }
+  else
+    {
+      /* Someone else created the same stream concurrently.  */
+      unusedNodes.push_back (newNode);
+    }
+
+  stream.users.insert (user);
+  return stream.node;
+}
+
+void
+ServerNotification::SendFilteredView (gloox::Client& c,
+                                      const std::string& user,
+                                      const NotificationFilter& f)
+{
+  std::lock_guard<std::mutex> lock(mutFiltered);
+
+  const auto mit = filtered.find (f.GetKey ());
+  if (mit == filtered.end () || mit->second.lastView.isNull ())
+    return;
+
+  NotificationUpdate upd(thread->GetType (), mit->second.lastView);
+  upd.SetTimestamps (filterReceived, GetTimestampMs ());
+
+  VLOG (1)
+      << "Sending current filtered " << thread->GetType () << " to " << user;
+  gloox::Message msg(gloox::Message::Normal, gloox::JID (user));
+  msg.addExtension (new PushedUpdate (*upd.CreateTag ()));
+  c.send (msg);
+}
+
+void
+ServerNotification::RemoveFilterUser (const std::string& user)
+{
+  std::lock_guard<std::mutex> lock(mutFiltered);
+
+  for (auto it = filtered.begin (); it != filtered.end (); )
+    {
+      auto& stream = it->second;
+      stream.users.erase (user);
+      if (!stream.users.empty ())
+        {
+          ++it;
+          continue;
+        }
+
+      VLOG (1) << "Filtered stream " << it->first << " is no longer used";
+      unusedNodes.push_back (stream.node);
+      it = filtered.erase (it);
+    }
+}
+
 void
 ServerNotification::ConnectPubSub (PubSubImpl& p)
 {
   std::lock_guard<std::mutex> lock(mut);
 
-  CHECK (pubsub == nullptr) << "There is already a PubSub instance";
-  pubsub = &p;
+  for (const auto& pub : publications)
+    CHECK (pub.pubsub != &p) << "PubSub instance is already connected";
+
+  Publication pub;
+  pub.pubsub = &p;
+  pub.node = p.CreateNode ();
+
+  /* If an alternative service is not available, we just go on without it
+     (and do not advertise it).  */
+  if (pub.node.empty () && !publications.empty ())
+    {
+      LOG (WARNING)
+          << "Failed to create node for " << thread->GetType ()
+          << " at " << p.GetService ().full () << ", not using it";
+      return;
+    }
+
+  if (publications.empty ())
+    ++pubsubGeneration;
 
-  node = pubsub->CreateNode ();
   LOG (INFO)
       << "Serving notifications for " << thread->GetType ()
-      << " on PubSub node " << node;
+      << " on PubSub node " << pub.node
+      << " at " << p.GetService ().full ();
+
+  publications.push_back (std::move (pub));
+}
+
+std::map<std::string, std::string>
+ServerNotification::GetAlternativeNodes () const
+{
+  std::map<std::string, std::string> res;
+  for (size_t i = 1; i < publications.size (); ++i)
+    res.emplace (publications[i].pubsub->GetService ().full (),
+                 publications[i].node);
+  return res;
 }
 
 void
@@ -177,8 +830,15 @@ ServerNotification::DisconnectPubSub ()
 {
   std::lock_guard<std::mutex> lock(mut);
 
-  pubsub = nullptr;
-  node.clear ();
+  publications.clear ();
+
+  /* All nodes are deleted together with the PubSub instance, and clients
+     will register their filters again when they reselect a server.  */
+  {
+    std::lock_guard<std::mutex> lockFiltered(mutFiltered);
+    filtered.clear ();
+    unusedNodes.clear ();
+  }
 
   LOG (INFO) << "Stopped PubSub updates for " << thread->GetType ();
 }
@@ -193,11 +853,27 @@ ServerNotification::DisconnectPubSub ()
  */
 class Server::IqAnsweringClient : public XmppClient,
                                   private gloox::MessageHandler,
-                                  private gloox::IqHandler
+                                  private gloox::IqHandler,
+                                  private gloox::PresenceHandler
 {
 
 private:
 
+  /**
+   * A thread that processes a filter registration in the background
+   * (since it has to wait for the PubSub service).
+   */
+  struct FilterCall
+  {
+
+    /** The running thread.  */
+    std::thread thread;
+
+    /** Set to true when the thread is done (and can be joined).  */
+    std::atomic<bool> done{false};
+
+  };
+
   /** The server's version string.  */
   const std::string version;
 
@@ -217,10 +893,120 @@ private:
    */
   bool ready = false;
 
+  /** The backend health tracker, if health gating is enabled.  */
+  std::unique_ptr<BackendHealth> health;
+
+  /** Interval between the health checks.  */
+  std::chrono::milliseconds healthInterval;
+
+  /**
+   * Whether or not our current presence (as seen by the XMPP server)
+   * is available.  This is set to false when we withdraw because of
+   * the backend being unhealthy.
+   */
+  bool announcedHealthy = true;
+
+  /** Set to true when the health loop should stop.  */
+  bool stopHealthLoop;
+
+  /** Mutex for the health-gating state.  */
+  std::mutex mutHealth;
+  /** Condition variable signalled to stop the health loop.  */
+  std::condition_variable cvHealth;
+
+  /** The thread running periodic health checks (if enabled).  */
+  std::unique_ptr<std::thread> healthLoop;
+
+  /**
+   * Ongoing (or finished but not yet joined) filter registrations.  This is
+   * only accessed from the XMPP receive thread and the destructor.
+   */
+  std::list<std::unique_ptr<FilterCall>> filterCalls;
+
+  /**
+   * Capabilities negotiated with each client (by full JID), based on the
+   * last ping we received from them.  This is only accessed from the
+   * XMPP receive thread.
+   */
+  std::map<std::string, Capabilities> peerCapabilities;
+
+  /**
+   * Maximum number of clients that may register for direct push of
+   * notifications.  Zero means that direct push is disabled.
+   */
+  std::atomic<unsigned> maxDirectClients{0};
+
+  /** Full JIDs of the clients registered for direct push.  */
+  std::set<std::string> directClients;
+
+  /** Mutex for directClients.  */
+  std::mutex mutDirectClients;
+
+  /**
+   * Memo of recent requests with an ID, used to answer retries without
+   * executing the backend call again.
+   */
+  IdempotencyMemo memo;
+
+  /**
+   * If set, large array results are split into pages for clients that
+   * support it, with the remaining items buffered here.  This is set
+   * before connecting.
+   */
+  std::unique_ptr<ResultPages> pages;
+
+  /**
+   * If set, sampled requests are recorded to this traffic log.  This is set
+   * before connecting and then only used from the XMPP receive thread.
+   */
+  std::unique_ptr<TrafficRecorder> traffic;
+
+  /**
+   * Returns the negotiated capabilities for the given client.  If we have
+   * not seen a ping from them, this is the legacy set.
+   */
+  Capabilities GetPeerCapabilities (const gloox::JID& peer) const;
+
+  /**
+   * Returns true if the backend is currently healthy.  If health gating
+   * is not enabled, this always returns true.
+   */
+  bool IsHealthy () const;
+
   void handleMessage (const gloox::Message& msg,
                       gloox::MessageSession* session) override;
   bool handleIq (const gloox::IQ& iq) override;
   void handleIqID (const gloox::IQ& iq, int context) override;
+  void handlePresence (const gloox::Presence& p) override;
+
+  /**
+   * Processes a request for a filtered notification stream.  The actual
+   * work (and the reply) is done in a separate thread.
+   */
+  bool HandleFilterRegistration (const gloox::IQ& iq,
+                                 const FilterRegistration& req);
+
+  /**
+   * Joins and removes all finished filter registration threads.  If wait
+   * is true, then all threads are joined, even unfinished ones.
+   */
+  void JoinFilterCalls (bool wait);
+
+  /**
+   * Processes a registration of a client for direct push of notifications.
+   */
+  bool HandleDirectRegistration (const gloox::IQ& iq,
+                                 const DirectRegistration& req);
+
+  /**
+   * Removes a client from direct push of all notifications.
+   */
+  void RemoveDirectClient (const std::string& user);
+
+  /**
+   * Answers a request for the next page of a split result.
+   */
+  bool HandlePageRequest (const gloox::IQ& iq, const PageRequest& req);
 
 protected:
 
@@ -235,6 +1021,26 @@ public:
                               const gloox::JID& jid,
                               const std::string& password);
 
+  ~IqAnsweringClient ();
+
+  /**
+   * Sets the recorder for request traffic.
+   */
+  void
+  SetTrafficRecorder (std::unique_ptr<TrafficRecorder> rec)
+  {
+    traffic = std::move (rec);
+  }
+
+  /**
+   * Enables splitting of large array results into pages.
+   */
+  void
+  SetResultPages (std::unique_ptr<ResultPages> p)
+  {
+    pages = std::move (p);
+  }
+
   /**
    * Adds a new notification updater.  This starts the corresponding waiter
    * thread immediately, but only starts publishing to a PubSub once the
@@ -248,6 +1054,38 @@ public:
    */
   void ConnectNotifications ();
 
+  /**
+   * Adds an alternative pubsub service, to which all notifications are
+   * published in addition to the main one.
+   */
+  void AddAlternativePubSub (const gloox::JID& service);
+
+  /**
+   * Allows up to the given number of clients to register for direct push
+   * of the notifications.
+   */
+  void EnableDirectPush (unsigned maxClients);
+
+  /**
+   * Turns on health gating with the given parameters, and starts the
+   * thread that checks the health periodically.
+   */
+  void EnableHealthGating (unsigned maxFailures,
+                           std::chrono::milliseconds interval,
+                           std::chrono::milliseconds failureExpiry);
+
+  /**
+   * Sets the maximum staleness for a notification type.
+   */
+  void SetMaxStaleness (const std::string& type,
+                        std::chrono::milliseconds maxAge);
+
+  /**
+   * Evaluates the backend health and withdraws from or re-enters selection
+   * by clients (by sending the corresponding presence) if it changed.
+   */
+  void CheckHealth ();
+
   /**
    * Returns the pubsub node for the given notification type.  This is used
    * in testing.
@@ -260,7 +1098,9 @@ Server::IqAnsweringClient::IqAnsweringClient (const std::string& v,
                                               RpcServer& b,
                                               const gloox::JID& jid,
                                               const std::string& password)
-  : XmppClient(jid, password), version(v), backend(b)
+  : XmppClient(jid, password), version(v), backend(b),
+    memo(IDEMPOTENCY_WINDOW, IDEMPOTENCY_MAX_ENTRIES,
+         IDEMPOTENCY_MAX_BYTES)
 {
   RunWithClient ([this] (gloox::Client& c)
     {
@@ -269,12 +1109,49 @@ Server::IqAnsweringClient::IqAnsweringClient (const std::string& v,
       c.registerStanzaExtension (new PingMessage ());
       c.registerStanzaExtension (new PongMessage ());
       c.registerStanzaExtension (new SupportedNotifications ());
+      c.registerStanzaExtension (new FilterRegistration ());
+      c.registerStanzaExtension (new DirectRegistration ());
+      c.registerStanzaExtension (new PushedUpdate ());
+      c.registerStanzaExtension (new PageRequest ());
 
       c.registerMessageHandler (this);
+      c.registerPresenceHandler (this);
       c.registerIqHandler (this, RpcRequest::EXT_TYPE);
+      c.registerIqHandler (this, FilterRegistration::EXT_TYPE);
+      c.registerIqHandler (this, DirectRegistration::EXT_TYPE);
+      c.registerIqHandler (this, PageRequest::EXT_TYPE);
     });
 }
 
+Server::IqAnsweringClient::~IqAnsweringClient ()
+{
+  RunWithClient ([this] (gloox::Client& c)
+    {
+      c.removePresenceHandler (this);
+    });
+  JoinFilterCalls (true);
+
+  if (healthLoop != nullptr)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutHealth);
+        stopHealthLoop = true;
+        cvHealth.notify_all ();
+      }
+
+      healthLoop->join ();
+      healthLoop.reset ();
+    }
+}
+
+bool
+Server::IqAnsweringClient::IsHealthy () const
+{
+  if (health == nullptr)
+    return true;
+  return health->IsHealthy ();
+}
+
 void
 Server::IqAnsweringClient::handleMessage (const gloox::Message& msg,
                                           gloox::MessageSession* session)
@@ -287,26 +1164,46 @@ Server::IqAnsweringClient::handleMessage (const gloox::Message& msg,
       if (!ready)
         {
           LOG (WARNING)
-              << "Server is not ready yet, ignoring ping from "
+              << "Server is not ready yet, ignoring ping from "
+              << msg.from ().full ();
+          return;
+        }
+
+      if (!IsHealthy ())
+        {
+          LOG (WARNING)
+              << "Backend is not healthy, ignoring ping from "
               << msg.from ().full ();
           return;
         }
 
       LOG (INFO) << "Processing ping from " << msg.from ().full ();
 
+      const auto caps
+          = Capabilities::Own ().Intersect (ping->GetCapabilities ());
+      peerCapabilities[msg.from ().full ()] = caps;
+
       gloox::Presence response(gloox::Presence::Available, msg.from ());
-      response.addExtension (new PongMessage (version));
+      auto pong = std::make_unique<PongMessage> (version);
+      pong->SetTime (GetTimestampMs ());
+      pong->SetCapabilities (Capabilities::Own ());
+      response.addExtension (pong.release ());
 
       if (!notifications.empty ())
         {
           const auto service = GetPubSub ().GetService ().full ();
           auto notificationInfo
               = std::make_unique<SupportedNotifications> (service);
+          notificationInfo->SetDirect (maxDirectClients > 0);
 
           for (const auto& entry : notifications)
             {
               const auto& node = entry.second->GetNode ();
               notificationInfo->AddNotification (entry.first, node);
+
+              for (const auto& alt : entry.second->GetAlternativeNodes ())
+                notificationInfo->AddAlternative (alt.first, entry.first,
+                                                  alt.second);
             }
 
           response.addExtension (notificationInfo.release ());
@@ -324,6 +1221,21 @@ Server::IqAnsweringClient::handleIq (const gloox::IQ& iq)
 {
   LOG (INFO) << "Received IQ request from " << iq.from ().full ();
 
+  const auto* filterReq
+      = iq.findExtension<FilterRegistration> (FilterRegistration::EXT_TYPE);
+  if (filterReq != nullptr)
+    return HandleFilterRegistration (iq, *filterReq);
+
+  const auto* directReq
+      = iq.findExtension<DirectRegistration> (DirectRegistration::EXT_TYPE);
+  if (directReq != nullptr)
+    return HandleDirectRegistration (iq, *directReq);
+
+  const auto* pageReq
+      = iq.findExtension<PageRequest> (PageRequest::EXT_TYPE);
+  if (pageReq != nullptr)
+    return HandlePageRequest (iq, *pageReq);
+
   auto* req = iq.findExtension<RpcRequest> (RpcRequest::EXT_TYPE);
 
   /* The handler should only be called by gloox if it detects the extension,
@@ -342,17 +1254,102 @@ Server::IqAnsweringClient::handleIq (const gloox::IQ& iq)
       return false;
     }
 
+  const auto caps = GetPeerCapabilities (iq.from ());
+
+  std::unique_ptr<TrafficRecord> record;
+  const auto start = std::chrono::steady_clock::now ();
+  if (traffic != nullptr && traffic->Sample ())
+    {
+      record = std::make_unique<TrafficRecord> ();
+      record->timestamp = GetTimestampMs ();
+      record->method = req->GetMethod ();
+      record->params = req->GetParams ();
+      record->requestSize = GetJsonSize (record->params);
+    }
+
+  /* Clients that do not know about stale results would take them as
+     fresh, so they get the backend's error instead.  */
+  const bool allowStale = caps.Has (CAPABILITY_STALE);
+  const auto call = [this, req, allowStale] ()
+    {
+      CallOutcome res;
+      try
+        {
+          if (allowStale)
+            res.result = backend.HandleMethodAllowStale (req->GetMethod (),
+                                                         req->GetParams (),
+                                                         res.stale);
+          else
+            res.result = backend.HandleMethod (req->GetMethod (),
+                                               req->GetParams ());
+          res.success = true;
+
+          /* A stale result means the backend itself could not be reached,
+             so it counts as a failure for health purposes.  */
+          if (health != nullptr)
+            health->RecordCall (!res.stale);
+        }
+      catch (const RpcServer::Error& exc)
+        {
+          if (health != nullptr)
+            health->RecordCall (!IsBackendFailure (exc));
+
+          res.success = false;
+          res.transient = IsBackendFailure (exc);
+          res.errorCode = exc.GetCode ();
+          res.errorMessage = exc.GetMessage ();
+          res.errorData = exc.GetData ();
+        }
+      return res;
+    };
+
+  /* If the client sent a request ID, retries of the same request (with the
+     same ID) are answered from the memo instead of calling the backend
+     again.  The memo is keyed by the sender's bare JID and the ID, and
+     only matches if the method and parameters are the same as well.
+     Clients send retries from the same account.  */
+  CallOutcome outcome;
+  if (req->GetId ().empty ())
+    outcome = call ();
+  else
+    {
+      bool executed;
+      outcome = memo.Execute (iq.from ().bare (), req->GetId (),
+                              req->GetMethod (), req->GetParams (),
+                              call, executed);
+      if (!executed)
+        LOG (INFO) << "Answered retried request " << req->GetId ();
+    }
+
   std::unique_ptr<RpcResponse> result;
-  try
+  if (outcome.success)
     {
-      const Json::Value resultJson = backend.HandleMethod (req->GetMethod (),
-                                                           req->GetParams ());
-      result = std::make_unique<RpcResponse> (resultJson);
+      if (record != nullptr)
+        record->responseSize = GetJsonSize (outcome.result);
+
+      /* Large array results are sent in pages to clients that can fetch
+         the rest lazily.  */
+      std::string cursor;
+      if (pages != nullptr && caps.Has (CAPABILITY_PAGES))
+        cursor = pages->Split (iq.from ().bare (), outcome.result);
+
+      result = std::make_unique<RpcResponse> (outcome.result);
+      if (caps.Has (CAPABILITY_STALE))
+        result->SetStale (outcome.stale);
+      result->SetCursor (cursor);
     }
-  catch (const RpcServer::Error& exc)
+  else
     {
-      result = std::make_unique<RpcResponse> (exc.GetCode (), exc.GetMessage (),
-                                              exc.GetData ());
+      if (record != nullptr)
+        {
+          record->error = true;
+          record->responseSize = outcome.errorMessage.size ()
+                                    + GetJsonSize (outcome.errorData);
+        }
+
+      result = std::make_unique<RpcResponse> (outcome.errorCode,
+                                              outcome.errorMessage,
+                                              outcome.errorData);
     }
 
   /* We always return an IQ type of result, even if we have a JSON-RPC error.
@@ -360,6 +1357,15 @@ Server::IqAnsweringClient::handleIq (const gloox::IQ& iq)
      only returned for transport-related errors.  If the XMPP IQ itself was
      fine but the call failed, we return an IQ result with an embedded
      JSON-RPC error response.  */
+  if (record != nullptr)
+    {
+      record->duration
+          = std::chrono::duration_cast<std::chrono::microseconds> (
+              std::chrono::steady_clock::now () - start).count ();
+      traffic->Record (*record);
+    }
+
+  result->SetEncoding (caps.GetEncodingOptions ());
   gloox::IQ response(gloox::IQ::Result, iq.from (), iq.id ());
   response.addExtension (result.release ());
 
@@ -371,16 +1377,311 @@ Server::IqAnsweringClient::handleIq (const gloox::IQ& iq)
   return true;
 }
 
+Capabilities
+Server::IqAnsweringClient::GetPeerCapabilities (const gloox::JID& peer) const
+{
+  const auto mit = peerCapabilities.find (peer.full ());
+  if (mit == peerCapabilities.end ())
+    return Capabilities::Legacy ();
+  return mit->second;
+}
+
 void
 Server::IqAnsweringClient::handleIqID (const gloox::IQ& iq, const int context)
 {}
 
+bool
+Server::IqAnsweringClient::HandlePageRequest (const gloox::IQ& iq,
+                                              const PageRequest& req)
+{
+  if (!req.IsValid ())
+    {
+      LOG (WARNING) << "Ignoring invalid PageRequest stanza";
+      return false;
+    }
+
+  if (iq.subtype () != gloox::IQ::Get)
+    {
+      LOG (WARNING) << "Ignoring IQ of type " << iq.subtype ();
+      return false;
+    }
+
+  if (pages == nullptr)
+    {
+      LOG (WARNING) << "Ignoring page request, pagination is not enabled";
+      return false;
+    }
+
+  /* Like for calls, a cursor that is not (or no longer) known is reported
+     as JSON-RPC error inside an IQ result.  */
+  Json::Value page;
+  std::string next;
+  std::unique_ptr<RpcResponse> result;
+  if (pages->Next (iq.from ().bare (), req.GetCursor (), req.GetOffset (),
+                   page, next))
+    {
+      result = std::make_unique<RpcResponse> (page);
+      result->SetCursor (next);
+    }
+  else
+    {
+      LOG (WARNING)
+          << "Unknown result cursor " << req.GetCursor ()
+          << " (offset " << req.GetOffset () << ")"
+          << " requested by " << iq.from ().full ();
+      result = std::make_unique<RpcResponse> (
+          jsonrpc::Errors::ERROR_RPC_INTERNAL_ERROR,
+          "unknown or expired result cursor", Json::Value ());
+    }
+
+  result->SetEncoding (GetPeerCapabilities (iq.from ()).GetEncodingOptions ());
+  gloox::IQ response(gloox::IQ::Result, iq.from (), iq.id ());
+  response.addExtension (result.release ());
+
+  RunWithClient ([&response] (gloox::Client& c)
+    {
+      c.send (response);
+    });
+
+  return true;
+}
+
+bool
+Server::IqAnsweringClient::HandleFilterRegistration (
+    const gloox::IQ& iq, const FilterRegistration& req)
+{
+  if (!req.IsValid ())
+    {
+      LOG (WARNING) << "Ignoring invalid FilterRegistration stanza";
+      return false;
+    }
+
+  if (iq.subtype () != gloox::IQ::Get)
+    {
+      LOG (WARNING) << "Ignoring IQ of type " << iq.subtype ();
+      return false;
+    }
+
+  const auto mit = notifications.find (req.GetType ());
+  if (mit == notifications.end ())
+    {
+      LOG (WARNING)
+          << "Filter requested for unsupported notification " << req.GetType ();
+      return false;
+    }
+
+  NotificationFilter filter;
+  if (!filter.Parse (req.GetSpec ()))
+    {
+      LOG (WARNING) << "Invalid filter requested:\n" << req.GetSpec ();
+      return false;
+    }
+
+  JoinFilterCalls (false);
+  if (filterCalls.size () >= MAX_FILTER_CALLS)
+    {
+      LOG (WARNING)
+          << "Too many ongoing filter registrations, rejecting the one from "
+          << iq.from ().full ();
+      gloox::IQ response(gloox::IQ::Error, iq.from (), iq.id ());
+      response.addExtension (
+          new gloox::Error (gloox::StanzaErrorTypeWait,
+                            gloox::StanzaErrorResourceConstraint));
+      RunWithClient ([&response] (gloox::Client& c)
+        {
+          c.send (response);
+        });
+      return true;
+    }
+
+  auto call = std::make_unique<FilterCall> ();
+  auto* callPtr = call.get ();
+  auto* n = mit->second.get ();
+  const std::string type = req.GetType ();
+  const gloox::JID from = iq.from ();
+  const std::string id = iq.id ();
+
+  call->thread = std::thread ([this, callPtr, n, filter, type, from, id] ()
+    {
+      const std::string node = n->AddFilterUser (filter, from.full ());
+
+      if (node.empty ())
+        {
+          gloox::IQ response(gloox::IQ::Error, from, id);
+          response.addExtension (
+              new gloox::Error (gloox::StanzaErrorTypeWait,
+                                gloox::StanzaErrorInternalServerError));
+          RunWithClient ([&response] (gloox::Client& c)
+            {
+              c.send (response);
+            });
+        }
+      else
+        {
+          gloox::IQ response(gloox::IQ::Result, from, id);
+          response.addExtension (new FilterRegistration (type, node));
+          RunWithClient ([&response, n, &from, &filter] (gloox::Client& c)
+            {
+              c.send (response);
+              n->SendFilteredView (c, from.full (), filter);
+            });
+        }
+
+      callPtr->done = true;
+    });
+  filterCalls.push_back (std::move (call));
+
+  return true;
+}
+
+void
+Server::IqAnsweringClient::JoinFilterCalls (const bool wait)
+{
+  for (auto it = filterCalls.begin (); it != filterCalls.end (); )
+    {
+      if (!wait && !(*it)->done)
+        {
+          ++it;
+          continue;
+        }
+
+      (*it)->thread.join ();
+      it = filterCalls.erase (it);
+    }
+}
+
+bool
+Server::IqAnsweringClient::HandleDirectRegistration (
+    const gloox::IQ& iq, const DirectRegistration& req)
+{
+  if (!req.IsValid ())
+    {
+      LOG (WARNING) << "Ignoring invalid DirectRegistration stanza";
+      return false;
+    }
+
+  if (iq.subtype () != gloox::IQ::Set)
+    {
+      LOG (WARNING) << "Ignoring IQ of type " << iq.subtype ();
+      return false;
+    }
+
+  const std::string user = iq.from ().full ();
+
+  std::map<ServerNotification*, std::unique_ptr<NotificationFilter>> filters;
+  for (const auto& entry : req.GetNotifications ())
+    {
+      const auto mit = notifications.find (entry.first);
+      if (mit == notifications.end ())
+        {
+          LOG (WARNING)
+              << "Direct push requested for unsupported notification "
+              << entry.first;
+          return false;
+        }
+
+      std::unique_ptr<NotificationFilter> filter;
+      if (!entry.second.isNull ())
+        {
+          filter = std::make_unique<NotificationFilter> ();
+          if (!filter->Parse (entry.second))
+            {
+              LOG (WARNING) << "Invalid filter requested:\n" << entry.second;
+              return false;
+            }
+        }
+
+      filters.emplace (mit->second.get (), std::move (filter));
+    }
+
+  bool accepted;
+  {
+    std::lock_guard<std::mutex> lock(mutDirectClients);
+    accepted = directClients.count (user) > 0
+                  || directClients.size () < maxDirectClients;
+    if (accepted)
+      directClients.insert (user);
+  }
+
+  if (!accepted)
+    {
+      LOG (WARNING)
+          << "Refusing direct push to " << user
+          << ", the maximum number of clients is reached";
+
+      gloox::IQ response(gloox::IQ::Error, iq.from (), iq.id ());
+      response.addExtension (
+          new gloox::Error (gloox::StanzaErrorTypeWait,
+                            gloox::StanzaErrorResourceConstraint));
+      RunWithClient ([&response] (gloox::Client& c)
+        {
+          c.send (response);
+        });
+      return true;
+    }
+
+  /* A new registration replaces the previous one (if any) completely.  */
+  for (auto& n : notifications)
+    n.second->RemoveDirectUser (user);
+  for (auto& entry : filters)
+    entry.first->AddDirectUser (user, std::move (entry.second));
+
+  gloox::IQ response(gloox::IQ::Result, iq.from (), iq.id ());
+  response.addExtension (new DirectRegistration ());
+  RunWithClient ([&response] (gloox::Client& c)
+    {
+      c.send (response);
+    });
+
+  return true;
+}
+
+void
+Server::IqAnsweringClient::RemoveDirectClient (const std::string& user)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutDirectClients);
+    if (directClients.erase (user) == 0)
+      return;
+  }
+
+  LOG (INFO) << "Client " << user << " left direct push";
+  for (auto& n : notifications)
+    n.second->RemoveDirectUser (user);
+}
+
+void
+Server::IqAnsweringClient::handlePresence (const gloox::Presence& p)
+{
+  if (p.subtype () != gloox::Presence::Unavailable)
+    return;
+
+  /* Clients that go away no longer need their filtered streams, direct
+     pushes or negotiated capabilities.  */
+  const std::string user = p.from ().full ();
+  peerCapabilities.erase (user);
+  RemoveDirectClient (user);
+  for (auto& n : notifications)
+    n.second->RemoveFilterUser (user);
+}
+
 void
 Server::IqAnsweringClient::HandleDisconnect ()
 {
   ready = false;
+
+  /* Clients register for direct push again when they reselect us
+     after we reconnected.  */
+  {
+    std::lock_guard<std::mutex> lock(mutDirectClients);
+    directClients.clear ();
+  }
+
   for (auto& n : notifications)
-    n.second->DisconnectPubSub ();
+    {
+      n.second->ClearDirectUsers ();
+      n.second->DisconnectPubSub ();
+    }
 }
 
 void
@@ -388,20 +1689,130 @@ Server::IqAnsweringClient::AddNotification (std::unique_ptr<WaiterThread> upd)
 {
   const auto type = upd->GetType ();
 
-  auto notifier = std::make_unique<ServerNotification> (std::move (upd));
+  auto notifier = std::make_unique<ServerNotification> (std::move (upd),
+                                                       backend, *this);
+  if (maxDirectClients > 0)
+    notifier->EnableDirectPush ();
   if (IsConnected ())
-    notifier->ConnectPubSub (GetPubSub ());
+    for (auto* p : GetAllPubSubs ())
+      notifier->ConnectPubSub (*p);
 
   const auto res = notifications.emplace (type, std::move (notifier));
   CHECK (res.second) << "Duplicate notification: " << type;
+
+  if (health != nullptr)
+    health->AddWaiter (res.first->second->GetThread ());
 }
 
 void
 Server::IqAnsweringClient::ConnectNotifications ()
 {
+  const auto pubsubs = GetAllPubSubs ();
   for (auto& n : notifications)
-    n.second->ConnectPubSub (GetPubSub ());
+    for (auto* p : pubsubs)
+      n.second->ConnectPubSub (*p);
   ready = true;
+
+  /* After (re)connecting, gloox has sent our initial available presence.
+     Make sure to withdraw right away if the backend is not healthy.  */
+  {
+    std::lock_guard<std::mutex> lock(mutHealth);
+    announcedHealthy = true;
+  }
+  CheckHealth ();
+}
+
+void
+Server::IqAnsweringClient::AddAlternativePubSub (const gloox::JID& service)
+{
+  AddExtraPubSub (service);
+
+  if (IsConnected ())
+    {
+      auto& p = *GetAllPubSubs ().back ();
+      for (auto& n : notifications)
+        n.second->ConnectPubSub (p);
+    }
+}
+
+void
+Server::IqAnsweringClient::EnableDirectPush (const unsigned maxClients)
+{
+  CHECK_GT (maxClients, 0u);
+  CHECK_EQ (maxDirectClients.load (), 0u)
+      << "Direct push is already enabled";
+
+  maxDirectClients = maxClients;
+  for (auto& n : notifications)
+    n.second->EnableDirectPush ();
+}
+
+void
+Server::IqAnsweringClient::EnableHealthGating (
+    const unsigned maxFailures, const std::chrono::milliseconds interval,
+    const std::chrono::milliseconds failureExpiry)
+{
+  CHECK (health == nullptr) << "Health gating is already enabled";
+
+  health = std::make_unique<BackendHealth> (maxFailures, failureExpiry);
+  for (const auto& n : notifications)
+    health->AddWaiter (n.second->GetThread ());
+
+  healthInterval = interval;
+  stopHealthLoop = false;
+  healthLoop = std::make_unique<std::thread> ([this] ()
+    {
+      std::unique_lock<std::mutex> lock(mutHealth);
+      while (!stopHealthLoop)
+        {
+          lock.unlock ();
+          CheckHealth ();
+          lock.lock ();
+
+          cvHealth.wait_for (lock, healthInterval);
+        }
+    });
+}
+
+void
+Server::IqAnsweringClient::SetMaxStaleness (
+    const std::string& type, const std::chrono::milliseconds maxAge)
+{
+  CHECK (health != nullptr) << "Health gating is not enabled";
+  health->SetMaxStaleness (type, maxAge);
+}
+
+void
+Server::IqAnsweringClient::CheckHealth ()
+{
+  if (health == nullptr)
+    return;
+
+  const bool healthy = health->IsHealthy ();
+
+  std::lock_guard<std::mutex> lock(mutHealth);
+  if (!IsConnected () || !ready || healthy == announcedHealthy)
+    return;
+
+  /* We send a broadcast presence without changing the client's own presence
+     data, so that gloox will still announce us as available when we
+     reconnect later on.  An unavailable resource does not receive messages
+     sent to the bare JID (i.e. pings), and clients that have selected us
+     get notified through their directed presence.  */
+  RunWithClient ([healthy] (gloox::Client& c)
+    {
+      const auto type = healthy ? gloox::Presence::Available
+                                : gloox::Presence::Unavailable;
+      gloox::Presence pres(type, gloox::JID (), "", c.presence ().priority ());
+      c.send (pres);
+    });
+
+  if (healthy)
+    LOG (INFO) << "Backend is healthy again, rejoining server selection";
+  else
+    LOG (WARNING) << "Backend is unhealthy, withdrawing from server selection";
+
+  announcedHealthy = healthy;
 }
 
 const std::string&
@@ -425,11 +1836,16 @@ Server::~Server () = default;
 void
 Server::AddPubSub (const std::string& service)
 {
-  CHECK (!hasPubSub);
-
   const gloox::JID serviceJid(service);
-  client->AddPubSub (serviceJid);
 
+  if (hasPubSub)
+    {
+      LOG (INFO) << "Adding alternative pubsub service " << service;
+      client->AddAlternativePubSub (serviceJid);
+      return;
+    }
+
+  client->AddPubSub (serviceJid);
   hasPubSub = true;
 }
 
@@ -440,12 +1856,67 @@ Server::AddNotification (std::unique_ptr<WaiterThread> upd)
   client->AddNotification (std::move (upd));
 }
 
+void
+Server::EnableDirectPush (const unsigned maxClients)
+{
+  CHECK (hasPubSub);
+  client->EnableDirectPush (maxClients);
+}
+
+void
+Server::EnableHealthGating (const unsigned maxFailures,
+                            const std::chrono::milliseconds interval,
+                            const std::chrono::milliseconds failureExpiry)
+{
+  client->EnableHealthGating (maxFailures, interval, failureExpiry);
+}
+
+void
+Server::EnablePagination (const unsigned pageSize,
+                          const std::chrono::milliseconds ttl)
+{
+  CHECK_GT (pageSize, 0u);
+  client->SetResultPages (std::make_unique<ResultPages> (
+      pageSize, ttl, RESULT_PAGES_MAX_ENTRIES));
+}
+
+void
+Server::RecordTraffic (std::unique_ptr<TrafficRecorder> rec)
+{
+  client->SetTrafficRecorder (std::move (rec));
+}
+
+void
+Server::SetMaxStaleness (const std::string& type,
+                         const std::chrono::milliseconds maxAge)
+{
+  client->SetMaxStaleness (type, maxAge);
+}
+
 void
 Server::SetRootCA (const std::string& path)
 {
   client->SetRootCA (path);
 }
 
+void
+Server::SetStreamCompression (const bool enable)
+{
+  client->SetStreamCompression (enable);
+}
+
+StreamStatistics
+Server::GetStreamStatistics ()
+{
+  return client->GetStreamStatistics ();
+}
+
+Json::Value
+Server::GetConnectStats () const
+{
+  return client->GetConnectStats ();
+}
+
 bool
 Server::Connect (const int priority)
 {
@@ -22,6 +22,9 @@
 #include "rpcserver.hpp"
 #include "waiterthread.hpp"
 
+#include <json/json.h>
+
+#include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <string>
@@ -30,6 +33,9 @@
 namespace charon
 {
 
+struct StreamStatistics;
+class TrafficRecorder;
+
 /**
  * The main Charon server:  This is the component that listens for IQ requests
  * over XMPP and answers them through some backing RpcServer instance.
@@ -62,6 +68,13 @@ public:
 
   class ReconnectLoop;
 
+  /**
+   * Maximum number of filtered streams (across all its filters) a single
+   * client may use for one notification.  Further registrations are
+   * rejected, and the client falls back to the full stream for them.
+   */
+  static constexpr unsigned MAX_FILTERS_PER_CLIENT = 8;
+
   explicit Server (const std::string& version, RpcServer& backend,
                    const std::string& jid, const std::string& password);
   ~Server ();
@@ -72,7 +85,12 @@ public:
 
   /**
    * Adds a pubsub service that can be used for notifications on the XMPP
-   * server we are connected to.
+   * server we are connected to.  This can be called several times:  The
+   * first service is the main one, and all notifications are published to
+   * the others as well, so that the fan-out to subscribers is shared among
+   * them (e.g. between pubsub components of different XMPP clusters).  All
+   * services are advertised to clients, which subscribe on the one they
+   * prefer.  Filtered streams are only offered on the main service.
    */
   void AddPubSub (const std::string& service);
 
@@ -86,11 +104,86 @@ public:
    */
   void AddNotification (std::unique_ptr<WaiterThread> upd);
 
+  /**
+   * Lets clients register for direct push of the notifications:  Updates
+   * are then sent as messages to their full JIDs, instead of going through
+   * the pubsub service.  This saves a hop and the work of the pubsub
+   * service, but makes the server send one message per client, so it is
+   * meant for a moderate number of clients.  Registrations beyond the given
+   * maximum are refused, and those clients use the pubsub nodes instead.
+   * Clients are unregistered when they send unavailable presence to us.
+   *
+   * This must only be called after AddPubSub (the pubsub nodes are still
+   * used for other clients) and at most once.
+   */
+  void EnableDirectPush (unsigned maxClients);
+
+  /**
+   * Enables health gating:  The server will then regularly (with the given
+   * interval) assess the health of its backend.  While it is unhealthy,
+   * the server withdraws from selection by clients, i.e. it ignores pings
+   * and sends unavailable presence.  When the backend recovers, the server
+   * becomes available again automatically.
+   *
+   * The backend is considered unhealthy if maxFailures forwarded calls
+   * in a row failed to reach it (until failureExpiry has passed since
+   * the last of them, so that the server can try again), if one of the
+   * notification waiters is backing off after failed calls, or if the state
+   * of a notification is older than configured with SetMaxStaleness.
+   */
+  void EnableHealthGating (unsigned maxFailures,
+                           std::chrono::milliseconds interval,
+                           std::chrono::milliseconds failureExpiry);
+
+  /**
+   * Sets the maximum time without change for the state of the given
+   * notification, before the backend is considered unhealthy.  This must
+   * only be called if health gating is enabled.
+   */
+  void SetMaxStaleness (const std::string& type,
+                        std::chrono::milliseconds maxAge);
+
+  /**
+   * Enables paged results:  If a call returns an array with more than
+   * pageSize items to a client that supports it, only the first page is
+   * sent in the response.  The rest is kept for the given time-to-live
+   * (extended on each access), during which the client can fetch it
+   * page by page.  This bounds the size of response stanzas and lets
+   * clients process the first items early.  This must be called before
+   * connecting.
+   */
+  void EnablePagination (unsigned pageSize, std::chrono::milliseconds ttl);
+
+  /**
+   * Enables recording of (sampled) incoming requests with the given
+   * recorder.  This must be called before connecting.
+   */
+  void RecordTraffic (std::unique_ptr<TrafficRecorder> rec);
+
   /**
    * Sets the root CA certificate to use for TLS verification.
    */
   void SetRootCA (const std::string& path);
 
+  /**
+   * Enables or disables XEP-0138 stream compression for the XMPP
+   * connection (if the XMPP server offers it).  It is enabled by default.
+   * This must be called before connecting.
+   */
+  void SetStreamCompression (bool enable);
+
+  /**
+   * Returns traffic statistics for the XMPP stream.  The full type of
+   * StreamStatistics is declared in xmppclient.hpp.
+   */
+  StreamStatistics GetStreamStatistics ();
+
+  /**
+   * Returns statistics about setting up the XMPP connection as JSON
+   * (see XmppClient::GetConnectStats).
+   */
+  Json::Value GetConnectStats () const;
+
   /**
    * Connects to XMPP with the given priority.  Starts processing
    * requests once the connection is established.  Returns false if the
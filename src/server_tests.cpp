@@ -21,11 +21,13 @@
 #include "private/pubsub.hpp"
 #include "private/stanzas.hpp"
 #include "testutils.hpp"
+#include "trafficlog.hpp"
 #include "xmppclient.hpp"
 
 #include <gloox/iq.h>
 #include <gloox/iqhandler.h>
 #include <gloox/message.h>
+#include <gloox/messagehandler.h>
 #include <gloox/presence.h>
 #include <gloox/presencehandler.h>
 
@@ -34,6 +36,8 @@
 
 #include <glog/logging.h>
 
+#include <experimental/filesystem>
+
 #include <condition_variable>
 #include <map>
 #include <mutex>
@@ -324,13 +328,15 @@ protected:
   }
 
   /**
-   * Sends a ping to the given JID.
+   * Sends a ping to the given JID, optionally with our capabilities.
    */
   void
-  SendPing (const gloox::JID& to)
+  SendPing (const gloox::JID& to, const Capabilities& caps = Capabilities ())
   {
     gloox::Message msg(gloox::Message::Normal, to);
-    msg.addExtension (new PingMessage ());
+    auto ping = std::make_unique<PingMessage> ();
+    ping->SetCapabilities (caps);
+    msg.addExtension (ping.release ());
 
     RunWithClient ([&msg] (gloox::Client& c)
       {
@@ -352,6 +358,16 @@ protected:
     return pongResource;
   }
 
+  /**
+   * Returns true if a pong message has been received already.
+   */
+  bool
+  HasPong ()
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    return pongMessage != nullptr;
+  }
+
   /**
    * Returns the SupportedNotifications stanza that was present on the last
    * pong message (or null if there was none).
@@ -401,6 +417,110 @@ TEST_F (ServerPingTests, SupportedNotifications)
   ));
 }
 
+TEST_F (ServerPingTests, AlternativePubSub)
+{
+  const char* alt = GetServerConfig ().altPubsub;
+  if (alt == nullptr)
+    {
+      LOG (WARNING) << "No alternative pubsub service available";
+      return;
+    }
+
+  auto upd = UpdatableState::Create ();
+  server.AddPubSub (GetServerConfig ().pubsub);
+  server.AddNotification (upd->NewWaiter ("foo"));
+  server.AddPubSub (alt);
+  server.AddNotification (upd->NewWaiter ("bar"));
+
+  SendPing (JIDWithoutResource (GetTestAccount (accServer)));
+  EXPECT_EQ (WaitForPong (), SERVER_RES);
+
+  const auto* n = GetNotifications ();
+  ASSERT_NE (n, nullptr);
+  EXPECT_EQ (n->GetService (), GetServerConfig ().pubsub);
+
+  const auto& alternatives = n->GetAlternatives ();
+  ASSERT_EQ (alternatives.size (), 1u);
+  const auto& altNodes = alternatives.at (alt);
+  EXPECT_EQ (altNodes.size (), 2u);
+  EXPECT_NE (altNodes.at ("foo"), GetNotificationNode ("foo"));
+  EXPECT_NE (altNodes.at ("bar"), GetNotificationNode ("bar"));
+}
+
+TEST_F (ServerPingTests, DirectPushAdvertised)
+{
+  auto upd = UpdatableState::Create ();
+  server.AddPubSub (GetServerConfig ().pubsub);
+  server.AddNotification (upd->NewWaiter ("foo"));
+
+  SendPing (JIDWithoutResource (GetTestAccount (accServer)));
+  WaitForPong ();
+  ASSERT_NE (GetNotifications (), nullptr);
+  EXPECT_FALSE (GetNotifications ()->SupportsDirect ());
+
+  server.EnableDirectPush (10);
+  SendPing (JIDWithoutResource (GetTestAccount (accServer)));
+  WaitForPong ();
+  ASSERT_NE (GetNotifications (), nullptr);
+  EXPECT_TRUE (GetNotifications ()->SupportsDirect ());
+}
+
+TEST_F (ServerPingTests, HealthGating)
+{
+  auto upd = UpdatableState::Create ();
+  server.AddPubSub (GetServerConfig ().pubsub);
+  auto waiter = upd->NewWaiter ("foo");
+  waiter->SetBackoff (std::chrono::milliseconds (100));
+  server.AddNotification (std::move (waiter));
+  server.EnableHealthGating (3, std::chrono::milliseconds (10),
+                             std::chrono::milliseconds (10));
+
+  upd->SetShouldFail (true);
+  std::this_thread::sleep_for (std::chrono::milliseconds (100));
+
+  SendPing (JIDWithResource (GetTestAccount (accServer), SERVER_RES));
+  std::this_thread::sleep_for (std::chrono::milliseconds (100));
+  EXPECT_FALSE (HasPong ());
+
+  upd->SetShouldFail (false);
+  std::this_thread::sleep_for (std::chrono::milliseconds (300));
+
+  SendPing (JIDWithoutResource (GetTestAccount (accServer)));
+  EXPECT_EQ (WaitForPong (), SERVER_RES);
+}
+
+TEST_F (ServerPingTests, HealthGatingRecoversFromFailedCalls)
+{
+  server.EnableHealthGating (2, std::chrono::milliseconds (50),
+                             std::chrono::milliseconds (200));
+
+  /* Clients do not send calls to a withdrawn server, so nothing would
+     reset the failed calls.  They expire instead, so that the server
+     re-enters selection by itself.  */
+  ReceivedIqResults results;
+  const gloox::JID jidTo = JIDWithResource (GetTestAccount (accServer),
+                                            SERVER_RES);
+  for (int i = 1; i <= 2; ++i)
+    {
+      gloox::IQ iq(gloox::IQ::Get, jidTo);
+      iq.addExtension (new RpcRequest ("unreachable",
+                                       ParseJson (R"(["down"])")));
+      RunWithClient ([&results, &iq, i] (gloox::Client& c)
+        {
+          c.send (iq, &results, i);
+        });
+    }
+  results.Expect ({{1, "error down"}, {2, "error down"}});
+
+  SendPing (jidTo);
+  std::this_thread::sleep_for (std::chrono::milliseconds (100));
+  EXPECT_FALSE (HasPong ());
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (500));
+  SendPing (JIDWithoutResource (GetTestAccount (accServer)));
+  EXPECT_EQ (WaitForPong (), SERVER_RES);
+}
+
 /* ************************************************************************** */
 
 /**
@@ -418,7 +538,7 @@ protected:
    */
   void
   SendRequest (const int context, const std::string& method,
-               const std::string& param)
+               const std::string& param, const std::string& id = "")
   {
     LOG (INFO)
         << "Sending request for context " << context << ": "
@@ -431,6 +551,8 @@ protected:
     Json::Value params(Json::arrayValue);
     params.append (param);
     auto req = std::make_unique<RpcRequest> (method, params);
+    if (!id.empty ())
+      req->SetId (id);
     iq.addExtension (req.release ());
 
     RunWithClient ([this, context, &iq] (gloox::Client& c)
@@ -467,6 +589,263 @@ TEST_F (ServerRpcTests, MultipleRequests)
   );
 }
 
+TEST_F (ServerRpcTests, RetriedRequestId)
+{
+  SendRequest (1, "count", "foo", "request 1");
+  results.Expect ({{1, "foo 1"}});
+  SendRequest (2, "count", "foo", "request 1");
+  results.Expect ({{2, "foo 1"}});
+
+  SendRequest (3, "count", "foo", "request 2");
+  results.Expect ({{3, "foo 2"}});
+  SendRequest (4, "count", "foo");
+  results.Expect ({{4, "foo 3"}});
+  SendRequest (5, "count", "foo");
+  results.Expect ({{5, "foo 4"}});
+}
+
+TEST_F (ServerRpcTests, RecordsTraffic)
+{
+  namespace fs = std::experimental::filesystem;
+  const auto file
+      = (fs::temp_directory_path () / "charon-server-traffic").string ();
+
+  /* The recorder is owned by the server, which outlives our use of it.  */
+  auto rec = std::make_unique<TrafficRecorder> (file, 1.0);
+  auto* recPtr = rec.get ();
+
+  server.Disconnect ();
+  server.RecordTraffic (std::move (rec));
+  ASSERT_TRUE (server.Connect (0));
+
+  SendRequest (1, "echo", "foo");
+  results.Expect ({{1, "foo"}});
+  SendRequest (2, "error", "bar");
+  results.Expect ({{2, "error bar"}});
+  recPtr->Flush ();
+
+  TrafficLogReader reader(file);
+  TrafficRecord r;
+
+  ASSERT_TRUE (reader.Next (r));
+  EXPECT_EQ (r.method, "echo");
+  EXPECT_EQ (r.params, ParseJson (R"(["foo"])"));
+  EXPECT_EQ (r.requestSize, 7u);
+  EXPECT_EQ (r.responseSize, 5u);
+  EXPECT_FALSE (r.error);
+
+  ASSERT_TRUE (reader.Next (r));
+  EXPECT_EQ (r.method, "error");
+  EXPECT_TRUE (r.error);
+
+  EXPECT_FALSE (reader.Next (r));
+  fs::remove (file);
+}
+
+/* ************************************************************************** */
+
+/**
+ * Test case for responses to RPC calls that depend on the capabilities
+ * negotiated with the client.
+ */
+class ServerCapabilityTests : public ServerPingTests, private gloox::IqHandler
+{
+
+private:
+
+  /** Mutex for the received response.  */
+  std::mutex mut;
+
+  /** Condition variable signalled when a response arrives.  */
+  std::condition_variable cv;
+
+  /** The last received response (or null if none yet).  */
+  std::unique_ptr<RpcResponse> response;
+
+  bool
+  handleIq (const gloox::IQ& iq) override
+  {
+    LOG (FATAL) << "Received IQ without context";
+  }
+
+  void
+  handleIqID (const gloox::IQ& iq, const int context) override
+  {
+    ASSERT_EQ (iq.subtype (), gloox::IQ::Result);
+
+    const auto* ext = iq.findExtension<RpcResponse> (RpcResponse::EXT_TYPE);
+    CHECK (ext != nullptr) << "No expected RpcResult extension";
+
+    std::lock_guard<std::mutex> lock(mut);
+    response.reset (dynamic_cast<RpcResponse*> (ext->clone ()));
+    cv.notify_all ();
+  }
+
+protected:
+
+  /**
+   * Sends an IQ with the given extension to the server and returns
+   * the response.
+   */
+  std::unique_ptr<RpcResponse>
+  Send (gloox::StanzaExtension* ext)
+  {
+    gloox::IQ iq(gloox::IQ::Get,
+                 JIDWithResource (GetTestAccount (accServer), SERVER_RES));
+    iq.addExtension (ext);
+
+    {
+      std::lock_guard<std::mutex> lock(mut);
+      response.reset ();
+    }
+
+    RunWithClient ([this, &iq] (gloox::Client& c)
+      {
+        c.send (iq, this, 0);
+      });
+
+    std::unique_lock<std::mutex> lock(mut);
+    while (response == nullptr)
+      cv.wait (lock);
+
+    return std::move (response);
+  }
+
+  /**
+   * Pings the server with our capabilities, so that it knows we support
+   * all of them.
+   */
+  void
+  Negotiate ()
+  {
+    SendPing (JIDWithResource (GetTestAccount (accServer), SERVER_RES),
+              Capabilities::Own ());
+    WaitForPong ();
+  }
+
+  /**
+   * Calls the given method with a single string argument, and returns
+   * the server's response.
+   */
+  std::unique_ptr<RpcResponse>
+  Call (const std::string& method, const std::string& arg)
+  {
+    Json::Value params(Json::arrayValue);
+    params.append (arg);
+    return Send (new RpcRequest (method, params));
+  }
+
+};
+
+TEST_F (ServerCapabilityTests, StaleResult)
+{
+  Negotiate ();
+
+  auto res = Call ("unreachable", "down");
+  ASSERT_TRUE (res->IsSuccess ());
+  EXPECT_EQ (res->GetResult (), "down");
+  EXPECT_TRUE (res->IsStale ());
+}
+
+TEST_F (ServerCapabilityTests, LegacyClientGetsNoStaleResult)
+{
+  /* Legacy clients cannot tell a stale result from a fresh one, so they
+     get the backend error instead.  */
+  auto res = Call ("unreachable", "down");
+  ASSERT_FALSE (res->IsSuccess ());
+  EXPECT_EQ (res->GetErrorMessage (), "down");
+}
+
+/**
+ * Test case for large array results that the server splits into pages.
+ */
+class ServerPaginationTests : public ServerCapabilityTests
+{
+
+protected:
+
+  ServerPaginationTests ()
+  {
+    RunWithClient ([] (gloox::Client& c)
+      {
+        c.registerStanzaExtension (new PageRequest ());
+      });
+
+    server.Disconnect ();
+    server.EnablePagination (2, std::chrono::seconds (10));
+    CHECK (server.Connect (0));
+  }
+
+  /**
+   * Calls the "chars" method with the given argument, and returns
+   * the server's response.
+   */
+  std::unique_ptr<RpcResponse>
+  CallChars (const std::string& arg)
+  {
+    return Call ("chars", arg);
+  }
+
+  /**
+   * Requests the page at the given offset for the given cursor.
+   */
+  std::unique_ptr<RpcResponse>
+  FetchPage (const std::string& cursor, const unsigned offset)
+  {
+    return Send (new PageRequest (cursor, offset));
+  }
+
+};
+
+TEST_F (ServerPaginationTests, Paged)
+{
+  Negotiate ();
+
+  auto res = CallChars ("abcde");
+  ASSERT_TRUE (res->IsSuccess ());
+  EXPECT_EQ (res->GetResult (), ParseJson (R"(["a", "b"])"));
+  const std::string cursor = res->GetCursor ();
+  ASSERT_NE (cursor, "");
+
+  res = FetchPage (cursor, 2);
+  ASSERT_TRUE (res->IsSuccess ());
+  EXPECT_EQ (res->GetResult (), ParseJson (R"(["c", "d"])"));
+  EXPECT_EQ (res->GetCursor (), cursor);
+
+  /* A page can be requested again, e.g. if the response got lost.  */
+  res = FetchPage (cursor, 2);
+  ASSERT_TRUE (res->IsSuccess ());
+  EXPECT_EQ (res->GetResult (), ParseJson (R"(["c", "d"])"));
+
+  res = FetchPage (cursor, 4);
+  ASSERT_TRUE (res->IsSuccess ());
+  EXPECT_EQ (res->GetResult (), ParseJson (R"(["e"])"));
+  EXPECT_EQ (res->GetCursor (), "");
+
+  /* Items before the last requested offset are gone.  */
+  res = FetchPage (cursor, 2);
+  ASSERT_FALSE (res->IsSuccess ());
+  EXPECT_EQ (res->GetErrorMessage (), "unknown or expired result cursor");
+}
+
+TEST_F (ServerPaginationTests, SmallResult)
+{
+  Negotiate ();
+
+  auto res = CallChars ("ab");
+  ASSERT_TRUE (res->IsSuccess ());
+  EXPECT_EQ (res->GetResult (), ParseJson (R"(["a", "b"])"));
+  EXPECT_EQ (res->GetCursor (), "");
+}
+
+TEST_F (ServerPaginationTests, LegacyClient)
+{
+  auto res = CallChars ("abcde");
+  ASSERT_TRUE (res->IsSuccess ());
+  EXPECT_EQ (res->GetResult (), ParseJson (R"(["a", "b", "c", "d", "e"])"));
+  EXPECT_EQ (res->GetCursor (), "");
+}
+
 /* ************************************************************************** */
 
 /**
@@ -602,6 +981,287 @@ TEST_F (ServerNotificationTests, MultipleUpdates)
   r.Expect ({"a=1", "b=2", "c=3"});
 }
 
+/**
+ * Test case for direct push of notifications to a registered client.
+ */
+class ServerDirectPushTests : public ServerNotificationTests,
+                              private gloox::IqHandler,
+                              private gloox::MessageHandler
+{
+
+private:
+
+  /** Mutex for the registration result.  */
+  std::mutex mut;
+
+  /** Condition variable signalled when the registration result arrives.  */
+  std::condition_variable cv;
+
+  /** Set to true when the registration result has been received.  */
+  bool hasResult;
+
+  /** Whether the registration has been accepted.  */
+  bool accepted;
+
+  bool
+  handleIq (const gloox::IQ& iq) override
+  {
+    LOG (FATAL) << "Received IQ without context";
+  }
+
+  void
+  handleIqID (const gloox::IQ& iq, const int context) override
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    hasResult = true;
+    accepted = (iq.subtype () == gloox::IQ::Result);
+    cv.notify_all ();
+  }
+
+  void
+  handleMessage (const gloox::Message& msg,
+                 gloox::MessageSession* session) override
+  {
+    const auto* ext
+        = msg.findExtension<PushedUpdate> (PushedUpdate::EXT_TYPE);
+    if (ext == nullptr)
+      return;
+    ASSERT_TRUE (ext->IsValid ());
+
+    const NotificationUpdate upd(ext->GetUpdate ());
+    ASSERT_TRUE (upd.IsValid ());
+
+    const auto& state = upd.GetState ();
+    pushed.Add (upd.GetType () + " " + state["id"].asString ()
+                  + "=" + state["value"].asString ());
+  }
+
+protected:
+
+  /**
+   * The updates received by direct push, as "type id=value" strings.
+   */
+  ReceivedMessages pushed;
+
+  ServerDirectPushTests ()
+  {
+    RunWithClient ([this] (gloox::Client& c)
+      {
+        c.registerStanzaExtension (new DirectRegistration ());
+        c.registerStanzaExtension (new FilterRegistration ());
+        c.registerStanzaExtension (new PushedUpdate ());
+        c.registerMessageHandler (this);
+      });
+  }
+
+  ~ServerDirectPushTests ()
+  {
+    RunWithClient ([this] (gloox::Client& c)
+      {
+        c.removeMessageHandler (this);
+      });
+  }
+
+  /**
+   * Sends an IQ with the given registration extension to the server
+   * and returns whether or not it was accepted.
+   */
+  bool
+  SendRegistration (const gloox::IQ::IqType type,
+                    const gloox::StanzaExtension& reg)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mut);
+      hasResult = false;
+    }
+
+    gloox::IQ iq(type,
+                 JIDWithResource (GetTestAccount (accServer), SERVER_RES));
+    iq.addExtension (reg.clone ());
+    RunWithClient ([this, &iq] (gloox::Client& c)
+      {
+        c.send (iq, this, 0);
+      });
+
+    std::unique_lock<std::mutex> lock(mut);
+    while (!hasResult)
+      cv.wait (lock);
+
+    return accepted;
+  }
+
+  /**
+   * Sends a direct registration to the server and returns whether
+   * or not it was accepted.
+   */
+  bool
+  Register (const DirectRegistration& reg)
+  {
+    return SendRegistration (gloox::IQ::Set, reg);
+  }
+
+  /**
+   * Requests a filtered stream for the given notification and filter spec,
+   * and returns whether or not it was accepted.
+   */
+  bool
+  RegisterFilter (const std::string& type, const Json::Value& spec)
+  {
+    return SendRegistration (gloox::IQ::Get, FilterRegistration (type, spec));
+  }
+
+  /**
+   * Sends unavailable presence to the server.
+   */
+  void
+  SendUnavailable ()
+  {
+    gloox::Presence p(gloox::Presence::Unavailable,
+                      JIDWithResource (GetTestAccount (accServer),
+                                       SERVER_RES));
+    RunWithClient ([&p] (gloox::Client& c)
+      {
+        c.send (p);
+      });
+  }
+
+};
+
+TEST_F (ServerDirectPushTests, Disabled)
+{
+  auto s = UpdatableState::Create ();
+  server.AddNotification (s->NewWaiter ("foo"));
+
+  DirectRegistration reg;
+  reg.AddNotification ("foo", Json::Value ());
+  EXPECT_FALSE (Register (reg));
+}
+
+TEST_F (ServerDirectPushTests, InvalidType)
+{
+  auto s = UpdatableState::Create ();
+  server.AddNotification (s->NewWaiter ("foo"));
+  server.EnableDirectPush (10);
+
+  DirectRegistration reg;
+  reg.AddNotification ("bar", Json::Value ());
+  EXPECT_FALSE (Register (reg));
+}
+
+TEST_F (ServerDirectPushTests, PushesUpdates)
+{
+  auto s1 = UpdatableState::Create ();
+  auto s2 = UpdatableState::Create ();
+  server.AddNotification (s1->NewWaiter ("foo"));
+  server.AddNotification (s2->NewWaiter ("bar"));
+  server.EnableDirectPush (10);
+
+  s1->SetState ("a", "1");
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+
+  DirectRegistration reg;
+  reg.AddNotification ("foo", Json::Value ());
+  ASSERT_TRUE (Register (reg));
+
+  /* The current state is pushed right away.  */
+  pushed.Expect ({"foo a=1"});
+
+  s1->SetState ("b", "2");
+  pushed.Expect ({"foo b=2"});
+
+  /* We did not register for this one.  */
+  s2->SetState ("c", "3");
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+  pushed.Expect ({});
+}
+
+TEST_F (ServerDirectPushTests, Filtered)
+{
+  auto s = UpdatableState::Create ();
+  server.AddNotification (s->NewWaiter ("foo"));
+  server.EnableDirectPush (10);
+
+  DirectRegistration reg;
+  reg.AddNotification ("foo", ParseJson (R"({
+    "path": "",
+    "keys": ["id"]
+  })"));
+  ASSERT_TRUE (Register (reg));
+
+  s->SetState ("a", "1");
+  pushed.Expect ({"foo a="});
+
+  /* Changes outside of the filtered view are not pushed.  */
+  s->SetState ("a", "2");
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+  s->SetState ("b", "3");
+  pushed.Expect ({"foo b="});
+}
+
+TEST_F (ServerDirectPushTests, FilterRegistrationSendsCurrentView)
+{
+  auto s = UpdatableState::Create ();
+  server.AddNotification (s->NewWaiter ("foo"));
+
+  s->SetState ("a", "1");
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+
+  const auto spec = ParseJson (R"({
+    "path": "",
+    "keys": ["id"]
+  })");
+
+  /* The view of the current state is sent right away, both when the
+     stream is created and when joining an existing one.  */
+  ASSERT_TRUE (RegisterFilter ("foo", spec));
+  pushed.Expect ({"foo a="});
+  ASSERT_TRUE (RegisterFilter ("foo", spec));
+  pushed.Expect ({"foo a="});
+}
+
+TEST_F (ServerDirectPushTests, FilterRegistrationLimit)
+{
+  auto s = UpdatableState::Create ();
+  server.AddNotification (s->NewWaiter ("foo"));
+
+  const auto getSpec = [] (const unsigned i)
+    {
+      Json::Value spec(Json::objectValue);
+      spec["path"] = "";
+      spec["keys"] = Json::Value (Json::arrayValue);
+      spec["keys"].append ("key " + std::to_string (i));
+      return spec;
+    };
+
+  for (unsigned i = 0; i < Server::MAX_FILTERS_PER_CLIENT; ++i)
+    ASSERT_TRUE (RegisterFilter ("foo", getSpec (i)));
+  EXPECT_FALSE (RegisterFilter ("foo", getSpec (100)));
+
+  /* Filters we already use are still fine.  */
+  EXPECT_TRUE (RegisterFilter ("foo", getSpec (0)));
+}
+
+TEST_F (ServerDirectPushTests, UnavailableStopsPush)
+{
+  auto s = UpdatableState::Create ();
+  server.AddNotification (s->NewWaiter ("foo"));
+  server.EnableDirectPush (10);
+
+  DirectRegistration reg;
+  reg.AddNotification ("foo", Json::Value ());
+  ASSERT_TRUE (Register (reg));
+
+  s->SetState ("a", "1");
+  pushed.Expect ({"foo a=1"});
+
+  SendUnavailable ();
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+
+  s->SetState ("b", "2");
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+  pushed.Expect ({});
+}
+
 /* ************************************************************************** */
 
 class ServerReconnectLoopTests : public testing::Test
@@ -22,6 +22,8 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <chrono>
 #include <sstream>
 
 namespace charon
@@ -30,6 +32,149 @@ namespace charon
 /** XML namespace for our stanza extensions.  */
 #define XMLNS "https://xaya.io/charon/"
 
+namespace
+{
+
+/**
+ * Parses an optional timestamp attribute of the given tag.  Returns zero
+ * if the attribute is missing or invalid.
+ */
+std::int64_t
+ParseTimestamp (const gloox::Tag& t, const std::string& attr)
+{
+  if (!t.hasAttribute (attr))
+    return 0;
+
+  const std::string str = t.findAttribute (attr);
+  std::istringstream in(str);
+  std::int64_t res;
+  in >> res;
+  if (!in || !in.eof () || res <= 0)
+    {
+      LOG (WARNING) << "Invalid timestamp " << attr << ": " << str;
+      return 0;
+    }
+
+  return res;
+}
+
+} // anonymous namespace
+
+std::int64_t
+GetTimestampMs ()
+{
+  const auto now = std::chrono::system_clock::now ().time_since_epoch ();
+  return std::chrono::duration_cast<std::chrono::milliseconds> (now).count ();
+}
+
+/* ************************************************************************** */
+
+void
+Capabilities::Set (const std::string& name, const unsigned version)
+{
+  if (version == 0)
+    versions.erase (name);
+  else
+    versions[name] = version;
+}
+
+unsigned
+Capabilities::Get (const std::string& name) const
+{
+  const auto mit = versions.find (name);
+  if (mit == versions.end ())
+    return 0;
+  return mit->second;
+}
+
+Capabilities
+Capabilities::Intersect (const Capabilities& other) const
+{
+  Capabilities res;
+  for (const auto& entry : versions)
+    res.Set (entry.first, std::min (entry.second, other.Get (entry.first)));
+  return res;
+}
+
+XmlEncodingOptions
+Capabilities::GetEncodingOptions () const
+{
+  XmlEncodingOptions res;
+  res.allowCompression = Has (CAPABILITY_ZLIB);
+  return res;
+}
+
+void
+Capabilities::AddToTag (gloox::Tag& t) const
+{
+  for (const auto& entry : versions)
+    {
+      auto child = std::make_unique<gloox::Tag> ("capability");
+      CHECK (child->addAttribute ("name", entry.first));
+      CHECK (child->addAttribute ("version", std::to_string (entry.second)));
+      t.addChild (child.release ());
+    }
+}
+
+Capabilities
+Capabilities::FromTag (const gloox::Tag& t)
+{
+  Capabilities res;
+  bool found = false;
+
+  for (const auto* child : t.findChildren ("capability"))
+    {
+      found = true;
+
+      const std::string name = child->findAttribute ("name");
+      std::istringstream in(child->findAttribute ("version"));
+      unsigned version;
+      in >> version;
+      if (name.empty () || !in || !in.eof ())
+        {
+          LOG (WARNING) << "Ignoring invalid capability:\n" << child->xml ();
+          continue;
+        }
+
+      res.Set (name, version);
+    }
+
+  if (!found)
+    return Legacy ();
+
+  return res;
+}
+
+const Capabilities&
+Capabilities::Own ()
+{
+  static const Capabilities own = [] ()
+    {
+      Capabilities res;
+      res.Set (CAPABILITY_STALE, 1);
+      res.Set (CAPABILITY_FILTER, 1);
+      res.Set (CAPABILITY_TIMESTAMPS, 1);
+      res.Set (CAPABILITY_ZLIB, 1);
+      res.Set (CAPABILITY_PAGES, 1);
+      return res;
+    } ();
+
+  return own;
+}
+
+const Capabilities&
+Capabilities::Legacy ()
+{
+  static const Capabilities legacy = [] ()
+    {
+      Capabilities res;
+      res.Set (CAPABILITY_ZLIB, 1);
+      return res;
+    } ();
+
+  return legacy;
+}
+
 /* ************************************************************************** */
 
 RpcRequest::RpcRequest ()
@@ -77,9 +222,23 @@ RpcRequest::RpcRequest (const gloox::Tag& t)
       return;
     }
 
+  id = t.findAttribute ("id");
+  if (id.size () > MAX_ID_LENGTH)
+    {
+      LOG (WARNING) << "request id is too long";
+      return;
+    }
+
   SetValid (true);
 }
 
+void
+RpcRequest::SetId (const std::string& i)
+{
+  CHECK_LE (i.size (), MAX_ID_LENGTH) << "Request ID is too long: " << i;
+  id = i;
+}
+
 const std::string&
 RpcRequest::filterString () const
 {
@@ -101,7 +260,9 @@ RpcRequest::clone () const
   if (IsValid ())
     {
       res->method = method;
+      res->id = id;
       res->params = params;
+      res->encoding = encoding;
       res->SetValid (true);
     }
   else
@@ -117,11 +278,13 @@ RpcRequest::tag () const
 
   auto res = std::make_unique<gloox::Tag> ("request");
   CHECK (res->setXmlns (XMLNS));
+  if (!id.empty ())
+    CHECK (res->addAttribute ("id", id));
 
   auto child = std::make_unique<gloox::Tag> ("method", method);
   res->addChild (child.release ());
 
-  child = EncodeXmlJson ("params", params);
+  child = EncodeXmlJson ("params", params, encoding);
   res->addChild (child.release ());
 
   return res.release ();
@@ -167,6 +330,8 @@ RpcResponse::RpcResponse (const gloox::Tag& t)
       if (!DecodeXmlJson (*outer, result))
         return;
 
+      stale = (t.findAttribute ("stale") == "true");
+      cursor = t.findAttribute ("cursor");
       success = true;
       SetValid (true);
       return;
@@ -210,6 +375,20 @@ RpcResponse::GetResult () const
   return result;
 }
 
+void
+RpcResponse::SetStale (const bool s)
+{
+  CHECK (IsSuccess ());
+  stale = s;
+}
+
+void
+RpcResponse::SetCursor (const std::string& c)
+{
+  CHECK (IsSuccess ());
+  cursor = c;
+}
+
 int
 RpcResponse::GetErrorCode () const
 {
@@ -253,9 +432,12 @@ RpcResponse::clone () const
     {
       res->success = success;
       res->result = result;
+      res->stale = stale;
+      res->cursor = cursor;
       res->errorCode = errorCode;
       res->errorMsg = errorMsg;
       res->errorData = errorData;
+      res->encoding = encoding;
       res->SetValid (true);
     }
   else
@@ -274,7 +456,12 @@ RpcResponse::tag () const
 
   if (success)
     {
-      auto child = EncodeXmlJson ("result", result);
+      if (stale)
+        CHECK (res->addAttribute ("stale", "true"));
+      if (!cursor.empty ())
+        CHECK (res->addAttribute ("cursor", cursor));
+
+      auto child = EncodeXmlJson ("result", result, encoding);
       res->addChild (child.release ());
     }
   else
@@ -290,7 +477,7 @@ RpcResponse::tag () const
 
       if (!errorData.isNull ())
         {
-          auto child = EncodeXmlJson ("data", errorData);
+          auto child = EncodeXmlJson ("data", errorData, encoding);
           outer->addChild (child.release ());
         }
 
@@ -308,6 +495,13 @@ PingMessage::PingMessage ()
   SetValid (true);
 }
 
+PingMessage::PingMessage (const gloox::Tag& t)
+  : ValidatedStanzaExtension(EXT_TYPE),
+    capabilities(Capabilities::FromTag (t))
+{
+  SetValid (true);
+}
+
 const std::string&
 PingMessage::filterString () const
 {
@@ -318,13 +512,15 @@ PingMessage::filterString () const
 gloox::StanzaExtension*
 PingMessage::newInstance (const gloox::Tag* tag) const
 {
-  return new PingMessage ();
+  return new PingMessage (*tag);
 }
 
 gloox::StanzaExtension*
 PingMessage::clone () const
 {
-  return new PingMessage ();
+  auto res = std::make_unique<PingMessage> ();
+  res->capabilities = capabilities;
+  return res.release ();
 }
 
 gloox::Tag*
@@ -332,6 +528,7 @@ PingMessage::tag () const
 {
   auto res = std::make_unique<gloox::Tag> ("ping");
   CHECK (res->setXmlns (XMLNS));
+  capabilities.AddToTag (*res);
 
   return res.release ();
 }
@@ -357,6 +554,8 @@ PongMessage::PongMessage (const gloox::Tag& t)
   /* If the attribute is not present, then we assume an empty version.
      This is totally fine.  */
   version = t.findAttribute ("version");
+  time = ParseTimestamp (t, "time");
+  capabilities = Capabilities::FromTag (t);
 }
 
 const std::string&
@@ -375,7 +574,10 @@ PongMessage::newInstance (const gloox::Tag* tag) const
 gloox::StanzaExtension*
 PongMessage::clone () const
 {
-  return new PongMessage (version);
+  auto res = std::make_unique<PongMessage> (version);
+  res->time = time;
+  res->capabilities = capabilities;
+  return res.release ();
 }
 
 gloox::Tag*
@@ -385,12 +587,64 @@ PongMessage::tag () const
   CHECK (res->setXmlns (XMLNS));
   if (!version.empty ())
     CHECK (res->addAttribute ("version", version));
+  if (time > 0)
+    CHECK (res->addAttribute ("time", std::to_string (time)));
+  capabilities.AddToTag (*res);
 
   return res.release ();
 }
 
 /* ************************************************************************** */
 
+namespace
+{
+
+/**
+ * Parses the notification children of a tag into the map of types
+ * to nodes.  Invalid and duplicate entries are ignored.
+ */
+void
+ParseNotificationNodes (const gloox::Tag& t,
+                        std::map<std::string, std::string>& nodes)
+{
+  for (const auto* child : t.findChildren ("notification"))
+    {
+      const std::string type = child->findAttribute ("type");
+      if (type.empty ())
+        {
+          LOG (WARNING) << "Empty / missing notification type";
+          continue;
+        }
+
+      const std::string node = child->cdata ();
+      if (node.empty ())
+        {
+          LOG (WARNING) << "Empty / missing node name for type " << type;
+          continue;
+        }
+
+      const auto res = nodes.emplace (type, node);
+      LOG_IF (WARNING, !res.second) << "Duplicate notification type: " << type;
+    }
+}
+
+/**
+ * Adds notification children for the given map of types to nodes.
+ */
+void
+AddNotificationNodes (gloox::Tag& t,
+                      const std::map<std::string, std::string>& nodes)
+{
+  for (const auto& entry : nodes)
+    {
+      auto child = std::make_unique<gloox::Tag> ("notification", entry.second);
+      CHECK (child->addAttribute ("type", entry.first));
+      t.addChild (child.release ());
+    }
+}
+
+} // anonymous namespace
+
 SupportedNotifications::SupportedNotifications ()
   : ValidatedStanzaExtension(EXT_TYPE)
 {
@@ -416,24 +670,27 @@ SupportedNotifications::SupportedNotifications (const gloox::Tag& t)
       return;
     }
 
-  for (const auto* child : t.findChildren ("notification"))
+  direct = (t.findAttribute ("direct") == "true");
+
+  ParseNotificationNodes (t, notifications);
+
+  for (const auto* child : t.findChildren ("alternative"))
     {
-      const std::string type = child->findAttribute ("type");
-      if (type.empty ())
+      const std::string srv = child->findAttribute ("service");
+      if (srv.empty () || srv == service)
         {
-          LOG (WARNING) << "Empty / missing notification type";
+          LOG (WARNING) << "Invalid alternative pubsub service: " << srv;
           continue;
         }
 
-      const std::string node = child->cdata ();
-      if (node.empty ())
+      const auto res = alternatives.emplace (srv, decltype (notifications) ());
+      if (!res.second)
         {
-          LOG (WARNING) << "Empty / missing node name for type " << type;
+          LOG (WARNING) << "Duplicate alternative pubsub service: " << srv;
           continue;
         }
 
-      const auto res = notifications.emplace (type, node);
-      LOG_IF (WARNING, !res.second) << "Duplicate notification type: " << type;
+      ParseNotificationNodes (*child, res.first->second);
     }
 
   SetValid (true);
@@ -450,6 +707,21 @@ SupportedNotifications::AddNotification (const std::string& type,
   CHECK (res.second) << "Duplicate notification type: " << type;
 }
 
+void
+SupportedNotifications::AddAlternative (const std::string& srv,
+                                        const std::string& type,
+                                        const std::string& node)
+{
+  CHECK (!srv.empty ());
+  CHECK_NE (srv, service);
+  CHECK (!type.empty ());
+  CHECK (!node.empty ());
+
+  const auto res = alternatives[srv].emplace (type, node);
+  CHECK (res.second)
+      << "Duplicate notification type " << type << " for " << srv;
+}
+
 const std::string&
 SupportedNotifications::filterString () const
 {
@@ -472,6 +744,8 @@ SupportedNotifications::clone () const
     {
       res->service = service;
       res->notifications = notifications;
+      res->direct = direct;
+      res->alternatives = alternatives;
       res->SetValid (true);
     }
   else
@@ -488,11 +762,212 @@ SupportedNotifications::tag () const
   auto res = std::make_unique<gloox::Tag> ("notifications");
   CHECK (res->setXmlns (XMLNS));
   CHECK (res->addAttribute ("service", service));
+  if (direct)
+    CHECK (res->addAttribute ("direct", "true"));
+
+  AddNotificationNodes (*res, notifications);
+
+  for (const auto& entry : alternatives)
+    {
+      auto child = std::make_unique<gloox::Tag> ("alternative");
+      CHECK (child->addAttribute ("service", entry.first));
+      AddNotificationNodes (*child, entry.second);
+      res->addChild (child.release ());
+    }
+
+  return res.release ();
+}
+
+/* ************************************************************************** */
+
+FilterRegistration::FilterRegistration ()
+  : ValidatedStanzaExtension(EXT_TYPE)
+{
+  SetValid (false);
+}
+
+FilterRegistration::FilterRegistration (const std::string& t,
+                                        const Json::Value& s)
+  : ValidatedStanzaExtension(EXT_TYPE),
+    type(t), spec(s)
+{
+  CHECK (!type.empty ());
+  SetValid (true);
+}
+
+FilterRegistration::FilterRegistration (const std::string& t,
+                                        const std::string& n)
+  : ValidatedStanzaExtension(EXT_TYPE),
+    type(t), node(n)
+{
+  CHECK (!type.empty ());
+  CHECK (!node.empty ());
+  SetValid (true);
+}
+
+FilterRegistration::FilterRegistration (const gloox::Tag& t)
+  : ValidatedStanzaExtension(EXT_TYPE)
+{
+  SetValid (false);
+
+  type = t.findAttribute ("type");
+  if (type.empty ())
+    {
+      LOG (WARNING) << "Empty / missing filter notification type";
+      return;
+    }
+
+  node = t.findAttribute ("node");
+
+  const auto* child = t.findChild ("spec");
+  if (child != nullptr && !DecodeXmlJson (*child, spec))
+    return;
+
+  SetValid (true);
+}
+
+const std::string&
+FilterRegistration::filterString () const
+{
+  static const std::string filter = "/*/filter[@xmlns='" XMLNS "']";
+  return filter;
+}
+
+gloox::StanzaExtension*
+FilterRegistration::newInstance (const gloox::Tag* tag) const
+{
+  return new FilterRegistration (*tag);
+}
+
+gloox::StanzaExtension*
+FilterRegistration::clone () const
+{
+  auto res = std::make_unique<FilterRegistration> ();
+
+  if (IsValid ())
+    {
+      res->type = type;
+      res->spec = spec;
+      res->node = node;
+      res->SetValid (true);
+    }
+  else
+    res->SetValid (false);
+
+  return res.release ();
+}
+
+gloox::Tag*
+FilterRegistration::tag () const
+{
+  CHECK (IsValid ()) << "Trying to serialise invalid FilterRegistration";
+
+  auto res = std::make_unique<gloox::Tag> ("filter");
+  CHECK (res->setXmlns (XMLNS));
+  CHECK (res->addAttribute ("type", type));
+
+  if (!node.empty ())
+    CHECK (res->addAttribute ("node", node));
+
+  if (!spec.isNull ())
+    {
+      auto child = EncodeXmlJson ("spec", spec);
+      res->addChild (child.release ());
+    }
+
+  return res.release ();
+}
+
+/* ************************************************************************** */
+
+DirectRegistration::DirectRegistration ()
+  : ValidatedStanzaExtension(EXT_TYPE)
+{
+  SetValid (true);
+}
+
+DirectRegistration::DirectRegistration (const gloox::Tag& t)
+  : ValidatedStanzaExtension(EXT_TYPE)
+{
+  SetValid (false);
+
+  for (const auto* child : t.findChildren ("notification"))
+    {
+      const std::string type = child->findAttribute ("type");
+      if (type.empty ())
+        {
+          LOG (WARNING) << "Empty / missing notification type";
+          return;
+        }
+
+      Json::Value spec;
+      const auto* specTag = child->findChild ("spec");
+      if (specTag != nullptr && !DecodeXmlJson (*specTag, spec))
+        return;
+
+      if (!notifications.emplace (type, spec).second)
+        {
+          LOG (WARNING) << "Duplicate notification type: " << type;
+          return;
+        }
+    }
+
+  SetValid (true);
+}
+
+void
+DirectRegistration::AddNotification (const std::string& type,
+                                     const Json::Value& spec)
+{
+  CHECK (!type.empty ());
+
+  const auto res = notifications.emplace (type, spec);
+  CHECK (res.second) << "Duplicate notification type: " << type;
+}
+
+const std::string&
+DirectRegistration::filterString () const
+{
+  static const std::string filter = "/*/direct[@xmlns='" XMLNS "']";
+  return filter;
+}
+
+gloox::StanzaExtension*
+DirectRegistration::newInstance (const gloox::Tag* tag) const
+{
+  return new DirectRegistration (*tag);
+}
+
+gloox::StanzaExtension*
+DirectRegistration::clone () const
+{
+  auto res = std::make_unique<DirectRegistration> ();
+
+  if (IsValid ())
+    res->notifications = notifications;
+  else
+    res->SetValid (false);
+
+  return res.release ();
+}
+
+gloox::Tag*
+DirectRegistration::tag () const
+{
+  CHECK (IsValid ()) << "Trying to serialise invalid DirectRegistration";
+
+  auto res = std::make_unique<gloox::Tag> ("direct");
+  CHECK (res->setXmlns (XMLNS));
 
   for (const auto& entry : notifications)
     {
-      auto child = std::make_unique<gloox::Tag> ("notification", entry.second);
+      auto child = std::make_unique<gloox::Tag> ("notification");
       CHECK (child->addAttribute ("type", entry.first));
+      if (!entry.second.isNull ())
+        {
+          auto spec = EncodeXmlJson ("spec", entry.second);
+          child->addChild (spec.release ());
+        }
       res->addChild (child.release ());
     }
 
@@ -501,6 +976,133 @@ SupportedNotifications::tag () const
 
 /* ************************************************************************** */
 
+PushedUpdate::PushedUpdate ()
+  : ValidatedStanzaExtension(EXT_TYPE)
+{
+  SetValid (false);
+}
+
+PushedUpdate::PushedUpdate (const gloox::Tag& t)
+  : ValidatedStanzaExtension(EXT_TYPE),
+    update(t.clone ())
+{
+  SetValid (true);
+}
+
+const gloox::Tag&
+PushedUpdate::GetUpdate () const
+{
+  CHECK (IsValid ()) << "Trying to access invalid PushedUpdate";
+  return *update;
+}
+
+const std::string&
+PushedUpdate::filterString () const
+{
+  static const std::string filter = "/message/update[@xmlns='" XMLNS "']";
+  return filter;
+}
+
+gloox::StanzaExtension*
+PushedUpdate::newInstance (const gloox::Tag* tag) const
+{
+  return new PushedUpdate (*tag);
+}
+
+gloox::StanzaExtension*
+PushedUpdate::clone () const
+{
+  if (!IsValid ())
+    return new PushedUpdate ();
+  return new PushedUpdate (*update);
+}
+
+gloox::Tag*
+PushedUpdate::tag () const
+{
+  CHECK (IsValid ()) << "Trying to serialise invalid PushedUpdate";
+  return update->clone ();
+}
+
+/* ************************************************************************** */
+
+PageRequest::PageRequest ()
+  : ValidatedStanzaExtension(EXT_TYPE)
+{
+  SetValid (false);
+}
+
+PageRequest::PageRequest (const std::string& c, const std::uint64_t o)
+  : ValidatedStanzaExtension(EXT_TYPE),
+    cursor(c), offset(o)
+{
+  CHECK (!cursor.empty ());
+  SetValid (true);
+}
+
+PageRequest::PageRequest (const gloox::Tag& t)
+  : ValidatedStanzaExtension(EXT_TYPE)
+{
+  SetValid (false);
+
+  cursor = t.findAttribute ("cursor");
+  if (cursor.empty ())
+    {
+      LOG (WARNING) << "page tag has no cursor";
+      return;
+    }
+
+  /* The offset must be a plain decimal number.  The stream would also
+     accept signs (and wrap negative numbers around).  */
+  const std::string offsetStr = t.findAttribute ("offset");
+  std::istringstream in(offsetStr);
+  if (offsetStr.empty ()
+        || offsetStr.find_first_not_of ("0123456789") != std::string::npos
+        || !(in >> offset) || !in.eof ())
+    {
+      LOG (WARNING) << "page tag has invalid offset: " << offsetStr;
+      return;
+    }
+
+  SetValid (true);
+}
+
+const std::string&
+PageRequest::filterString () const
+{
+  static const std::string filter = "/*/page[@xmlns='" XMLNS "']";
+  return filter;
+}
+
+gloox::StanzaExtension*
+PageRequest::newInstance (const gloox::Tag* tag) const
+{
+  return new PageRequest (*tag);
+}
+
+gloox::StanzaExtension*
+PageRequest::clone () const
+{
+  if (!IsValid ())
+    return new PageRequest ();
+  return new PageRequest (cursor, offset);
+}
+
+gloox::Tag*
+PageRequest::tag () const
+{
+  CHECK (IsValid ()) << "Trying to serialise invalid PageRequest";
+
+  auto res = std::make_unique<gloox::Tag> ("page");
+  CHECK (res->setXmlns (XMLNS));
+  CHECK (res->addAttribute ("cursor", cursor));
+  CHECK (res->addAttribute ("offset", std::to_string (offset)));
+
+  return res.release ();
+}
+
+/* ************************************************************************** */
+
 NotificationUpdate::NotificationUpdate (const std::string& t,
                                         const Json::Value& s)
   : valid(true), type(t), newState(s)
@@ -521,6 +1123,9 @@ NotificationUpdate::NotificationUpdate (const gloox::Tag& t)
   if (!DecodeXmlJson (t, newState))
     return;
 
+  received = ParseTimestamp (t, "received");
+  published = ParseTimestamp (t, "published");
+
   valid = true;
 }
 
@@ -533,6 +1138,12 @@ NotificationUpdate::CreateTag () const
   CHECK (res->setXmlns (XMLNS));
   CHECK (res->addAttribute ("type", type));
 
+  if (HasTimestamps ())
+    {
+      CHECK (res->addAttribute ("received", std::to_string (received)));
+      CHECK (res->addAttribute ("published", std::to_string (published)));
+    }
+
   return res;
 }
 
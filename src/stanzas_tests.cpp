@@ -59,6 +59,83 @@ ExtensionRoundtrip (const T& ext)
 
 /* ************************************************************************** */
 
+using CapabilitiesTests = testing::Test;
+
+TEST_F (CapabilitiesTests, GetAndSet)
+{
+  Capabilities c;
+  EXPECT_TRUE (c.IsEmpty ());
+  EXPECT_EQ (c.Get ("foo"), 0u);
+  EXPECT_FALSE (c.Has ("foo"));
+
+  c.Set ("foo", 2);
+  EXPECT_EQ (c.Get ("foo"), 2u);
+  EXPECT_TRUE (c.Has ("foo"));
+  EXPECT_TRUE (c.Has ("foo", 2));
+  EXPECT_FALSE (c.Has ("foo", 3));
+
+  c.Set ("foo", 0);
+  EXPECT_TRUE (c.IsEmpty ());
+}
+
+TEST_F (CapabilitiesTests, Intersect)
+{
+  Capabilities a;
+  a.Set ("both", 3);
+  a.Set ("only a", 1);
+
+  Capabilities b;
+  b.Set ("both", 2);
+  b.Set ("only b", 1);
+
+  Capabilities expected;
+  expected.Set ("both", 2);
+
+  EXPECT_EQ (a.Intersect (b), expected);
+  EXPECT_EQ (b.Intersect (a), expected);
+}
+
+TEST_F (CapabilitiesTests, TagRoundtrip)
+{
+  Capabilities c;
+  c.Set ("foo", 1);
+  c.Set ("bar", 42);
+
+  gloox::Tag tag("ping");
+  c.AddToTag (tag);
+  EXPECT_EQ (Capabilities::FromTag (tag), c);
+}
+
+TEST_F (CapabilitiesTests, InvalidEntries)
+{
+  gloox::Tag tag("ping");
+  auto* child = new gloox::Tag (&tag, "capability");
+  child->addAttribute ("name", "foo");
+  child->addAttribute ("version", "x");
+  child = new gloox::Tag (&tag, "capability");
+  child->addAttribute ("version", "1");
+  child = new gloox::Tag (&tag, "capability");
+  child->addAttribute ("name", "bar");
+  child->addAttribute ("version", "5");
+
+  Capabilities expected;
+  expected.Set ("bar", 5);
+  EXPECT_EQ (Capabilities::FromTag (tag), expected);
+}
+
+TEST_F (CapabilitiesTests, Legacy)
+{
+  const gloox::Tag tag("ping");
+  EXPECT_EQ (Capabilities::FromTag (tag), Capabilities::Legacy ());
+  EXPECT_TRUE (Capabilities::Legacy ().GetEncodingOptions ().allowCompression);
+
+  Capabilities none;
+  none.Set ("foo", 1);
+  EXPECT_FALSE (none.GetEncodingOptions ().allowCompression);
+}
+
+/* ************************************************************************** */
+
 using RpcRequestTests = testing::Test;
 
 TEST_F (RpcRequestTests, ParamsArray)
@@ -88,6 +165,28 @@ TEST_F (RpcRequestTests, ParamsObject)
   ASSERT_TRUE (recreated->IsValid ());
   EXPECT_EQ (recreated->GetMethod (), "method");
   EXPECT_EQ (recreated->GetParams (), params);
+  EXPECT_EQ (recreated->GetId (), "");
+}
+
+TEST_F (RpcRequestTests, WithId)
+{
+  const auto params = ParseJson ("[]");
+  RpcRequest original("method", params);
+  original.SetId ("abc123");
+
+  auto recreated = ExtensionRoundtrip (original);
+  ASSERT_TRUE (recreated->IsValid ());
+  EXPECT_EQ (recreated->GetMethod (), "method");
+  EXPECT_EQ (recreated->GetId (), "abc123");
+}
+
+TEST_F (RpcRequestTests, IdTooLong)
+{
+  const RpcRequest original("method", ParseJson ("[]"));
+  std::unique_ptr<gloox::Tag> tag(original.tag ());
+  tag->addAttribute ("id", std::string (RpcRequest::MAX_ID_LENGTH + 1, 'x'));
+
+  EXPECT_FALSE (RpcRequest (*tag).IsValid ());
 }
 
 /* ************************************************************************** */
@@ -110,6 +209,36 @@ TEST_F (RpcResponseTests, Success)
   ASSERT_TRUE (recreated->IsValid ());
   ASSERT_TRUE (recreated->IsSuccess ());
   EXPECT_EQ (recreated->GetResult (), result);
+  EXPECT_FALSE (recreated->IsStale ());
+}
+
+TEST_F (RpcResponseTests, StaleSuccess)
+{
+  RpcResponse original(ParseJson ("[1, 2, 3]"));
+  original.SetStale (true);
+  ASSERT_TRUE (original.IsStale ());
+
+  auto recreated = ExtensionRoundtrip (original);
+  ASSERT_TRUE (recreated->IsValid ());
+  ASSERT_TRUE (recreated->IsSuccess ());
+  EXPECT_TRUE (recreated->IsStale ());
+  EXPECT_EQ (recreated->GetResult (), ParseJson ("[1, 2, 3]"));
+}
+
+TEST_F (RpcResponseTests, Cursor)
+{
+  const RpcResponse complete(ParseJson ("[1, 2, 3]"));
+  auto recreated = ExtensionRoundtrip (complete);
+  ASSERT_TRUE (recreated->IsValid ());
+  EXPECT_EQ (recreated->GetCursor (), "");
+
+  RpcResponse original(ParseJson ("[1, 2]"));
+  original.SetCursor ("abc");
+  recreated = ExtensionRoundtrip (original);
+  ASSERT_TRUE (recreated->IsValid ());
+  ASSERT_TRUE (recreated->IsSuccess ());
+  EXPECT_EQ (recreated->GetCursor (), "abc");
+  EXPECT_EQ (recreated->GetResult (), ParseJson ("[1, 2]"));
 }
 
 TEST_F (RpcResponseTests, ErrorWithData)
@@ -148,6 +277,27 @@ TEST_F (RpcResponseTests, ErrorOnlyCode)
 
 /* ************************************************************************** */
 
+using PingMessageTests = testing::Test;
+
+TEST_F (PingMessageTests, Capabilities)
+{
+  PingMessage original;
+  original.SetCapabilities (Capabilities::Own ());
+
+  auto recreated = ExtensionRoundtrip (original);
+  ASSERT_TRUE (recreated->IsValid ());
+  EXPECT_EQ (recreated->GetCapabilities (), Capabilities::Own ());
+}
+
+TEST_F (PingMessageTests, LegacyPing)
+{
+  auto recreated = ExtensionRoundtrip (PingMessage ());
+  ASSERT_TRUE (recreated->IsValid ());
+  EXPECT_EQ (recreated->GetCapabilities (), Capabilities::Legacy ());
+}
+
+/* ************************************************************************** */
+
 using PongMessageTests = testing::Test;
 
 TEST_F (PongMessageTests, WithoutVersion)
@@ -169,6 +319,30 @@ TEST_F (PongMessageTests, WithVersion)
 
   ASSERT_TRUE (recreated->IsValid ());
   EXPECT_EQ (recreated->GetVersion (), "version");
+  EXPECT_EQ (recreated->GetTime (), 0);
+}
+
+TEST_F (PongMessageTests, WithTime)
+{
+  PongMessage original("version");
+  original.SetTime (1234567890123);
+  auto recreated = ExtensionRoundtrip (original);
+
+  ASSERT_TRUE (recreated->IsValid ());
+  EXPECT_EQ (recreated->GetTime (), 1234567890123);
+}
+
+TEST_F (PongMessageTests, Capabilities)
+{
+  Capabilities caps;
+  caps.Set ("foo", 3);
+
+  PongMessage original("version");
+  original.SetCapabilities (caps);
+
+  auto recreated = ExtensionRoundtrip (original);
+  ASSERT_TRUE (recreated->IsValid ());
+  EXPECT_EQ (recreated->GetCapabilities (), caps);
 }
 
 /* ************************************************************************** */
@@ -200,6 +374,164 @@ TEST_F (SupportedNotificationsTests, WithNotifications)
   ));
 }
 
+TEST_F (SupportedNotificationsTests, Direct)
+{
+  SupportedNotifications original("pubsub service");
+  EXPECT_FALSE (ExtensionRoundtrip (original)->SupportsDirect ());
+
+  original.SetDirect (true);
+  auto recreated = ExtensionRoundtrip (original);
+  ASSERT_TRUE (recreated->IsValid ());
+  EXPECT_TRUE (recreated->SupportsDirect ());
+}
+
+TEST_F (SupportedNotificationsTests, Alternatives)
+{
+  SupportedNotifications original("pubsub service");
+  original.AddNotification ("state", "state node");
+  original.AddAlternative ("other service", "state", "other state");
+  original.AddAlternative ("other service", "pending", "other pending");
+  original.AddAlternative ("third service", "state", "third state");
+  auto recreated = ExtensionRoundtrip (original);
+
+  ASSERT_TRUE (recreated->IsValid ());
+  EXPECT_THAT (recreated->GetNotifications (), ElementsAre (
+    std::make_pair ("state", "state node")
+  ));
+
+  const auto& alt = recreated->GetAlternatives ();
+  ASSERT_EQ (alt.size (), 2u);
+  EXPECT_THAT (alt.at ("other service"), ElementsAre (
+    std::make_pair ("pending", "other pending"),
+    std::make_pair ("state", "other state")
+  ));
+  EXPECT_THAT (alt.at ("third service"), ElementsAre (
+    std::make_pair ("state", "third state")
+  ));
+}
+
+/* ************************************************************************** */
+
+using FilterRegistrationTests = testing::Test;
+
+TEST_F (FilterRegistrationTests, Request)
+{
+  const auto spec = ParseJson (R"({"path": "/pending", "keys": ["domob"]})");
+  FilterRegistration original("pending", spec);
+  auto recreated = ExtensionRoundtrip (original);
+
+  ASSERT_TRUE (recreated->IsValid ());
+  EXPECT_EQ (recreated->GetType (), "pending");
+  EXPECT_EQ (recreated->GetSpec (), spec);
+  EXPECT_EQ (recreated->GetNode (), "");
+}
+
+TEST_F (FilterRegistrationTests, Response)
+{
+  FilterRegistration original("pending", std::string ("filter node"));
+  auto recreated = ExtensionRoundtrip (original);
+
+  ASSERT_TRUE (recreated->IsValid ());
+  EXPECT_EQ (recreated->GetType (), "pending");
+  EXPECT_TRUE (recreated->GetSpec ().isNull ());
+  EXPECT_EQ (recreated->GetNode (), "filter node");
+}
+
+/* ************************************************************************** */
+
+using DirectRegistrationTests = testing::Test;
+
+TEST_F (DirectRegistrationTests, Empty)
+{
+  DirectRegistration original;
+  auto recreated = ExtensionRoundtrip (original);
+
+  ASSERT_TRUE (recreated->IsValid ());
+  EXPECT_THAT (recreated->GetNotifications (), IsEmpty ());
+}
+
+TEST_F (DirectRegistrationTests, WithNotifications)
+{
+  const auto spec = ParseJson (R"({"path": "/pending", "keys": ["domob"]})");
+
+  DirectRegistration original;
+  original.AddNotification ("state", Json::Value ());
+  original.AddNotification ("pending", spec);
+  auto recreated = ExtensionRoundtrip (original);
+
+  ASSERT_TRUE (recreated->IsValid ());
+  EXPECT_THAT (recreated->GetNotifications (), ElementsAre (
+    std::make_pair ("pending", spec),
+    std::make_pair ("state", Json::Value ())
+  ));
+}
+
+TEST_F (DirectRegistrationTests, MissingType)
+{
+  gloox::Tag tag("direct");
+  tag.addChild (new gloox::Tag ("notification"));
+  EXPECT_FALSE (DirectRegistration (tag).IsValid ());
+}
+
+/* ************************************************************************** */
+
+using PushedUpdateTests = testing::Test;
+
+TEST_F (PushedUpdateTests, Roundtrip)
+{
+  NotificationUpdate upd("state", "data");
+  upd.SetTimestamps (1000, 1005);
+
+  const PushedUpdate original(*upd.CreateTag ());
+  auto recreated = ExtensionRoundtrip (original);
+  ASSERT_TRUE (recreated->IsValid ());
+
+  const NotificationUpdate parsed(recreated->GetUpdate ());
+  ASSERT_TRUE (parsed.IsValid ());
+  EXPECT_EQ (parsed.GetType (), "state");
+  EXPECT_EQ (parsed.GetState (), "data");
+  EXPECT_EQ (parsed.GetReceived (), 1000);
+}
+
+/* ************************************************************************** */
+
+using PageRequestTests = testing::Test;
+
+TEST_F (PageRequestTests, Roundtrip)
+{
+  const PageRequest original("abc", 42);
+  auto recreated = ExtensionRoundtrip (original);
+
+  ASSERT_TRUE (recreated->IsValid ());
+  EXPECT_EQ (recreated->GetCursor (), "abc");
+  EXPECT_EQ (recreated->GetOffset (), 42);
+}
+
+TEST_F (PageRequestTests, MissingCursor)
+{
+  gloox::Tag tag("page");
+  tag.addAttribute ("offset", "0");
+  EXPECT_FALSE (PageRequest (tag).IsValid ());
+}
+
+TEST_F (PageRequestTests, InvalidOffset)
+{
+  for (const std::string str : {"", "-1", "+1", "1x", "x", "1.5"})
+    {
+      gloox::Tag tag("page");
+      tag.addAttribute ("cursor", "abc");
+      if (!str.empty ())
+        tag.addAttribute ("offset", str);
+      EXPECT_FALSE (PageRequest (tag).IsValid ()) << str;
+    }
+
+  gloox::Tag tag("page");
+  tag.addAttribute ("cursor", "abc");
+  tag.addAttribute ("offset", "0");
+  ASSERT_TRUE (PageRequest (tag).IsValid ());
+  EXPECT_EQ (PageRequest (tag).GetOffset (), 0);
+}
+
 /* ************************************************************************** */
 
 class NotificationUpdateTests : public testing::Test
@@ -239,6 +571,32 @@ TEST_F (NotificationUpdateTests, ObjectData)
   TestRoundtrip ("pending", data);
 }
 
+TEST_F (NotificationUpdateTests, Timestamps)
+{
+  NotificationUpdate original("state", "data");
+  EXPECT_FALSE (original.HasTimestamps ());
+  EXPECT_FALSE (original.CreateTag ()->hasAttribute ("received"));
+
+  original.SetTimestamps (1000, 1005);
+  const NotificationUpdate recreated(*original.CreateTag ());
+  ASSERT_TRUE (recreated.IsValid ());
+  ASSERT_TRUE (recreated.HasTimestamps ());
+  EXPECT_EQ (recreated.GetReceived (), 1000);
+  EXPECT_EQ (recreated.GetPublished (), 1005);
+}
+
+TEST_F (NotificationUpdateTests, InvalidTimestamps)
+{
+  auto tag = NotificationUpdate ("state", "data").CreateTag ();
+  tag->addAttribute ("received", "foo");
+  tag->addAttribute ("published", "100");
+
+  const NotificationUpdate upd(*tag);
+  ASSERT_TRUE (upd.IsValid ());
+  EXPECT_FALSE (upd.HasTimestamps ());
+  EXPECT_EQ (upd.GetPublished (), 100);
+}
+
 /* ************************************************************************** */
 
 } // anonymous namespace
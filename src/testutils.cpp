@@ -21,6 +21,8 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <jsonrpccpp/common/errors.h>
+
 #include <glog/logging.h>
 
 #include <experimental/filesystem>
@@ -48,6 +50,7 @@ const ServerConfiguration LOCAL_SERVER =
   {
     "localhost",
     "pubsub.localhost",
+    "pubsub2.localhost",
     "testenv.pem",
     {
       {"xmpptest1", "password"},
@@ -66,6 +69,7 @@ const ServerConfiguration PROD_SERVER =
   {
     "chat.xaya.io",
     "pubsub.chat.xaya.io",
+    nullptr,
     "letsencrypt.pem",
     {
       {
@@ -162,9 +166,35 @@ TestBackend::HandleMethod (const std::string& method, const Json::Value& params)
   if (method == "error")
     throw Error (42, params[0].asString (), Json::Value ());
 
+  if (method == "count")
+    return params[0].asString () + " " + std::to_string (++counted);
+
+  if (method == "unreachable")
+    throw Error (jsonrpc::Errors::ERROR_CLIENT_CONNECTOR,
+                 params[0].asString (), Json::Value ());
+
+  if (method == "chars")
+    {
+      Json::Value res(Json::arrayValue);
+      for (const char c : params[0].asString ())
+        res.append (std::string (1, c));
+      return res;
+    }
+
   LOG (FATAL) << "Unexpected method: " << method;
 }
 
+Json::Value
+TestBackend::HandleMethodAllowStale (const std::string& method,
+                                     const Json::Value& params, bool& stale)
+{
+  stale = (method == "unreachable");
+  if (stale)
+    return params[0];
+
+  return HandleMethod (method, params);
+}
+
 /* ************************************************************************** */
 
 ReceivedMessages::~ReceivedMessages ()
@@ -293,10 +323,15 @@ std::unique_ptr<WaiterThread>
 UpdatableState::NewWaiter (const std::string& type)
 {
   auto notification = std::make_unique<Notification> (type);
-  CHECK (!self.expired ());
-  auto waiter = std::make_unique<Waiter> (self.lock ());
   return std::make_unique<WaiterThread> (std::move (notification),
-                                         std::move (waiter));
+                                         NewUpdateWaiter ());
+}
+
+std::unique_ptr<UpdateWaiter>
+UpdatableState::NewUpdateWaiter ()
+{
+  CHECK (!self.expired ());
+  return std::make_unique<Waiter> (self.lock ());
 }
 
 /* ************************************************************************** */
@@ -26,6 +26,7 @@
 
 #include <json/json.h>
 
+#include <atomic>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
@@ -61,6 +62,12 @@ struct ServerConfiguration
   /** The pubsub service.  */
   const char* pubsub;
 
+  /**
+   * A second pubsub service on the same server (for tests with several
+   * services), or null if there is none.
+   */
+  const char* altPubsub;
+
   /**
    * The CA certificate file (relative to the repository "data" folder)
    * that is used by the test server.
@@ -110,14 +117,23 @@ gloox::JID JIDWithResource (const TestAccount& acc, const std::string& res);
 Json::Value ParseJson (const std::string& str);
 
 /**
- * Backend for answering RPC calls in a dummy fashion.  It supports two
- * methods (both accept a single string as positional argument):  "echo"
+ * Backend for answering RPC calls in a dummy fashion.  It supports these
+ * methods (all accept a single string as positional argument):  "echo"
  * returns the argument back to the caller, while "error" throws a JSON-RPC
- * error with the string as message.
+ * error with the string as message.  "count" returns the argument followed
+ * by the number of "count" calls made so far, so that tests can tell
+ * whether a call has been executed again.  "chars" returns an array
+ * with the characters of the argument as strings.  "unreachable" fails
+ * as if the backend could not be reached.
  */
 class TestBackend : public RpcServer
 {
 
+private:
+
+  /** Number of "count" calls so far.  */
+  std::atomic<unsigned> counted{0};
+
 public:
 
   TestBackend () = default;
@@ -125,6 +141,14 @@ public:
   Json::Value HandleMethod (const std::string& method,
                             const Json::Value& params) override;
 
+  /**
+   * Answers "unreachable" with its argument as stale result, and all other
+   * methods like HandleMethod.
+   */
+  Json::Value HandleMethodAllowStale (const std::string& method,
+                                      const Json::Value& params,
+                                      bool& stale) override;
+
 };
 
 /**
@@ -237,6 +261,12 @@ public:
    */
   std::unique_ptr<WaiterThread> NewWaiter (const std::string& type);
 
+  /**
+   * Constructs just an UpdateWaiter for this state (e.g. to combine
+   * it with others).  It holds a reference to this instance.
+   */
+  std::unique_ptr<UpdateWaiter> NewUpdateWaiter ();
+
   /**
    * Updates the current state.
    */
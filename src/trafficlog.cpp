@@ -0,0 +1,333 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "trafficlog.hpp"
+
+#include <glog/logging.h>
+
+#include <chrono>
+#include <sstream>
+
+namespace charon
+{
+
+namespace
+{
+
+/** Magic bytes at the start of a traffic log.  */
+const std::string MAGIC = "CHARONTL";
+
+/** Format version written after the magic bytes.  */
+constexpr char VERSION = 1;
+
+/** Flag bit for records of calls that returned an error.  */
+constexpr unsigned char FLAG_ERROR = 1;
+
+/** Interval at which the writer thread writes buffered records.  */
+constexpr auto FLUSH_INTERVAL = std::chrono::seconds (1);
+
+/**
+ * Size of buffered data at which the writer thread is woken up right away
+ * instead of waiting for the next interval.
+ */
+constexpr size_t FLUSH_THRESHOLD = 1 << 16;
+
+/**
+ * Maximum size of buffered data.  If the writer thread cannot keep up
+ * and the buffer is full, further records are dropped.
+ */
+constexpr size_t MAX_BUFFERED = 1 << 24;
+
+void
+WriteVarint (std::ostream& out, std::uint64_t val)
+{
+  while (val >= 0x80)
+    {
+      out.put (static_cast<char> ((val & 0x7F) | 0x80));
+      val >>= 7;
+    }
+  out.put (static_cast<char> (val));
+}
+
+void
+WriteSigned (std::ostream& out, const std::int64_t val)
+{
+  /* Zig-zag encoding, so that small negative numbers are small as well.  */
+  const auto uval = static_cast<std::uint64_t> (val);
+  WriteVarint (out, (uval << 1) ^ (val < 0 ? ~std::uint64_t (0) : 0));
+}
+
+void
+WriteString (std::ostream& out, const std::string& str)
+{
+  WriteVarint (out, str.size ());
+  out.write (str.data (), str.size ());
+}
+
+bool
+ReadVarint (std::istream& in, std::uint64_t& val)
+{
+  val = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+      const int c = in.get ();
+      if (c == std::istream::traits_type::eof ())
+        return false;
+
+      val |= static_cast<std::uint64_t> (c & 0x7F) << shift;
+      if ((c & 0x80) == 0)
+        return true;
+    }
+
+  LOG (WARNING) << "Invalid varint in traffic log";
+  return false;
+}
+
+bool
+ReadSigned (std::istream& in, std::int64_t& val)
+{
+  std::uint64_t uval;
+  if (!ReadVarint (in, uval))
+    return false;
+
+  val = static_cast<std::int64_t> (uval >> 1);
+  if (uval & 1)
+    val = ~val;
+
+  return true;
+}
+
+/**
+ * Reads a length-prefixed string.  The length must not exceed maxLen (the
+ * remaining size of the file), so that corrupt data does not make us
+ * allocate huge amounts of memory.
+ */
+bool
+ReadString (std::istream& in, const std::uint64_t maxLen, std::string& str)
+{
+  std::uint64_t len;
+  if (!ReadVarint (in, len))
+    return false;
+
+  if (len > maxLen)
+    {
+      LOG (WARNING)
+          << "String length " << len << " in traffic log exceeds the"
+          << " remaining " << maxLen << " bytes";
+      return false;
+    }
+
+  str.resize (len);
+  in.read (&str[0], len);
+
+  return in.gcount () == static_cast<std::streamsize> (len);
+}
+
+} // anonymous namespace
+
+/* ************************************************************************** */
+
+TrafficRecorder::TrafficRecorder (const std::string& file, const double rate)
+  : out(file, std::ios::binary | std::ios::trunc), sampleRate(rate),
+    rnd(std::random_device () ())
+{
+  CHECK (out) << "Failed to open traffic log " << file;
+  CHECK (sampleRate >= 0.0 && sampleRate <= 1.0)
+      << "Invalid sample rate: " << sampleRate;
+
+  LOG (INFO)
+      << "Recording " << (100.0 * sampleRate) << "% of requests to "
+      << file;
+
+  out.write (MAGIC.data (), MAGIC.size ());
+  out.put (VERSION);
+  out.flush ();
+
+  writer = std::thread ([this] ()
+    {
+      RunWriter ();
+    });
+}
+
+TrafficRecorder::~TrafficRecorder ()
+{
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    shouldStop = true;
+    cvWriter.notify_all ();
+  }
+
+  writer.join ();
+  Flush ();
+
+  if (dropped > 0)
+    LOG (WARNING) << "Dropped " << dropped << " records from the traffic log";
+}
+
+void
+TrafficRecorder::RunWriter ()
+{
+  std::unique_lock<std::mutex> lock(mut);
+  while (!shouldStop)
+    {
+      cvWriter.wait_for (lock, FLUSH_INTERVAL, [this] ()
+        {
+          return shouldStop || buffer.size () >= FLUSH_THRESHOLD;
+        });
+
+      lock.unlock ();
+      Flush ();
+      lock.lock ();
+    }
+}
+
+void
+TrafficRecorder::Flush ()
+{
+  std::lock_guard<std::mutex> lockFile(mutFile);
+
+  std::string data;
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    data.swap (buffer);
+  }
+
+  if (data.empty ())
+    return;
+
+  out.write (data.data (), data.size ());
+  out.flush ();
+}
+
+bool
+TrafficRecorder::Sample ()
+{
+  if (sampleRate >= 1.0)
+    return true;
+  if (sampleRate <= 0.0)
+    return false;
+
+  std::lock_guard<std::mutex> lock(mut);
+  return std::bernoulli_distribution (sampleRate) (rnd);
+}
+
+void
+TrafficRecorder::Record (const TrafficRecord& r)
+{
+  /* The params (which may be large) are serialised before taking the lock.
+     The rest depends on lastTimestamp and is cheap.  */
+  Json::StreamWriterBuilder wbuilder;
+  wbuilder["commentStyle"] = "None";
+  wbuilder["indentation"] = "";
+  const std::string params = Json::writeString (wbuilder, r.params);
+
+  std::lock_guard<std::mutex> lock(mut);
+
+  std::ostringstream buf;
+  WriteSigned (buf, r.timestamp - lastTimestamp);
+  WriteString (buf, r.method);
+  WriteString (buf, params);
+  WriteVarint (buf, r.requestSize);
+  WriteVarint (buf, r.responseSize);
+  WriteVarint (buf, r.duration);
+  buf.put (r.error ? FLAG_ERROR : 0);
+
+  /* Records are only written by the writer thread, so that requests are
+     not delayed by disk I/O.  */
+  const std::string data = buf.str ();
+  if (buffer.size () + data.size () > MAX_BUFFERED)
+    {
+      ++dropped;
+      return;
+    }
+  buffer += data;
+  if (buffer.size () >= FLUSH_THRESHOLD)
+    cvWriter.notify_all ();
+
+  lastTimestamp = r.timestamp;
+  ++recorded;
+}
+
+std::uint64_t
+TrafficRecorder::GetRecorded () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return recorded;
+}
+
+/* ************************************************************************** */
+
+TrafficLogReader::TrafficLogReader (const std::string& file)
+  : in(file, std::ios::binary | std::ios::ate)
+{
+  CHECK (in) << "Failed to open traffic log " << file;
+  fileSize = in.tellg ();
+  in.seekg (0);
+
+  std::string magic(MAGIC.size (), '\0');
+  in.read (&magic[0], magic.size ());
+  CHECK (in && magic == MAGIC) << "Not a traffic log: " << file;
+
+  const int version = in.get ();
+  CHECK_EQ (version, VERSION) << "Unsupported traffic log version";
+}
+
+std::uint64_t
+TrafficLogReader::GetRemaining ()
+{
+  const auto pos = in.tellg ();
+  if (pos < 0 || static_cast<std::uint64_t> (pos) > fileSize)
+    return 0;
+  return fileSize - pos;
+}
+
+bool
+TrafficLogReader::Next (TrafficRecord& r)
+{
+  if (in.peek () == std::istream::traits_type::eof ())
+    return false;
+
+  std::int64_t delta;
+  std::string params;
+  int flags;
+  if (!ReadSigned (in, delta)
+        || !ReadString (in, GetRemaining (), r.method)
+        || !ReadString (in, GetRemaining (), params)
+        || !ReadVarint (in, r.requestSize)
+        || !ReadVarint (in, r.responseSize)
+        || !ReadVarint (in, r.duration)
+        || (flags = in.get ()) == std::istream::traits_type::eof ())
+    {
+      LOG (WARNING) << "Ignoring truncated record at the end of traffic log";
+      return false;
+    }
+
+  Json::CharReaderBuilder rbuilder;
+  std::string parseErrs;
+  std::istringstream paramsIn(params);
+  CHECK (Json::parseFromStream (rbuilder, paramsIn, &r.params, &parseErrs))
+      << "Invalid params in traffic log: " << parseErrs;
+
+  lastTimestamp += delta;
+  r.timestamp = lastTimestamp;
+  r.error = (flags & FLAG_ERROR) != 0;
+
+  return true;
+}
+
+} // namespace charon
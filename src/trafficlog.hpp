@@ -0,0 +1,214 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_TRAFFICLOG_HPP
+#define CHARON_TRAFFICLOG_HPP
+
+#include <json/json.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace charon
+{
+
+/**
+ * Metadata about a single request handled by the server, as stored in
+ * a traffic log.
+ */
+struct TrafficRecord
+{
+
+  /** Time the request was received, in milliseconds since the Unix epoch.  */
+  std::int64_t timestamp = 0;
+
+  /** The method called.  */
+  std::string method;
+
+  /** The parameters of the call.  */
+  Json::Value params;
+
+  /** Size of the serialised parameters in bytes.  */
+  std::uint64_t requestSize = 0;
+
+  /** Size of the serialised result (or error) in bytes.  */
+  std::uint64_t responseSize = 0;
+
+  /** Time it took to handle the request, in microseconds.  */
+  std::uint64_t duration = 0;
+
+  /** Whether the call returned a JSON-RPC error.  */
+  bool error = false;
+
+};
+
+/**
+ * Records sampled requests to a compact binary log file.  The file starts
+ * with a header identifying the format, followed by the records, each of
+ * which has its integers encoded as variable-length integers and the
+ * method and (compactly serialised) params as length-prefixed strings.
+ * Timestamps are stored as difference to the previous record.
+ *
+ * Records are buffered in memory and written to the file by a background
+ * thread (periodically or when enough data is buffered), so that callers
+ * never wait for the disk.  If the process is killed, the records of
+ * the last moments may be lost.
+ *
+ * All methods are thread-safe.
+ */
+class TrafficRecorder
+{
+
+private:
+
+  /** The output file.  This is only accessed with mutFile held.  */
+  std::ofstream out;
+
+  /**
+   * Lock for writing to the file.  If both are needed, it is acquired
+   * before mut, so that buffered data is written in order.
+   */
+  std::mutex mutFile;
+
+  /** The fraction of requests to record.  */
+  const double sampleRate;
+
+  /** Timestamp of the last record written.  */
+  std::int64_t lastTimestamp = 0;
+
+  /** Number of records written.  */
+  std::uint64_t recorded = 0;
+
+  /** Number of records dropped because the buffer was full.  */
+  std::uint64_t dropped = 0;
+
+  /** Serialised records that have not been written to the file yet.  */
+  std::string buffer;
+
+  /** Set to true when the writer thread should stop.  */
+  bool shouldStop = false;
+
+  /** Condition variable (for mut) to wake up the writer thread.  */
+  std::condition_variable cvWriter;
+
+  /** The thread writing buffered records to the file.  */
+  std::thread writer;
+
+  /** Random generator for the sampling.  */
+  std::mt19937_64 rnd;
+
+  /** Lock for this instance.  */
+  mutable std::mutex mut;
+
+  /**
+   * Runs the writer thread's loop.
+   */
+  void RunWriter ();
+
+public:
+
+  /**
+   * Opens a new log (overwriting any existing file) that records the
+   * given fraction (between 0 and 1) of requests.
+   */
+  explicit TrafficRecorder (const std::string& file, double rate);
+
+  /**
+   * Stops the writer thread and writes all remaining records.
+   */
+  ~TrafficRecorder ();
+
+  TrafficRecorder () = delete;
+  TrafficRecorder (const TrafficRecorder&) = delete;
+  void operator= (const TrafficRecorder&) = delete;
+
+  /**
+   * Decides whether or not the next request should be recorded.  This is
+   * separate from Record, so that callers can skip collecting the data
+   * for requests that are not sampled.
+   */
+  bool Sample ();
+
+  /**
+   * Adds a record to the log.  It is buffered, and written to the file
+   * later on by the writer thread.
+   */
+  void Record (const TrafficRecord& r);
+
+  /**
+   * Writes all buffered records to the file right away.
+   */
+  void Flush ();
+
+  /**
+   * Returns the number of records added so far.
+   */
+  std::uint64_t GetRecorded () const;
+
+};
+
+/**
+ * Reads back a log written by TrafficRecorder.
+ */
+class TrafficLogReader
+{
+
+private:
+
+  /** The input file.  */
+  std::ifstream in;
+
+  /** Total size of the file.  */
+  std::uint64_t fileSize;
+
+  /** Timestamp of the last record read.  */
+  std::int64_t lastTimestamp = 0;
+
+  /**
+   * Returns the number of bytes left to read in the file.
+   */
+  std::uint64_t GetRemaining ();
+
+public:
+
+  /**
+   * Opens the given log file.  The file must exist and have a valid header.
+   */
+  explicit TrafficLogReader (const std::string& file);
+
+  TrafficLogReader () = delete;
+  TrafficLogReader (const TrafficLogReader&) = delete;
+  void operator= (const TrafficLogReader&) = delete;
+
+  /**
+   * Reads the next record.  Returns false if there are no more records.
+   * A truncated record at the end (e.g. if the server was killed while
+   * writing it) is ignored.
+   */
+  bool Next (TrafficRecord& r);
+
+};
+
+} // namespace charon
+
+#endif // CHARON_TRAFFICLOG_HPP
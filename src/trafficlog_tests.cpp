@@ -0,0 +1,197 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "trafficlog.hpp"
+
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <experimental/filesystem>
+
+#include <fstream>
+#include <vector>
+
+namespace charon
+{
+namespace
+{
+
+namespace fs = std::experimental::filesystem;
+
+class TrafficLogTests : public testing::Test
+{
+
+protected:
+
+  /** Temporary file used for the log.  */
+  const std::string file;
+
+  TrafficLogTests ()
+    : file((fs::temp_directory_path () / "charon-trafficlog-test").string ())
+  {}
+
+  ~TrafficLogTests ()
+  {
+    fs::remove (file);
+  }
+
+  /**
+   * Reads all records from our log file.
+   */
+  std::vector<TrafficRecord>
+  ReadAll () const
+  {
+    TrafficLogReader reader(file);
+
+    std::vector<TrafficRecord> res;
+    TrafficRecord r;
+    while (reader.Next (r))
+      res.push_back (r);
+
+    return res;
+  }
+
+};
+
+TrafficRecord
+MakeRecord (const std::int64_t timestamp, const std::string& method,
+            const std::string& params)
+{
+  TrafficRecord res;
+  res.timestamp = timestamp;
+  res.method = method;
+  res.params = ParseJson (params);
+  res.requestSize = params.size ();
+  res.responseSize = 1000 + timestamp;
+  res.duration = 42;
+  return res;
+}
+
+TEST_F (TrafficLogTests, Empty)
+{
+  {
+    TrafficRecorder rec(file, 1.0);
+  }
+
+  EXPECT_TRUE (ReadAll ().empty ());
+}
+
+TEST_F (TrafficLogTests, Roundtrip)
+{
+  {
+    TrafficRecorder rec(file, 1.0);
+    rec.Record (MakeRecord (1600000000000, "getstate", "[]"));
+    rec.Record (MakeRecord (1600000000005, "echo", R"(["fooä"])"));
+    /* Timestamps may go backwards slightly between threads.  */
+    auto err = MakeRecord (1600000000003, "error", R"({"a": [1, 2]})");
+    err.error = true;
+    err.duration = 1 << 30;
+    rec.Record (err);
+    EXPECT_EQ (rec.GetRecorded (), 3u);
+  }
+
+  const auto records = ReadAll ();
+  ASSERT_EQ (records.size (), 3u);
+
+  EXPECT_EQ (records[0].timestamp, 1600000000000);
+  EXPECT_EQ (records[0].method, "getstate");
+  EXPECT_EQ (records[0].params, ParseJson ("[]"));
+  EXPECT_EQ (records[0].requestSize, 2u);
+  EXPECT_FALSE (records[0].error);
+
+  EXPECT_EQ (records[1].timestamp, 1600000000005);
+  EXPECT_EQ (records[1].method, "echo");
+  EXPECT_EQ (records[1].params, ParseJson (R"(["fooä"])"));
+  EXPECT_EQ (records[1].responseSize, 1600000001005u);
+  EXPECT_EQ (records[1].duration, 42u);
+
+  EXPECT_EQ (records[2].timestamp, 1600000000003);
+  EXPECT_EQ (records[2].params, ParseJson (R"({"a": [1, 2]})"));
+  EXPECT_EQ (records[2].duration, 1u << 30);
+  EXPECT_TRUE (records[2].error);
+}
+
+TEST_F (TrafficLogTests, Sampling)
+{
+  {
+    TrafficRecorder rec(file, 0.0);
+    for (unsigned i = 0; i < 100; ++i)
+      EXPECT_FALSE (rec.Sample ());
+  }
+
+  {
+    TrafficRecorder rec(file, 1.0);
+    for (unsigned i = 0; i < 100; ++i)
+      EXPECT_TRUE (rec.Sample ());
+  }
+
+  TrafficRecorder rec(file, 0.5);
+  unsigned sampled = 0;
+  for (unsigned i = 0; i < 1000; ++i)
+    if (rec.Sample ())
+      ++sampled;
+  EXPECT_GT (sampled, 350u);
+  EXPECT_LT (sampled, 650u);
+}
+
+TEST_F (TrafficLogTests, TruncatedRecord)
+{
+  {
+    TrafficRecorder rec(file, 1.0);
+    rec.Record (MakeRecord (10, "foo", "[1]"));
+    rec.Record (MakeRecord (20, "bar", R"(["some longer string"])"));
+  }
+
+  fs::resize_file (file, fs::file_size (file) - 5);
+
+  const auto records = ReadAll ();
+  ASSERT_EQ (records.size (), 1u);
+  EXPECT_EQ (records[0].method, "foo");
+}
+
+TEST_F (TrafficLogTests, CorruptStringLength)
+{
+  {
+    TrafficRecorder rec(file, 1.0);
+  }
+
+  /* A record with a timestamp delta of zero and a huge method length,
+     which must not be allocated.  */
+  {
+    std::ofstream out(file, std::ios::binary | std::ios::app);
+    out.put (0);
+    out << "\xff\xff\xff\xff\xff\xff\xff\x0f" << "foo";
+  }
+
+  EXPECT_TRUE (ReadAll ().empty ());
+}
+
+TEST_F (TrafficLogTests, Flush)
+{
+  TrafficRecorder rec(file, 1.0);
+  rec.Record (MakeRecord (10, "foo", "[1]"));
+  rec.Flush ();
+
+  const auto records = ReadAll ();
+  ASSERT_EQ (records.size (), 1u);
+  EXPECT_EQ (records[0].method, "foo");
+}
+
+} // anonymous namespace
+} // namespace charon
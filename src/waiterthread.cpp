@@ -29,12 +29,17 @@ namespace
 /** The default backoff time used for waiter calls.  */
 const auto DEFAULT_BACKOFF = std::chrono::seconds (5);
 
+/** Memory tag for the current states of waiter threads.  */
+MemoryTag memState("waiterstate");
+
 } // anonymous namespace
 
 WaiterThread::WaiterThread (std::unique_ptr<NotificationType> t,
                             std::unique_ptr<UpdateWaiter> w)
   : type(std::move (t)), waiter(std::move (w)),
-    backoff(DEFAULT_BACKOFF)
+    backoff(DEFAULT_BACKOFF), backingOff(false),
+    lastChange(Clock::now ().time_since_epoch ().count ()),
+    lastReceived(0), stateMemory(memState)
 {}
 
 WaiterThread::~WaiterThread ()
@@ -45,13 +50,14 @@ WaiterThread::~WaiterThread ()
 void
 WaiterThread::RunLoop ()
 {
-  using Clock = std::chrono::steady_clock;
   while (!shouldStop)
     {
       Json::Value result;
       const auto before = Clock::now ();
       if (!waiter->WaitForUpdate (result))
         {
+          backingOff = true;
+
           /* Make sure to wait for the backoff time to be elapsed in case
              the call failed.  We take the time of the call itself into account,
              though, to e.g. handle timeout errors better.  */
@@ -70,23 +76,28 @@ WaiterThread::RunLoop ()
           continue;
         }
 
+      backingOff = false;
       if (result.isNull ())
         continue;
+      const auto received = SystemClock::now ();
 
       std::lock_guard<std::mutex> lock(mut);
       const Json::Value newId = type->ExtractStateId (result);
 
-      if (!currentState.isNull ()
-            && type->ExtractStateId (currentState) == newId)
+      if (!currentState.IsNull () && currentStateId == newId)
         continue;
 
       VLOG (1)
           << "Found new best state ID for " << type->GetType ()
           << ": " << newId;
-      currentState = result;
+      currentState = CompactJson (result);
+      currentStateId = newId;
+      stateMemory.Set (currentState.GetSize ());
+      lastChange = Clock::now ().time_since_epoch ().count ();
+      lastReceived = received.time_since_epoch ().count ();
 
       if (cb)
-        cb (currentState);
+        cb (result);
     }
 }
 
@@ -96,8 +107,12 @@ WaiterThread::Start ()
   CHECK (loop == nullptr);
   LOG (INFO) << "Starting waiter thread for " << type->GetType () << "...";
 
-  currentState = Json::Value ();
+  currentState = CompactJson ();
+  currentStateId = Json::Value ();
+  stateMemory.Set (0);
   shouldStop = false;
+  backingOff = false;
+  lastChange = Clock::now ().time_since_epoch ().count ();
   loop = std::make_unique<std::thread> ([this] ()
     {
       RunLoop ();
@@ -122,7 +137,20 @@ WaiterThread::GetCurrentState () const
 {
   CHECK (loop != nullptr);
   std::lock_guard<std::mutex> lock(mut);
-  return currentState;
+  return currentState.ToJson ();
+}
+
+WaiterThread::Clock::duration
+WaiterThread::GetTimeSinceChange () const
+{
+  const Clock::time_point changed(Clock::duration (lastChange.load ()));
+  return Clock::now () - changed;
+}
+
+WaiterThread::SystemClock::time_point
+WaiterThread::GetReceivedTime () const
+{
+  return SystemClock::time_point (SystemClock::duration (lastReceived.load ()));
 }
 
 void
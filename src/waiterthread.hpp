@@ -19,6 +19,8 @@
 #ifndef CHARON_WAITERTHREAD_HPP
 #define CHARON_WAITERTHREAD_HPP
 
+#include "compactjson.hpp"
+#include "memorytags.hpp"
 #include "notifications.hpp"
 
 #include <json/json.h>
@@ -75,6 +77,15 @@ public:
   /** Type of callback for state changes.  */
   using UpdateHandler = std::function<void (const Json::Value& newState)>;
 
+  /** Clock used for tracking the time of updates.  */
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Clock used for timestamps of received states that are meant to be
+   * compared across machines.
+   */
+  using SystemClock = std::chrono::system_clock;
+
 private:
 
   /** NotificationType that this is for.  */
@@ -101,11 +112,38 @@ private:
   /** Set to true if the loop should stop.  */
   std::atomic<bool> shouldStop;
 
+  /**
+   * Set to true while the waiter calls are failing, i.e. we are backing off
+   * before retrying them.  This is atomic (rather than protected by mut)
+   * so that it can be queried even while an update handler is running.
+   */
+  std::atomic<bool> backingOff;
+
+  /**
+   * Time (since the Clock's epoch) when the state last changed or the
+   * loop was started.
+   */
+  std::atomic<Clock::duration::rep> lastChange;
+
+  /**
+   * Time (since the SystemClock's epoch) when the current state was
+   * returned by the UpdateWaiter.  This is atomic so that it can be
+   * queried from the update handler.
+   */
+  std::atomic<SystemClock::duration::rep> lastReceived;
+
   /**
    * Current state from the polling loop.  May be JSON null when we have
-   * just started the loop and not yet received an update.
+   * just started the loop and not yet received an update.  It is stored
+   * in compact form, since it is kept around until the next change.
    */
-  Json::Value currentState;
+  CompactJson currentState;
+
+  /** The state ID extracted from currentState.  */
+  Json::Value currentStateId;
+
+  /** Accounting of the memory used by currentState.  */
+  TrackedMemory stateMemory;
 
   /** Callback to be invoked whenever the state changes.  */
   UpdateHandler cb;
@@ -168,6 +206,28 @@ public:
    */
   Json::Value GetCurrentState () const;
 
+  /**
+   * Returns true if the last call to the underlying waiter failed, and we
+   * are thus backing off before retrying.
+   */
+  bool
+  IsBackingOff () const
+  {
+    return backingOff;
+  }
+
+  /**
+   * Returns the time that has elapsed since the last change of our state
+   * (or since the loop was started if there has not been any state yet).
+   */
+  Clock::duration GetTimeSinceChange () const;
+
+  /**
+   * Returns the system time at which the current state was received
+   * from the UpdateWaiter.
+   */
+  SystemClock::time_point GetReceivedTime () const;
+
   /**
    * Removes the update handler.
    */
@@ -113,6 +113,12 @@ public:
       }
   }
 
+  WaiterThread::SystemClock::time_point
+  GetReceivedTime () const
+  {
+    return thread->GetReceivedTime ();
+  }
+
   Json::Value
   GetStateJson (const std::string& id, const std::string& value)
   {
@@ -172,6 +178,19 @@ TEST_F (WaiterThreadTests, Update)
   w.ExpectUpdate ("third", "final");
 }
 
+TEST_F (WaiterThreadTests, ReceivedTime)
+{
+  TestWaiter w("test");
+
+  const auto before = WaiterThread::SystemClock::now ();
+  w.SetState ("first", "foo");
+  w.ExpectUpdate ("first", "foo");
+  const auto after = WaiterThread::SystemClock::now ();
+
+  EXPECT_GE (w.GetReceivedTime (), before);
+  EXPECT_LE (w.GetReceivedTime (), after);
+}
+
 TEST_F (WaiterThreadTests, TwoWaiters)
 {
   TestWaiter w1("test 1");
@@ -24,6 +24,8 @@
 
 #include <glog/logging.h>
 
+#include <cctype>
+#include <ostream>
 #include <sstream>
 #include <vector>
 
@@ -56,10 +58,11 @@ constexpr size_t MAX_COMPRESSED_PERCENT = 70;
  * Serialised JSON in particular fulfills this.
  */
 bool
-CanStoreRaw (const std::string& str)
+CanStoreRaw (const char* data, const size_t len)
 {
-  for (const char c : str)
+  for (size_t i = 0; i < len; ++i)
     {
+      const char c = data[i];
       if (c == '\n')
         continue;
       if (c >= ' ')
@@ -79,20 +82,19 @@ CanStoreRaw (const std::string& str)
  * Encodes a given binary string as base64.
  */
 std::string
-EncodeBase64 (const std::string& data)
+EncodeBase64 (const char* data, const size_t len)
 {
   /* We need an upper bound on the length of the generated data, so that we
      can reserve a buffer large enough.  The output will be four bytes for
      every three in the input, plus newlines every 64 bytes, plus one NUL at
      the end.  By doubling the input data plus some extra bytes in the case
      of very short input, we are certainly above that.  */
-  const size_t bufSize = 3 + 2 * data.size ();
+  const size_t bufSize = 3 + 2 * len;
 
   std::vector<unsigned char> encoded(bufSize, 0);
   const int n
       = EVP_EncodeBlock (encoded.data (),
-                         reinterpret_cast<const unsigned char*> (data.data ()),
-                         data.size ());
+                         reinterpret_cast<const unsigned char*> (data), len);
   CHECK_LE (n + 1, bufSize);
 
   /* Strip out all newline characters from the generated string.  */
@@ -105,10 +107,27 @@ EncodeBase64 (const std::string& data)
 }
 
 /**
- * Tries to decode a given base64 string.
+ * Returns the size of the buffer needed to decode the given base64 data.
+ * This ignores whitespace, and is at most two bytes (for the padding) more
+ * than the decoded data if it is valid.
+ */
+size_t
+GetBase64BufferSize (const std::string& encoded)
+{
+  size_t chars = 0;
+  for (const char c : encoded)
+    if (!std::isspace (static_cast<unsigned char> (c)))
+      ++chars;
+
+  return (chars + 3) / 4 * 3;
+}
+
+/**
+ * Tries to decode a given base64 string, appending the result to
+ * the buffer.
  */
 bool
-DecodeBase64 (const std::string& encoded, std::string& data)
+DecodeBase64 (const std::string& encoded, PayloadBuffer& data)
 {
   /* Check for the number of padding characters.  */
   size_t paddings = 0;
@@ -141,25 +160,27 @@ DecodeBase64 (const std::string& encoded, std::string& data)
       return false;
     }
 
-  /* The output data will never be longer than the input.  If the input
-     contains whitespace (which is ignored), the difference will be even
-     more pronounced.  */
-  const size_t bufSize = encoded.size ();
-  data.resize (bufSize);
+  /* OpenSSL only skips leading and trailing whitespace, and fails on
+     whitespace in the middle.  So each group of four other characters
+     yields at most three bytes.  */
+  const size_t bufSize = GetBase64BufferSize (encoded);
+  const size_t oldSize = data.GetSize ();
 
   const unsigned char* in
       = reinterpret_cast<const unsigned char*> (encoded.data ());
-  unsigned char* out = reinterpret_cast<unsigned char*> (&data[0]);
+  unsigned char* out
+      = reinterpret_cast<unsigned char*> (data.Extend (bufSize));
   const int n = EVP_DecodeBlock (out, in, encoded.size ());
   if (n == -1)
     {
       LOG (WARNING) << "OpenSSL base64 decode returned error";
+      data.Truncate (oldSize);
       return false;
     }
   CHECK_LE (n, bufSize);
 
   CHECK_LE (paddings, n);
-  data.resize (n - paddings);
+  data.Truncate (oldSize + n - paddings);
 
   return true;
 }
@@ -170,43 +191,43 @@ DecodeBase64 (const std::string& encoded, std::string& data)
  * Compresses the given data with zlib's utility compress.
  */
 std::string
-Compress (const std::string& data)
+Compress (const char* data, const size_t len)
 {
-  const auto* in = reinterpret_cast<const Bytef*> (data.data ());
-  uLongf destLen = compressBound (data.size ());
+  const auto* in = reinterpret_cast<const Bytef*> (data);
+  uLongf destLen = compressBound (len);
 
   std::string res;
   res.resize (destLen);
   auto* out = reinterpret_cast<Bytef*> (&res[0]);
 
-  CHECK_EQ (compress (out, &destLen, in, data.size ()), Z_OK);
+  CHECK_EQ (compress (out, &destLen, in, len), Z_OK);
   res.resize (destLen);
 
-  VLOG (2)
-      << "Compressed " << data.size ()
-      << " input bytes into " << res.size ();
+  VLOG (2) << "Compressed " << len << " input bytes into " << res.size ();
 
   return res;
 }
 
 /**
- * Tries to uncompress data with zlib's utility uncompress.  Returns
- * false if there is some error.  The expected size of the uncompressed
- * data must be passed in.
+ * Tries to uncompress data with zlib's utility uncompress, appending it to
+ * the buffer.  Returns false if there is some error.  The expected size of
+ * the uncompressed data must be passed in.
  */
 bool
-Uncompress (const std::string& compressed, const size_t len, std::string& data)
+Uncompress (const PayloadBuffer& compressed, const size_t len,
+            PayloadBuffer& data)
 {
-  data.resize (len);
+  const size_t oldSize = data.GetSize ();
 
-  const auto* in = reinterpret_cast<const Bytef*> (compressed.data ());
-  auto* out = reinterpret_cast<Bytef*> (&data[0]);
+  const auto* in = reinterpret_cast<const Bytef*> (compressed.GetData ());
+  auto* out = reinterpret_cast<Bytef*> (data.Extend (len));
   uLongf destLen = len;
 
-  const int rc = uncompress (out, &destLen, in, compressed.size ());
+  const int rc = uncompress (out, &destLen, in, compressed.GetSize ());
   if (rc != Z_OK)
     {
       LOG (WARNING) << "zlib uncompress failed with code " << rc;
+      data.Truncate (oldSize);
       return false;
     }
 
@@ -215,6 +236,7 @@ Uncompress (const std::string& compressed, const size_t len, std::string& data)
       LOG (WARNING)
           << "Uncompressed data has wrong size " << destLen
           << " (expected " << len << ")";
+      data.Truncate (oldSize);
       return false;
     }
 
@@ -224,27 +246,66 @@ Uncompress (const std::string& compressed, const size_t len, std::string& data)
 /* ************************************************************************** */
 
 /**
- * Tries to decode the payload in a particular payload tag.
+ * Returns true if data of the given size can be appended to the payload
+ * without exceeding the maximum size.  This is checked before appending,
+ * so that an oversized child is rejected without buffering it first.
+ */
+bool
+FitsPayload (const PayloadBuffer& payload, const size_t len,
+             const gloox::Tag& tag)
+{
+  if (payload.GetSize () + len <= MAX_XML_PAYLOAD_SIZE)
+    return true;
+
+  LOG (WARNING)
+      << "Exceeded maximum payload size of " << MAX_XML_PAYLOAD_SIZE
+      << " with <" << tag.name () << "> data";
+  return false;
+}
+
+/**
+ * Tries to decode the payload in a particular payload tag, appending it
+ * to the buffer.
  */
 bool
-DecodePayloadTag (const gloox::Tag& tag, std::string& payload)
+DecodePayloadTag (const gloox::Tag& tag, PayloadBuffer& payload)
 {
   if (tag.name () == "raw")
     {
-      payload = tag.cdata ();
+      const std::string data = tag.cdata ();
+      if (!FitsPayload (payload, data.size (), tag))
+        return false;
+
+      payload.Append (data.data (), data.size ());
       return true;
     }
 
   if (tag.name () == "base64")
-    return DecodeBase64 (tag.cdata (), payload);
+    {
+      const std::string data = tag.cdata ();
+      if (!FitsPayload (payload, GetBase64BufferSize (data), tag))
+        return false;
+
+      return DecodeBase64 (data, payload);
+    }
 
   if (tag.name () == "zlib")
     {
       std::istringstream sizeStr(tag.findAttribute ("size"));
       size_t len;
       sizeStr >> len;
+      if (!sizeStr)
+        {
+          LOG (WARNING) << "Invalid size for <zlib> data";
+          return false;
+        }
+
+      /* Check the size before allocating the buffer, so that a forged
+         size attribute cannot exhaust our memory.  */
+      if (!FitsPayload (payload, len, tag))
+        return false;
 
-      std::string compressed;
+      PayloadBuffer compressed(PAYLOAD_SPILL_SIZE);
       if (!DecodeXmlPayload (tag, compressed))
         {
           LOG (WARNING) << "Failed to extract <zlib> compressed data";
@@ -260,34 +321,32 @@ DecodePayloadTag (const gloox::Tag& tag, std::string& payload)
 
 /* ************************************************************************** */
 
-} // anonymous namespace
-
-std::unique_ptr<gloox::Tag>
-EncodeXmlBase64 (const std::string& payload)
-{
-  return std::make_unique<gloox::Tag> ("base64", EncodeBase64 (payload));
-}
-
+/**
+ * Encodes payload data (given as pointer and length) into a tag.
+ */
 std::unique_ptr<gloox::Tag>
-EncodeXmlPayload (const std::string& name, const std::string& payload)
+EncodePayloadData (const std::string& name, const char* data, const size_t len,
+                   const XmlEncodingOptions& opt)
 {
   auto res = std::make_unique<gloox::Tag> (name);
-  if (payload.empty ())
+  if (len == 0)
     return res;
 
   /* Heuristically estimate if it makes sense to compress the data.  We do
      that only for data that has a somewhat meaningful length, and also only
      if the compressed size is sufficiently small to make it worthwhile even
      with adding base64 on top.  */
-  if (payload.size () >= MIN_COMPRESS_LEN)
+  if (!opt.allowCompression)
+    VLOG (2) << "Compression is not supported by the receiver";
+  else if (len >= MIN_COMPRESS_LEN)
     {
-      const std::string compressed = Compress (payload);
-      if (compressed.size () * 100 <= MAX_COMPRESSED_PERCENT * payload.size ())
+      const std::string compressed = Compress (data, len);
+      if (compressed.size () * 100 <= MAX_COMPRESSED_PERCENT * len)
         {
           VLOG (2) << "Sending compressed payload";
 
           std::ostringstream size;
-          size << payload.size ();
+          size << len;
 
           auto zlibTag = std::make_unique<gloox::Tag> ("zlib");
           zlibTag->addAttribute ("size", size.str ());
@@ -300,43 +359,62 @@ EncodeXmlPayload (const std::string& name, const std::string& payload)
       VLOG (2) << "Compression ratio is not sufficient, sending uncompressed";
     }
   else
-    VLOG (2)
-        << "Not attempting compression of payload with size "
-        << payload.size ();
+    VLOG (2) << "Not attempting compression of payload with size " << len;
 
-  if (CanStoreRaw (payload))
-    res->addChild (new gloox::Tag ("raw", payload));
+  if (CanStoreRaw (data, len))
+    res->addChild (new gloox::Tag ("raw", std::string (data, len)));
   else
-    res->addChild (EncodeXmlBase64 (payload).release ());
+    res->addChild (new gloox::Tag ("base64", EncodeBase64 (data, len)));
 
   return res;
 }
 
+} // anonymous namespace
+
+std::unique_ptr<gloox::Tag>
+EncodeXmlBase64 (const std::string& payload)
+{
+  return std::make_unique<gloox::Tag> ("base64",
+                                       EncodeBase64 (payload.data (),
+                                                     payload.size ()));
+}
+
+std::unique_ptr<gloox::Tag>
+EncodeXmlPayload (const std::string& name, const std::string& payload)
+{
+  return EncodeXmlPayload (name, payload, XmlEncodingOptions ());
+}
+
+std::unique_ptr<gloox::Tag>
+EncodeXmlPayload (const std::string& name, const std::string& payload,
+                  const XmlEncodingOptions& opt)
+{
+  return EncodePayloadData (name, payload.data (), payload.size (), opt);
+}
+
 bool
-DecodeXmlPayload (const gloox::Tag& tag, std::string& payload)
+DecodeXmlPayload (const gloox::Tag& tag, PayloadBuffer& payload)
 {
-  std::ostringstream res;
-  size_t len = 0;
+  /* Each payload tag checks the maximum size before appending its data,
+     so the buffer never exceeds it.  */
   for (const auto* child : tag.children ())
-    {
-      std::string cur;
-      if (!DecodePayloadTag (*child, cur))
-        return false;
+    if (!DecodePayloadTag (*child, payload))
+      return false;
 
-      if (len + cur.size () > MAX_XML_PAYLOAD_SIZE)
-        {
-          LOG (WARNING)
-              << "Exceeded maximum payload size of " << MAX_XML_PAYLOAD_SIZE
-              << ", ignoring payload";
-          return false;
-        }
+  return true;
+}
 
-      res << cur;
-      len += cur.size ();
-    }
+bool
+DecodeXmlPayload (const gloox::Tag& tag, std::string& payload)
+{
+  /* The result is returned as string anyway, so there is no point in
+     moving it to a file.  The buffer never exceeds the maximum size.  */
+  PayloadBuffer buf(MAX_XML_PAYLOAD_SIZE);
+  if (!DecodeXmlPayload (tag, buf))
+    return false;
 
-  payload = res.str ();
-  CHECK_EQ (payload.size (), len);
+  CHECK (!buf.IsSpilled ());
+  payload = buf.TakeString ();
   CHECK_LE (payload.size (), MAX_XML_PAYLOAD_SIZE);
 
   return true;
@@ -344,6 +422,13 @@ DecodeXmlPayload (const gloox::Tag& tag, std::string& payload)
 
 std::unique_ptr<gloox::Tag>
 EncodeXmlJson (const std::string& name, const Json::Value& val)
+{
+  return EncodeXmlJson (name, val, XmlEncodingOptions ());
+}
+
+std::unique_ptr<gloox::Tag>
+EncodeXmlJson (const std::string& name, const Json::Value& val,
+               const XmlEncodingOptions& opt)
 {
   Json::StreamWriterBuilder wbuilder;
   wbuilder["commentStyle"] = "None";
@@ -352,13 +437,24 @@ EncodeXmlJson (const std::string& name, const Json::Value& val)
   wbuilder["dropNullPlaceholders"] = false;
   wbuilder["useSpecialFloats"] = false;
 
-  return EncodeXmlPayload (name, Json::writeString (wbuilder, val));
+  /* Large values are serialised into a temporary file, and the payload
+     is encoded from there directly.  */
+  PayloadBuffer buf(PAYLOAD_SPILL_SIZE);
+  PayloadStreamBuf sb(buf);
+  std::ostream out(&sb);
+  std::unique_ptr<Json::StreamWriter> writer(wbuilder.newStreamWriter ());
+  writer->write (val, &out);
+  out.flush ();
+
+  return EncodePayloadData (name, buf.GetData (), buf.GetSize (), opt);
 }
 
 bool
 DecodeXmlJson (const gloox::Tag& tag, Json::Value& val)
 {
-  std::string serialised;
+  /* Large payloads are decoded into a temporary file, and the JSON parser
+     reads from it as a view.  */
+  PayloadBuffer serialised(PAYLOAD_SPILL_SIZE);
   if (!DecodeXmlPayload (tag, serialised))
     return false;
 
@@ -368,13 +464,15 @@ DecodeXmlJson (const gloox::Tag& tag, Json::Value& val)
   rbuilder["failIfExtra"] = true;
   rbuilder["rejectDupKeys"] = true;
 
-  std::istringstream in(serialised);
+  std::unique_ptr<Json::CharReader> reader(rbuilder.newCharReader ());
+  const char* begin = serialised.GetData ();
+  const char* end = begin + serialised.GetSize ();
   std::string parseErrs;
-  if (!Json::parseFromStream (rbuilder, in, &val, &parseErrs))
+  if (!reader->parse (begin, end, &val, &parseErrs))
     {
       LOG (WARNING)
           << "Failed parsing JSON:\n"
-          << serialised << "\n" << parseErrs;
+          << std::string (begin, end) << "\n" << parseErrs;
       return false;
     }
 
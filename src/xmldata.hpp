@@ -29,12 +29,31 @@
 namespace charon
 {
 
+/**
+ * Options for encoding payloads, e.g. based on what the receiving peer
+ * is known to support.
+ */
+struct XmlEncodingOptions
+{
+
+  /** Whether or not the payload may be compressed with zlib.  */
+  bool allowCompression = true;
+
+};
+
 /**
  * Encodes a payload string into a gloox tag of the given name.
  */
 std::unique_ptr<gloox::Tag> EncodeXmlPayload (const std::string& name,
                                               const std::string& payload);
 
+/**
+ * Encodes a payload string using the given options.
+ */
+std::unique_ptr<gloox::Tag> EncodeXmlPayload (const std::string& name,
+                                              const std::string& payload,
+                                              const XmlEncodingOptions& opt);
+
 /**
  * Decodes the payload from a given tag.  Returns true on success, and false
  * if no valid payload was found.
@@ -47,6 +66,13 @@ bool DecodeXmlPayload (const gloox::Tag& tag, std::string& payload);
 std::unique_ptr<gloox::Tag> EncodeXmlJson (const std::string& name,
                                            const Json::Value& val);
 
+/**
+ * Encodes a JSON value as payload using the given options.
+ */
+std::unique_ptr<gloox::Tag> EncodeXmlJson (const std::string& name,
+                                           const Json::Value& val,
+                                           const XmlEncodingOptions& opt);
+
 /**
  * Decodes a payload as JSON from a given tag.  Returns true on success and
  * false if no payload was found or it failed to parse as JSON.
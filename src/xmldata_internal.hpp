@@ -23,6 +23,7 @@
 #ifndef CHARON_XMLDATA_INTERNAL_HPP
 #define CHARON_XMLDATA_INTERNAL_HPP
 
+#include "payloadbuffer.hpp"
 #include "xmldata.hpp"
 
 #include <cstddef>
@@ -37,11 +38,23 @@ namespace charon
  */
 static constexpr size_t MAX_XML_PAYLOAD_SIZE = 64 * (1 << 20);
 
+/**
+ * Size above which JSON payloads are encoded from and decoded into
+ * memory-mapped temporary files rather than memory (see PayloadBuffer).
+ */
+static constexpr size_t PAYLOAD_SPILL_SIZE = 4 * (1 << 20);
+
 /**
  * Encodes a payload string as base64 tag and returns the <base64> tag.
  */
 std::unique_ptr<gloox::Tag> EncodeXmlBase64 (const std::string& payload);
 
+/**
+ * Decodes the payload from a given tag, appending it to the buffer.
+ * Returns false if no valid payload was found.
+ */
+bool DecodeXmlPayload (const gloox::Tag& tag, PayloadBuffer& payload);
+
 } // namespace charon
 
 #endif // CHARON_XMLDATA_INTERNAL_HPP
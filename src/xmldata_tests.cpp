@@ -103,6 +103,25 @@ TEST_F (XmlPayloadTests, MaxSize)
   EXPECT_FALSE (DecodeXmlPayload (tag, decoded));
 }
 
+TEST_F (XmlPayloadTests, OversizedChildNotBuffered)
+{
+  gloox::Tag raw("foo");
+  raw.addChild (new gloox::Tag ("raw",
+                                std::string (MAX_XML_PAYLOAD_SIZE + 1, 'x')));
+
+  gloox::Tag base64("foo");
+  base64.addChild (new gloox::Tag (
+      "base64", std::string ((MAX_XML_PAYLOAD_SIZE / 3 + 1) * 4, 'A')));
+
+  for (const auto* tag : {&raw, &base64})
+    {
+      PayloadBuffer buf(1'000);
+      EXPECT_FALSE (DecodeXmlPayload (*tag, buf));
+      EXPECT_EQ (buf.GetSize (), 0);
+      EXPECT_FALSE (buf.IsSpilled ());
+    }
+}
+
 TEST_F (XmlPayloadTests, Compression)
 {
   std::ostringstream data;
@@ -120,6 +139,24 @@ TEST_F (XmlPayloadTests, Compression)
   EXPECT_EQ (recovered, payload);
 }
 
+TEST_F (XmlPayloadTests, CompressionDisabled)
+{
+  const std::string payload(1024, 'x');
+
+  auto tag = EncodeXmlPayload ("foo", payload);
+  EXPECT_NE (tag->findChild ("zlib"), nullptr);
+
+  XmlEncodingOptions opt;
+  opt.allowCompression = false;
+  tag = EncodeXmlPayload ("foo", payload, opt);
+  EXPECT_EQ (tag->findChild ("zlib"), nullptr);
+  EXPECT_NE (tag->findChild ("raw"), nullptr);
+
+  std::string recovered;
+  ASSERT_TRUE (DecodeXmlPayload (*tag, recovered));
+  EXPECT_EQ (recovered, payload);
+}
+
 TEST_F (XmlPayloadTests, Base64Example)
 {
   gloox::Tag tag("foo");
@@ -146,6 +183,35 @@ TEST_F (XmlPayloadTests, CompressionExample)
   EXPECT_EQ (val, "This is compressed data.");
 }
 
+TEST_F (XmlPayloadTests, CompressionSizeTooLarge)
+{
+  auto zlibTag = std::make_unique<gloox::Tag> ("zlib");
+  zlibTag->addAttribute ("size", std::to_string (MAX_XML_PAYLOAD_SIZE + 1));
+  zlibTag->addChild (new gloox::Tag (
+      "base64", "eJwLycgsVgCi5PzcgqLU4uLUFIWUxJJEPQBvPQjS"));
+
+  gloox::Tag tag("foo");
+  tag.addChild (zlibTag.release ());
+
+  std::string val;
+  EXPECT_FALSE (DecodeXmlPayload (tag, val));
+}
+
+TEST_F (XmlPayloadTests, SpilledBuffer)
+{
+  const std::string part(1'000, 'x');
+
+  gloox::Tag tag("foo");
+  tag.addChild (new gloox::Tag ("raw", part));
+  tag.addChild (new gloox::Tag ("raw", part));
+  tag.addChild (new gloox::Tag ("raw", part));
+
+  PayloadBuffer buf(1'500);
+  ASSERT_TRUE (DecodeXmlPayload (tag, buf));
+  EXPECT_TRUE (buf.IsSpilled ());
+  EXPECT_EQ (buf.TakeString (), part + part + part);
+}
+
 /* ************************************************************************** */
 
 class XmlBase64Tests : public testing::Test
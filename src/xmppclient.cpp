@@ -20,6 +20,8 @@
 
 #include "private/pubsub.hpp"
 
+#include <gloox/connectiontcpclient.h>
+
 #include <glog/logging.h>
 
 #include <chrono>
@@ -37,11 +39,23 @@ namespace
  */
 constexpr auto WAITING_SLEEP = std::chrono::milliseconds (1);
 
+/**
+ * Returns a duration in (fractional) milliseconds.
+ */
+template <typename Rep, typename Period>
+  double
+  ToMillis (const std::chrono::duration<Rep, Period>& d)
+{
+  return std::chrono::duration<double, std::milli> (d).count ();
+}
+
 } // anonymous namespace
 
 XmppClient::XmppClient (const gloox::JID& j, const std::string& password)
   : jid(j), client(jid, password),
-    connectionState(ConnectionState::DISCONNECTED)
+    connectionState(ConnectionState::DISCONNECTED),
+    disconnectReason(gloox::ConnNoError),
+    lastConnect(Json::objectValue)
 {
   client.registerConnectionListener (this);
   client.logInstance ().registerLogHandler (gloox::LogLevelDebug,
@@ -69,6 +83,20 @@ XmppClient::AttachPubSub ()
     }
   else
     pubsub.reset ();
+
+  extraPubSubs.clear ();
+  for (const auto& s : extraPubSubServices)
+    {
+      LOG (INFO) << "Setting up extra pubsub at " << s.full ();
+      extraPubSubs.push_back (std::make_unique<PubSubImpl> (*this, s));
+    }
+}
+
+void
+XmppClient::DetachPubSub ()
+{
+  extraPubSubs.clear ();
+  pubsub.reset ();
 }
 
 void
@@ -78,6 +106,59 @@ XmppClient::SetRootCA (const std::string& path)
   client.setCACerts ({path});
 }
 
+void
+XmppClient::SetStreamCompression (const bool enable)
+{
+  CHECK (connectionState == ConnectionState::DISCONNECTED)
+      << "Stream compression must be configured before connecting";
+
+  LOG (INFO) << "Stream compression enabled: " << enable;
+  std::lock_guard<std::recursive_mutex> lock(mut);
+  client.setCompression (enable);
+}
+
+StreamStatistics
+XmppClient::GetStreamStatistics ()
+{
+  std::lock_guard<std::recursive_mutex> lock(mut);
+  const auto stats = client.getStatistics ();
+
+  StreamStatistics res;
+  res.xmlBytesSent = stats.totalBytesSent;
+  res.xmlBytesReceived = stats.totalBytesReceived;
+  res.stanzasSent = stats.totalStanzasSent;
+  res.stanzasReceived = stats.totalStanzasReceived;
+  res.compressed = stats.compression;
+
+  if (res.compressed)
+    {
+      res.wireBytesSent = stats.compressedBytesSent;
+      res.wireBytesReceived = stats.compressedBytesReceived;
+    }
+  else
+    {
+      res.wireBytesSent = res.xmlBytesSent;
+      res.wireBytesReceived = res.xmlBytesReceived;
+    }
+
+  return res;
+}
+
+Json::Value
+XmppClient::GetConnectStats () const
+{
+  Json::Value res(Json::objectValue);
+  res["resolve"] = resolveTime.ToJson ();
+  res["tcp"] = tcpTime.ToJson ();
+  res["tls"] = tlsTime.ToJson ();
+  res["login"] = loginTime.ToJson ();
+
+  std::lock_guard<std::mutex> lock(connectMut);
+  res["last"] = lastConnect;
+
+  return res;
+}
+
 void
 XmppClient::AddPubSub (const gloox::JID& service)
 {
@@ -94,6 +175,26 @@ XmppClient::GetPubSub ()
   return *pubsub;
 }
 
+void
+XmppClient::AddExtraPubSub (const gloox::JID& service)
+{
+  extraPubSubServices.push_back (service.full ());
+  if (connectionState == ConnectionState::CONNECTED)
+    {
+      LOG (INFO) << "Setting up extra pubsub at " << service.full ();
+      extraPubSubs.push_back (std::make_unique<PubSubImpl> (*this, service));
+    }
+}
+
+std::vector<PubSubImpl*>
+XmppClient::GetAllPubSubs ()
+{
+  std::vector<PubSubImpl*> res = {&GetPubSub ()};
+  for (auto& p : extraPubSubs)
+    res.push_back (p.get ());
+  return res;
+}
+
 bool
 XmppClient::Connect (const int priority)
 {
@@ -112,13 +213,100 @@ XmppClient::Connect (const int priority)
     }
 
   client.presence ().setPriority (priority);
+
+  auto& cache = EndpointCache::Default ();
+  const std::string domain = jid.server ();
+
+  const auto start = std::chrono::steady_clock::now ();
+  bool cached;
+  auto endpoints = cache.Get (domain, cached);
+  const auto resolve = std::chrono::steady_clock::now () - start;
+  resolveTime.Record (ToMillis (resolve));
+
+  Json::Value details(Json::objectValue);
+  details["cached"] = cached;
+  details["resolve"] = ToMillis (resolve);
+
+  /* If we could not resolve the domain ourselves, let gloox try it
+     (port -1 means that it does the SRV lookup by itself).  */
+  if (endpoints.empty ())
+    {
+      XmppEndpoint ep;
+      ep.host = domain;
+      ep.address = domain;
+      ep.port = -1;
+      endpoints.push_back (ep);
+    }
+
+  bool res = false;
+  unsigned attempts = 0;
+  for (const auto& ep : endpoints)
+    {
+      ++attempts;
+      if (ConnectTo (ep, details))
+        {
+          if (ep.port != -1)
+            cache.MarkGood (domain, ep);
+          res = true;
+          break;
+        }
+
+      /* Other endpoints will not help if the server rejected us.  */
+      if (disconnectReason == gloox::ConnAuthenticationFailed)
+        break;
+    }
+
+  /* If no endpoint worked, maybe the cached data is outdated.  */
+  if (!res && cached)
+    cache.Invalidate (domain);
+
+  details["attempts"] = attempts;
+  details["success"] = res;
+  {
+    std::lock_guard<std::mutex> lock(connectMut);
+    lastConnect = details;
+  }
+
+  if (res)
+    AttachPubSub ();
+  return res;
+}
+
+bool
+XmppClient::ConnectTo (const XmppEndpoint& ep, Json::Value& details)
+{
+  VLOG (1)
+      << "Trying endpoint " << ep.address << ":" << ep.port
+      << " (" << ep.host << ") for " << jid.full ();
+
+  details["host"] = ep.host;
+  details["address"] = ep.address;
+  details["port"] = ep.port;
+  details.removeMember ("tcp");
+  details.removeMember ("tls");
+  details.removeMember ("login");
+
+  {
+    std::lock_guard<std::recursive_mutex> lock(mut);
+    client.setConnectionImpl (
+        new gloox::ConnectionTCPClient (&client, client.logInstance (),
+                                        ep.address, ep.port));
+  }
+
   connectionState = ConnectionState::CONNECTING;
+  disconnectReason = gloox::ConnNoError;
+  tlsDone = std::chrono::steady_clock::time_point ();
+  const auto start = std::chrono::steady_clock::now ();
   if (!client.connect (false))
     {
       CHECK (connectionState == ConnectionState::DISCONNECTED);
       return false;
     }
 
+  const auto tcpDone = std::chrono::steady_clock::now ();
+  tcpTime.Record (ToMillis (tcpDone - start));
+  details["tcp"] = ToMillis (tcpDone - start);
+
   stopLoop = false;
   recvLoop = std::make_unique<std::thread> ([this] ()
     {
@@ -137,9 +325,23 @@ XmppClient::Connect (const int priority)
     switch (connectionState)
       {
       case ConnectionState::CONNECTED:
-        AttachPubSub ();
-        return true;
+        {
+          const auto loginDone = std::chrono::steady_clock::now ();
+          auto loginStart = tcpDone;
+          if (tlsDone != std::chrono::steady_clock::time_point ())
+            {
+              tlsTime.Record (ToMillis (tlsDone - tcpDone));
+              details["tls"] = ToMillis (tlsDone - tcpDone);
+              loginStart = tlsDone;
+            }
+          loginTime.Record (ToMillis (loginDone - loginStart));
+          details["login"] = ToMillis (loginDone - loginStart);
+          return true;
+        }
       case ConnectionState::DISCONNECTED:
+        stopLoop = true;
+        recvLoop->join ();
+        recvLoop.reset ();
         return false;
       case ConnectionState::CONNECTING:
         std::this_thread::sleep_for (WAITING_SLEEP);
@@ -185,10 +387,10 @@ XmppClient::Disconnect ()
      things as needed beforehand.  */
   HandleDisconnect ();
 
-  /* Make sure to clean up the pubsub service first, so that it will still
-     clean up all its associated nodes and subscriptions before the connection
-     is gone.  */
-  pubsub.reset ();
+  /* Make sure to clean up the pubsub services first, so that they will still
+     clean up all their associated nodes and subscriptions before
+     the connection is gone.  */
+  DetachPubSub ();
 
   /* Explicitly stop the receive loop now, before we disconnect.  */
   if (recvLoop != nullptr)
@@ -226,9 +428,10 @@ XmppClient::onDisconnect (const gloox::ConnectionError err)
       break;
     }
 
+  disconnectReason = err;
   connectionState = ConnectionState::DISCONNECTED;
   HandleDisconnect ();
-  pubsub.reset ();
+  DetachPubSub ();
 }
 
 bool
@@ -250,6 +453,7 @@ XmppClient::onTLSConnect (const gloox::CertInfo& info)
       return false;
     }
 
+  tlsDone = std::chrono::steady_clock::now ();
   return true;
 }
 
@@ -19,21 +19,58 @@
 #ifndef CHARON_XMPPCLIENT_HPP
 #define CHARON_XMPPCLIENT_HPP
 
+#include "endpointcache.hpp"
+#include "histogram.hpp"
+
 #include <gloox/client.h>
 #include <gloox/connectionlistener.h>
 #include <gloox/loghandler.h>
 
+#include <json/json.h>
+
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 namespace charon
 {
 
 class PubSubImpl;
 
+/**
+ * Traffic statistics for an XMPP stream.
+ */
+struct StreamStatistics
+{
+
+  /** Total bytes of XML (before compression) sent.  */
+  std::uint64_t xmlBytesSent = 0;
+  /** Total bytes of XML (after decompression) received.  */
+  std::uint64_t xmlBytesReceived = 0;
+
+  /**
+   * Bytes sent on the wire (after compression if enabled, but not counting
+   * the TLS overhead).
+   */
+  std::uint64_t wireBytesSent = 0;
+  /** Bytes received on the wire (before decompression).  */
+  std::uint64_t wireBytesReceived = 0;
+
+  /** Number of stanzas sent.  */
+  std::uint64_t stanzasSent = 0;
+  /** Number of stanzas received.  */
+  std::uint64_t stanzasReceived = 0;
+
+  /** True if stream compression is active.  */
+  bool compressed = false;
+
+};
+
 /**
  * Basic XMPP client, based on the gloox library.  It manages the connection
  * and logs, but does not have any specific listening or other logic by itself.
@@ -73,6 +110,15 @@ private:
   /** PubSub instance used by this client.  */
   std::unique_ptr<PubSubImpl> pubsub;
 
+  /**
+   * Further pubsub services (see AddExtraPubSub), which are attached
+   * together with the main one.
+   */
+  std::vector<gloox::JID> extraPubSubServices;
+
+  /** PubSub instances for the extra services (when connected).  */
+  std::vector<std::unique_ptr<PubSubImpl>> extraPubSubs;
+
   /**
    * When connected, this is the thread running polling for new messages.
    */
@@ -84,6 +130,34 @@ private:
   /** Current connection state (set by the onConnect/onDisconnect handlers).  */
   std::atomic<ConnectionState> connectionState;
 
+  /** Reason of the last disconnect (set by onDisconnect).  */
+  std::atomic<gloox::ConnectionError> disconnectReason;
+
+  /**
+   * Time at which the TLS handshake of the current connection attempt
+   * finished.  This is set on the receive thread by onTLSConnect before
+   * the connection state changes, and read after that by Connect.
+   */
+  std::chrono::steady_clock::time_point tlsDone;
+
+  /** Time (in milliseconds) spent resolving the server endpoints.  */
+  Histogram resolveTime;
+  /** Time (in milliseconds) until the TCP connection was established.  */
+  Histogram tcpTime;
+  /** Time (in milliseconds) for the TLS handshake.  */
+  Histogram tlsTime;
+  /**
+   * Time (in milliseconds) from the TLS handshake until the session was
+   * ready, i.e. for authentication and resource binding.
+   */
+  Histogram loginTime;
+
+  /** Mutex for lastConnect.  */
+  mutable std::mutex connectMut;
+
+  /** Details about the last connection attempt (for GetConnectStats).  */
+  Json::Value lastConnect;
+
   /**
    * Lock used to synchronise receives and other client accesses.  This has
    * to be recursive so that also callbacks triggered in reply to a message
@@ -99,10 +173,22 @@ private:
   bool Receive ();
 
   /**
-   * Attaches the PubSubImpl for our configured service.
+   * Attaches the PubSubImpl instances for our configured services.
    */
   void AttachPubSub ();
 
+  /**
+   * Destroys all PubSubImpl instances.
+   */
+  void DetachPubSub ();
+
+  /**
+   * Tries to connect to the given endpoint, starting the receive loop if
+   * the connection succeeds.  The times taken by the connection phases
+   * are recorded, and also added to the JSON details of the attempt.
+   */
+  bool ConnectTo (const XmppEndpoint& ep, Json::Value& details);
+
   void onConnect () override;
   void onDisconnect (gloox::ConnectionError err) override;
   bool onTLSConnect (const gloox::CertInfo& info) override;
@@ -152,6 +238,26 @@ public:
    */
   void SetRootCA (const std::string& path);
 
+  /**
+   * Enables or disables XEP-0138 stream compression (zlib) for the
+   * connection.  It is enabled by default (as in gloox), but only used
+   * if the XMPP server offers it.  This must be called before Connect.
+   */
+  void SetStreamCompression (bool enable);
+
+  /**
+   * Returns traffic statistics for the current (or last) connection.
+   */
+  StreamStatistics GetStreamStatistics ();
+
+  /**
+   * Returns statistics about the connection setup as JSON:  Histograms
+   * (in milliseconds) of the time spent in each phase, as "resolve",
+   * "tcp", "tls" and "login", and details about the "last" attempt (the
+   * endpoint used, whether it was cached, and the phase times).
+   */
+  Json::Value GetConnectStats () const;
+
   /**
    * Adds a pubsub handler for the given pubsub service JID.
    */
@@ -163,11 +269,29 @@ public:
    */
   PubSubImpl& GetPubSub ();
 
+  /**
+   * Adds a further pubsub service, which is attached in addition to the
+   * main one set with AddPubSub.  This is used by servers that publish
+   * their notifications to several services.
+   */
+  void AddExtraPubSub (const gloox::JID& service);
+
+  /**
+   * Returns all pubsub instances, i.e. the main one followed by those for
+   * the extra services.  Must only be called if the main one was set up
+   * with AddPubSub and the server is connected.
+   */
+  std::vector<PubSubImpl*> GetAllPubSubs ();
+
   /**
    * Sets up the connection to the server, using the specified priority.
    * Once connected, the receiving loop will be started.  The loop will
    * run until the connection is closed.
    *
+   * The server's endpoints are taken from the process-wide EndpointCache,
+   * so that reconnects need not wait for DNS, and are tried in order
+   * (starting with the one that worked last).
+   *
    * Returns true if the connection was opened successfully, and false
    * if the connection failed (in which case the client will still be
    * disconnected after return).
@@ -59,7 +59,8 @@ private:
 
 public:
 
-  explicit TestXmppClient (const TestAccount& acc)
+  explicit TestXmppClient (const TestAccount& acc,
+                           const bool compression = false)
     : XmppClient(JIDWithoutResource (acc), acc.password)
   {
     RunWithClient ([this] (gloox::Client& c)
@@ -68,6 +69,7 @@ public:
       });
 
     SetRootCA (GetTestCA ());
+    SetStreamCompression (compression);
 
     /* Connect with the default priority of zero.  */
     Connect (0);
@@ -152,6 +154,41 @@ TEST_F (XmppClientTests, Reconnection)
   ASSERT_TRUE (client.IsConnected ());
 }
 
+TEST_F (XmppClientTests, ConnectStats)
+{
+  TestXmppClient client(GetTestAccount (0));
+  ASSERT_TRUE (client.IsConnected ());
+  client.Disconnect ();
+  ASSERT_TRUE (client.Connect (0));
+
+  const auto stats = client.GetConnectStats ();
+  for (const std::string phase : {"resolve", "tcp", "tls", "login"})
+    EXPECT_EQ (stats[phase]["count"].asInt (), 2) << phase;
+
+  const auto& last = stats["last"];
+  EXPECT_TRUE (last["success"].asBool ());
+  EXPECT_EQ (last["attempts"].asInt (), 1);
+  EXPECT_TRUE (last.isMember ("login"));
+}
+
+TEST_F (XmppClientTests, ConnectStatsOnFailure)
+{
+  const auto& acc = GetTestAccount (0);
+  XmppClient client(JIDWithoutResource (acc), "wrong");
+  client.SetRootCA (GetTestCA ());
+  ASSERT_FALSE (client.Connect (0));
+
+  const auto stats = client.GetConnectStats ();
+  EXPECT_EQ (stats["resolve"]["count"].asInt (), 1);
+  EXPECT_EQ (stats["login"]["count"].asInt (), 0);
+  EXPECT_FALSE (stats["last"]["success"].asBool ());
+
+  /* Authentication failures are not retried on other endpoints.  The
+     endpoint that worked in earlier tests is tried first (the cache is
+     shared within the process), so this is the only attempt.  */
+  EXPECT_EQ (stats["last"]["attempts"].asInt (), 1);
+}
+
 TEST_F (XmppClientTests, Messages)
 {
   TestXmppClient client1(GetTestAccount (0));
@@ -166,6 +203,34 @@ TEST_F (XmppClientTests, Messages)
   client2.ExpectMessages ({"foo", "bar"});
 }
 
+TEST_F (XmppClientTests, StreamCompression)
+{
+  TestXmppClient client1(GetTestAccount (0), true);
+  TestXmppClient client2(GetTestAccount (1), true);
+  ASSERT_TRUE (client1.IsConnected ());
+
+  client1.SendMessage (client2, "foo");
+  client2.ExpectMessages ({"foo"});
+
+  /* The test XMPP server offers compression.  */
+  const auto stats = client1.GetStreamStatistics ();
+  EXPECT_TRUE (stats.compressed);
+  EXPECT_GT (stats.xmlBytesSent, 0);
+  EXPECT_GT (stats.xmlBytesReceived, 0);
+  EXPECT_GT (stats.stanzasSent, 0);
+  EXPECT_GT (stats.wireBytesSent, 0);
+}
+
+TEST_F (XmppClientTests, StreamCompressionDisabled)
+{
+  TestXmppClient client(GetTestAccount (0), false);
+  ASSERT_TRUE (client.IsConnected ());
+
+  const auto stats = client.GetStreamStatistics ();
+  EXPECT_FALSE (stats.compressed);
+  EXPECT_EQ (stats.wireBytesSent, stats.xmlBytesSent);
+}
+
 /* ************************************************************************** */
 
 } // anonymous namespace
@@ -20,8 +20,11 @@ fashion for integration testing.
 """
 
 import jsonrpclib
+from jsonrpclib import ProtocolError
+import json
 import logging
 import os
+import socket
 import subprocess
 import time
 
@@ -32,6 +35,49 @@ import time
 STARTUP_SLEEP = 1
 
 
+class UnixSocketProxy ():
+  """
+  A minimal JSON-RPC client for charon-client's Unix domain socket interface,
+  which can be used like a jsonrpclib.ServerProxy for calling methods.
+  Each call opens its own connection and sends a single request terminated
+  by a newline, so that instances can be shared between threads.
+  """
+
+  def __init__ (self, path):
+    self.path = path
+
+  def __getattr__ (self, name):
+    if name.startswith ("_"):
+      raise AttributeError (name)
+    return lambda *args, **kwargs: self._call (name, args or kwargs)
+
+  def _call (self, method, params):
+    req = {
+      "jsonrpc": "2.0",
+      "id": 1,
+      "method": method,
+      "params": params,
+    }
+
+    with socket.socket (socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+      sock.connect (self.path)
+      sock.sendall ((json.dumps (req) + "\n").encode ("utf-8"))
+
+      data = b""
+      while not data.endswith (b"\n"):
+        chunk = sock.recv (4096)
+        if not chunk:
+          break
+        data += chunk
+
+    resp = json.loads (data.decode ("utf-8"))
+    if "error" in resp:
+      err = resp["error"]
+      raise ProtocolError ((err["code"], err["message"]))
+
+    return resp["result"]
+
+
 class Client ():
   """
   A context manager that runs a charon-client process under the hood while
@@ -40,10 +86,12 @@ class Client ():
 
   def __init__ (self, basedir, binary, port, methods,
                 serverJid, clientJid, password,
-                extraArgs):
+                extraArgs, socketPath=None):
     """
     Constructs the manager, which will run the charon-client binary located
     at the given path, setting its log directory and JSON-RPC port as provided.
+    If socketPath is given, the local RPC interface is served on a Unix
+    domain socket there instead of the port.
     """
 
     self.log = logging.getLogger ("charon-client")
@@ -57,6 +105,7 @@ class Client ():
     self.password = password
     self.cafile = None
     self.extraArgs = extraArgs
+    self.socketPath = socketPath
 
     self.rpcurl = "http://localhost:%d" % port
     self.proc = None
@@ -68,7 +117,10 @@ class Client ():
 
     args = [self.binary]
     args.append ("--nodetect_server")
-    args.extend (["--port", "%d" % self.port])
+    if self.socketPath is None:
+      args.extend (["--port", "%d" % self.port])
+    else:
+      args.extend (["--rpc_socket", self.socketPath])
     args.extend (["--client_jid", self.clientJid])
     args.extend (["--server_jid", self.serverJid])
     args.extend (["--password", self.password])
@@ -100,6 +152,9 @@ class Client ():
     Returns a fresh JSON-RPC client connection to the process' local server.
     """
 
+    if self.socketPath is not None:
+      return UnixSocketProxy (self.socketPath)
+
     return jsonrpclib.ServerProxy (self.rpcurl)
 
 
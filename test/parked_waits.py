@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+
+#   Charon - a transport system for GSP data
+#   Copyright (C) 2026  Autonomous Worlds Ltd
+#
+#   This program is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation, either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+"""
+Load test for parked waits on the local RPC interface:  Many concurrent
+waitforchange calls must not prevent fast calls from being processed.
+"""
+
+import testcase
+
+import resource
+import threading
+import time
+
+
+# Number of concurrent waitforchange callers.
+WAITERS = 1000
+
+# Number of worker threads for the client.
+RPC_THREADS = 4
+
+# Number of threads making fast calls and calls each of them makes.
+FAST_THREADS = 8
+FAST_CALLS = 25
+
+# Maximum latency we accept for fast calls while the waits are parked.
+MAX_LATENCY = 2
+
+
+class Methods:
+  """
+  The RPC backend, which supports echo and waitforchange calls.  The latter
+  block until we explicitly specify a new state.
+  """
+
+  methods = ["echo"]
+
+  def __init__ (self):
+    self.cv = threading.Condition ()
+    self.state = ""
+    self.waitEnabled = False
+
+  def __enter__ (self):
+    with self.cv:
+      self.waitEnabled = True
+    return self
+
+  def __exit__ (self, exc, value, traceback):
+    with self.cv:
+      self.waitEnabled = False
+      self.cv.notify_all ()
+
+  def echo (self, val):
+    return val
+
+  def waitforchange (self, known):
+    with self.cv:
+      if self.waitEnabled:
+        self.cv.wait ()
+      return self.state
+
+  def update (self, newState):
+    with self.cv:
+      self.state = newState
+      self.cv.notify_all ()
+
+
+def raiseFileLimit ():
+  """
+  Raises our limit of open files (which is inherited by the processes
+  we start), so that we can open all the connections.
+  """
+
+  _, hard = resource.getrlimit (resource.RLIMIT_NOFILE)
+  resource.setrlimit (resource.RLIMIT_NOFILE, (hard, hard))
+
+
+if __name__ == "__main__":
+  raiseFileLimit ()
+
+  with Methods () as backend, \
+       testcase.Fixture (backend.methods, waitforchange=True) as t, \
+       t.runClient (extraArgs=["--rpc_threads", str (RPC_THREADS),
+                               "--max_parked_waits", str (WAITERS)]) as c, \
+       t.runServer (backend):
+
+    # Make sure the client is connected and has selected the server
+    # before starting the load.
+    t.assertEqual (c.rpc.echo ("warmup"), "warmup")
+    time.sleep (1)
+
+    t.mainLogger.info ("Parking %d waits..." % WAITERS)
+    results = [None] * WAITERS
+    def waiter (i):
+      rpc = c.createRpc ()
+      # Waits may time out before we send the update, in which case
+      # we simply try again (as frontends would).
+      while results[i] != "new":
+        results[i] = rpc.waitforchange ("")
+    waiters = [threading.Thread (target=waiter, args=(i,))
+                for i in range (WAITERS)]
+    for w in waiters:
+      w.start ()
+    time.sleep (2)
+
+    t.mainLogger.info ("Further waits are rejected...")
+    t.expectRpcError (".*too many parked waits.*", c.rpc.waitforchange, "")
+
+    t.mainLogger.info ("Fast calls while waits are parked...")
+    latencies = []
+    errors = []
+    def fastCalls (i):
+      rpc = c.createRpc ()
+      for j in range (FAST_CALLS):
+        val = "%d-%d" % (i, j)
+        before = time.time ()
+        res = rpc.echo (val)
+        latencies.append (time.time () - before)
+        if res != val:
+          errors.append ((val, res))
+    fast = [threading.Thread (target=fastCalls, args=(i,))
+              for i in range (FAST_THREADS)]
+    for f in fast:
+      f.start ()
+    for f in fast:
+      f.join ()
+    t.assertEqual (errors, [])
+    t.assertEqual (len (latencies), FAST_THREADS * FAST_CALLS)
+    t.mainLogger.info ("Maximum latency: %.3f s" % max (latencies))
+    assert max (latencies) < MAX_LATENCY, "fast calls were blocked"
+
+    t.mainLogger.info ("Completing all parked waits...")
+    backend.update ("new")
+    for w in waiters:
+      w.join ()
+    t.assertEqual (results, ["new"] * WAITERS)
@@ -96,9 +96,11 @@ class Fixture (object):
 
     logging.shutdown ()
 
-  def runClient (self, methods=None, extraArgs=[]):
+  def runClient (self, methods=None, extraArgs=[], socket=False):
     """
     Returns a context manager for running a Charon client in our environment.
+    If socket is true, the client's local RPC interface is served on
+    a Unix domain socket in the base directory instead of HTTP.
     """
 
     binary = os.path.join (self.bindir, "charon-client")
@@ -110,12 +112,16 @@ class Fixture (object):
     if self.waitforchange:
       extraArgs.append ("--waitforchange")
 
+    socketPath = None
+    if socket:
+      socketPath = os.path.join (self.basedir, "client-%d.sock" % port)
+
     acc = self.cfg["accounts"]
     res = charonbin.Client (self.basedir, binary, port, methods,
                             self.getAccountJid (acc[0]),
                             self.getAccountJid (acc[1]),
                             acc[1][1],
-                            extraArgs)
+                            extraArgs, socketPath=socketPath)
     res.cafile = self.getRootCA ()
     return res
 
@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+
+#   Charon - a transport system for GSP data
+#   Copyright (C) 2026  Autonomous Worlds Ltd
+#
+#   This program is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation, either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+"""
+Tests the local RPC interface of charon-client served on a Unix domain
+socket, including concurrent callers.
+"""
+
+import testcase
+
+import threading
+import time
+
+
+# Number of concurrent caller threads and calls each of them makes.
+THREADS = 10
+CALLS_PER_THREAD = 20
+
+
+class Methods:
+  """
+  The RPC backend.  Besides simple methods, it supports waitforchange calls
+  that block until a new state is set explicitly.
+
+  This is also a context manager.  On exit, all waiting threads are woken up.
+  """
+
+  methods = ["echo", "error"]
+
+  def __init__ (self):
+    self.cv = threading.Condition ()
+    self.state = ""
+    self.waitEnabled = False
+
+  def __enter__ (self):
+    with self.cv:
+      self.waitEnabled = True
+    return self
+
+  def __exit__ (self, exc, value, traceback):
+    with self.cv:
+      self.waitEnabled = False
+      self.cv.notify_all ()
+
+  def echo (self, val):
+    return val
+
+  def error (self, msg):
+    raise RuntimeError (msg)
+
+  def waitforchange (self, known):
+    with self.cv:
+      if self.waitEnabled:
+        self.cv.wait ()
+      return self.state
+
+  def update (self, newState):
+    with self.cv:
+      self.state = newState
+      self.cv.notify_all ()
+
+
+def callConcurrently (rpc, fcn):
+  """
+  Runs fcn (rpc, i) in THREADS threads in parallel and returns the
+  list of results or exceptions raised per thread.
+  """
+
+  results, threads = startConcurrently (rpc, fcn)
+  for th in threads:
+    th.join ()
+
+  return results
+
+
+def startConcurrently (rpc, fcn):
+  """
+  Starts fcn (rpc, i) in THREADS threads in parallel.  Returns the list
+  that will hold the results (or exceptions) per thread, and the list
+  of threads.
+  """
+
+  results = [None] * THREADS
+
+  def worker (i):
+    try:
+      results[i] = fcn (rpc, i)
+    except Exception as exc:
+      results[i] = exc
+
+  threads = [threading.Thread (target=worker, args=(i,))
+              for i in range (THREADS)]
+  for th in threads:
+    th.start ()
+
+  return results, threads
+
+
+if __name__ == "__main__":
+  with Methods () as backend, \
+       testcase.Fixture (backend.methods, waitforchange=True) as t, \
+       t.runClient (socket=True) as c, \
+       t.runServer (backend):
+
+    t.mainLogger.info ("Basic calls over the socket...")
+    t.assertEqual (c.rpc.echo ("bla"), "bla")
+    t.assertEqual (c.rpc.echo ({"foo": [1, 2]}), {"foo": [1, 2]})
+    t.expectRpcError (".*my error.*", c.rpc.error, "my error")
+
+    t.mainLogger.info ("Concurrent callers...")
+    def echoMany (rpc, i):
+      res = []
+      for j in range (CALLS_PER_THREAD):
+        res.append (rpc.echo ("%d-%d" % (i, j)))
+      return res
+    results = callConcurrently (c.rpc, echoMany)
+    for i, res in enumerate (results):
+      t.assertEqual (res, ["%d-%d" % (i, j) for j in range (CALLS_PER_THREAD)])
+
+    t.mainLogger.info ("Blocked callers do not hold up others...")
+    # The waitforchange calls block inside charon-client until a
+    # notification arrives, so they keep their socket connections busy
+    # while other calls are made.
+    results, threads = startConcurrently (
+        c.rpc, lambda rpc, i: rpc.waitforchange (""))
+    time.sleep (1)
+    for th in threads:
+      assert th.is_alive (), "waitforchange returned early"
+
+    before = time.time ()
+    t.assertEqual (c.rpc.echo ("during wait"), "during wait")
+    duration = time.time () - before
+    assert duration < 1, "call was blocked by waiting callers"
+
+    backend.update ("new state")
+    for th in threads:
+      th.join ()
+    t.assertEqual (results, ["new state"] * THREADS)
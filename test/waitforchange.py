@@ -112,6 +112,18 @@ if __name__ == "__main__":
       backend.update ("second")
       t.assertEqual (w.wait (), "second")
 
+      t.mainLogger.info ("Testing waitforanychange...")
+      w = Waiter (c.rpc.waitforanychange, {"waitforchange": "other"})
+      t.assertEqual (w.wait (), {"method": "waitforchange", "state": "second"})
+
+      w = Waiter (c.rpc.waitforanychange, {"waitforchange": "second"})
+      w.assertRunning ()
+      backend.update ("any")
+      t.assertEqual (w.wait (), {"method": "waitforchange", "state": "any"})
+
+      t.expectRpcError (".*known state IDs.*", c.rpc.waitforanychange,
+                        {"invalid": ""})
+
     t.mainLogger.info ("Testing server reselection...")
     with t.runServer (backend):
       w = Waiter (c.rpc.waitforchange, "")
@@ -0,0 +1,464 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "eventstream.hpp"
+
+#include <glog/logging.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace charon
+{
+
+namespace
+{
+
+/** Interval for keep-alive comments on idle connections.  */
+constexpr auto KEEPALIVE_INTERVAL = std::chrono::seconds (15);
+
+/** Timeout for writing to a connection.  */
+constexpr int SOCKET_TIMEOUT_MS = 1'000;
+
+/** Time a new connection has to send its complete request.  */
+constexpr auto REQUEST_TIMEOUT = std::chrono::seconds (5);
+
+/**
+ * Maximum number of connections whose request we are reading at the same
+ * time.  Further connections are rejected.
+ */
+constexpr size_t MAX_PENDING = 64;
+
+/** Timeout for polling the listening socket (to check for stopping).  */
+constexpr int ACCEPT_POLL_MS = 200;
+
+/** Maximum size of the HTTP request we read.  */
+constexpr size_t MAX_REQUEST_SIZE = 8'192;
+
+/**
+ * Maximum number of queued events.  If the writer thread falls behind
+ * more than that, the oldest events are dropped.
+ */
+constexpr size_t MAX_QUEUED = 1'000;
+
+/**
+ * Sets the send and receive timeouts on a socket.
+ */
+void
+SetSocketTimeouts (const int fd)
+{
+  struct timeval tv;
+  tv.tv_sec = SOCKET_TIMEOUT_MS / 1'000;
+  tv.tv_usec = (SOCKET_TIMEOUT_MS % 1'000) * 1'000;
+  setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+  setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof (tv));
+}
+
+/**
+ * Sets or clears the non-blocking flag of a socket.
+ */
+void
+SetNonBlocking (const int fd, const bool nonBlocking)
+{
+  const int flags = fcntl (fd, F_GETFL, 0);
+  CHECK_GE (flags, 0) << "fcntl failed: " << std::strerror (errno);
+  const int newFlags = nonBlocking ? (flags | O_NONBLOCK)
+                                   : (flags & ~O_NONBLOCK);
+  CHECK_EQ (fcntl (fd, F_SETFL, newFlags), 0)
+      << "fcntl failed: " << std::strerror (errno);
+}
+
+/**
+ * A new connection whose request has not been read completely yet.
+ */
+struct PendingConnection
+{
+
+  /** The connection's socket (in non-blocking mode).  */
+  int fd;
+
+  /** The data read so far.  */
+  std::string request;
+
+  /** Time until which the request must be complete.  */
+  std::chrono::steady_clock::time_point deadline;
+
+};
+
+/**
+ * Result of reading from a pending connection.
+ */
+enum class ReadResult
+{
+  /** The request is not yet complete.  */
+  INCOMPLETE,
+  /** The full request head has been read.  */
+  COMPLETE,
+  /** The connection failed or the request is invalid.  */
+  FAILED,
+};
+
+/**
+ * Reads all data that is currently available from a pending connection.
+ */
+ReadResult
+ReadRequest (PendingConnection& c)
+{
+  while (true)
+    {
+      if (c.request.find ("\r\n\r\n") != std::string::npos)
+        return ReadResult::COMPLETE;
+      if (c.request.size () > MAX_REQUEST_SIZE)
+        {
+          LOG (WARNING) << "Event stream request is too large";
+          return ReadResult::FAILED;
+        }
+
+      char buf[1'024];
+      const auto n = recv (c.fd, buf, sizeof (buf), 0);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return ReadResult::INCOMPLETE;
+      if (n <= 0)
+        {
+          VLOG (1) << "Event stream connection closed before request";
+          return ReadResult::FAILED;
+        }
+      c.request.append (buf, n);
+    }
+}
+
+} // anonymous namespace
+
+EventStreamServer::EventStreamServer (const int p)
+  : keepAlive(KEEPALIVE_INTERVAL)
+{
+  listenFd = socket (AF_INET, SOCK_STREAM, 0);
+  if (listenFd < 0)
+    throw std::runtime_error ("failed to create event stream socket");
+
+  const int one = 1;
+  setsockopt (listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+
+  struct sockaddr_in addr;
+  std::memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons (p);
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+  socklen_t addrLen = sizeof (addr);
+  if (bind (listenFd, reinterpret_cast<struct sockaddr*> (&addr),
+            sizeof (addr)) != 0
+        || listen (listenFd, 16) != 0
+        || getsockname (listenFd, reinterpret_cast<struct sockaddr*> (&addr),
+                        &addrLen) != 0)
+    {
+      const std::string err = std::strerror (errno);
+      close (listenFd);
+      throw std::runtime_error ("failed to listen for event streams on port "
+                                + std::to_string (p) + ": " + err);
+    }
+  port = ntohs (addr.sin_port);
+
+  LOG (INFO) << "Serving event streams on port " << port;
+
+  acceptThread = std::make_unique<std::thread> ([this] ()
+    {
+      RunAccept ();
+    });
+  writeThread = std::make_unique<std::thread> ([this] ()
+    {
+      RunWrite ();
+    });
+}
+
+EventStreamServer::~EventStreamServer ()
+{
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    shouldStop = true;
+    cv.notify_all ();
+  }
+
+  acceptThread->join ();
+  writeThread->join ();
+
+  close (listenFd);
+  for (const int fd : newConnections)
+    close (fd);
+  for (const int fd : connections)
+    close (fd);
+}
+
+bool
+EventStreamServer::WriteAll (const int fd, const std::string& data)
+{
+  size_t done = 0;
+  while (done < data.size ())
+    {
+      const auto n = send (fd, data.data () + done, data.size () - done,
+                           MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      done += n;
+    }
+
+  return true;
+}
+
+bool
+EventStreamServer::StartStream (const int fd, const std::string& request)
+{
+  /* From now on, the socket is only written to (by the writer thread),
+     which uses blocking writes with a timeout.  */
+  SetNonBlocking (fd, false);
+  SetSocketTimeouts (fd);
+
+  /* We only need the request line, e.g. "GET /events HTTP/1.1".  */
+  const auto lineEnd = request.find ("\r\n");
+  const std::string line = request.substr (0, lineEnd);
+  const auto pathEnd = line.find (' ', 4);
+  std::string path;
+  if (line.compare (0, 4, "GET ") == 0 && pathEnd != std::string::npos)
+    path = line.substr (4, pathEnd - 4);
+  path = path.substr (0, path.find ('?'));
+
+  if (path != "/" && path != "/events")
+    {
+      LOG (WARNING) << "Invalid event stream request: " << line;
+      WriteAll (fd, "HTTP/1.1 404 Not Found\r\n"
+                    "Content-Length: 0\r\n"
+                    "Connection: close\r\n\r\n");
+      close (fd);
+      return false;
+    }
+
+  const bool ok = WriteAll (fd, "HTTP/1.1 200 OK\r\n"
+                                "Content-Type: text/event-stream\r\n"
+                                "Cache-Control: no-cache\r\n"
+                                "Connection: keep-alive\r\n"
+                                "Access-Control-Allow-Origin: *\r\n\r\n");
+  if (!ok)
+    {
+      close (fd);
+      return false;
+    }
+
+  return true;
+}
+
+void
+EventStreamServer::RunAccept ()
+{
+  /* Requests are read from all new connections in parallel with
+     non-blocking sockets, polled together with the listening socket.  */
+  std::vector<PendingConnection> pending;
+
+  while (true)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mut);
+        if (shouldStop)
+          break;
+      }
+
+      std::vector<struct pollfd> pfds(1 + pending.size ());
+      pfds[0].fd = listenFd;
+      pfds[0].events = POLLIN;
+      for (size_t i = 0; i < pending.size (); ++i)
+        {
+          pfds[i + 1].fd = pending[i].fd;
+          pfds[i + 1].events = POLLIN;
+        }
+
+      if (poll (pfds.data (), pfds.size (), ACCEPT_POLL_MS) < 0)
+        continue;
+
+      const auto now = std::chrono::steady_clock::now ();
+      std::vector<PendingConnection> stillPending;
+      for (size_t i = 0; i < pending.size (); ++i)
+        {
+          auto& c = pending[i];
+
+          ReadResult res = ReadResult::INCOMPLETE;
+          if (pfds[i + 1].revents != 0)
+            res = ReadRequest (c);
+
+          switch (res)
+            {
+            case ReadResult::INCOMPLETE:
+              if (now < c.deadline)
+                stillPending.push_back (std::move (c));
+              else
+                {
+                  VLOG (1) << "Timeout reading event stream request";
+                  close (c.fd);
+                }
+              break;
+
+            case ReadResult::FAILED:
+              close (c.fd);
+              break;
+
+            case ReadResult::COMPLETE:
+              if (StartStream (c.fd, c.request))
+                {
+                  VLOG (1) << "New event stream connection";
+                  std::lock_guard<std::mutex> lock(mut);
+                  newConnections.push_back (c.fd);
+                  cv.notify_all ();
+                }
+              break;
+            }
+        }
+      pending.swap (stillPending);
+
+      if (pfds[0].revents == 0)
+        continue;
+
+      const int fd = accept (listenFd, nullptr, nullptr);
+      if (fd < 0)
+        {
+          LOG (WARNING)
+              << "Failed to accept event stream connection: "
+              << std::strerror (errno);
+          continue;
+        }
+
+      if (pending.size () >= MAX_PENDING)
+        {
+          LOG (WARNING)
+              << "Too many pending event stream connections, rejecting";
+          close (fd);
+          continue;
+        }
+
+      SetNonBlocking (fd, true);
+      PendingConnection c;
+      c.fd = fd;
+      c.deadline = now + REQUEST_TIMEOUT;
+      pending.push_back (std::move (c));
+    }
+
+  for (const auto& c : pending)
+    close (c.fd);
+}
+
+void
+EventStreamServer::RunWrite ()
+{
+  while (true)
+    {
+      std::vector<int> added;
+      std::string initial;
+      std::deque<std::string> events;
+
+      {
+        std::unique_lock<std::mutex> lock(mut);
+
+        /* The keep-alive interval may be changed while we wait, so it is
+           checked again after each wakeup.  */
+        const auto start = std::chrono::steady_clock::now ();
+        while (!shouldStop && queue.empty () && newConnections.empty ()
+                && std::chrono::steady_clock::now () < start + keepAlive)
+          cv.wait_until (lock, start + keepAlive);
+        if (shouldStop)
+          return;
+
+        events.swap (queue);
+
+        /* New connections get the latest event of each name, which already
+           includes the events queued right now.  */
+        added.swap (newConnections);
+        if (!added.empty ())
+          for (const auto& entry : latest)
+            initial += entry.second;
+      }
+
+      /* Without any events, send a comment as keep-alive, which also
+         detects closed connections.  */
+      if (events.empty () && added.empty ())
+        events.push_back (": keepalive\n\n");
+
+      std::string data;
+      for (const auto& e : events)
+        data += e;
+
+      std::vector<int> remaining;
+      for (const int fd : connections)
+        if (data.empty () || WriteAll (fd, data))
+          remaining.push_back (fd);
+        else
+          {
+            VLOG (1) << "Dropping event stream connection";
+            close (fd);
+          }
+
+      for (const int fd : added)
+        if (initial.empty () || WriteAll (fd, initial))
+          remaining.push_back (fd);
+        else
+          close (fd);
+
+      std::lock_guard<std::mutex> lock(mut);
+      connections.swap (remaining);
+    }
+}
+
+void
+EventStreamServer::Publish (const std::string& name, const Json::Value& data)
+{
+  Json::StreamWriterBuilder wbuilder;
+  wbuilder["commentStyle"] = "None";
+  wbuilder["indentation"] = "";
+
+  const std::string event = "event: " + name + "\n"
+                              + "data: " + Json::writeString (wbuilder, data)
+                              + "\n\n";
+
+  std::lock_guard<std::mutex> lock(mut);
+  latest[name] = event;
+  queue.push_back (event);
+  if (queue.size () > MAX_QUEUED)
+    {
+      LOG (WARNING) << "Event stream queue is full, dropping event";
+      queue.pop_front ();
+    }
+  cv.notify_all ();
+}
+
+std::size_t
+EventStreamServer::GetNumConnections () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return connections.size ();
+}
+
+} // namespace charon
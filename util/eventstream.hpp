@@ -0,0 +1,170 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_UTILS_EVENTSTREAM_HPP
+#define CHARON_UTILS_EVENTSTREAM_HPP
+
+#include <json/json.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace charon
+{
+
+/**
+ * A minimal HTTP server that streams events to connected clients as
+ * Server-Sent Events (text/event-stream).  This is used by charon-client
+ * to push notification updates to local frontends, so that they do not
+ * have to long-poll the waitforchange methods.
+ *
+ * Clients connect with a GET request to "/" or "/events".  They first
+ * receive the latest event for each name (if any), and then all events as
+ * they are published.  Each event has the event name and the JSON data
+ * serialised on a single line.
+ *
+ * Publishing only queues the event.  A separate thread writes it to all
+ * connections, dropping those that fail or are too slow, so that publishers
+ * (e.g. the XMPP thread) never block on frontends.  Requests of new
+ * connections are read without blocking, so that a slow client cannot hold
+ * up accepting others either.
+ */
+class EventStreamServer
+{
+
+private:
+
+  /** The listening socket.  */
+  int listenFd = -1;
+
+  /** The port we are listening on.  */
+  int port;
+
+  /** Thread accepting new connections.  */
+  std::unique_ptr<std::thread> acceptThread;
+
+  /** Thread writing queued events to the connections.  */
+  std::unique_ptr<std::thread> writeThread;
+
+  /** Mutex for the internal state.  */
+  mutable std::mutex mut;
+
+  /** Condition variable signalled when events are queued or we stop.  */
+  std::condition_variable cv;
+
+  /** Set to true when the server is stopping.  */
+  bool shouldStop = false;
+
+  /** Sockets of connections that have not yet received anything.  */
+  std::vector<int> newConnections;
+
+  /**
+   * Sockets of active connections.  They are only written to by the writer
+   * thread, but the vector itself is modified with mut held.
+   */
+  std::vector<int> connections;
+
+  /** Interval for keep-alive comments when there are no events.  */
+  std::chrono::milliseconds keepAlive;
+
+  /** Serialised events waiting to be written.  */
+  std::deque<std::string> queue;
+
+  /** Latest serialised event for each name.  */
+  std::map<std::string, std::string> latest;
+
+  /**
+   * Runs the loop accepting connections.
+   */
+  void RunAccept ();
+
+  /**
+   * Runs the loop writing events.
+   */
+  void RunWrite ();
+
+  /**
+   * Replies to the HTTP request read from a new connection with the stream
+   * headers.  Returns false (and closes the socket) if the request is not
+   * valid for us.
+   */
+  static bool StartStream (int fd, const std::string& request);
+
+  /**
+   * Writes all of the data to the socket.  Returns false if that failed.
+   */
+  static bool WriteAll (int fd, const std::string& data);
+
+public:
+
+  /**
+   * Starts listening on the given port on the loopback interface.  If the
+   * port is zero, a free one is chosen.  Throws if the port cannot be bound.
+   */
+  explicit EventStreamServer (int p);
+
+  ~EventStreamServer ();
+
+  EventStreamServer () = delete;
+  EventStreamServer (const EventStreamServer&) = delete;
+  void operator= (const EventStreamServer&) = delete;
+
+  /**
+   * Returns the port the server is listening on.
+   */
+  int
+  GetPort () const
+  {
+    return port;
+  }
+
+  /**
+   * Sets the keep-alive interval to a custom value.
+   */
+  template <typename Rep, typename Period>
+    void
+    SetKeepAlive (const std::chrono::duration<Rep, Period>& val)
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    keepAlive = std::chrono::duration_cast<std::chrono::milliseconds> (val);
+    cv.notify_all ();
+  }
+
+  /**
+   * Queues an event with the given name and data for all connections.
+   */
+  void Publish (const std::string& name, const Json::Value& data);
+
+  /**
+   * Returns the number of active connections (for testing).
+   */
+  std::size_t GetNumConnections () const;
+
+};
+
+} // namespace charon
+
+#endif // CHARON_UTILS_EVENTSTREAM_HPP
@@ -0,0 +1,267 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "eventstream.hpp"
+
+#include <gtest/gtest.h>
+
+#include <glog/logging.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace charon
+{
+namespace
+{
+
+using namespace std::chrono_literals;
+
+/**
+ * A raw TCP connection to the event stream server.
+ */
+class TestConnection
+{
+
+private:
+
+  int fd;
+
+  /** Data received but not yet consumed.  */
+  std::string buffer;
+
+public:
+
+  explicit TestConnection (const int port)
+  {
+    fd = socket (AF_INET, SOCK_STREAM, 0);
+    CHECK_GE (fd, 0);
+
+    struct timeval tv;
+    tv.tv_sec = 5;
+    tv.tv_usec = 0;
+    setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+
+    struct sockaddr_in addr;
+    std::memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons (port);
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    CHECK_EQ (connect (fd, reinterpret_cast<struct sockaddr*> (&addr),
+                       sizeof (addr)), 0);
+  }
+
+  ~TestConnection ()
+  {
+    close (fd);
+  }
+
+  TestConnection () = delete;
+  TestConnection (const TestConnection&) = delete;
+  void operator= (const TestConnection&) = delete;
+
+  void
+  Send (const std::string& data)
+  {
+    const auto n = send (fd, data.data (), data.size (), MSG_NOSIGNAL);
+    CHECK_EQ (n, static_cast<ssize_t> (data.size ()));
+  }
+
+  /**
+   * Reads until the given string has been received, and returns all data
+   * up to and including it.  Returns an empty string if the connection
+   * is closed or times out before.
+   */
+  std::string
+  ReadUntil (const std::string& str)
+  {
+    while (true)
+      {
+        const auto pos = buffer.find (str);
+        if (pos != std::string::npos)
+          {
+            const std::string res = buffer.substr (0, pos + str.size ());
+            buffer.erase (0, pos + str.size ());
+            return res;
+          }
+
+        char buf[1'024];
+        const auto n = recv (fd, buf, sizeof (buf), 0);
+        if (n <= 0)
+          return "";
+        buffer.append (buf, n);
+      }
+  }
+
+  /**
+   * Sends a request for the event stream and reads the response headers.
+   */
+  std::string
+  StartStream (const std::string& path = "/events")
+  {
+    Send ("GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    return ReadUntil ("\r\n\r\n");
+  }
+
+};
+
+class EventStreamServerTests : public testing::Test
+{
+
+protected:
+
+  EventStreamServer server;
+
+  EventStreamServerTests ()
+    : server(0)
+  {}
+
+  /**
+   * Waits until the server has the given number of active connections.
+   */
+  void
+  WaitForConnections (const size_t num)
+  {
+    for (unsigned i = 0; i < 500; ++i)
+      {
+        if (server.GetNumConnections () == num)
+          return;
+        std::this_thread::sleep_for (10ms);
+      }
+
+    FAIL () << "Timeout waiting for " << num << " connections";
+  }
+
+};
+
+TEST_F (EventStreamServerTests, Handshake)
+{
+  TestConnection conn(server.GetPort ());
+  const std::string headers = conn.StartStream ("/events?foo=bar");
+  EXPECT_EQ (headers.substr (0, 15), "HTTP/1.1 200 OK");
+  EXPECT_NE (headers.find ("Content-Type: text/event-stream\r\n"),
+             std::string::npos);
+  WaitForConnections (1);
+}
+
+TEST_F (EventStreamServerTests, InvalidPath)
+{
+  TestConnection conn(server.GetPort ());
+  const std::string headers = conn.StartStream ("/foo");
+  EXPECT_EQ (headers.substr (0, 22), "HTTP/1.1 404 Not Found");
+  EXPECT_EQ (conn.ReadUntil ("event:"), "");
+}
+
+TEST_F (EventStreamServerTests, InitialReplay)
+{
+  server.Publish ("foo", 1);
+  server.Publish ("bar", 2);
+  server.Publish ("foo", 3);
+
+  TestConnection conn(server.GetPort ());
+  conn.StartStream ();
+  EXPECT_EQ (conn.ReadUntil ("\n\n"), "event: bar\ndata: 2\n\n");
+  EXPECT_EQ (conn.ReadUntil ("\n\n"), "event: foo\ndata: 3\n\n");
+}
+
+TEST_F (EventStreamServerTests, LiveEvents)
+{
+  TestConnection conn(server.GetPort ());
+  conn.StartStream ();
+  WaitForConnections (1);
+
+  server.Publish ("foo", 1);
+  EXPECT_EQ (conn.ReadUntil ("\n\n"), "event: foo\ndata: 1\n\n");
+
+  Json::Value data(Json::objectValue);
+  data["value"] = "x";
+  server.Publish ("bar", data);
+  EXPECT_EQ (conn.ReadUntil ("\n\n"),
+             "event: bar\ndata: {\"value\":\"x\"}\n\n");
+}
+
+TEST_F (EventStreamServerTests, KeepAlive)
+{
+  server.SetKeepAlive (50ms);
+
+  TestConnection conn(server.GetPort ());
+  conn.StartStream ();
+  EXPECT_EQ (conn.ReadUntil ("\n\n"), ": keepalive\n\n");
+}
+
+TEST_F (EventStreamServerTests, ClosedConnectionDropped)
+{
+  server.SetKeepAlive (50ms);
+
+  {
+    TestConnection conn(server.GetPort ());
+    conn.StartStream ();
+    WaitForConnections (1);
+  }
+
+  WaitForConnections (0);
+}
+
+TEST_F (EventStreamServerTests, SlowConsumerDropped)
+{
+  TestConnection slow(server.GetPort ());
+  slow.StartStream ();
+  TestConnection fast(server.GetPort ());
+  fast.StartStream ();
+  WaitForConnections (2);
+
+  /* Publish much more data than fits into the socket buffers without
+     reading it on the slow connection.  */
+  const std::string big(1 << 20, 'x');
+  for (unsigned i = 0; i < 64; ++i)
+    {
+      server.Publish ("big", big);
+      fast.ReadUntil ("\n\n");
+    }
+
+  WaitForConnections (1);
+
+  server.Publish ("foo", 42);
+  EXPECT_EQ (fast.ReadUntil ("\n\n"), "event: foo\ndata: 42\n\n");
+}
+
+TEST_F (EventStreamServerTests, SlowRequestDoesNotBlockAccept)
+{
+  TestConnection slow(server.GetPort ());
+  slow.Send ("GET /events HTTP/1.1\r\n");
+
+  TestConnection conn(server.GetPort ());
+  const auto start = std::chrono::steady_clock::now ();
+  EXPECT_EQ (conn.StartStream ().substr (0, 15), "HTTP/1.1 200 OK");
+  EXPECT_LT (std::chrono::steady_clock::now () - start, 500ms);
+
+  slow.Send ("\r\n");
+  EXPECT_EQ (slow.ReadUntil ("\r\n\r\n").substr (0, 15), "HTTP/1.1 200 OK");
+  WaitForConnections (2);
+}
+
+} // anonymous namespace
+} // namespace charon
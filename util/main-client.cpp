@@ -19,13 +19,20 @@
 #include "config.h"
 
 #include "methods.hpp"
+#include "notificationconfig.hpp"
 #include "util-client.hpp"
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <sys/resource.h>
+
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 namespace
 {
@@ -39,16 +46,109 @@ DEFINE_string (password, "", "XMPP password for the client JID");
 
 DEFINE_string (cafile, "",
                "if set, use this file as CA trust root of the system default");
+DEFINE_bool (stream_compression, true,
+             "If true, use XMPP stream compression if the server offers it");
+
+DEFINE_int32 (xmpp_connections, 1,
+              "Number of XMPP connections over which calls are distributed");
+DEFINE_string (endpoint_jids, "",
+               "Comma-separated JIDs of further XMPP accounts (e.g. on other"
+               " XMPP servers) over which calls can be routed");
+DEFINE_string (endpoint_passwords, "",
+               "Comma-separated passwords for --endpoint_jids");
+DEFINE_string (preferred_pubsub_services, "",
+               "Comma-separated list of pubsub services (e.g. the nearest ones)"
+               " to subscribe on if the server offers several");
+DEFINE_bool (direct_push, false,
+             "If true, ask the server to push notifications directly instead"
+             " of subscribing to its pubsub nodes");
 
 DEFINE_int32 (port, 0, "Port for the local JSON-RPC server");
+DEFINE_string (rpc_socket, "",
+               "If set, serve the local JSON-RPC interface on a Unix domain"
+               " socket at this path instead of HTTP on --port");
+DEFINE_int32 (rpc_threads, 50,
+              "Number of worker threads processing local JSON-RPC calls");
+DEFINE_int32 (max_parked_waits, 1'000,
+              "Maximum number of waitforchange-like calls that can be"
+              " parked at the same time");
+DEFINE_int32 (events_port, 0,
+              "If set, push notification updates as Server-Sent Events"
+              " on this local port");
 
 DEFINE_bool (waitforchange, false, "If true, enable waitforchange updates");
 DEFINE_bool (waitforpendingchange, false,
              "If true, enable waitforpendingchange updates");
+DEFINE_string (pending_filter, "",
+               "If set, only track the parts of the pending state selected"
+               " by this JSON filter, e.g. {\"path\": \"/pending\","
+               " \"keys\": [\"domob\"]}");
 
 DEFINE_bool (detect_server, true,
              "Whether to run server detection immediately on start");
 
+DEFINE_int32 (retry_attempts, 1,
+              "Maximum number of attempts for calls to idempotent methods"
+              " (see --methods_idempotent)");
+DEFINE_int32 (retry_attempt_ms, 1000,
+              "Timeout in milliseconds for each attempt when retrying");
+DEFINE_int32 (breaker_failures, 0,
+              "If positive, avoid a server instance after that many failed"
+              " calls to it in a row");
+DEFINE_int32 (breaker_cooldown_ms, 10000,
+              "Time in milliseconds for which a failed server is avoided");
+
+/**
+ * Splits a comma-separated list of values.
+ */
+std::vector<std::string>
+SplitList (const std::string& lst)
+{
+  std::vector<std::string> res;
+
+  std::istringstream in(lst);
+  std::string cur;
+  while (std::getline (in, cur, ','))
+    if (!cur.empty ())
+      res.push_back (cur);
+
+  return res;
+}
+
+/** Number of file descriptors we reserve beyond local RPC connections.  */
+constexpr rlim_t EXTRA_FILES = 256;
+
+/**
+ * Raises the soft limit on open files (up to the hard limit) if needed
+ * to support the given number of local RPC connections.
+ */
+void
+RaiseFileLimit (const rlim_t connections)
+{
+  struct rlimit lim;
+  if (getrlimit (RLIMIT_NOFILE, &lim) != 0)
+    return;
+
+  const rlim_t wanted = connections + EXTRA_FILES;
+  if (lim.rlim_cur == RLIM_INFINITY || lim.rlim_cur >= wanted)
+    return;
+
+  rlim_t target = wanted;
+  if (lim.rlim_max != RLIM_INFINITY && target > lim.rlim_max)
+    {
+      LOG (WARNING)
+          << "Hard limit of " << lim.rlim_max << " open files may be too low"
+          << " for " << connections << " local RPC connections";
+      target = lim.rlim_max;
+    }
+
+  lim.rlim_cur = target;
+  if (setrlimit (RLIMIT_NOFILE, &lim) != 0)
+    LOG (WARNING) << "Failed to raise the limit on open files";
+  else
+    LOG (INFO) << "Raised the limit on open files to " << target;
+}
+
 } // anonymous namespace
 
 int
@@ -67,22 +167,71 @@ main (int argc, char** argv)
       if (FLAGS_client_jid.empty ())
         throw std::runtime_error ("--client_jid must be set");
 
-      if (FLAGS_port == 0)
-        throw std::runtime_error ("--port must be set");
+      if ((FLAGS_port == 0) == FLAGS_rpc_socket.empty ())
+        throw std::runtime_error ("exactly one of --port and --rpc_socket"
+                                  " must be set");
+
+      if (FLAGS_rpc_threads <= 0)
+        throw std::runtime_error ("--rpc_threads must be positive");
+      if (FLAGS_xmpp_connections <= 0)
+        throw std::runtime_error ("--xmpp_connections must be positive");
+      if (FLAGS_max_parked_waits < 0)
+        throw std::runtime_error ("--max_parked_waits must not be negative");
+
+      const auto endpointJids = SplitList (FLAGS_endpoint_jids);
+      const auto endpointPasswords = SplitList (FLAGS_endpoint_passwords);
+      if (endpointJids.size () != endpointPasswords.size ())
+        throw std::runtime_error ("--endpoint_passwords must have one entry"
+                                  " for each of --endpoint_jids");
+
+      charon::LocalRpcConfig rpc;
+      rpc.port = FLAGS_port;
+      rpc.socketPath = FLAGS_rpc_socket;
+      rpc.threads = FLAGS_rpc_threads;
+      rpc.maxParkedWaits = FLAGS_max_parked_waits;
+
+      /* Each parked wait holds a connection open, so make sure we can
+         have enough file descriptors.  */
+      RaiseFileLimit (rpc.maxParkedWaits + rpc.threads);
 
       charon::UtilClient client(FLAGS_server_jid, FLAGS_backend_version,
-                                FLAGS_client_jid, FLAGS_password,
-                                FLAGS_port);
+                                FLAGS_client_jid, FLAGS_password, rpc);
 
       client.AddMethods (charon::GetSelectedMethods ());
 
       if (FLAGS_waitforchange)
         client.EnableWaitForChange ();
       if (FLAGS_waitforpendingchange)
-        client.EnableWaitForPendingChange ();
+        {
+          if (FLAGS_pending_filter.empty ())
+            client.EnableWaitForPendingChange ();
+          else
+            client.EnableWaitForPendingChange (FLAGS_pending_filter);
+        }
+      for (const auto& cfg : charon::GetConfiguredNotifications ())
+        client.EnableNotification (cfg);
+      if (FLAGS_events_port != 0)
+        client.EnableEventStream (FLAGS_events_port);
+
+      if (FLAGS_retry_attempts > 1)
+        client.EnableRetries (charon::GetIdempotentMethods (),
+                              FLAGS_retry_attempts,
+                              std::chrono::milliseconds (
+                                  FLAGS_retry_attempt_ms));
+      if (FLAGS_breaker_failures > 0)
+        client.EnableServerBreakers (FLAGS_breaker_failures,
+                                     std::chrono::milliseconds (
+                                         FLAGS_breaker_cooldown_ms));
 
       if (!FLAGS_cafile.empty ())
         client.SetRootCA (FLAGS_cafile);
+      client.SetStreamCompression (FLAGS_stream_compression);
+      client.SetConnections (FLAGS_xmpp_connections);
+      client.SetDirectPush (FLAGS_direct_push);
+      for (const auto& s : SplitList (FLAGS_preferred_pubsub_services))
+        client.AddPreferredPubSub (s);
+      for (size_t i = 0; i < endpointJids.size (); ++i)
+        client.AddEndpoint (endpointJids[i], endpointPasswords[i]);
 
       client.Run (FLAGS_detect_server);
       return EXIT_SUCCESS;
@@ -0,0 +1,296 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include "client.hpp"
+#include "histogram.hpp"
+#include "rpcserver.hpp"
+#include "trafficlog.hpp"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <json/json.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+DEFINE_string (server_jid, "", "Bare or full JID for the server");
+DEFINE_string (backend_version, "",
+               "A string identifying the version of the backend"
+               " that the server should run");
+
+DEFINE_string (client_jid, "",
+               "Bare JID for the clients (each gets its own resource)");
+DEFINE_string (password, "", "XMPP password for the client JID");
+
+DEFINE_string (cafile, "",
+               "if set, use this file as CA trust root of the system default");
+
+DEFINE_string (traffic_log, "",
+               "The traffic log (recorded by charon-server) to replay");
+DEFINE_double (speed, 1.0,
+               "Replay speed relative to the recorded timing, or zero to"
+               " send requests as fast as possible");
+DEFINE_int32 (clients, 4, "Number of Charon clients to send requests with");
+DEFINE_int32 (max_requests, 0,
+              "If positive, replay at most that many requests");
+DEFINE_int32 (timeout_ms, 5000, "Timeout in milliseconds for each call");
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Returns the duration in milliseconds between two time points.
+ */
+double
+GetMs (const Clock::time_point from, const Clock::time_point to)
+{
+  return std::chrono::duration<double, std::milli> (to - from).count ();
+}
+
+/**
+ * Returns summary statistics and the full histogram as JSON.
+ */
+Json::Value
+Summarise (const charon::Histogram& h)
+{
+  Json::Value res(Json::objectValue);
+  res["p50"] = h.GetQuantile (0.5);
+  res["p90"] = h.GetQuantile (0.9);
+  res["p99"] = h.GetQuantile (0.99);
+  res["histogram"] = h.ToJson ();
+  return res;
+}
+
+/**
+ * The replay of a loaded traffic log with a set of clients.
+ */
+class Replay
+{
+
+private:
+
+  /** The records to replay.  */
+  const std::vector<charon::TrafficRecord>& records;
+
+  /** Clients used for sending the requests.  */
+  std::vector<std::unique_ptr<charon::Client>> clients;
+
+  /** Index of the next record to send.  */
+  std::atomic<size_t> next;
+
+  /** Number of calls that returned an error.  */
+  std::atomic<unsigned> errors;
+
+  /**
+   * Number of calls where the outcome (error or success) differed
+   * from the recorded one.
+   */
+  std::atomic<unsigned> mismatches;
+
+  /** Latencies of all calls.  */
+  charon::Histogram latency;
+
+  /** Latencies of calls per method.  */
+  std::map<std::string, std::unique_ptr<charon::Histogram>> methodLatency;
+
+  /**
+   * Delays between the intended start of a call (according to the recorded
+   * timing) and when it was actually sent.  This is non-zero if all clients
+   * were busy.
+   */
+  charon::Histogram scheduleLag;
+
+  /**
+   * Sends requests from the log with the given client until all are done.
+   */
+  void
+  RunWorker (charon::Client& client, const Clock::time_point start)
+  {
+    const auto firstTimestamp = records.front ().timestamp;
+
+    while (true)
+      {
+        const size_t ind = next++;
+        if (ind >= records.size ())
+          return;
+        const auto& r = records[ind];
+
+        if (FLAGS_speed > 0.0)
+          {
+            const double offsetMs
+                = (r.timestamp - firstTimestamp) / FLAGS_speed;
+            const auto target = start
+                + std::chrono::duration_cast<Clock::duration> (
+                    std::chrono::duration<double, std::milli> (offsetMs));
+            std::this_thread::sleep_until (target);
+            scheduleLag.Record (GetMs (target, Clock::now ()));
+          }
+
+        bool error = false;
+        const auto before = Clock::now ();
+        try
+          {
+            client.ForwardMethod (r.method, r.params);
+          }
+        catch (const charon::RpcServer::Error& exc)
+          {
+            VLOG (1) << "Error for " << r.method << ": " << exc.what ();
+            error = true;
+          }
+        const double ms = GetMs (before, Clock::now ());
+
+        latency.Record (ms);
+        methodLatency.at (r.method)->Record (ms);
+        if (error)
+          ++errors;
+        if (error != r.error)
+          ++mismatches;
+      }
+  }
+
+public:
+
+  explicit Replay (const std::vector<charon::TrafficRecord>& r)
+    : records(r), next(0), errors(0), mismatches(0)
+  {
+    /* Create all per-method histograms up front, so that the map is not
+       modified while the workers run.  */
+    for (const auto& rec : records)
+      if (methodLatency.count (rec.method) == 0)
+        methodLatency.emplace (rec.method,
+                               std::make_unique<charon::Histogram> ());
+
+    for (int i = 0; i < FLAGS_clients; ++i)
+      {
+        const std::string jid
+            = FLAGS_client_jid + "/replay-" + std::to_string (i);
+        auto c = std::make_unique<charon::Client> (
+            FLAGS_server_jid, FLAGS_backend_version, jid, FLAGS_password);
+        c->SetTimeout (std::chrono::milliseconds (FLAGS_timeout_ms));
+        if (!FLAGS_cafile.empty ())
+          c->SetRootCA (FLAGS_cafile);
+
+        c->Connect ();
+        if (c->GetServerResource ().empty ())
+          throw std::runtime_error ("failed to find a server for " + jid);
+
+        clients.push_back (std::move (c));
+      }
+  }
+
+  /**
+   * Replays all records and returns the results as JSON.
+   */
+  Json::Value
+  Run ()
+  {
+    LOG (INFO)
+        << "Replaying " << records.size () << " requests with "
+        << clients.size () << " clients";
+
+    const auto start = Clock::now ();
+    std::vector<std::thread> workers;
+    for (auto& c : clients)
+      workers.emplace_back ([this, &c, start] ()
+        {
+          RunWorker (*c, start);
+        });
+    for (auto& w : workers)
+      w.join ();
+    const double totalMs = GetMs (start, Clock::now ());
+
+    Json::Value res(Json::objectValue);
+    res["requests"] = static_cast<Json::UInt64> (records.size ());
+    res["errors"] = errors.load ();
+    res["mismatches"] = mismatches.load ();
+    res["durationms"] = totalMs;
+    res["latency"] = Summarise (latency);
+    if (FLAGS_speed > 0.0)
+      res["schedulelag"] = Summarise (scheduleLag);
+
+    Json::Value methods(Json::objectValue);
+    for (const auto& entry : methodLatency)
+      methods[entry.first] = Summarise (*entry.second);
+    res["methods"] = methods;
+
+    return res;
+  }
+
+};
+
+} // anonymous namespace
+
+int
+main (int argc, char** argv)
+{
+  google::InitGoogleLogging (argv[0]);
+
+  gflags::SetUsageMessage ("Replay recorded traffic against a Charon server");
+  gflags::SetVersionString (PACKAGE_VERSION);
+  gflags::ParseCommandLineFlags (&argc, &argv, true);
+
+  try
+    {
+      if (FLAGS_server_jid.empty ())
+        throw std::runtime_error ("--server_jid must be set");
+      if (FLAGS_client_jid.empty ())
+        throw std::runtime_error ("--client_jid must be set");
+      if (FLAGS_traffic_log.empty ())
+        throw std::runtime_error ("--traffic_log must be set");
+      if (FLAGS_clients <= 0)
+        throw std::runtime_error ("--clients must be positive");
+      if (FLAGS_speed < 0.0)
+        throw std::runtime_error ("--speed must not be negative");
+
+      std::vector<charon::TrafficRecord> records;
+      charon::TrafficLogReader reader(FLAGS_traffic_log);
+      charon::TrafficRecord r;
+      while (reader.Next (r))
+        {
+          records.push_back (r);
+          if (FLAGS_max_requests > 0
+                && records.size () >= static_cast<size_t> (FLAGS_max_requests))
+            break;
+        }
+
+      if (records.empty ())
+        throw std::runtime_error ("the traffic log is empty");
+
+      Replay replay(records);
+      std::cout << replay.Run () << std::endl;
+
+      return EXIT_SUCCESS;
+    }
+  catch (const std::exception& exc)
+    {
+      std::cerr << "Error: " << exc.what () << std::endl;
+      return EXIT_FAILURE;
+    }
+}
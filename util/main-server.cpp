@@ -19,11 +19,15 @@
 #include "config.h"
 
 #include "methods.hpp"
+#include "notificationconfig.hpp"
+#include "profiling.hpp"
 
 #include "notifications.hpp"
+#include "redundantwaiter.hpp"
 #include "rpcserver.hpp"
 #include "rpcwaiter.hpp"
 #include "server.hpp"
+#include "trafficlog.hpp"
 #include "waiterthread.hpp"
 
 #include <gflags/gflags.h>
@@ -33,13 +37,19 @@
 #include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <thread>
+#include <vector>
 
 namespace
 {
 
 DEFINE_string (backend_rpc_url, "",
                "URL at which the backend JSON-RPC interface is available");
+DEFINE_string (backend_waiter_urls, "",
+               "Comma-separated list of additional replica backends, which"
+               " are long-polled in parallel for block notifications"
+               " (they must support getnullstate)");
 DEFINE_string (backend_version, "",
                "A string identifying the version of the backend provided");
 
@@ -49,29 +59,147 @@ DEFINE_int32 (priority, 0, "Priority for the XMPP connection");
 
 DEFINE_string (cafile, "",
                "if set, use this file as CA trust root of the system default");
+DEFINE_bool (stream_compression, true,
+             "If true, use XMPP stream compression if the server offers it");
 DEFINE_string (pubsub_service, "", "The pubsub service to use on the server");
+DEFINE_string (alternative_pubsub_services, "",
+               "Comma-separated list of further pubsub services (e.g. on other"
+               " XMPP clusters) to which notifications are published as well");
+DEFINE_int32 (direct_push_max_clients, 0,
+              "If positive, allow up to that many clients to receive"
+              " notifications by direct push instead of through pubsub");
 
 DEFINE_bool (waitforchange, false, "If true, enable waitforchange updates");
 DEFINE_bool (waitforpendingchange, false,
              "If true, enable waitforpendingchange updates");
 
+DEFINE_int32 (health_max_failures, 0,
+              "If positive, enable health gating and withdraw from client"
+              " selection after that many failed backend calls in a row");
+DEFINE_int32 (health_check_ms, 1000,
+              "Interval in milliseconds between backend health checks");
+DEFINE_int32 (health_failure_expiry_ms, 10000,
+              "Time in milliseconds after the last failed backend call after"
+              " which failed calls no longer count for health gating");
+DEFINE_int32 (max_state_age, 0,
+              "If positive and health gating is enabled, consider the backend"
+              " unhealthy if the game state did not change for that many"
+              " seconds");
+
+DEFINE_int32 (backend_timeout_ms, 0,
+              "If positive, timeout in milliseconds for backend calls");
+DEFINE_int32 (breaker_failures, 0,
+              "If positive, stop calling the backend for a while after that"
+              " many calls in a row failed to reach it");
+DEFINE_int32 (breaker_cooldown_ms, 5000,
+              "Time in milliseconds before the backend is tried again after"
+              " the circuit breaker opened");
+DEFINE_bool (serve_stale, false,
+             "If true, answer calls with the last good result (marked as"
+             " stale) while the backend is unavailable");
+
+DEFINE_int32 (prewarm_top, 0,
+              "If positive, evaluate that many of the most popular calls"
+              " right after each new block (see --methods_prewarm);"
+              " requires --waitforchange");
+DEFINE_int32 (prewarm_concurrency, 4,
+              "Number of parallel backend calls used for pre-warming");
+DEFINE_int32 (prewarm_budget_ms, 500,
+              "Time budget in milliseconds for pre-warming after each block");
+
+DEFINE_int32 (page_size, 0,
+              "If positive, return array results with more items in pages"
+              " that clients fetch one after the other");
+DEFINE_int32 (page_ttl_ms, 30000,
+              "Time in milliseconds for which the remaining pages of a result"
+              " are kept after the last access");
+
+DEFINE_string (traffic_log, "",
+               "If set, record metadata of incoming requests to this file"
+               " (for replaying with charon-replay)");
+DEFINE_double (traffic_sample_rate, 1.0,
+               "Fraction of requests to record with --traffic_log");
+
+DEFINE_string (profile_dir, "",
+               "If set, enable profiling on demand (SIGUSR1 for a CPU profile,"
+               " SIGUSR2 for a memory dump) with output files in this"
+               " directory");
+DEFINE_int32 (profile_duration_ms, 30000,
+              "Duration in milliseconds of CPU profiles");
+
 /**
  * Time between connection retries if the server gets disconnected.  This is
  * also the general sleep time in the main loop.
  */
 const auto RECONNECT_INTERVAL = std::chrono::seconds (5);
 
+/**
+ * Returns the URLs of all backends used for long-polling block states, i.e.
+ * the main backend and all replicas from --backend_waiter_urls.
+ */
+std::vector<std::string>
+GetWaiterUrls ()
+{
+  std::vector<std::string> res = {FLAGS_backend_rpc_url};
+
+  std::istringstream in(FLAGS_backend_waiter_urls);
+  std::string cur;
+  while (std::getline (in, cur, ','))
+    if (!cur.empty ())
+      res.push_back (cur);
+
+  return res;
+}
+
 /**
  * Constructs a WaiterThread instance for the given notification type, using
- * the given RPC method as long-polling backend call.
+ * the given RPC method as long-polling call on the main backend.
  */
-template <typename Notification>
-  std::unique_ptr<charon::WaiterThread>
-  NewWaiter (const std::string& method)
+std::unique_ptr<charon::WaiterThread>
+NewWaiter (std::unique_ptr<charon::NotificationType> n,
+           const std::string& method)
 {
-  auto n = std::make_unique<Notification> ();
   auto w = std::make_unique<charon::RpcUpdateWaiter> (
       FLAGS_backend_rpc_url, method, n->AlwaysBlockId ());
+  return std::make_unique<charon::WaiterThread> (std::move (n), std::move (w));
+}
+
+/**
+ * Constructs the WaiterThread instance for block states (waitforchange).
+ * If replica backends are configured, all of them are polled in parallel.
+ * This is only done for block states, since other states (like pending
+ * versions) are local to each backend.
+ */
+std::unique_ptr<charon::WaiterThread>
+NewStateWaiter ()
+{
+  const std::string method = "waitforchange";
+  auto n = std::make_unique<charon::StateChangeNotification> ();
+
+  const auto urls = GetWaiterUrls ();
+  if (urls.size () == 1)
+    return NewWaiter (std::move (n), method);
+
+  std::vector<std::unique_ptr<charon::UpdateWaiter>> sources;
+  auto heights
+      = std::make_shared<std::vector<std::unique_ptr<charon::RpcBlockHeights>>> ();
+  for (const auto& url : urls)
+    {
+      LOG (INFO) << "Long-polling " << method << " on backend " << url;
+      sources.push_back (std::make_unique<charon::RpcUpdateWaiter> (
+          url, method, n->AlwaysBlockId ()));
+      heights->push_back (std::make_unique<charon::RpcBlockHeights> (url));
+    }
+
+  auto w = std::make_unique<charon::RedundantUpdateWaiter> (
+      std::make_unique<charon::StateChangeNotification> (),
+      std::move (sources));
+  w->SetHeightFunction ([heights] (const size_t source,
+                                   const Json::Value& state,
+                                   uint64_t& height)
+    {
+      return (*heights)[source]->GetHeight (state, height);
+    });
 
   return std::make_unique<charon::WaiterThread> (std::move (n), std::move (w));
 }
@@ -98,6 +226,16 @@ main (int argc, char** argv)
       return EXIT_FAILURE;
     }
 
+  /* This has to be done before any threads are started.  */
+  std::unique_ptr<charon::ProfilingControl> profiling;
+  if (!FLAGS_profile_dir.empty ())
+    {
+      charon::BlockProfilingSignals ();
+      profiling = std::make_unique<charon::ProfilingControl> (
+          FLAGS_profile_dir,
+          std::chrono::milliseconds (FLAGS_profile_duration_ms));
+    }
+
   charon::ForwardingRpcServer backend(FLAGS_backend_rpc_url);
   LOG (INFO)
       << "Forwarding calls to JSON-RPC server at " << FLAGS_backend_rpc_url;
@@ -109,15 +247,51 @@ main (int argc, char** argv)
   for (const auto& m : methods)
     {
       LOG (INFO) << "Allowing method: " << m;
-      backend.AllowMethod (m);
+      if (FLAGS_serve_stale)
+        backend.AllowStaleResults (m);
+      else
+        backend.AllowMethod (m);
+    }
+
+  if (FLAGS_prewarm_top > 0)
+    {
+      /* Pre-warmed results are only invalidated by new blocks, so without
+         the state notification they would be served forever.  */
+      CHECK (FLAGS_waitforchange) << "--prewarm_top requires --waitforchange";
+      for (const auto& m : charon::GetPrewarmMethods ())
+        {
+          CHECK (methods.count (m) > 0)
+              << "Pre-warmed method " << m << " is not selected";
+          LOG (INFO) << "Allowing pre-warming for: " << m;
+          backend.AllowPrewarming (m);
+        }
+      backend.EnablePrewarming (
+          FLAGS_prewarm_top, FLAGS_prewarm_concurrency,
+          std::chrono::milliseconds (FLAGS_prewarm_budget_ms));
+    }
+
+  if (FLAGS_backend_timeout_ms > 0)
+    backend.SetBackendTimeout (
+        std::chrono::milliseconds (FLAGS_backend_timeout_ms));
+  if (FLAGS_breaker_failures > 0)
+    {
+      LOG (INFO)
+          << "Enabling circuit breaker after " << FLAGS_breaker_failures
+          << " failed backend calls";
+      backend.EnableCircuitBreaker (
+          FLAGS_breaker_failures,
+          std::chrono::milliseconds (FLAGS_breaker_cooldown_ms));
     }
 
   charon::Server srv(FLAGS_backend_version, backend,
                      FLAGS_server_jid, FLAGS_password);
 
+  const auto configured = charon::GetConfiguredNotifications ();
+
   if (FLAGS_pubsub_service.empty ())
     {
-      if (FLAGS_waitforchange || FLAGS_waitforpendingchange)
+      if (FLAGS_waitforchange || FLAGS_waitforpendingchange
+            || !configured.empty ())
         {
           std::cerr
               << "Error: Notifications are enabled"
@@ -127,17 +301,70 @@ main (int argc, char** argv)
         }
     }
   else
-    srv.AddPubSub (FLAGS_pubsub_service);
+    {
+      srv.AddPubSub (FLAGS_pubsub_service);
+
+      std::istringstream in(FLAGS_alternative_pubsub_services);
+      std::string cur;
+      while (std::getline (in, cur, ','))
+        if (!cur.empty ())
+          srv.AddPubSub (cur);
+    }
 
   if (FLAGS_waitforchange)
-    srv.AddNotification (NewWaiter<charon::StateChangeNotification> (
-        "waitforchange"));
+    srv.AddNotification (NewStateWaiter ());
   if (FLAGS_waitforpendingchange)
-    srv.AddNotification (NewWaiter<charon::PendingChangeNotification> (
+    srv.AddNotification (NewWaiter (
+        std::make_unique<charon::PendingChangeNotification> (),
         "waitforpendingchange"));
+  for (const auto& cfg : configured)
+    {
+      LOG (INFO)
+          << "Enabling notification " << cfg.type
+          << " with backend method " << cfg.method;
+      srv.AddNotification (NewWaiter (cfg.CreateNotification (), cfg.method));
+    }
+
+  if (FLAGS_direct_push_max_clients > 0 && !FLAGS_pubsub_service.empty ())
+    {
+      LOG (INFO)
+          << "Enabling direct push of notifications for up to "
+          << FLAGS_direct_push_max_clients << " clients";
+      srv.EnableDirectPush (FLAGS_direct_push_max_clients);
+    }
+
+  if (FLAGS_health_max_failures > 0)
+    {
+      LOG (INFO)
+          << "Enabling health gating after " << FLAGS_health_max_failures
+          << " failed calls";
+      srv.EnableHealthGating (FLAGS_health_max_failures,
+                              std::chrono::milliseconds (
+                                  FLAGS_health_check_ms),
+                              std::chrono::milliseconds (
+                                  FLAGS_health_failure_expiry_ms));
+
+      if (FLAGS_waitforchange && FLAGS_max_state_age > 0)
+        srv.SetMaxStaleness ("state",
+                             std::chrono::seconds (FLAGS_max_state_age));
+    }
 
   if (!FLAGS_cafile.empty ())
     srv.SetRootCA (FLAGS_cafile);
+  if (FLAGS_page_size > 0)
+    {
+      LOG (INFO)
+          << "Returning array results in pages of " << FLAGS_page_size
+          << " items";
+      srv.EnablePagination (FLAGS_page_size,
+                            std::chrono::milliseconds (FLAGS_page_ttl_ms));
+    }
+
+  srv.SetStreamCompression (FLAGS_stream_compression);
+
+  if (!FLAGS_traffic_log.empty ())
+    srv.RecordTraffic (std::make_unique<charon::TrafficRecorder> (
+        FLAGS_traffic_log, FLAGS_traffic_sample_rate));
 
   LOG (INFO) << "Connecting server to XMPP as " << FLAGS_server_jid;
 
@@ -40,6 +40,12 @@ DEFINE_string (methods_exclude, "",
                "Comma-separated list of methods to exclude");
 DEFINE_string (methods_json_spec, "",
                "If specified, load methods from the given JSON file");
+DEFINE_string (methods_idempotent, "",
+               "Comma-separated list of methods that are idempotent and"
+               " may be retried by the client");
+DEFINE_string (methods_prewarm, "",
+               "Comma-separated list of methods whose results only depend"
+               " on the current game state, and that may be pre-warmed");
 
 /**
  * Parses a comma-separated string into pieces.
@@ -115,4 +121,16 @@ GetSelectedMethods ()
   return diff;
 }
 
+std::set<std::string>
+GetIdempotentMethods ()
+{
+  return ParseCommaSeparated (FLAGS_methods_idempotent);
+}
+
+std::set<std::string>
+GetPrewarmMethods ()
+{
+  return ParseCommaSeparated (FLAGS_methods_prewarm);
+}
+
 } // namespace charon
@@ -37,6 +37,19 @@ std::set<std::string> GetMethodsFromJsonSpec (const std::string& file);
  */
 std::set<std::string> GetSelectedMethods ();
 
+/**
+ * Returns the set of methods that are marked (through command-line arguments)
+ * as idempotent, so that the client may retry them.
+ */
+std::set<std::string> GetIdempotentMethods ();
+
+/**
+ * Returns the set of methods that are marked (through command-line arguments)
+ * as depending only on the current game state, so that their results can
+ * be pre-warmed after each new block.
+ */
+std::set<std::string> GetPrewarmMethods ();
+
 } // namespace charon
 
 #endif // CHARON_UTILS_METHODS_HPP
@@ -0,0 +1,103 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "notificationconfig.hpp"
+
+#include "notificationfilter.hpp"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <fstream>
+#include <set>
+
+namespace charon
+{
+
+namespace
+{
+
+DEFINE_string (notifications_config, "",
+               "If specified, load additional notifications for"
+               " long-polling methods from the given JSON file");
+
+} // anonymous namespace
+
+std::unique_ptr<NotificationType>
+NotificationConfig::CreateNotification () const
+{
+  return std::make_unique<ConfigurableNotification> (type, idPointer,
+                                                     alwaysBlock);
+}
+
+std::vector<NotificationConfig>
+LoadNotificationConfig (const std::string& file)
+{
+  if (file.empty ())
+    return {};
+
+  std::ifstream in(file);
+  CHECK (in) << "Failed to open notifications config file " << file;
+  LOG (INFO) << "Loading notifications config file " << file;
+
+  Json::Value config;
+  in >> config;
+  CHECK (config.isArray ())
+      << "Notifications config must be an array:\n" << config;
+
+  std::vector<NotificationConfig> res;
+  std::set<std::string> types;
+  for (const auto& entry : config)
+    {
+      CHECK (entry.isObject ()) << "Invalid notification config:\n" << entry;
+
+      NotificationConfig cur;
+
+      CHECK (entry["type"].isString () && entry["method"].isString ()
+                && entry["id"].isString ())
+          << "Notification config needs type, method and id:\n" << entry;
+      cur.type = entry["type"].asString ();
+      cur.method = entry["method"].asString ();
+      cur.idPointer = entry["id"].asString ();
+      cur.alwaysBlock = entry["alwaysblock"];
+
+      CHECK (!cur.type.empty ()) << "Empty notification type:\n" << entry;
+      CHECK (types.insert (cur.type).second)
+          << "Duplicate notification type " << cur.type;
+      CHECK (cur.type != StateChangeNotification ().GetType ()
+               && cur.type != PendingChangeNotification ().GetType ())
+          << "Notification type " << cur.type << " is reserved";
+
+      std::vector<std::string> tokens;
+      CHECK (NotificationFilter::ParsePointer (cur.idPointer, tokens))
+          << "Invalid JSON pointer for notification " << cur.type
+          << ": " << cur.idPointer;
+
+      res.push_back (std::move (cur));
+    }
+
+  return res;
+}
+
+std::vector<NotificationConfig>
+GetConfiguredNotifications ()
+{
+  return LoadNotificationConfig (FLAGS_notifications_config);
+}
+
+} // namespace charon
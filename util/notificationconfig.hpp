@@ -0,0 +1,84 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_UTILS_NOTIFICATIONCONFIG_HPP
+#define CHARON_UTILS_NOTIFICATIONCONFIG_HPP
+
+#include "notifications.hpp"
+
+#include <json/json.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace charon
+{
+
+/**
+ * Configuration of a notification for an arbitrary long-polling method
+ * of the GSP, as loaded from a config file.
+ */
+struct NotificationConfig
+{
+
+  /** The notification type.  */
+  std::string type;
+
+  /**
+   * The long-polling RPC method.  The server calls this on the backend,
+   * and the client exposes it on its local RPC interface.
+   */
+  std::string method;
+
+  /** JSON pointer to the state ID within the state.  */
+  std::string idPointer;
+
+  /** The "always block" value of the state ID.  */
+  Json::Value alwaysBlock;
+
+  /**
+   * Constructs the NotificationType instance for this config.
+   */
+  std::unique_ptr<NotificationType> CreateNotification () const;
+
+};
+
+/**
+ * Loads notification configs from the given JSON file.  It must contain
+ * an array of objects like this:
+ *
+ *  {
+ *    "type": "stats",
+ *    "method": "waitforstatschange",
+ *    "id": "/version",
+ *    "alwaysblock": 0
+ *  }
+ */
+std::vector<NotificationConfig> LoadNotificationConfig (
+    const std::string& file);
+
+/**
+ * Returns the notifications configured by the corresponding command-line
+ * argument.
+ */
+std::vector<NotificationConfig> GetConfiguredNotifications ();
+
+} // namespace charon
+
+#endif // CHARON_UTILS_NOTIFICATIONCONFIG_HPP
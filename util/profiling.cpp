@@ -0,0 +1,251 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include "profiling.hpp"
+
+#include "memorytags.hpp"
+
+#ifdef HAVE_GPERFTOOLS
+# include <gperftools/profiler.h>
+#endif // HAVE_GPERFTOOLS
+#ifdef HAVE_TCMALLOC
+# include <gperftools/malloc_extension.h>
+#endif // HAVE_TCMALLOC
+
+#include <glog/logging.h>
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+namespace charon
+{
+
+namespace
+{
+
+/**
+ * Returns the set of signals we use.
+ */
+sigset_t
+GetSignals ()
+{
+  sigset_t res;
+  sigemptyset (&res);
+  sigaddset (&res, SIGUSR1);
+  sigaddset (&res, SIGUSR2);
+  return res;
+}
+
+} // anonymous namespace
+
+void
+BlockProfilingSignals ()
+{
+  const auto signals = GetSignals ();
+  CHECK_EQ (pthread_sigmask (SIG_BLOCK, &signals, nullptr), 0);
+}
+
+ProfilingControl::ProfilingControl (const std::string& d,
+                                    const std::chrono::milliseconds dur)
+  : dir(d), duration(dur)
+{
+  LOG (INFO)
+      << "Profiling on demand is enabled, writing files to " << dir
+      << " (SIGUSR1 for a CPU profile of " << duration.count () << " ms,"
+      << " SIGUSR2 for a memory dump)";
+#ifndef HAVE_GPERFTOOLS
+  LOG (WARNING) << "Built without gperftools, CPU profiling is disabled";
+#endif // !HAVE_GPERFTOOLS
+#ifndef HAVE_TCMALLOC
+  LOG (WARNING)
+      << "Built without heap profiling, only memory tags can be dumped";
+#endif // !HAVE_TCMALLOC
+
+  signalThread = std::make_unique<std::thread> ([this] ()
+    {
+      RunSignalLoop ();
+    });
+}
+
+ProfilingControl::~ProfilingControl ()
+{
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    shouldStop = true;
+  }
+
+  /* Wake up the signal thread, which then notices that it should stop.  */
+  pthread_kill (signalThread->native_handle (), SIGUSR2);
+  signalThread->join ();
+
+  StopCpuProfile ();
+}
+
+std::string
+ProfilingControl::GetFileName (const std::string& prefix,
+                               const std::string& ext) const
+{
+  const auto now = std::chrono::system_clock::now ().time_since_epoch ();
+  const auto ms
+      = std::chrono::duration_cast<std::chrono::milliseconds> (now).count ();
+
+  std::ostringstream res;
+  res << dir << "/" << prefix << "-" << getpid () << "-" << ms << "." << ext;
+  return res.str ();
+}
+
+void
+ProfilingControl::RunSignalLoop ()
+{
+  const auto signals = GetSignals ();
+  while (true)
+    {
+      int sig;
+      CHECK_EQ (sigwait (&signals, &sig), 0);
+
+      {
+        std::lock_guard<std::mutex> lock(mut);
+        if (shouldStop)
+          return;
+      }
+
+      switch (sig)
+        {
+        case SIGUSR1:
+          ToggleCpuProfile ();
+          break;
+        case SIGUSR2:
+          DumpMemory ();
+          break;
+        default:
+          LOG (WARNING) << "Unexpected signal: " << sig;
+          break;
+        }
+    }
+}
+
+void
+ProfilingControl::ToggleCpuProfile ()
+{
+#ifdef HAVE_GPERFTOOLS
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    if (cpuRunning)
+      {
+        LOG (INFO) << "Stopping CPU profile early";
+        cpuRunning = false;
+        ProfilerStop ();
+        cvStop.notify_all ();
+        return;
+      }
+  }
+
+  /* The timer thread of an earlier profile is done already (or about to
+     be done), since it is not running any more.  */
+  if (cpuTimer != nullptr)
+    {
+      cpuTimer->join ();
+      cpuTimer.reset ();
+    }
+
+  const auto file = GetFileName ("cpu", "prof");
+  if (!ProfilerStart (file.c_str ()))
+    {
+      LOG (ERROR) << "Failed to start CPU profile to " << file;
+      return;
+    }
+  LOG (INFO) << "Started CPU profile to " << file;
+
+  std::lock_guard<std::mutex> lock(mut);
+  cpuRunning = true;
+  cpuTimer = std::make_unique<std::thread> ([this] ()
+    {
+      std::unique_lock<std::mutex> lock(mut);
+      cvStop.wait_for (lock, duration, [this] ()
+        {
+          return !cpuRunning;
+        });
+
+      if (cpuRunning)
+        {
+          ProfilerStop ();
+          cpuRunning = false;
+          LOG (INFO) << "CPU profile finished";
+        }
+    });
+#else // HAVE_GPERFTOOLS
+  LOG (WARNING) << "CPU profiling is not available without gperftools";
+#endif // HAVE_GPERFTOOLS
+}
+
+void
+ProfilingControl::StopCpuProfile ()
+{
+#ifdef HAVE_GPERFTOOLS
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    if (cpuRunning)
+      {
+        ProfilerStop ();
+        cpuRunning = false;
+      }
+  }
+  cvStop.notify_all ();
+#endif // HAVE_GPERFTOOLS
+
+  if (cpuTimer != nullptr)
+    {
+      cpuTimer->join ();
+      cpuTimer.reset ();
+    }
+}
+
+void
+ProfilingControl::DumpMemory ()
+{
+  const auto tags = MemoryTag::GetSnapshot ();
+  const auto tagsFile = GetFileName ("memory", "json");
+  std::ofstream out(tagsFile);
+  out << tags << std::endl;
+  LOG (INFO) << "Memory tags written to " << tagsFile << ":\n" << tags;
+
+#ifdef HAVE_TCMALLOC
+  std::string sample;
+  MallocExtension::instance ()->GetHeapSample (&sample);
+  if (sample.empty ())
+    {
+      LOG (WARNING)
+          << "No heap sample available, make sure to run with"
+          << " TCMALLOC_SAMPLE_PARAMETER set";
+      return;
+    }
+
+  const auto heapFile = GetFileName ("heap", "prof");
+  std::ofstream heapOut(heapFile, std::ios::binary);
+  heapOut << sample;
+  LOG (INFO) << "Heap sample written to " << heapFile;
+#endif // HAVE_TCMALLOC
+}
+
+} // namespace charon
@@ -0,0 +1,128 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_UTILS_PROFILING_HPP
+#define CHARON_UTILS_PROFILING_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace charon
+{
+
+/**
+ * Admin control for profiling a running process on demand, triggered by
+ * signals:
+ *
+ *  - SIGUSR1 starts a CPU profile, which is stopped automatically after
+ *    the configured duration (or when SIGUSR1 is received again).
+ *  - SIGUSR2 writes a heap sample (with tcmalloc, if sampling is enabled
+ *    through TCMALLOC_SAMPLE_PARAMETER) and a JSON dump of the memory tags.
+ *
+ * All files are written to the configured directory, with the process ID
+ * and a timestamp in their names.  CPU profiles require building with
+ * --with-gperftools, and heap samples additionally --enable-heap-profiling
+ * (which links tcmalloc); without them, only the memory tags are available.
+ *
+ * The signals are handled synchronously by a dedicated thread.  For this,
+ * BlockProfilingSignals must be called before any other threads are
+ * started, so that all threads inherit the signal mask.
+ */
+class ProfilingControl
+{
+
+private:
+
+  /** Directory for the output files.  */
+  const std::string dir;
+
+  /** Duration of CPU profiles.  */
+  const std::chrono::milliseconds duration;
+
+  /** The thread waiting for signals.  */
+  std::unique_ptr<std::thread> signalThread;
+
+  /** The thread stopping the current CPU profile after the duration.  */
+  std::unique_ptr<std::thread> cpuTimer;
+
+  /** Whether a CPU profile is running.  */
+  bool cpuRunning = false;
+
+  /** Set to true when the instance is being destructed.  */
+  bool shouldStop = false;
+
+  /** Mutex for the internal state.  */
+  std::mutex mut;
+
+  /** Condition variable signalled to stop the CPU profile early.  */
+  std::condition_variable cvStop;
+
+  /**
+   * Returns the full name of a new output file with the given prefix
+   * and extension.
+   */
+  std::string GetFileName (const std::string& prefix,
+                           const std::string& ext) const;
+
+  /**
+   * Runs the loop that waits for the signals.
+   */
+  void RunSignalLoop ();
+
+  /**
+   * Stops the running CPU profile (if any) and joins the timer thread.
+   * Must be called without holding mut.
+   */
+  void StopCpuProfile ();
+
+public:
+
+  explicit ProfilingControl (const std::string& d,
+                             std::chrono::milliseconds dur);
+  ~ProfilingControl ();
+
+  ProfilingControl () = delete;
+  ProfilingControl (const ProfilingControl&) = delete;
+  void operator= (const ProfilingControl&) = delete;
+
+  /**
+   * Starts a CPU profile for the configured duration.  If one is already
+   * running, it is stopped instead.
+   */
+  void ToggleCpuProfile ();
+
+  /**
+   * Writes a heap sample (if available) and the memory tag counters.
+   */
+  void DumpMemory ();
+
+};
+
+/**
+ * Blocks the signals used by ProfilingControl in the calling thread, and
+ * thus all threads started from it afterwards.
+ */
+void BlockProfilingSignals ();
+
+} // namespace charon
+
+#endif // CHARON_UTILS_PROFILING_HPP
@@ -0,0 +1,959 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "rpctransport.hpp"
+
+#include <glog/logging.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace charon
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+/** Epoll data value for the listening socket.  */
+constexpr uint64_t LISTEN_ID = 0;
+
+/** Epoll data value for the wake-up eventfd.  */
+constexpr uint64_t WAKE_ID = 1;
+
+/** Maximum size of the HTTP request line and headers.  */
+constexpr size_t MAX_HEAD_SIZE = 16 * 1'024;
+
+/** Maximum size of a request body (or line on the Unix socket).  */
+constexpr size_t MAX_REQUEST_SIZE = 16 * 1'024 * 1'024;
+
+/**
+ * Connections without a request in flight are closed after being idle
+ * for this long.
+ */
+constexpr auto IDLE_TIMEOUT = std::chrono::seconds (60);
+
+/** Timeout for epoll_wait, after which we check for idle connections.  */
+constexpr int LOOP_TIMEOUT_MS = 1'000;
+
+/**
+ * When we run out of file descriptors, we stop accepting new connections
+ * for this long (instead of spinning on the readable listening socket).
+ */
+constexpr auto ACCEPT_PAUSE = std::chrono::milliseconds (100);
+
+/** Headers allowing browser-based frontends to call us (CORS).  */
+const char* const CORS_HEADERS =
+    "Access-Control-Allow-Origin: *\r\n";
+const char* const CORS_PREFLIGHT_HEADERS =
+    "Access-Control-Allow-Origin: *\r\n"
+    "Access-Control-Allow-Methods: POST, OPTIONS\r\n"
+    "Access-Control-Allow-Headers: origin, content-type, accept\r\n";
+
+/**
+ * Returns the string converted to lower case.
+ */
+std::string
+ToLower (std::string str)
+{
+  std::transform (str.begin (), str.end (), str.begin (),
+                  [] (const unsigned char c) { return std::tolower (c); });
+  return str;
+}
+
+/**
+ * Parsed request line and headers of an HTTP request.  Header names
+ * are converted to lower case.
+ */
+struct HttpHead
+{
+  std::string method;
+  std::string version;
+  std::map<std::string, std::string> headers;
+};
+
+/**
+ * Parses the head of an HTTP request (without the terminating empty line).
+ * Returns false if it is invalid.
+ */
+bool
+ParseHttpHead (const std::string& data, HttpHead& head)
+{
+  std::istringstream in(data);
+
+  std::string line;
+  if (!std::getline (in, line))
+    return false;
+  if (!line.empty () && line.back () == '\r')
+    line.pop_back ();
+
+  std::istringstream requestLine(line);
+  std::string path;
+  if (!(requestLine >> head.method >> path >> head.version))
+    return false;
+  if (head.version.compare (0, 5, "HTTP/") != 0)
+    return false;
+
+  while (std::getline (in, line))
+    {
+      if (!line.empty () && line.back () == '\r')
+        line.pop_back ();
+
+      const auto colon = line.find (':');
+      if (colon == std::string::npos)
+        return false;
+
+      const auto start = line.find_first_not_of (" \t", colon + 1);
+      const auto end = line.find_last_not_of (" \t");
+      std::string value;
+      if (start != std::string::npos)
+        value = line.substr (start, end + 1 - start);
+
+      head.headers[ToLower (line.substr (0, colon))] = value;
+    }
+
+  return true;
+}
+
+/**
+ * Formats a full HTTP response.
+ */
+std::string
+FormatHttp (const std::string& status, const std::string& extraHeaders,
+            const std::string& body, const bool keepAlive)
+{
+  std::ostringstream out;
+  out << "HTTP/1.1 " << status << "\r\n"
+      << extraHeaders
+      << "Content-Length: " << body.size () << "\r\n"
+      << "Connection: " << (keepAlive ? "keep-alive" : "close") << "\r\n"
+      << "\r\n"
+      << body;
+  return out.str ();
+}
+
+} // anonymous namespace
+
+/* ************************************************************************** */
+
+/**
+ * Queue of completed replies that the event loop has to send.  Pushing
+ * to it wakes up the loop through an eventfd.
+ */
+class RpcTransport::Completions
+{
+
+public:
+
+  /** A completed reply.  */
+  struct Item
+  {
+    uint64_t conn;
+    bool ok;
+    std::string body;
+  };
+
+private:
+
+  /** Mutex for the queue.  */
+  std::mutex mut;
+
+  /** The queued items.  */
+  std::vector<Item> items;
+
+  /** Set when the transport has stopped and items should be dropped.  */
+  bool closed = false;
+
+public:
+
+  /** The eventfd used to wake up the loop.  */
+  const int fd;
+
+  Completions ()
+    : fd(eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC))
+  {
+    if (fd < 0)
+      throw std::runtime_error ("failed to create eventfd: "
+                                + std::string (std::strerror (errno)));
+  }
+
+  ~Completions ()
+  {
+    close (fd);
+  }
+
+  Completions (const Completions&) = delete;
+  void operator= (const Completions&) = delete;
+
+  /**
+   * Wakes up the event loop.
+   */
+  void
+  Wake ()
+  {
+    const uint64_t one = 1;
+    if (write (fd, &one, sizeof (one)) < 0 && errno != EAGAIN)
+      LOG (ERROR) << "Failed to wake up RPC event loop";
+  }
+
+  void
+  Push (Item&& item)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mut);
+      if (closed)
+        return;
+      items.push_back (std::move (item));
+    }
+    Wake ();
+  }
+
+  /**
+   * Returns and clears all queued items.
+   */
+  std::vector<Item>
+  Take ()
+  {
+    uint64_t cnt;
+    while (read (fd, &cnt, sizeof (cnt)) < 0 && errno == EINTR)
+      continue;
+
+    std::vector<Item> res;
+    std::lock_guard<std::mutex> lock(mut);
+    res.swap (items);
+    return res;
+  }
+
+  void
+  Close ()
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    closed = true;
+    items.clear ();
+  }
+
+};
+
+/**
+ * State of one client connection.
+ */
+struct RpcTransport::Connection
+{
+
+  /** The socket.  */
+  int fd;
+
+  /** Data received but not yet processed.  */
+  std::string input;
+
+  /** Data waiting to be written.  */
+  std::string output;
+
+  /** Whether a request is being processed (i.e. we await its reply).  */
+  bool busy = false;
+
+  /** Whether the connection should be kept open after the current request.  */
+  bool keepAlive = true;
+
+  /** Set if the connection should be closed once output is written.  */
+  bool closeAfterWrite = false;
+
+  /** Whether we sent "100 Continue" for the current request already.  */
+  bool continueSent = false;
+
+  /** The epoll events we are currently watching for.  */
+  uint32_t events;
+
+  /** Time of the last activity on the connection.  */
+  Clock::time_point lastActive;
+
+};
+
+/* ************************************************************************** */
+
+RpcTransport::Reply::~Reply ()
+{
+  Complete (false, "");
+}
+
+void
+RpcTransport::Reply::Complete (const bool ok, const std::string& body)
+{
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    if (done)
+      return;
+    done = true;
+  }
+
+  if (!ok)
+    LOG (WARNING) << "Local RPC request was not answered";
+
+  completions->Push ({conn, ok, body});
+}
+
+/* ************************************************************************** */
+
+RpcTransport::RpcTransport (const Config& cfg)
+  : config(cfg), nextConnection(WAKE_ID + 1)
+{
+  CHECK_GT (config.workers, 0);
+}
+
+RpcTransport::~RpcTransport ()
+{
+  Stop ();
+}
+
+void
+RpcTransport::SetHandler (const Handler& h)
+{
+  CHECK (loopThread == nullptr) << "Transport is already running";
+  handler = h;
+}
+
+void
+RpcTransport::Listen ()
+{
+  if (config.socketPath.empty ())
+    {
+      listenFd = socket (AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                         0);
+      if (listenFd < 0)
+        throw std::runtime_error ("failed to create RPC socket");
+
+      const int one = 1;
+      setsockopt (listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+
+      struct sockaddr_in addr;
+      std::memset (&addr, 0, sizeof (addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons (config.port);
+      addr.sin_addr.s_addr = htonl (INADDR_ANY);
+
+      socklen_t addrLen = sizeof (addr);
+      if (bind (listenFd, reinterpret_cast<struct sockaddr*> (&addr),
+                sizeof (addr)) != 0
+            || listen (listenFd, SOMAXCONN) != 0
+            || getsockname (listenFd,
+                            reinterpret_cast<struct sockaddr*> (&addr),
+                            &addrLen) != 0)
+        {
+          const std::string err = std::strerror (errno);
+          close (listenFd);
+          listenFd = -1;
+          throw std::runtime_error ("failed to listen for RPCs on port "
+                                    + std::to_string (config.port)
+                                    + ": " + err);
+        }
+      port = ntohs (addr.sin_port);
+
+      return;
+    }
+
+  const auto& path = config.socketPath;
+
+  struct sockaddr_un addr;
+  std::memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size () >= sizeof (addr.sun_path))
+    throw std::runtime_error ("socket path is too long: " + path);
+  std::memcpy (addr.sun_path, path.data (), path.size ());
+
+  /* Remove a stale socket left behind e.g. by a crashed process, but
+     nothing else that may be there.  */
+  struct stat st;
+  if (lstat (path.c_str (), &st) == 0)
+    {
+      if (!S_ISSOCK (st.st_mode))
+        throw std::runtime_error ("not a socket: " + path);
+      LOG (WARNING) << "Removing existing socket " << path;
+      unlink (path.c_str ());
+    }
+
+  listenFd = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listenFd < 0)
+    throw std::runtime_error ("failed to create RPC socket");
+
+  if (bind (listenFd, reinterpret_cast<struct sockaddr*> (&addr),
+            sizeof (addr)) != 0
+        || listen (listenFd, SOMAXCONN) != 0)
+    {
+      const std::string err = std::strerror (errno);
+      close (listenFd);
+      listenFd = -1;
+      throw std::runtime_error ("failed to listen for RPCs on " + path
+                                + ": " + err);
+    }
+}
+
+void
+RpcTransport::Start ()
+{
+  CHECK (handler) << "No handler set for RPC transport";
+  CHECK (loopThread == nullptr) << "Transport is already running";
+
+  completions = std::make_shared<Completions> ();
+  Listen ();
+
+  epollFd = epoll_create1 (EPOLL_CLOEXEC);
+  if (epollFd < 0)
+    throw std::runtime_error ("failed to create epoll instance");
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = LISTEN_ID;
+  CHECK_EQ (epoll_ctl (epollFd, EPOLL_CTL_ADD, listenFd, &ev), 0);
+  ev.data.u64 = WAKE_ID;
+  CHECK_EQ (epoll_ctl (epollFd, EPOLL_CTL_ADD, completions->fd, &ev), 0);
+
+  shouldStop = false;
+  for (unsigned i = 0; i < config.workers; ++i)
+    workers.emplace_back ([this] ()
+      {
+        RunWorker ();
+      });
+  loopThread = std::make_unique<std::thread> ([this] ()
+    {
+      RunLoop ();
+    });
+
+  LOG (INFO)
+      << "Processing local RPCs with " << config.workers << " worker threads";
+}
+
+void
+RpcTransport::Stop ()
+{
+  if (loopThread == nullptr)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    shouldStop = true;
+    cv.notify_all ();
+  }
+  completions->Wake ();
+
+  loopThread->join ();
+  loopThread.reset ();
+  for (auto& w : workers)
+    w.join ();
+  workers.clear ();
+
+  completions->Close ();
+  completions.reset ();
+  jobs.clear ();
+
+  while (!connections.empty ())
+    CloseConnection (connections.begin ()->first);
+  close (epollFd);
+  epollFd = -1;
+  close (listenFd);
+  listenFd = -1;
+
+  if (!config.socketPath.empty ())
+    unlink (config.socketPath.c_str ());
+}
+
+void
+RpcTransport::RunWorker ()
+{
+  while (true)
+    {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mut);
+        cv.wait (lock, [this] ()
+          {
+            return shouldStop || !jobs.empty ();
+          });
+        if (shouldStop)
+          return;
+
+        job = std::move (jobs.front ());
+        jobs.pop_front ();
+      }
+
+      auto reply = std::make_shared<Reply> (completions, job.conn);
+      try
+        {
+          handler (job.request, reply);
+        }
+      catch (const std::exception& exc)
+        {
+          LOG (ERROR) << "Error processing local RPC request: " << exc.what ();
+        }
+    }
+}
+
+void
+RpcTransport::RunLoop ()
+{
+  bool acceptPaused = false;
+  Clock::time_point acceptResume;
+  Clock::time_point lastSweep = Clock::now ();
+
+  while (true)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mut);
+        if (shouldStop)
+          return;
+      }
+
+      struct epoll_event events[64];
+      const int n = epoll_wait (epollFd, events, 64, LOOP_TIMEOUT_MS);
+      if (n < 0 && errno != EINTR)
+        LOG (FATAL) << "epoll_wait failed: " << std::strerror (errno);
+
+      for (int i = 0; i < n; ++i)
+        {
+          const uint64_t id = events[i].data.u64;
+
+          if (id == LISTEN_ID)
+            {
+              if (!AcceptAll ())
+                {
+                  CHECK_EQ (epoll_ctl (epollFd, EPOLL_CTL_DEL, listenFd,
+                                       nullptr), 0);
+                  acceptPaused = true;
+                  acceptResume = Clock::now () + ACCEPT_PAUSE;
+                }
+              continue;
+            }
+
+          if (id == WAKE_ID)
+            {
+              for (const auto& item : completions->Take ())
+                {
+                  const auto mit = connections.find (item.conn);
+                  if (mit == connections.end ())
+                    {
+                      VLOG (1) << "Dropping reply for closed connection";
+                      continue;
+                    }
+                  QueueResponse (item.conn, *mit->second, item.ok, item.body);
+                }
+              continue;
+            }
+
+          /* The connection may have been closed while processing earlier
+             events in this batch.  */
+          const auto mit = connections.find (id);
+          if (mit == connections.end ())
+            continue;
+          Connection& c = *mit->second;
+
+          if (events[i].events & EPOLLERR)
+            {
+              CloseConnection (id);
+              continue;
+            }
+          if ((events[i].events & EPOLLOUT) && !WriteTo (id, c))
+            continue;
+          if (events[i].events & (EPOLLIN | EPOLLHUP))
+            ReadFrom (id, c);
+        }
+
+      const auto now = Clock::now ();
+
+      if (acceptPaused && now >= acceptResume)
+        {
+          struct epoll_event ev;
+          ev.events = EPOLLIN;
+          ev.data.u64 = LISTEN_ID;
+          CHECK_EQ (epoll_ctl (epollFd, EPOLL_CTL_ADD, listenFd, &ev), 0);
+          acceptPaused = false;
+        }
+
+      if (now - lastSweep >= std::chrono::milliseconds (LOOP_TIMEOUT_MS))
+        {
+          lastSweep = now;
+
+          std::vector<uint64_t> idle;
+          for (const auto& entry : connections)
+            {
+              const auto& c = *entry.second;
+              if (!c.busy && c.output.empty ()
+                    && now - c.lastActive >= IDLE_TIMEOUT)
+                idle.push_back (entry.first);
+            }
+
+          for (const auto id : idle)
+            {
+              VLOG (1) << "Closing idle RPC connection";
+              CloseConnection (id);
+            }
+        }
+    }
+}
+
+bool
+RpcTransport::AcceptAll ()
+{
+  while (true)
+    {
+      const int fd = accept4 (listenFd, nullptr, nullptr,
+                              SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0)
+        switch (errno)
+          {
+          case EINTR:
+          case ECONNABORTED:
+            continue;
+
+          case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+          case EWOULDBLOCK:
+#endif
+            return true;
+
+          case EMFILE:
+          case ENFILE:
+          case ENOBUFS:
+          case ENOMEM:
+            LOG (WARNING)
+                << "Cannot accept RPC connection: " << std::strerror (errno);
+            return false;
+
+          default:
+            LOG (WARNING)
+                << "Failed to accept RPC connection: " << std::strerror (errno);
+            return true;
+          }
+
+      const uint64_t id = nextConnection++;
+
+      auto c = std::make_unique<Connection> ();
+      c->fd = fd;
+      c->events = EPOLLIN;
+      c->lastActive = Clock::now ();
+
+      struct epoll_event ev;
+      ev.events = c->events;
+      ev.data.u64 = id;
+      if (epoll_ctl (epollFd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+          LOG (WARNING)
+              << "Failed to watch RPC connection: " << std::strerror (errno);
+          close (fd);
+          continue;
+        }
+
+      connections.emplace (id, std::move (c));
+    }
+}
+
+bool
+RpcTransport::ReadFrom (const uint64_t id, Connection& c)
+{
+  while (true)
+    {
+      char buf[16 * 1'024];
+      const auto n = recv (c.fd, buf, sizeof (buf), 0);
+
+      if (n > 0)
+        {
+          c.input.append (buf, n);
+          if (c.input.size () > MAX_HEAD_SIZE + MAX_REQUEST_SIZE)
+            {
+              LOG (WARNING) << "Too much data on local RPC connection";
+              CloseConnection (id);
+              return false;
+            }
+          continue;
+        }
+
+      if (n == 0)
+        {
+          VLOG (1) << "RPC connection closed by peer";
+          CloseConnection (id);
+          return false;
+        }
+
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+
+      VLOG (1) << "Error reading from RPC connection: " << std::strerror (errno);
+      CloseConnection (id);
+      return false;
+    }
+
+  c.lastActive = Clock::now ();
+  return ProcessInput (id, c);
+}
+
+bool
+RpcTransport::ProcessInput (const uint64_t id, Connection& c)
+{
+  if (c.busy || c.closeAfterWrite)
+    return true;
+
+  std::string request;
+
+  if (!config.socketPath.empty ())
+    {
+      /* On the Unix socket, each connection carries a single request
+         terminated by a newline.  */
+      const auto end = c.input.find ('\n');
+      if (end == std::string::npos)
+        {
+          if (c.input.size () > MAX_REQUEST_SIZE)
+            {
+              LOG (WARNING) << "Local RPC request is too large";
+              CloseConnection (id);
+              return false;
+            }
+          return true;
+        }
+
+      request = c.input.substr (0, end);
+      c.input.clear ();
+      c.keepAlive = false;
+    }
+  else
+    {
+      const auto headEnd = c.input.find ("\r\n\r\n");
+      if (headEnd == std::string::npos)
+        {
+          if (c.input.size () <= MAX_HEAD_SIZE)
+            return true;
+
+          c.keepAlive = false;
+          c.output += FormatHttp ("431 Request Header Fields Too Large", "", "",
+                                  false);
+          c.closeAfterWrite = true;
+          return WriteTo (id, c);
+        }
+
+      HttpHead head;
+      if (!ParseHttpHead (c.input.substr (0, headEnd), head))
+        {
+          c.keepAlive = false;
+          c.output += FormatHttp ("400 Bad Request", "", "", false);
+          c.closeAfterWrite = true;
+          return WriteTo (id, c);
+        }
+
+      const auto& hdr = head.headers;
+      const auto getHeader = [&hdr] (const std::string& name)
+        {
+          const auto mit = hdr.find (name);
+          return mit == hdr.end () ? std::string () : ToLower (mit->second);
+        };
+
+      const std::string connection = getHeader ("connection");
+      if (head.version == "HTTP/1.0")
+        c.keepAlive = (connection == "keep-alive");
+      else
+        c.keepAlive = (connection != "close");
+
+      if (hdr.count ("transfer-encoding") > 0)
+        {
+          c.keepAlive = false;
+          c.output += FormatHttp ("411 Length Required", "", "", false);
+          c.closeAfterWrite = true;
+          return WriteTo (id, c);
+        }
+
+      size_t length = 0;
+      const std::string lengthStr = getHeader ("content-length");
+      if (lengthStr.find_first_not_of ("0123456789") != std::string::npos
+            || (hdr.count ("content-length") > 0 && lengthStr.empty ()))
+        {
+          c.keepAlive = false;
+          c.output += FormatHttp ("400 Bad Request", "", "", false);
+          c.closeAfterWrite = true;
+          return WriteTo (id, c);
+        }
+      if (lengthStr.size () > 10)
+        length = MAX_REQUEST_SIZE + 1;
+      else if (!lengthStr.empty ())
+        length = std::stoull (lengthStr);
+      if (length > MAX_REQUEST_SIZE)
+        {
+          c.keepAlive = false;
+          c.output += FormatHttp ("413 Payload Too Large", "", "", false);
+          c.closeAfterWrite = true;
+          return WriteTo (id, c);
+        }
+
+      const size_t total = headEnd + 4 + length;
+      if (c.input.size () < total)
+        {
+          if (!c.continueSent && getHeader ("expect") == "100-continue")
+            {
+              c.output += "HTTP/1.1 100 Continue\r\n\r\n";
+              c.continueSent = true;
+              return WriteTo (id, c);
+            }
+          return true;
+        }
+
+      request = c.input.substr (headEnd + 4, length);
+      c.input.erase (0, total);
+      c.continueSent = false;
+
+      if (head.method == "OPTIONS")
+        {
+          c.output += FormatHttp ("200 OK", CORS_PREFLIGHT_HEADERS, "",
+                                  c.keepAlive);
+          c.closeAfterWrite = !c.keepAlive;
+          if (!WriteTo (id, c))
+            return false;
+          return ProcessInput (id, c);
+        }
+
+      if (head.method != "POST")
+        {
+          c.keepAlive = false;
+          c.output += FormatHttp ("405 Method Not Allowed", CORS_HEADERS, "",
+                                  false);
+          c.closeAfterWrite = true;
+          return WriteTo (id, c);
+        }
+    }
+
+  c.busy = true;
+
+  std::lock_guard<std::mutex> lock(mut);
+  jobs.push_back ({id, std::move (request)});
+  cv.notify_one ();
+
+  return true;
+}
+
+bool
+RpcTransport::QueueResponse (const uint64_t id, Connection& c, const bool ok,
+                             const std::string& body)
+{
+  CHECK (c.busy);
+  c.busy = false;
+  c.lastActive = Clock::now ();
+
+  if (!config.socketPath.empty ())
+    {
+      if (ok)
+        c.output += body + "\n";
+      c.closeAfterWrite = true;
+    }
+  else
+    {
+      if (ok)
+        c.output += FormatHttp ("200 OK",
+                                std::string ("Content-Type: application/json\r\n")
+                                  + CORS_HEADERS,
+                                body, c.keepAlive);
+      else
+        {
+          c.keepAlive = false;
+          c.output += FormatHttp ("500 Internal Server Error", CORS_HEADERS, "",
+                                  false);
+        }
+      c.closeAfterWrite = !c.keepAlive;
+    }
+
+  if (!WriteTo (id, c))
+    return false;
+
+  /* Process a pipelined next request, if there is one.  */
+  return ProcessInput (id, c);
+}
+
+bool
+RpcTransport::WriteTo (const uint64_t id, Connection& c)
+{
+  size_t done = 0;
+  while (done < c.output.size ())
+    {
+      const auto n = send (c.fd, c.output.data () + done,
+                           c.output.size () - done, MSG_NOSIGNAL);
+      if (n >= 0)
+        {
+          done += n;
+          continue;
+        }
+
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+
+      VLOG (1) << "Error writing to RPC connection: " << std::strerror (errno);
+      CloseConnection (id);
+      return false;
+    }
+  c.output.erase (0, done);
+
+  if (c.output.empty () && c.closeAfterWrite)
+    {
+      CloseConnection (id);
+      return false;
+    }
+
+  UpdateEvents (id, c);
+  return true;
+}
+
+void
+RpcTransport::UpdateEvents (const uint64_t id, Connection& c)
+{
+  uint32_t events = EPOLLIN;
+  if (!c.output.empty ())
+    events |= EPOLLOUT;
+
+  if (events == c.events)
+    return;
+
+  struct epoll_event ev;
+  ev.events = events;
+  ev.data.u64 = id;
+  CHECK_EQ (epoll_ctl (epollFd, EPOLL_CTL_MOD, c.fd, &ev), 0);
+  c.events = events;
+}
+
+void
+RpcTransport::CloseConnection (const uint64_t id)
+{
+  const auto mit = connections.find (id);
+  CHECK (mit != connections.end ());
+
+  epoll_ctl (epollFd, EPOLL_CTL_DEL, mit->second->fd, nullptr);
+  close (mit->second->fd);
+  connections.erase (mit);
+}
+
+} // namespace charon
@@ -0,0 +1,297 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_UTILS_RPCTRANSPORT_HPP
+#define CHARON_UTILS_RPCTRANSPORT_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace charon
+{
+
+/**
+ * Connection handling for the local JSON-RPC interface of charon-client.
+ * It serves either HTTP on a TCP port or newline-delimited requests on
+ * a Unix domain socket (one request per connection, like the socket server
+ * of libjson-rpc-cpp).
+ *
+ * All connections are handled by a single event-loop thread, which reads
+ * complete requests and hands them to a fixed pool of worker threads.
+ * The handler does not have to produce the response right away:  it gets
+ * a Reply handle, which can be completed later from any thread.  This allows
+ * long-polling calls to be parked without holding on to a worker, so that
+ * the workers remain available for fast calls no matter how many clients
+ * are waiting.
+ */
+class RpcTransport
+{
+
+public:
+
+  class Reply;
+
+  /**
+   * Handler for requests, which is called on one of the worker threads with
+   * the raw request and the Reply handle to complete it with.
+   */
+  using Handler
+      = std::function<void (const std::string& request,
+                            const std::shared_ptr<Reply>& reply)>;
+
+  /**
+   * Configuration of the transport.
+   */
+  struct Config
+  {
+
+    /** The TCP port for HTTP.  Only used if socketPath is empty.  */
+    int port = 0;
+
+    /** If not empty, listen on a Unix domain socket at this path.  */
+    std::string socketPath;
+
+    /** Number of worker threads that process requests.  */
+    unsigned workers = 50;
+
+  };
+
+private:
+
+  class Completions;
+  struct Connection;
+
+  /** A request waiting for a worker.  */
+  struct Job
+  {
+    uint64_t conn;
+    std::string request;
+  };
+
+  /** The configuration.  */
+  const Config config;
+
+  /** The handler for requests.  */
+  Handler handler;
+
+  /** The listening socket.  */
+  int listenFd = -1;
+
+  /** The TCP port we listen on (if not on a Unix socket).  */
+  int port = -1;
+
+  /** The epoll instance of the event loop.  */
+  int epollFd = -1;
+
+  /**
+   * Queue of completed replies for the event loop.  This is shared with
+   * the Reply handles, which may outlive the transport.
+   */
+  std::shared_ptr<Completions> completions;
+
+  /** Thread running the event loop.  */
+  std::unique_ptr<std::thread> loopThread;
+
+  /** The worker threads.  */
+  std::vector<std::thread> workers;
+
+  /** Mutex for the job queue.  */
+  std::mutex mut;
+
+  /** Condition variable signalled when jobs are queued or we stop.  */
+  std::condition_variable cv;
+
+  /** Set to true when the workers should stop.  */
+  bool shouldStop = false;
+
+  /** Requests waiting for a worker.  */
+  std::deque<Job> jobs;
+
+  /**
+   * The open connections by ID.  This is only accessed from the event
+   * loop thread.
+   */
+  std::map<uint64_t, std::unique_ptr<Connection>> connections;
+
+  /** Next ID to assign to a new connection.  */
+  uint64_t nextConnection;
+
+  /**
+   * Opens the listening socket.  Throws if that fails.
+   */
+  void Listen ();
+
+  /**
+   * Runs the event loop until stopped.
+   */
+  void RunLoop ();
+
+  /**
+   * Runs a worker thread until stopped.
+   */
+  void RunWorker ();
+
+  /**
+   * Accepts all pending connections.  Returns false if accepting failed
+   * due to a lack of file descriptors.
+   */
+  bool AcceptAll ();
+
+  /**
+   * Reads available data from the connection and starts processing the
+   * next request, if complete.  Returns false if the connection has been
+   * closed (and c is thus no longer valid).
+   */
+  bool ReadFrom (uint64_t id, Connection& c);
+
+  /**
+   * Parses the next request from the connection's input buffer, if it is
+   * complete and no other request is in flight.  It is either queued for
+   * the workers or answered directly (for HTTP errors and CORS preflight).
+   * Returns false if the connection has been closed.
+   */
+  bool ProcessInput (uint64_t id, Connection& c);
+
+  /**
+   * Queues a response to the connection's request in flight and writes
+   * as much as possible.  Returns false if the connection has been closed.
+   */
+  bool QueueResponse (uint64_t id, Connection& c, bool ok,
+                      const std::string& body);
+
+  /**
+   * Writes buffered output to the connection.  Closes it if that failed or
+   * everything is written and the connection should be closed afterwards,
+   * in which case false is returned.
+   */
+  bool WriteTo (uint64_t id, Connection& c);
+
+  /**
+   * Updates the epoll events we watch for on the connection.
+   */
+  void UpdateEvents (uint64_t id, Connection& c);
+
+  /**
+   * Closes and removes the connection.
+   */
+  void CloseConnection (uint64_t id);
+
+public:
+
+  /**
+   * Constructs the transport with the given config.  It does not listen
+   * yet until Start is called.
+   */
+  explicit RpcTransport (const Config& cfg);
+
+  ~RpcTransport ();
+
+  RpcTransport () = delete;
+  RpcTransport (const RpcTransport&) = delete;
+  void operator= (const RpcTransport&) = delete;
+
+  /**
+   * Sets the handler for requests.  Must be called before Start.
+   */
+  void SetHandler (const Handler& h);
+
+  /**
+   * Starts listening and processing requests.  Throws if the socket
+   * cannot be opened.
+   */
+  void Start ();
+
+  /**
+   * Stops processing requests and closes all connections.  Replies completed
+   * afterwards are ignored.
+   */
+  void Stop ();
+
+  /**
+   * Returns the TCP port we listen on, which is useful if the configured
+   * port is zero (for testing).  Must only be called after Start.
+   */
+  int
+  GetPort () const
+  {
+    return port;
+  }
+
+};
+
+/**
+ * Handle for completing a request received by the RpcTransport.  It can be
+ * used from any thread.  If it is destroyed without being completed,
+ * the request fails with an internal error.
+ */
+class RpcTransport::Reply
+{
+
+private:
+
+  /** The transport's completion queue.  */
+  std::shared_ptr<Completions> completions;
+
+  /** The connection the request came from.  */
+  const uint64_t conn;
+
+  /** Mutex guarding against multiple completions.  */
+  std::mutex mut;
+
+  /** Whether the reply has been completed already.  */
+  bool done = false;
+
+  /**
+   * Queues the completion if not yet done.
+   */
+  void Complete (bool ok, const std::string& body);
+
+public:
+
+  explicit Reply (const std::shared_ptr<Completions>& c, uint64_t id)
+    : completions(c), conn(id)
+  {}
+
+  ~Reply ();
+
+  Reply () = delete;
+  Reply (const Reply&) = delete;
+  void operator= (const Reply&) = delete;
+
+  /**
+   * Sends the given (JSON-RPC) response for the request.
+   */
+  void
+  Send (const std::string& response)
+  {
+    Complete (true, response);
+  }
+
+};
+
+} // namespace charon
+
+#endif // CHARON_UTILS_RPCTRANSPORT_HPP
@@ -0,0 +1,648 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "rpctransport.hpp"
+
+#include <gtest/gtest.h>
+
+#include <glog/logging.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace charon
+{
+namespace
+{
+
+using namespace std::chrono_literals;
+
+/** Size limit of request bodies enforced by the transport.  */
+constexpr size_t MAX_REQUEST_SIZE = 16 * 1'024 * 1'024;
+
+/**
+ * A parsed HTTP response as received by a test connection.
+ */
+struct HttpResponse
+{
+  std::string status;
+  std::string head;
+  std::string body;
+};
+
+/**
+ * A raw connection to the transport, either over TCP or a Unix socket.
+ */
+class TestConnection
+{
+
+private:
+
+  int fd;
+
+  /** Data received but not yet consumed.  */
+  std::string buffer;
+
+  /**
+   * Sets a receive timeout, so that tests fail instead of hanging.
+   */
+  void
+  SetTimeout ()
+  {
+    struct timeval tv;
+    tv.tv_sec = 5;
+    tv.tv_usec = 0;
+    setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+  }
+
+  /**
+   * Receives more data into the buffer.  Returns false if the connection
+   * is closed or the read times out.
+   */
+  bool
+  Receive ()
+  {
+    char buf[1'024];
+    const auto n = recv (fd, buf, sizeof (buf), 0);
+    if (n <= 0)
+      return false;
+    buffer.append (buf, n);
+    return true;
+  }
+
+public:
+
+  /**
+   * Connects to the given TCP port on localhost.
+   */
+  explicit TestConnection (const int port)
+  {
+    fd = socket (AF_INET, SOCK_STREAM, 0);
+    CHECK_GE (fd, 0);
+    SetTimeout ();
+
+    struct sockaddr_in addr;
+    std::memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons (port);
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    CHECK_EQ (connect (fd, reinterpret_cast<struct sockaddr*> (&addr),
+                       sizeof (addr)), 0);
+  }
+
+  /**
+   * Connects to the given Unix domain socket.
+   */
+  explicit TestConnection (const std::string& path)
+  {
+    fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    CHECK_GE (fd, 0);
+    SetTimeout ();
+
+    struct sockaddr_un addr;
+    std::memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    CHECK_LT (path.size (), sizeof (addr.sun_path));
+    std::memcpy (addr.sun_path, path.data (), path.size ());
+    CHECK_EQ (connect (fd, reinterpret_cast<struct sockaddr*> (&addr),
+                       sizeof (addr)), 0);
+  }
+
+  ~TestConnection ()
+  {
+    if (fd >= 0)
+      close (fd);
+  }
+
+  TestConnection () = delete;
+  TestConnection (const TestConnection&) = delete;
+  void operator= (const TestConnection&) = delete;
+
+  /**
+   * Sends all the given data.  Returns false if that fails (e.g. because
+   * the other side closed the connection).
+   */
+  bool
+  Send (const std::string& data)
+  {
+    size_t done = 0;
+    while (done < data.size ())
+      {
+        const auto n = send (fd, data.data () + done, data.size () - done,
+                             MSG_NOSIGNAL);
+        if (n <= 0)
+          return false;
+        done += n;
+      }
+    return true;
+  }
+
+  /**
+   * Closes the connection from our side.
+   */
+  void
+  Close ()
+  {
+    close (fd);
+    fd = -1;
+  }
+
+  /**
+   * Reads until the given string has been received, and returns all data
+   * up to and including it.  Returns an empty string if the connection
+   * is closed or times out before.
+   */
+  std::string
+  ReadUntil (const std::string& str)
+  {
+    while (true)
+      {
+        const auto pos = buffer.find (str);
+        if (pos != std::string::npos)
+          {
+            const std::string res = buffer.substr (0, pos + str.size ());
+            buffer.erase (0, pos + str.size ());
+            return res;
+          }
+
+        if (!Receive ())
+          return "";
+      }
+  }
+
+  /**
+   * Reads a full HTTP response (based on its Content-Length).  Returns
+   * an empty status if the connection is closed before.
+   */
+  HttpResponse
+  ReadResponse ()
+  {
+    HttpResponse res;
+    res.head = ReadUntil ("\r\n\r\n");
+    if (res.head.empty ())
+      return res;
+    res.status = res.head.substr (0, res.head.find ("\r\n"));
+
+    const std::string lengthHeader = "Content-Length: ";
+    const auto pos = res.head.find (lengthHeader);
+    CHECK_NE (pos, std::string::npos);
+    const size_t length
+        = std::strtoul (res.head.c_str () + pos + lengthHeader.size (),
+                        nullptr, 10);
+
+    while (buffer.size () < length)
+      if (!Receive ())
+        return HttpResponse ();
+
+    res.body = buffer.substr (0, length);
+    buffer.erase (0, length);
+    return res;
+  }
+
+  /**
+   * Returns true if the connection is closed by the other side without
+   * any more data being sent.
+   */
+  bool
+  IsClosed ()
+  {
+    if (!buffer.empty ())
+      return false;
+
+    char c;
+    const auto n = recv (fd, &c, 1, 0);
+    if (n == 0)
+      return true;
+
+    /* The connection may also be reset if we were still sending when the
+       other side closed it.  */
+    return n < 0 && errno != EAGAIN && errno != EWOULDBLOCK;
+  }
+
+};
+
+/**
+ * Returns a POST request with the given body.
+ */
+std::string
+PostRequest (const std::string& body, const std::string& extraHeaders = "")
+{
+  return "POST / HTTP/1.1\r\n"
+         "Host: localhost\r\n"
+         + extraHeaders
+         + "Content-Length: " + std::to_string (body.size ()) + "\r\n"
+         "\r\n"
+         + body;
+}
+
+/**
+ * Test fixture with a transport whose handler echoes the requests.
+ */
+class RpcTransportTestBase : public testing::Test
+{
+
+private:
+
+  /** Lock for the received requests.  */
+  std::mutex mut;
+
+  /** All requests the handler received.  */
+  std::vector<std::string> requests;
+
+protected:
+
+  std::unique_ptr<RpcTransport> transport;
+
+  /**
+   * Starts the transport with the given config.
+   */
+  void
+  Start (const RpcTransport::Config& cfg)
+  {
+    transport = std::make_unique<RpcTransport> (cfg);
+    using Reply = RpcTransport::Reply;
+    transport->SetHandler ([this] (const std::string& request,
+                                   const std::shared_ptr<Reply>& reply)
+      {
+        {
+          std::lock_guard<std::mutex> lock(mut);
+          requests.push_back (request);
+        }
+        reply->Send ("echo:" + request);
+      });
+    transport->Start ();
+  }
+
+  /**
+   * Returns the requests received by the handler so far.
+   */
+  std::vector<std::string>
+  GetRequests ()
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    return requests;
+  }
+
+};
+
+/**
+ * Tests for the transport serving HTTP on a TCP port.
+ */
+class RpcTransportTests : public RpcTransportTestBase
+{
+
+protected:
+
+  RpcTransportTests ()
+  {
+    RpcTransport::Config cfg;
+    cfg.port = 0;
+    cfg.workers = 2;
+    Start (cfg);
+  }
+
+  /**
+   * Opens a new TCP connection to the transport.
+   */
+  std::unique_ptr<TestConnection>
+  Connect ()
+  {
+    return std::make_unique<TestConnection> (transport->GetPort ());
+  }
+
+};
+
+TEST_F (RpcTransportTests, Basic)
+{
+  auto conn = Connect ();
+  conn->Send (PostRequest ("foo"));
+
+  const auto res = conn->ReadResponse ();
+  EXPECT_EQ (res.status, "HTTP/1.1 200 OK");
+  EXPECT_EQ (res.body, "echo:foo");
+  EXPECT_NE (res.head.find ("Content-Type: application/json\r\n"),
+             std::string::npos);
+  EXPECT_NE (res.head.find ("Access-Control-Allow-Origin: *\r\n"),
+             std::string::npos);
+  EXPECT_EQ (GetRequests (), std::vector<std::string> ({"foo"}));
+}
+
+TEST_F (RpcTransportTests, MissingContentLength)
+{
+  auto conn = Connect ();
+  conn->Send ("POST / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+
+  const auto res = conn->ReadResponse ();
+  EXPECT_EQ (res.status, "HTTP/1.1 200 OK");
+  EXPECT_EQ (res.body, "echo:");
+}
+
+TEST_F (RpcTransportTests, NonNumericContentLength)
+{
+  for (const std::string len : {"abc", "-5", "1e3", "0x10", ""})
+    {
+      auto conn = Connect ();
+      conn->Send ("POST / HTTP/1.1\r\nContent-Length: " + len + "\r\n\r\n");
+      EXPECT_EQ (conn->ReadResponse ().status, "HTTP/1.1 400 Bad Request")
+          << len;
+      EXPECT_TRUE (conn->IsClosed ());
+    }
+
+  EXPECT_TRUE (GetRequests ().empty ());
+}
+
+TEST_F (RpcTransportTests, OversizeContentLength)
+{
+  for (const auto& len : {std::to_string (MAX_REQUEST_SIZE + 1),
+                          std::string ("99999999999"),
+                          std::string (30, '9')})
+    {
+      auto conn = Connect ();
+      conn->Send ("POST / HTTP/1.1\r\nContent-Length: " + len + "\r\n\r\n");
+      EXPECT_EQ (conn->ReadResponse ().status,
+                 "HTTP/1.1 413 Payload Too Large")
+          << len;
+      EXPECT_TRUE (conn->IsClosed ());
+    }
+
+  EXPECT_TRUE (GetRequests ().empty ());
+}
+
+TEST_F (RpcTransportTests, TransferEncoding)
+{
+  auto conn = Connect ();
+  conn->Send ("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+              "3\r\nfoo\r\n0\r\n\r\n");
+  EXPECT_EQ (conn->ReadResponse ().status, "HTTP/1.1 411 Length Required");
+  EXPECT_TRUE (conn->IsClosed ());
+}
+
+TEST_F (RpcTransportTests, InvalidHead)
+{
+  auto conn = Connect ();
+  conn->Send ("garbage\r\n\r\n");
+  EXPECT_EQ (conn->ReadResponse ().status, "HTTP/1.1 400 Bad Request");
+  EXPECT_TRUE (conn->IsClosed ());
+}
+
+TEST_F (RpcTransportTests, SplitAcrossReads)
+{
+  const std::string request = PostRequest ("split body");
+
+  auto conn = Connect ();
+  for (size_t i = 0; i < request.size (); i += 7)
+    {
+      conn->Send (request.substr (i, 7));
+      std::this_thread::sleep_for (5ms);
+    }
+
+  const auto res = conn->ReadResponse ();
+  EXPECT_EQ (res.status, "HTTP/1.1 200 OK");
+  EXPECT_EQ (res.body, "echo:split body");
+}
+
+TEST_F (RpcTransportTests, Pipelined)
+{
+  auto conn = Connect ();
+  conn->Send (PostRequest ("first") + PostRequest ("second")
+                + PostRequest ("third"));
+
+  EXPECT_EQ (conn->ReadResponse ().body, "echo:first");
+  EXPECT_EQ (conn->ReadResponse ().body, "echo:second");
+  EXPECT_EQ (conn->ReadResponse ().body, "echo:third");
+  EXPECT_EQ (GetRequests (),
+             std::vector<std::string> ({"first", "second", "third"}));
+}
+
+TEST_F (RpcTransportTests, KeepAlive)
+{
+  auto conn = Connect ();
+  for (const std::string body : {"a", "b", "c"})
+    {
+      conn->Send (PostRequest (body));
+      const auto res = conn->ReadResponse ();
+      EXPECT_EQ (res.body, "echo:" + body);
+      EXPECT_NE (res.head.find ("Connection: keep-alive\r\n"),
+                 std::string::npos);
+    }
+
+  conn->Send (PostRequest ("last", "Connection: close\r\n"));
+  const auto res = conn->ReadResponse ();
+  EXPECT_EQ (res.body, "echo:last");
+  EXPECT_NE (res.head.find ("Connection: close\r\n"), std::string::npos);
+  EXPECT_TRUE (conn->IsClosed ());
+}
+
+TEST_F (RpcTransportTests, Http10)
+{
+  auto conn = Connect ();
+  conn->Send ("POST / HTTP/1.0\r\nContent-Length: 3\r\n\r\nfoo");
+  EXPECT_EQ (conn->ReadResponse ().body, "echo:foo");
+  EXPECT_TRUE (conn->IsClosed ());
+
+  conn = Connect ();
+  conn->Send ("POST / HTTP/1.0\r\nConnection: keep-alive\r\n"
+              "Content-Length: 3\r\n\r\nfoo");
+  EXPECT_EQ (conn->ReadResponse ().body, "echo:foo");
+  conn->Send ("POST / HTTP/1.0\r\nContent-Length: 3\r\n\r\nbar");
+  EXPECT_EQ (conn->ReadResponse ().body, "echo:bar");
+}
+
+TEST_F (RpcTransportTests, ExpectContinue)
+{
+  auto conn = Connect ();
+  conn->Send ("POST / HTTP/1.1\r\n"
+              "Expect: 100-continue\r\n"
+              "Content-Length: 3\r\n"
+              "\r\n");
+  EXPECT_EQ (conn->ReadUntil ("\r\n\r\n"), "HTTP/1.1 100 Continue\r\n\r\n");
+
+  conn->Send ("foo");
+  const auto res = conn->ReadResponse ();
+  EXPECT_EQ (res.status, "HTTP/1.1 200 OK");
+  EXPECT_EQ (res.body, "echo:foo");
+
+  /* The body was sent right away, so no interim response is needed.  */
+  conn->Send (PostRequest ("bar", "Expect: 100-continue\r\n"));
+  EXPECT_EQ (conn->ReadResponse ().status, "HTTP/1.1 200 OK");
+}
+
+TEST_F (RpcTransportTests, OptionsCors)
+{
+  auto conn = Connect ();
+  conn->Send ("OPTIONS / HTTP/1.1\r\n"
+              "Origin: http://example.com\r\n"
+              "Access-Control-Request-Method: POST\r\n"
+              "\r\n");
+
+  const auto res = conn->ReadResponse ();
+  EXPECT_EQ (res.status, "HTTP/1.1 200 OK");
+  EXPECT_NE (res.head.find ("Access-Control-Allow-Origin: *\r\n"),
+             std::string::npos);
+  EXPECT_NE (res.head.find ("Access-Control-Allow-Methods: POST, OPTIONS\r\n"),
+             std::string::npos);
+  EXPECT_TRUE (GetRequests ().empty ());
+
+  /* The connection stays usable for the actual request.  */
+  conn->Send (PostRequest ("foo"));
+  EXPECT_EQ (conn->ReadResponse ().body, "echo:foo");
+}
+
+TEST_F (RpcTransportTests, MethodNotAllowed)
+{
+  auto conn = Connect ();
+  conn->Send ("GET / HTTP/1.1\r\n\r\n");
+  EXPECT_EQ (conn->ReadResponse ().status,
+             "HTTP/1.1 405 Method Not Allowed");
+  EXPECT_TRUE (conn->IsClosed ());
+  EXPECT_TRUE (GetRequests ().empty ());
+}
+
+TEST_F (RpcTransportTests, PeerClosesMidBody)
+{
+  auto conn = Connect ();
+  conn->Send ("POST / HTTP/1.1\r\nContent-Length: 100\r\n\r\npartial");
+  std::this_thread::sleep_for (10ms);
+  conn->Close ();
+  std::this_thread::sleep_for (10ms);
+
+  EXPECT_TRUE (GetRequests ().empty ());
+
+  conn = Connect ();
+  conn->Send (PostRequest ("foo"));
+  EXPECT_EQ (conn->ReadResponse ().body, "echo:foo");
+}
+
+TEST_F (RpcTransportTests, HeadTooLarge)
+{
+  auto conn = Connect ();
+  conn->Send ("POST / HTTP/1.1\r\nX-Padding: " + std::string (20'000, 'x'));
+  EXPECT_EQ (conn->ReadResponse ().status,
+             "HTTP/1.1 431 Request Header Fields Too Large");
+  EXPECT_TRUE (conn->IsClosed ());
+}
+
+TEST_F (RpcTransportTests, RequestSizeLimit)
+{
+  const std::string body(MAX_REQUEST_SIZE, 'x');
+
+  auto conn = Connect ();
+  conn->Send (PostRequest (body));
+  const auto res = conn->ReadResponse ();
+  EXPECT_EQ (res.status, "HTTP/1.1 200 OK");
+  EXPECT_EQ (res.body, "echo:" + body);
+
+  conn = Connect ();
+  conn->Send (PostRequest (body + "x"));
+  EXPECT_EQ (conn->ReadResponse ().status, "HTTP/1.1 413 Payload Too Large");
+  EXPECT_TRUE (conn->IsClosed ());
+  EXPECT_EQ (GetRequests ().size (), 1);
+}
+
+/* ************************************************************************** */
+
+/**
+ * Tests for the transport on a Unix domain socket.
+ */
+class RpcTransportUnixTests : public RpcTransportTestBase
+{
+
+protected:
+
+  /** Temporary directory holding the socket.  */
+  std::string dir;
+
+  /** Path of the socket.  */
+  std::string path;
+
+  RpcTransportUnixTests ()
+  {
+    char tmpl[] = "/tmp/charon-rpctransport-XXXXXX";
+    CHECK (mkdtemp (tmpl) != nullptr);
+    dir = tmpl;
+    path = dir + "/socket";
+
+    RpcTransport::Config cfg;
+    cfg.socketPath = path;
+    cfg.workers = 2;
+    Start (cfg);
+  }
+
+  ~RpcTransportUnixTests ()
+  {
+    /* Stopping the transport removes the socket file.  */
+    transport.reset ();
+    rmdir (dir.c_str ());
+  }
+
+};
+
+TEST_F (RpcTransportUnixTests, Basic)
+{
+  TestConnection conn(path);
+  conn.Send ("foo\n");
+  EXPECT_EQ (conn.ReadUntil ("\n"), "echo:foo\n");
+  EXPECT_TRUE (conn.IsClosed ());
+}
+
+TEST_F (RpcTransportUnixTests, SplitAcrossReads)
+{
+  TestConnection conn(path);
+  conn.Send ("fo");
+  std::this_thread::sleep_for (10ms);
+  conn.Send ("o\n");
+  EXPECT_EQ (conn.ReadUntil ("\n"), "echo:foo\n");
+}
+
+TEST_F (RpcTransportUnixTests, PeerClosesMidRequest)
+{
+  auto conn = std::make_unique<TestConnection> (path);
+  conn->Send ("partial");
+  std::this_thread::sleep_for (10ms);
+  conn.reset ();
+  std::this_thread::sleep_for (10ms);
+  EXPECT_TRUE (GetRequests ().empty ());
+
+  TestConnection other(path);
+  other.Send ("foo\n");
+  EXPECT_EQ (other.ReadUntil ("\n"), "echo:foo\n");
+}
+
+TEST_F (RpcTransportUnixTests, RequestSizeLimit)
+{
+  TestConnection conn(path);
+  conn.Send (std::string (MAX_REQUEST_SIZE + 1, 'x'));
+  EXPECT_TRUE (conn.IsClosed ());
+  EXPECT_TRUE (GetRequests ().empty ());
+}
+
+} // anonymous namespace
+} // namespace charon
@@ -19,17 +19,24 @@
 #include "util-client.hpp"
 
 #include "client.hpp"
+#include "eventstream.hpp"
+#include "notificationconfig.hpp"
+#include "rpctransport.hpp"
+#include "waitparker.hpp"
 
 #include <json/json.h>
 #include <jsonrpccpp/common/errors.h>
 #include <jsonrpccpp/common/exception.h>
 #include <jsonrpccpp/server.h>
-#include <jsonrpccpp/server/connectors/httpserver.h>
+#include <jsonrpccpp/server/abstractserverconnector.h>
 
 #include <glog/logging.h>
 
 #include <condition_variable>
+#include <map>
 #include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <unordered_map>
 
 namespace charon
@@ -37,6 +44,78 @@ namespace charon
 namespace
 {
 
+/**
+ * Timeout for parked waits.  This matches the timeout of blocking waits
+ * in the Charon client.
+ */
+constexpr auto PARKED_WAIT_TIMEOUT = std::chrono::seconds (5);
+
+/** Name of the local RPC method for waiting on multiple notifications.  */
+const std::string ANY_CHANGE_METHOD = "waitforanychange";
+
+/**
+ * JSON-RPC error code returned for waits that are rejected because too many
+ * are parked already.
+ */
+constexpr int ERROR_TOO_MANY_WAITS = -32000;
+
+/**
+ * Serialises a JSON value compactly.
+ */
+std::string
+SerialiseJson (const Json::Value& val)
+{
+  Json::StreamWriterBuilder wbuilder;
+  wbuilder["commentStyle"] = "None";
+  wbuilder["indentation"] = "";
+
+  return Json::writeString (wbuilder, val);
+}
+
+/**
+ * Server connector for the local RPC server, which is based on our own
+ * RpcTransport.  Requests are passed to a handler set by the server, which
+ * can then either park them or process them through jsonrpc::AbstractServer.
+ */
+class LocalConnector : public jsonrpc::AbstractServerConnector
+{
+
+private:
+
+  /** The underlying transport.  */
+  RpcTransport transport;
+
+public:
+
+  explicit LocalConnector (const RpcTransport::Config& cfg)
+    : transport(cfg)
+  {}
+
+  /**
+   * Sets the handler for raw requests from the transport.
+   */
+  void
+  SetRequestHandler (const RpcTransport::Handler& h)
+  {
+    transport.SetHandler (h);
+  }
+
+  bool
+  StartListening () override
+  {
+    transport.Start ();
+    return true;
+  }
+
+  bool
+  StopListening () override
+  {
+    transport.Stop ();
+    return true;
+  }
+
+};
+
 /**
  * Local JSON-RPC server that supports stopping via notification, but otherwise
  * forwards calls to a given list of methods to a Charon client.
@@ -46,9 +125,15 @@ class LocalServer : public jsonrpc::AbstractServer<LocalServer>
 
 private:
 
+  /** Connector this server is using.  */
+  LocalConnector& connector;
+
   /** Charon client to forward to.  */
   charon::Client& client;
 
+  /** Parker for the waiter methods.  */
+  WaitParker& parker;
+
   /**
    * Waiter methods that are supported, with the corresponding notification
    * "type" string that should be passed to Client::WaitForChange.
@@ -86,15 +171,168 @@ private:
     LOG (FATAL) << "method call not intercepted";
   }
 
+  /**
+   * Parses the parameters of waitforanychange, which are a single object
+   * mapping waiter method names to the respective known state ID.  Fills in
+   * the known states by notification type.  Returns false if the parameters
+   * are invalid.
+   */
+  bool
+  ParseAnyChangeParams (const Json::Value& params,
+                        std::map<std::string, Json::Value>& known) const
+  {
+    if (!params.isArray () || params.size () != 1)
+      return false;
+    const auto& obj = params[0];
+    if (!obj.isObject () || obj.empty ())
+      return false;
+
+    known.clear ();
+    for (auto it = obj.begin (); it != obj.end (); ++it)
+      {
+        const auto mit = notifications.find (it.name ());
+        if (mit == notifications.end ())
+          return false;
+        known[mit->second] = *it;
+      }
+
+    return true;
+  }
+
+  /**
+   * Tries to park the request as wait, if it is a single call to one of
+   * the waiter methods.  Returns false if the request should be processed
+   * normally instead.
+   */
+  bool
+  TryParkWait (const std::string& request,
+               const std::shared_ptr<RpcTransport::Reply>& reply)
+  {
+    /* Avoid parsing requests that cannot be for a waiter method.  */
+    if (notifications.empty ())
+      return false;
+    bool candidate
+        = request.find ('"' + ANY_CHANGE_METHOD + '"') != std::string::npos;
+    for (const auto& entry : notifications)
+      if (request.find ('"' + entry.first + '"') != std::string::npos)
+        {
+          candidate = true;
+          break;
+        }
+    if (!candidate)
+      return false;
+
+    Json::CharReaderBuilder rbuilder;
+    std::istringstream in(request);
+    Json::Value req;
+    std::string parseErrs;
+    if (!Json::parseFromStream (rbuilder, in, &req, &parseErrs))
+      return false;
+
+    /* Anything that is not a well-formed call with a single parameter
+       is left for the normal processing, which also produces the right
+       errors for it.  */
+    if (!req.isObject () || req["jsonrpc"] != "2.0" || !req.isMember ("id")
+          || !req["method"].isString ())
+      return false;
+    const std::string method = req["method"].asString ();
+    const auto& params = req["params"];
+
+    std::map<std::string, Json::Value> known;
+    const auto mit = notifications.find (method);
+    if (method == ANY_CHANGE_METHOD)
+      {
+        if (!ParseAnyChangeParams (params, known))
+          return false;
+      }
+    else if (mit == notifications.end ()
+               || !params.isArray () || params.size () != 1)
+      return false;
+
+    const std::string prefix = "{\"jsonrpc\":\"2.0\",\"id\":"
+                                 + SerialiseJson (req["id"]) + ",";
+    const auto sendError = [&reply, &prefix] (const int code,
+                                              const std::string& msg)
+      {
+        Json::Value err(Json::objectValue);
+        err["code"] = code;
+        err["message"] = msg;
+        reply->Send (prefix + "\"error\":" + SerialiseJson (err) + "}");
+      };
+
+    /* This makes sure we are subscribed to the notifications.  */
+    if (client.GetServerResource ().empty ())
+      {
+        sendError (jsonrpc::Errors::ERROR_RPC_INTERNAL_ERROR,
+                   "could not discover full server JID");
+        return true;
+      }
+
+    bool ok;
+    if (method == ANY_CHANGE_METHOD)
+      {
+        /* The callback may run after we are destroyed (when the parker
+           shuts down), so it gets its own copy of the method names.  */
+        std::map<std::string, std::string> methods;
+        for (const auto& entry : known)
+          methods[entry.first] = GetNotificationMethod (entry.first);
+
+        ok = parker.WaitAny (known,
+            [reply, prefix, methods] (const std::string& type,
+                                      const std::string& state)
+            {
+              Json::Value changed;
+              if (!type.empty ())
+                changed = methods.at (type);
+              reply->Send (prefix + "\"result\":{\"method\":"
+                             + SerialiseJson (changed)
+                             + ",\"state\":" + state + "}}");
+            });
+      }
+    else
+      ok = parker.Wait (mit->second, params[0],
+          [reply, prefix] (const std::string& state)
+          {
+            reply->Send (prefix + "\"result\":" + state + "}");
+          });
+    if (!ok)
+      sendError (ERROR_TOO_MANY_WAITS, "too many parked waits");
+
+    return true;
+  }
+
+  /**
+   * Handles a raw request from the transport.  Waits are parked, and all
+   * other requests are processed through the JSON-RPC server directly.
+   */
+  void
+  HandleRequest (const std::string& request,
+                 const std::shared_ptr<RpcTransport::Reply>& reply)
+  {
+    if (TryParkWait (request, reply))
+      return;
+
+    std::string response;
+    connector.ProcessRequest (request, response);
+    reply->Send (response);
+  }
+
 public:
 
-  explicit LocalServer (jsonrpc::AbstractServerConnector& conn,
-                        charon::Client& c)
+  explicit LocalServer (LocalConnector& conn, charon::Client& c,
+                        WaitParker& p)
     : jsonrpc::AbstractServer<LocalServer>(conn, jsonrpc::JSONRPC_SERVER_V2),
-      client(c)
+      connector(conn), client(c), parker(p)
   {
     jsonrpc::Procedure stopProc("stop", jsonrpc::PARAMS_BY_POSITION, nullptr);
     bindAndAddNotification (stopProc, &LocalServer::stop);
+
+    connector.SetRequestHandler ([this] (
+        const std::string& request,
+        const std::shared_ptr<RpcTransport::Reply>& reply)
+      {
+        HandleRequest (request, reply);
+      });
   }
 
   ~LocalServer ()
@@ -124,9 +362,28 @@ public:
   void
   AddNotification (const std::string& method, const charon::NotificationType& n)
   {
+    /* Waiting on multiple notifications is possible as soon as there
+       is one to wait for.  */
+    if (notifications.empty ())
+      AddMethod (ANY_CHANGE_METHOD);
+
     const auto res = notifications.emplace (method, n.GetType ());
     CHECK (res.second) << "Duplicate notification method: " << method;
     AddMethod (method);
+    parker.AddType (n);
+  }
+
+  /**
+   * Returns the RPC method name for the given notification type, or an
+   * empty string if there is none.
+   */
+  std::string
+  GetNotificationMethod (const std::string& type) const
+  {
+    for (const auto& entry : notifications)
+      if (entry.second == type)
+        return entry.first;
+    return "";
   }
 
   /**
@@ -136,7 +393,8 @@ public:
   Run ()
   {
     shouldStop = false;
-    StartListening ();
+    if (!StartListening ())
+      throw std::runtime_error ("failed to start the local RPC server");
 
     {
       std::unique_lock<std::mutex> lock(mut);
@@ -153,6 +411,33 @@ public:
   {
     const std::string method = proc.GetProcedureName ();
 
+    /* Like waits for a single notification below, this is only reached
+       if the call was not parked.  */
+    if (method == ANY_CHANGE_METHOD)
+      {
+        std::map<std::string, Json::Value> known;
+        if (!ParseAnyChangeParams (params, known))
+          throw jsonrpc::JsonRpcException (
+              jsonrpc::Errors::ERROR_RPC_INVALID_PARAMS,
+              ANY_CHANGE_METHOD + " expects an object of known state IDs"
+              " by enabled wait method");
+
+        std::string type;
+        Json::Value state;
+        result = Json::Value (Json::objectValue);
+        if (client.WaitForAnyChange (known, type, state))
+          {
+            result["method"] = GetNotificationMethod (type);
+            result["state"] = state;
+          }
+        else
+          {
+            result["method"] = Json::Value ();
+            result["state"] = Json::Value ();
+          }
+        return;
+      }
+
     const auto mit = notifications.find (method);
     if (mit != notifications.end ())
       {
@@ -161,6 +446,9 @@ public:
               jsonrpc::Errors::ERROR_RPC_INVALID_PARAMS,
               "wait method expects a single positional argument");
 
+        /* Waits are normally parked before getting here.  This is only
+           reached for them in other cases (e.g. as part of a batch), where
+           we block the worker thread instead.  */
         result = client.WaitForChange (mit->second, params[0]);
         return;
       }
@@ -183,11 +471,23 @@ private:
   /** The client JID (used for logging).  */
   const std::string clientJid;
 
+  /**
+   * The event stream server, if enabled.  This is declared before the
+   * client, so that it outlives the client's listener calling into it.
+   */
+  std::unique_ptr<EventStreamServer> events;
+
+  /**
+   * The parker for waits on the local RPC interface.  Like the event stream,
+   * it is updated from a listener on the client and thus declared before it.
+   */
+  WaitParker parker;
+
   /** The underlying Charon client.  */
   charon::Client client;
 
-  /** The HTTP server connector for the local RPC server.  */
-  jsonrpc::HttpServer httpServer;
+  /** The server connector for the local RPC server.  */
+  LocalConnector connector;
 
   /** The local RPC server.  */
   LocalServer rpcServer;
@@ -199,12 +499,32 @@ public:
   explicit Impl (const std::string& serverJid,
                  const std::string& backendVersion,
                  const std::string& cJid, const std::string& password,
-                 const int port)
+                 const LocalRpcConfig& rpc)
     : clientJid(cJid),
+      parker(rpc.maxParkedWaits, PARKED_WAIT_TIMEOUT),
       client(serverJid, backendVersion, clientJid, password),
-      httpServer(port),
-      rpcServer(httpServer, client)
-  {}
+      connector(GetTransportConfig (rpc)),
+      rpcServer(connector, client, parker)
+  {
+    client.AddNotificationListener ([this] (const std::string& type,
+                                            const Json::Value& state)
+      {
+        parker.Update (type, state);
+      });
+  }
+
+  /**
+   * Converts our config to the one for the RpcTransport.
+   */
+  static RpcTransport::Config
+  GetTransportConfig (const LocalRpcConfig& rpc)
+  {
+    RpcTransport::Config res;
+    res.port = rpc.port;
+    res.socketPath = rpc.socketPath;
+    res.workers = rpc.threads;
+    return res;
+  }
 
 };
 
@@ -213,18 +533,35 @@ UtilClient::UtilClient (const std::string& serverJid,
                         const std::string& clientJid,
                         const std::string& password,
                         const int port)
+  : UtilClient(serverJid, backendVersion, clientJid, password,
+               LocalRpcConfig::Http (port))
+{}
+
+UtilClient::UtilClient (const std::string& serverJid,
+                        const std::string& backendVersion,
+                        const std::string& clientJid,
+                        const std::string& password,
+                        const LocalRpcConfig& rpc)
 {
   CHECK (!serverJid.empty ());
   CHECK (!clientJid.empty ());
-  CHECK_GT (port, 0);
+  CHECK_GT (rpc.threads, 0);
 
   LOG (INFO) << "Using " << serverJid << " as server";
   LOG (INFO) << "Requiring backend version " << backendVersion;
-  LOG (INFO) << "Listening for local RPCs on port " << port;
+  if (rpc.socketPath.empty ())
+    {
+      CHECK_GT (rpc.port, 0);
+      LOG (INFO) << "Listening for local RPCs on port " << rpc.port;
+    }
+  else
+    LOG (INFO) << "Listening for local RPCs on socket " << rpc.socketPath;
+  LOG (INFO)
+      << "Using " << rpc.threads << " RPC worker threads and up to "
+      << rpc.maxParkedWaits << " parked waits";
 
   impl = std::make_unique<Impl> (serverJid, backendVersion,
-                                 clientJid, password,
-                                 port);
+                                 clientJid, password, rpc);
 }
 
 UtilClient::~UtilClient () = default;
@@ -257,12 +594,118 @@ UtilClient::EnableWaitForPendingChange ()
   impl->client.AddNotification (std::move (n));
 }
 
+void
+UtilClient::EnableWaitForPendingChange (const std::string& filter)
+{
+  Json::CharReaderBuilder rbuilder;
+  rbuilder["allowComments"] = false;
+  rbuilder["strictRoot"] = false;
+  rbuilder["failIfExtra"] = true;
+  rbuilder["rejectDupKeys"] = true;
+
+  std::istringstream in(filter);
+  Json::Value spec;
+  std::string parseErrs;
+  NotificationFilter f;
+  if (!Json::parseFromStream (rbuilder, in, &spec, &parseErrs)
+        || !f.Parse (spec))
+    throw std::runtime_error ("invalid notification filter: " + filter);
+
+  auto n = std::make_unique<charon::PendingChangeNotification> ();
+  impl->rpcServer.AddNotification ("waitforpendingchange", *n);
+  impl->client.AddFilteredNotification (std::move (n), f);
+}
+
+void
+UtilClient::EnableNotification (const NotificationConfig& cfg)
+{
+  auto n = cfg.CreateNotification ();
+  impl->rpcServer.AddNotification (cfg.method, *n);
+  impl->client.AddNotification (std::move (n));
+}
+
+void
+UtilClient::EnableRetries (const std::set<std::string>& methods,
+                           const unsigned attempts,
+                           const std::chrono::milliseconds perAttempt)
+{
+  LOG (INFO)
+      << "Retrying calls up to " << attempts << " times, with "
+      << perAttempt.count () << " ms per attempt";
+  impl->client.SetRetryPolicy (attempts, perAttempt);
+
+  for (const auto& m : methods)
+    {
+      LOG (INFO) << "Allowing retries for method: " << m;
+      impl->client.AllowRetries (m);
+    }
+}
+
+void
+UtilClient::EnableServerBreakers (const unsigned threshold,
+                                  const std::chrono::milliseconds cooldown)
+{
+  LOG (INFO)
+      << "Avoiding servers for " << cooldown.count () << " ms after "
+      << threshold << " failed calls";
+  impl->client.EnableServerBreakers (threshold, cooldown);
+}
+
+void
+UtilClient::EnableEventStream (const int port)
+{
+  CHECK (impl->events == nullptr) << "Event stream is already enabled";
+  impl->events = std::make_unique<EventStreamServer> (port);
+
+  Impl& self = *impl;
+  self.client.AddNotificationListener ([&self] (const std::string& type,
+                                                const Json::Value& state)
+    {
+      const auto method = self.rpcServer.GetNotificationMethod (type);
+      if (!method.empty ())
+        self.events->Publish (method, state);
+    });
+}
+
 void
 UtilClient::SetRootCA (const std::string& path)
 {
   impl->client.SetRootCA (path);
 }
 
+void
+UtilClient::SetStreamCompression (const bool enable)
+{
+  impl->client.SetStreamCompression (enable);
+}
+
+void
+UtilClient::SetConnections (const unsigned n)
+{
+  LOG (INFO) << "Using " << n << " XMPP connections for forwarded calls";
+  impl->client.SetConnections (n);
+}
+
+void
+UtilClient::SetDirectPush (const bool enable)
+{
+  impl->client.SetDirectPush (enable);
+}
+
+void
+UtilClient::AddPreferredPubSub (const std::string& service)
+{
+  LOG (INFO) << "Preferring pubsub service " << service;
+  impl->client.AddPreferredPubSub (service);
+}
+
+void
+UtilClient::AddEndpoint (const std::string& jid, const std::string& password)
+{
+  LOG (INFO) << "Adding XMPP endpoint " << jid;
+  impl->client.AddEndpoint (jid, password);
+}
+
 void
 UtilClient::Run (const bool detectServer)
 {
@@ -19,6 +19,7 @@
 #ifndef CHARON_UTILS_CLIENT_HPP
 #define CHARON_UTILS_CLIENT_HPP
 
+#include <chrono>
 #include <memory>
 #include <set>
 #include <string>
@@ -26,6 +27,50 @@
 namespace charon
 {
 
+struct NotificationConfig;
+
+/**
+ * Configuration of the local RPC interface of a UtilClient.
+ */
+struct LocalRpcConfig
+{
+
+  /** Port for serving HTTP.  Only used if socketPath is empty.  */
+  int port = 0;
+
+  /**
+   * If not empty, serve on a Unix domain socket at this path instead of
+   * HTTP.  Each connection to it carries a single JSON-RPC request terminated
+   * by a newline, and the response is returned the same way.
+   */
+  std::string socketPath;
+
+  /**
+   * Number of worker threads processing calls.  Waits (like waitforchange)
+   * are parked instead of blocking a worker, so this only needs to cover
+   * the concurrent forwarded calls.
+   */
+  unsigned threads = 50;
+
+  /**
+   * Maximum number of waits that can be parked at the same time.  Further
+   * waits are rejected with an error.
+   */
+  unsigned maxParkedWaits = 1'000;
+
+  /**
+   * Returns a config for HTTP on the given port with default settings.
+   */
+  static LocalRpcConfig
+  Http (const int p)
+  {
+    LocalRpcConfig res;
+    res.port = p;
+    return res;
+  }
+
+};
+
 /**
  * A simple wrapper around the full-fledged Charon client, which allows
  * to spin up a Charon client with local RPC interface easily.  This is used
@@ -45,7 +90,8 @@ private:
 public:
 
   /**
-   * Constructs a new client with the given base data.
+   * Constructs a new client with the given base data, serving the local
+   * RPC interface over HTTP on the given port.
    */
   explicit UtilClient (const std::string& serverJid,
                        const std::string& backendVersion,
@@ -53,6 +99,16 @@ public:
                        const std::string& password,
                        int port);
 
+  /**
+   * Constructs a new client with the given base data and configuration
+   * of the local RPC interface.
+   */
+  explicit UtilClient (const std::string& serverJid,
+                       const std::string& backendVersion,
+                       const std::string& clientJid,
+                       const std::string& password,
+                       const LocalRpcConfig& rpc);
+
   ~UtilClient ();
 
   /**
@@ -70,6 +126,40 @@ public:
    */
   void EnableWaitForPendingChange ();
 
+  /**
+   * Turns on the waitforpendingchange notification, but only for the
+   * part of the pending state selected by the given filter (in the JSON
+   * format of NotificationFilter).  Throws if the filter is invalid.
+   */
+  void EnableWaitForPendingChange (const std::string& filter);
+
+  /**
+   * Turns on a notification for some other long-polling method, which
+   * is exposed on the local RPC interface with the configured name.
+   */
+  void EnableNotification (const NotificationConfig& cfg);
+
+  /**
+   * Enables retries of calls to the given (idempotent) methods, with up to
+   * the given number of attempts that each time out after perAttempt.
+   */
+  void EnableRetries (const std::set<std::string>& methods, unsigned attempts,
+                      std::chrono::milliseconds perAttempt);
+
+  /**
+   * Enables per-server circuit breakers, which avoid a server instance
+   * for the cooldown period after threshold failed calls in a row.
+   */
+  void EnableServerBreakers (unsigned threshold,
+                             std::chrono::milliseconds cooldown);
+
+  /**
+   * Starts serving Server-Sent Events on the given local port, which push
+   * every new state of the enabled notifications to connected frontends.
+   * The events are named after the local RPC methods (e.g. waitforchange).
+   */
+  void EnableEventStream (int port);
+
   /**
    * Sets the root CA file to use for verifying the XMPP server's
    * certificate.  If this method is not used, then by default the
@@ -77,6 +167,33 @@ public:
    */
   void SetRootCA (const std::string& path);
 
+  /**
+   * Enables or disables XMPP stream compression.
+   */
+  void SetStreamCompression (bool enable);
+
+  /**
+   * Sets the number of XMPP connections over which forwarded calls
+   * are distributed.
+   */
+  void SetConnections (unsigned n);
+
+  /**
+   * Enables or disables direct push of notifications from the server.
+   */
+  void SetDirectPush (bool enable);
+
+  /**
+   * Adds a preferred pubsub service for notifications.
+   */
+  void AddPreferredPubSub (const std::string& service);
+
+  /**
+   * Adds a further XMPP account (e.g. on another XMPP server) over which
+   * calls can be routed if it is healthier.
+   */
+  void AddEndpoint (const std::string& jid, const std::string& password);
+
   /**
    * Runs the main loop, optionally detecting the server right away
    * (instead of just doing it as needed for RPC calls).  This connects
@@ -0,0 +1,284 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "waitparker.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace charon
+{
+
+namespace
+{
+
+/**
+ * Serialises a JSON value compactly.
+ */
+std::shared_ptr<const std::string>
+Serialise (const Json::Value& val)
+{
+  Json::StreamWriterBuilder wbuilder;
+  wbuilder["commentStyle"] = "None";
+  wbuilder["indentation"] = "";
+
+  return std::make_shared<const std::string> (Json::writeString (wbuilder,
+                                                                 val));
+}
+
+} // anonymous namespace
+
+WaitParker::WaitParker (const size_t maxWaits,
+                        const std::chrono::milliseconds to)
+  : maxParked(maxWaits), timeout(to), nullState(Serialise (Json::Value ()))
+{
+  timerThread = std::make_unique<std::thread> ([this] ()
+    {
+      RunTimer ();
+    });
+}
+
+WaitParker::~WaitParker ()
+{
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    shouldStop = true;
+    cv.notify_all ();
+  }
+  timerThread->join ();
+
+  for (auto& w : waiters)
+    {
+      const auto c = TimedOut (w);
+      c.cb (c.type, *c.state);
+    }
+}
+
+void
+WaitParker::AddType (const NotificationType& n)
+{
+  std::lock_guard<std::mutex> lock(mut);
+
+  TypeState t;
+  t.notification = &n;
+  t.state = nullState;
+
+  const auto res = types.emplace (n.GetType (), std::move (t));
+  CHECK (res.second) << "Duplicate notification type: " << n.GetType ();
+}
+
+bool
+WaitParker::HasType (const std::string& type) const
+{
+  /* Types are only added during setup, before any concurrent access.  */
+  return types.count (type) > 0;
+}
+
+WaitParker::Completion
+WaitParker::TimedOut (Waiter& w) const
+{
+  Completion res;
+  res.cb = std::move (w.cb);
+  if (w.any)
+    res.state = nullState;
+  else
+    {
+      res.type = w.types.front ();
+      res.state = types.at (res.type).state;
+    }
+
+  return res;
+}
+
+void
+WaitParker::Update (const std::string& type, const Json::Value& state)
+{
+  std::vector<AnyCallback> done;
+  std::shared_ptr<const std::string> serialised;
+
+  {
+    std::lock_guard<std::mutex> lock(mut);
+
+    const auto mit = types.find (type);
+    if (mit == types.end ())
+      return;
+
+    auto& t = mit->second;
+    t.hasState = true;
+    t.state = Serialise (state);
+    t.stateId = t.notification->ExtractStateId (state);
+    serialised = t.state;
+
+    for (auto it = waiters.begin (); it != waiters.end (); )
+      if (std::find (it->types.begin (), it->types.end (), type)
+            != it->types.end ())
+        {
+          done.push_back (std::move (it->cb));
+          it = waiters.erase (it);
+        }
+      else
+        ++it;
+  }
+
+  VLOG (1) << "Completing " << done.size () << " parked waits for " << type;
+  for (const auto& cb : done)
+    cb (type, *serialised);
+}
+
+bool
+WaitParker::Park (std::vector<std::string>&& waitTypes, const bool any,
+                  const AnyCallback& cb)
+{
+  if (waiters.size () >= maxParked)
+    {
+      LOG (WARNING)
+          << "Too many parked waits (" << waiters.size ()
+          << "), rejecting wait";
+      return false;
+    }
+
+  Waiter w;
+  w.types = std::move (waitTypes);
+  w.any = any;
+  w.deadline = Clock::now () + timeout;
+  w.cb = cb;
+
+  const bool wasEmpty = waiters.empty ();
+  waiters.push_back (std::move (w));
+  if (wasEmpty)
+    cv.notify_all ();
+
+  return true;
+}
+
+bool
+WaitParker::Wait (const std::string& type, const Json::Value& known,
+                  const Callback& cb)
+{
+  std::shared_ptr<const std::string> current;
+
+  {
+    std::lock_guard<std::mutex> lock(mut);
+
+    const auto mit = types.find (type);
+    CHECK (mit != types.end ()) << "Notification type not enabled: " << type;
+    const auto& t = mit->second;
+
+    if (!t.hasState || known == t.notification->AlwaysBlockId ()
+          || known == t.stateId)
+      return Park ({type}, false,
+                   [cb] (const std::string& changed, const std::string& state)
+                   {
+                     cb (state);
+                   });
+
+    current = t.state;
+  }
+
+  VLOG (1) << "Known state ID for " << type << " is outdated";
+  cb (*current);
+  return true;
+}
+
+bool
+WaitParker::WaitAny (const std::map<std::string, Json::Value>& known,
+                     const AnyCallback& cb)
+{
+  CHECK (!known.empty ());
+
+  std::string outdated;
+  std::shared_ptr<const std::string> current;
+
+  {
+    std::lock_guard<std::mutex> lock(mut);
+
+    std::vector<std::string> waitTypes;
+    for (const auto& entry : known)
+      {
+        const auto mit = types.find (entry.first);
+        CHECK (mit != types.end ())
+            << "Notification type not enabled: " << entry.first;
+        const auto& t = mit->second;
+
+        if (t.hasState && entry.second != t.notification->AlwaysBlockId ()
+              && entry.second != t.stateId)
+          {
+            outdated = entry.first;
+            current = t.state;
+            break;
+          }
+
+        waitTypes.push_back (entry.first);
+      }
+
+    if (current == nullptr)
+      return Park (std::move (waitTypes), true, cb);
+  }
+
+  VLOG (1) << "Known state ID for " << outdated << " is outdated";
+  cb (outdated, *current);
+  return true;
+}
+
+size_t
+WaitParker::GetNumParked ()
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return waiters.size ();
+}
+
+void
+WaitParker::RunTimer ()
+{
+  std::unique_lock<std::mutex> lock(mut);
+  while (true)
+    {
+      if (shouldStop)
+        return;
+
+      if (waiters.empty ())
+        {
+          cv.wait (lock);
+          continue;
+        }
+
+      const auto deadline = waiters.front ().deadline;
+      if (Clock::now () < deadline)
+        {
+          cv.wait_until (lock, deadline);
+          continue;
+        }
+
+      std::vector<Completion> done;
+      const auto now = Clock::now ();
+      while (!waiters.empty () && waiters.front ().deadline <= now)
+        {
+          done.push_back (TimedOut (waiters.front ()));
+          waiters.pop_front ();
+        }
+
+      lock.unlock ();
+      VLOG (1) << "Timing out " << done.size () << " parked waits";
+      for (const auto& c : done)
+        c.cb (c.type, *c.state);
+      lock.lock ();
+    }
+}
+
+} // namespace charon
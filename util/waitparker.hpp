@@ -0,0 +1,241 @@
+/*
+    Charon - a transport system for GSP data
+    Copyright (C) 2026  Autonomous Worlds Ltd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARON_UTILS_WAITPARKER_HPP
+#define CHARON_UTILS_WAITPARKER_HPP
+
+#include "notifications.hpp"
+
+#include <json/json.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace charon
+{
+
+/**
+ * Tracks long-polling waits (like waitforchange) on the local RPC interface
+ * without blocking a thread for each of them.  It keeps the current state
+ * of each notification type, updated from the Charon client's notification
+ * listener, and completes parked waits through callbacks when a new state
+ * arrives or their timeout expires.
+ *
+ * The semantics match Client::WaitForChange:  If the known state ID differs
+ * from the current one, the wait returns immediately.  Otherwise it returns
+ * the state after the next update, or the unchanged state on timeout.
+ * Waits for multiple types at once match Client::WaitForAnyChange.
+ */
+class WaitParker
+{
+
+public:
+
+  /**
+   * Callback for completing a wait.  It receives the resulting state
+   * already serialised as JSON, so that the work is shared between all
+   * waits completed by the same update.  Callbacks are invoked without
+   * any locks held, possibly on the thread delivering the update.
+   */
+  using Callback = std::function<void (const std::string& state)>;
+
+  /**
+   * Callback for completing a wait for multiple types.  It receives the type
+   * that changed and its serialised state, or an empty type and "null"
+   * if the wait timed out.
+   */
+  using AnyCallback
+      = std::function<void (const std::string& type, const std::string& state)>;
+
+private:
+
+  /** Clock used for the timeouts.  */
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Current state of one notification type.
+   */
+  struct TypeState
+  {
+
+    /** The notification type, used to extract state IDs.  */
+    const NotificationType* notification;
+
+    /** Whether we have received a state yet.  */
+    bool hasState = false;
+
+    /** The current state serialised as JSON.  */
+    std::shared_ptr<const std::string> state;
+
+    /** The current state's ID.  */
+    Json::Value stateId;
+
+  };
+
+  /**
+   * A parked wait.
+   */
+  struct Waiter
+  {
+
+    /** The notification types this is waiting for.  */
+    std::vector<std::string> types;
+
+    /**
+     * Whether this is a wait for any of multiple types.  In that case,
+     * a timeout is signalled with an empty type instead of the state.
+     */
+    bool any;
+
+    /** When the wait times out.  */
+    Clock::time_point deadline;
+
+    /** The callback to complete it with.  */
+    AnyCallback cb;
+
+  };
+
+  /**
+   * A wait that is being completed (outside of the lock).
+   */
+  struct Completion
+  {
+    AnyCallback cb;
+    std::string type;
+    std::shared_ptr<const std::string> state;
+  };
+
+  /** Maximum number of parked waits.  */
+  const size_t maxParked;
+
+  /** Timeout for parked waits.  */
+  const std::chrono::milliseconds timeout;
+
+  /** Mutex for the internal state.  */
+  std::mutex mut;
+
+  /** Condition variable to wake up the timer thread.  */
+  std::condition_variable cv;
+
+  /** Set to true when the timer thread should stop.  */
+  bool shouldStop = false;
+
+  /** The notification types by their type string.  */
+  std::map<std::string, TypeState> types;
+
+  /**
+   * The parked waits.  Since the timeout is the same for all of them,
+   * they are ordered by deadline.
+   */
+  std::list<Waiter> waiters;
+
+  /** Thread completing waits on timeout.  */
+  std::unique_ptr<std::thread> timerThread;
+
+  /** Serialised JSON null, used for timed out waits on multiple types.  */
+  std::shared_ptr<const std::string> nullState;
+
+  /**
+   * Runs the loop of the timer thread.
+   */
+  void RunTimer ();
+
+  /**
+   * Returns the completion for a waiter that timed out.  Must be called
+   * with the lock held.
+   */
+  Completion TimedOut (Waiter& w) const;
+
+  /**
+   * Parks a wait for the given types if the limit allows it.  Must be called
+   * with the lock held.
+   */
+  bool Park (std::vector<std::string>&& types, bool any, const AnyCallback& cb);
+
+public:
+
+  /**
+   * Constructs the parker with the given limit on parked waits and timeout
+   * for each of them.
+   */
+  explicit WaitParker (size_t maxWaits, std::chrono::milliseconds to);
+
+  /**
+   * Stops the parker.  All waits still parked are completed with the
+   * current state.
+   */
+  ~WaitParker ();
+
+  WaitParker () = delete;
+  WaitParker (const WaitParker&) = delete;
+  void operator= (const WaitParker&) = delete;
+
+  /**
+   * Adds a notification type that can be waited for.  The instance must
+   * stay valid while this parker is in use.
+   */
+  void AddType (const NotificationType& n);
+
+  /**
+   * Returns true if the given type has been added.
+   */
+  bool HasType (const std::string& type) const;
+
+  /**
+   * Processes a new state of a notification and completes all waits
+   * parked for it.  This can be used as the Charon client's notification
+   * listener directly.
+   */
+  void Update (const std::string& type, const Json::Value& state);
+
+  /**
+   * Starts a wait for the given type with the known state ID.  Returns false
+   * (without calling the callback) if too many waits are parked already.
+   * Otherwise the callback is invoked exactly once, either right away or
+   * later when the wait is completed.
+   */
+  bool Wait (const std::string& type, const Json::Value& known,
+             const Callback& cb);
+
+  /**
+   * Starts a wait for any of multiple types, given as map from type to
+   * known state ID.  Returns false if too many waits are parked.  Otherwise
+   * the callback is invoked exactly once, like for Wait.
+   */
+  bool WaitAny (const std::map<std::string, Json::Value>& known,
+                const AnyCallback& cb);
+
+  /**
+   * Returns the number of currently parked waits.
+   */
+  size_t GetNumParked ();
+
+};
+
+} // namespace charon
+
+#endif // CHARON_UTILS_WAITPARKER_HPP